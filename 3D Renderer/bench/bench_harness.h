@@ -0,0 +1,188 @@
+// bench_harness.h
+// shared timing harness for the microbenchmarks: warmup, repeated timed runs, median and p99,
+// a console table and json results that later runs can be compared against
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include "../core/cpu_features.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// keep value (and whatever it points to) alive, so the compiler cannot drop the work behind it
+template <typename T>
+inline void keep_result(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    std::string unit;       // what one item is: a matrix, a pixel, a byte
+    uint64_t items = 0;     // items per call of the benchmark body
+    int repetitions = 0;
+    int calls = 0;          // body calls per repetition, so each repetition is long enough to time
+    double median_ns = 0.0; // per item, as every statistic below
+    double p99_ns = 0.0;
+    double min_ns = 0.0;
+    double mean_ns = 0.0;
+};
+
+// command line: --reps N, --warmup N, --filter TEXT (run benchmarks whose name contains TEXT),
+// --json PATH (default SUITE.json), --label TEXT (stored with the results, e.g. the commit),
+// --baseline PATH (an earlier json file; medians are compared by name)
+class BenchHarness {
+public:
+    BenchHarness(const char* suite_name, int argc, char** argv) : suite(suite_name), json_path(suite + ".json") {
+        for (int i = 1; i < argc; i++) {
+            bool has_value = i + 1 < argc;
+            if (std::strcmp(argv[i], "--reps") == 0 && has_value) {
+                repetitions = std::max(1, std::atoi(argv[++i]));
+            } else if (std::strcmp(argv[i], "--warmup") == 0 && has_value) {
+                warmup = std::max(0, std::atoi(argv[++i]));
+            } else if (std::strcmp(argv[i], "--filter") == 0 && has_value) {
+                filter = argv[++i];
+            } else if (std::strcmp(argv[i], "--json") == 0 && has_value) {
+                json_path = argv[++i];
+            } else if (std::strcmp(argv[i], "--label") == 0 && has_value) {
+                label = argv[++i];
+            } else if (std::strcmp(argv[i], "--baseline") == 0 && has_value) {
+                load_baseline(argv[++i]);
+            }
+        }
+        std::printf("%s: %d warmup and %d timed repetitions of at least %.1f ms, times per item%s%s\n\n",
+                    suite.c_str(), warmup, repetitions, MIN_REPETITION_NS / 1e6, label.empty() ? "" : ", ",
+                    label.c_str());
+        std::printf("%-28s %-8s %12s %12s %12s %14s%s\n", "benchmark", "unit", "median ns", "p99 ns", "min ns",
+                    "items/s", baseline.empty() ? "" : "   vs baseline");
+    }
+    
+    // time body(), which processes items units of work per call; the first warmup calls also
+    // size the number of calls per repetition
+    template <typename F>
+    void run(const std::string& name, const char* unit, uint64_t items, F&& body) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        using Clock = std::chrono::steady_clock;
+        
+        int calls = 1;
+        for (int w = 0; w < std::max(1, warmup); w++) {
+            auto start = Clock::now();
+            for (int c = 0; c < calls; c++) body();
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (ns < MIN_REPETITION_NS) calls = (int)std::min(1e6, std::ceil(calls * MIN_REPETITION_NS / std::max(ns, 1.0)));
+        }
+        
+        std::vector<double> per_item(repetitions);
+        for (int r = 0; r < repetitions; r++) {
+            auto start = Clock::now();
+            for (int c = 0; c < calls; c++) body();
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            per_item[r] = ns / ((double)calls * std::max<uint64_t>(1, items));
+        }
+        
+        BenchResult result;
+        result.name = name;
+        result.unit = unit;
+        result.items = items;
+        result.repetitions = repetitions;
+        result.calls = calls;
+        double sum = 0.0;
+        for (double ns : per_item) sum += ns;
+        result.mean_ns = sum / repetitions;
+        std::sort(per_item.begin(), per_item.end());
+        result.median_ns = per_item[repetitions / 2];
+        result.p99_ns = per_item[std::min(repetitions - 1, (int)std::ceil(0.99 * repetitions) - 1)];
+        result.min_ns = per_item[0];
+        results.push_back(result);
+        
+        std::printf("%-28s %-8s %12.3f %12.3f %12.3f %14.4g", name.c_str(), unit, result.median_ns, result.p99_ns,
+                    result.min_ns, 1e9 / result.median_ns);
+        for (const auto& base : baseline) {
+            if (base.first != name) continue;
+            // above 1 is faster than the baseline; noise of a few percent is normal
+            double speedup = base.second / result.median_ns;
+            std::printf("   %6.2fx%s", speedup, speedup < 1.0 / REGRESSION_RATIO ? " slower" : "");
+        }
+        std::printf("\n");
+    }
+    
+    // write the results as json, one result object per line; returns false when the file cannot be written
+    bool finish() {
+        std::ofstream file(json_path);
+        if (!file) {
+            std::cerr << "Error: Could not write benchmark results to " << json_path << std::endl;
+            return false;
+        }
+        file << "{\n";
+        file << "  \"suite\": \"" << suite << "\",\n";
+        file << "  \"label\": \"" << escape(label) << "\",\n";
+        file << "  \"simd\": \"" << simd_level_name(detect_simd_level()) << "\",\n";
+        file << "  \"compiler\": \"" << escape(__VERSION__) << "\",\n";
+        file << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"unit\": \"%s\", \"items\": %llu, \"repetitions\": %d, "
+                          "\"calls\": %d, \"median_ns\": %.6g, \"p99_ns\": %.6g, \"min_ns\": %.6g, \"mean_ns\": %.6g}%s\n",
+                          escape(r.name).c_str(), escape(r.unit).c_str(), (unsigned long long)r.items, r.repetitions,
+                          r.calls, r.median_ns, r.p99_ns, r.min_ns, r.mean_ns, i + 1 < results.size() ? "," : "");
+            file << line;
+        }
+        file << "  ]\n}\n";
+        std::printf("\nresults written to %s\n", json_path.c_str());
+        return (bool)file;
+    }
+    
+private:
+    // repetitions shorter than this are mostly timer overhead
+    static constexpr double MIN_REPETITION_NS = 2e6;
+    
+    // medians this much slower than the baseline are flagged
+    static constexpr double REGRESSION_RATIO = 1.1;
+    
+    std::string suite;
+    std::string json_path;
+    std::string label;
+    std::string filter;
+    int warmup = 3;
+    int repetitions = 31;
+    std::vector<BenchResult> results;
+    std::vector<std::pair<std::string, double>> baseline;  // name and median ns of an earlier run
+    
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if ((unsigned char)c >= 0x20) escaped += c;
+        }
+        return escaped;
+    }
+    
+    // reads the files finish() writes, which keep each result on its own line
+    void load_baseline(const char* path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Error: Could not read benchmark baseline " << path << std::endl;
+            return;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t name = line.find("\"name\": \"");
+            size_t median = line.find("\"median_ns\": ");
+            if (name == std::string::npos || median == std::string::npos) continue;
+            name += 9;
+            size_t end = line.find('"', name);
+            baseline.emplace_back(line.substr(name, end - name), std::atof(line.c_str() + median + 13));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+// clip_bench.cpp
+// camera fly-through that grazes and passes through geometry
+// reports the frame time distribution and how much work the clip stage rejected and cut
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int FRAMES = 240;
+    const int ROWS = 12;  // pairs of objects lining the flight path
+    
+    void build_scene(Scene& scene) {
+        scene.clear_scene();
+        Material red(Vec3(0.8f, 0.3f, 0.3f), Vec3(1, 1, 1), 32.0f);
+        Material blue(Vec3(0.3f, 0.4f, 0.9f), Vec3(1, 1, 1), 64.0f);
+        
+        // objects on both sides of the path and some straddling it, so the camera passes close
+        // to and right through them
+        for (int r = 0; r < ROWS; r++) {
+            float z = -4.0f * r;
+            for (int side = -1; side <= 1; side += 2) {
+                Mesh sphere = Mesh::create_sphere(1.2f, 48, blue);
+                sphere.transform = Mat4::translation(Vec3(side * (0.9f + 0.3f * (r % 3)), 0.2f * side, z));
+                scene.add_mesh(sphere);
+            }
+            Mesh cube = Mesh::create_cube(2.0f, red);
+            cube.transform = Mat4::translation(Vec3(0.0f, (r % 2) ? 1.3f : -1.3f, z - 2.0f)) *
+                             Mat4::rotation_y(0.4f * r);
+            scene.add_mesh(cube);
+        }
+        
+        scene.add_light(Light(LightType::POINT, Vec3(0, 3, 2), Vec3(1, 1, 1), 1.0f));
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.3f, -1, -0.5f), Vec3(0.4f, 0.4f, 0.4f), 0.6f));
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // weaving path down the row of objects, always looking ahead
+    void place_camera(Camera& camera, int frame) {
+        float t = (float)frame / FRAMES;
+        float z = 4.0f - t * 4.0f * (ROWS + 1);
+        Vec3 position(0.8f * std::sin(t * 19.0f), 0.5f * std::sin(t * 11.0f), z);
+        camera.position = position;
+        camera.target = position + Vec3(0.3f * std::cos(t * 19.0f), 0.0f, -1.0f);
+    }
+    
+    double percentile(std::vector<double> values, double p) {
+        std::sort(values.begin(), values.end());
+        size_t index = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+        return values[index];
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    build_scene(scene);
+    
+    std::printf("clip stage, fly-through of %zu meshes, %d frames, %dx%d, %d thread(s)\n\n",
+                scene.get_mesh_count(), FRAMES, WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-10s %9s %9s %9s %9s %12s %10s %10s %12s\n", "mode", "median", "p99", "max", "ms total",
+                "triangles", "rejected", "clipped", "fragments");
+    
+    for (bool wireframe : {false, true}) {
+        std::vector<double> times;
+        GeometryStats geometry;
+        uint64_t fragments = 0;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            place_camera(scene.camera, frame);
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, wireframe);
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            
+            const GeometryStats& stats = renderer.get_geometry_stats();
+            geometry.triangles_submitted += stats.triangles_submitted;
+            geometry.triangles_rejected += stats.triangles_rejected;
+            geometry.triangles_clipped += stats.triangles_clipped;
+            fragments += renderer.get_raster_stats().fragments_written;
+        }
+        
+        double total = 0.0;
+        for (double t : times) total += t;
+        std::printf("%-10s %9.3f %9.3f %9.3f %9.1f %12llu %10llu %10llu %12llu\n", wireframe ? "wireframe" : "solid",
+                    percentile(times, 0.5), percentile(times, 0.99), percentile(times, 1.0), total,
+                    (unsigned long long)geometry.triangles_submitted,
+                    (unsigned long long)geometry.triangles_rejected,
+                    (unsigned long long)geometry.triangles_clipped, (unsigned long long)fragments);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,271 @@
+// compact_bench.cpp
+// large scanned-looking meshes stored as full meshes versus the quantized compact encoding
+// reports memory per vertex and triangle, encoding error, vertex stage and frame times, and image differences;
+// smooth frames should match the full mesh, flat ones pay for face normals rebuilt per triangle
+// exits with an error when compact face normals alone change flat shading by more than a few levels
+
+#include "../rendering/renderer.h"
+#include "../rendering/rasterizer.h"
+#include "../scene/scene.h"
+#include "../geometry/compact_mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int FRAMES = 7;
+    
+    // largest channel difference flat shading may show from compact face normals alone
+    const int MAX_FLAT_NORMAL_DIFFERENCE = 8;
+    
+    // a lumpy sphere with fine surface noise, standing in for a scan: every vertex is moved
+    // along its normal, then face and vertex normals are rebuilt from the new surface
+    Mesh make_scan(int segments) {
+        Mesh scan = Mesh::create_sphere(1.0f, segments, Material(Vec3(0.7f, 0.6f, 0.5f), Vec3(0.3f, 0.3f, 0.3f), 16.0f));
+        for (auto& vertex : scan.vertices) {
+            const Vec3& p = vertex.position;
+            float lumps = 0.08f * std::sin(5.0f * p.x) * std::sin(4.0f * p.y + 1.0f) * std::sin(6.0f * p.z);
+            float grain = 0.004f * std::sin(97.0f * p.x + 31.0f * p.y) * std::cos(83.0f * p.z);
+            vertex.position = p * (1.0f + lumps + grain);
+        }
+        for (auto& triangle : scan.triangles) {
+            triangle.calculate_normal(scan.vertices);
+        }
+        scan.calculate_vertex_normals();
+        scan.update_bounds();
+        scan.transform = Mat4::rotation_y(0.4f) * Mat4::scale(Vec3(1.2f, 1.0f, 1.1f));
+        return scan;
+    }
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    template <typename Fn>
+    double best_time_ms(Fn&& fn, int repetitions = 7) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min(best, elapsed_ms(start));
+        }
+        return best;
+    }
+    
+    // worst position error as a fraction of the bounds diagonal, and worst normal error in degrees
+    void encoding_error(const Mesh& mesh, const CompactMesh& compact, double& position_error, double& normal_degrees) {
+        Vec3 diagonal = mesh.get_bounds().max - mesh.get_bounds().min;
+        double worst_position = 0.0, worst_cos = 1.0;
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            Vec3 offset = compact.decode_position(compact.vertices[i]) - mesh.vertices[i].position;
+            worst_position = std::max(worst_position, (double)offset.length());
+            Vec3 normal = mesh.vertices[i].normal;
+            if (normal.length() == 0.0f) continue;
+            worst_cos = std::min(worst_cos, (double)CompactMesh::decode_normal(compact.vertices[i].normal).dot(normal));
+        }
+        position_error = worst_position / diagonal.length();
+        normal_degrees = std::acos(std::min(1.0, worst_cos)) * 180.0 / M_PI;
+    }
+    
+    void setup_view(Scene& scene) {
+        scene.clear_scene();
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.5f, -0.8f, -0.6f), Vec3(1, 1, 1), 0.9f));
+        scene.add_light(Light(LightType::POINT, Vec3(2, 2, 3), Vec3(1, 0.9f, 0.8f), 0.8f));
+        scene.camera.position = Vec3(0, 0.6f, 3.2f);
+        scene.camera.target = Vec3(0, 0, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    double median(std::vector<double> times) {
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+    
+    // the decoded mesh carries the compact face normals; with the original ones instead, flat
+    // shading differences between the two come from the normals alone
+    Mesh decoded_with_original_normals(const Mesh& mesh, const CompactMesh& compact) {
+        Mesh decoded = compact.decode();
+        for (size_t i = 0; i < decoded.triangles.size(); i++) {
+            decoded.triangles[i].normal = mesh.triangles[i].normal;
+        }
+        return decoded;
+    }
+    
+    std::vector<uint32_t> snapshot(Renderer& renderer) {
+        ImageView image = renderer.get_framebuffer().get_image();
+        std::vector<uint32_t> pixels;
+        for (int y = 0; y < image.height; y++) {
+            pixels.insert(pixels.end(), image.pixels + (size_t)y * image.stride,
+                          image.pixels + (size_t)y * image.stride + image.width);
+        }
+        return pixels;
+    }
+    
+    // frames of the two scenes alternate, so drift in clock speed or cache state hits both alike;
+    // returns the full scene's last image, and leaves the compact one's in the framebuffer
+    std::vector<uint32_t> median_frame_ms(Scene& full, Scene& compact, Renderer& renderer, bool flat_shading,
+                                          double& full_ms, double& compact_ms) {
+        std::vector<double> full_times, compact_times;
+        std::vector<uint32_t> full_image;
+        for (int f = 0; f < FRAMES; f++) {
+            auto start = std::chrono::steady_clock::now();
+            full.render(renderer, false, flat_shading);
+            full_times.push_back(elapsed_ms(start));
+            if (f == FRAMES - 1) full_image = snapshot(renderer);
+            
+            start = std::chrono::steady_clock::now();
+            compact.render(renderer, false, flat_shading);
+            compact_times.push_back(elapsed_ms(start));
+        }
+        full_ms = median(full_times);
+        compact_ms = median(compact_times);
+        return full_image;
+    }
+    
+    // pixels differing at all, pixels off by more than a few levels, and the largest channel difference
+    struct ImageDifference {
+        size_t pixels = 0;
+        size_t visible = 0;
+        int worst = 0;
+    };
+    
+    ImageDifference image_difference(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+        const int VISIBLE_LEVELS = 4;
+        ImageDifference difference;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i] == b[i]) continue;
+            int pixel_worst = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                pixel_worst = std::max(pixel_worst, std::abs((int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF)));
+            }
+            difference.pixels++;
+            if (pixel_worst > VISIBLE_LEVELS) difference.visible++;
+            difference.worst = std::max(difference.worst, pixel_worst);
+        }
+        return difference;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene, compact_scene;
+    const int segment_counts[] = {180, 500};  // below and above 64k vertices
+    
+    std::printf("compact meshes, %dx%d, %d thread(s)\n\n", WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-9s %9s %9s %6s %10s %10s %9s %9s %8s %11s %10s\n", "mesh", "vertices", "triangles", "index",
+                "full MB", "compact MB", "B/vert", "B/tri", "ratio", "pos error", "normal deg");
+    
+    std::vector<Mesh> scans;
+    std::vector<CompactMesh> compacts;
+    for (int segments : segment_counts) {
+        scans.push_back(make_scan(segments));
+        const Mesh& mesh = scans.back();
+        compacts.push_back(CompactMesh::encode(mesh));
+        const CompactMesh& compact = compacts.back();
+        
+        double position_error, normal_degrees;
+        encoding_error(mesh, compact, position_error, normal_degrees);
+        size_t full = mesh.memory_bytes(), packed = compact.memory_bytes();
+        size_t index_bytes = compact.indices16.empty() ? 4 : 2;
+        char name[32];
+        std::snprintf(name, sizeof(name), "scan %d", segments);
+        std::printf("%-9s %9zu %9zu %4zubit %10.2f %10.2f %4zu/%-4zu %4zu/%-4zu %7.2fx %11.2e %10.3f\n", name,
+                    mesh.vertices.size(), mesh.triangles.size(), index_bytes * 8, full / (1024.0 * 1024.0),
+                    packed / (1024.0 * 1024.0), sizeof(Vertex), sizeof(QuantizedVertex), sizeof(Triangle),
+                    3 * index_bytes, (double)full / packed, position_error, normal_degrees);
+    }
+    
+    // the vertex stage alone on the larger mesh, one thread, for every instruction set
+    const Mesh& mesh = scans.back();
+    const CompactMesh& compact = compacts.back();
+    size_t count = mesh.vertices.size();
+    Mat4 view_proj = scene.camera.get_projection_matrix() * scene.camera.get_view_matrix();
+    VertexTransform full_transform(mesh.transform, view_proj, WIDTH, HEIGHT);
+    VertexTransform compact_transform(compact.transform, compact.get_dequantize_matrix(), view_proj, WIDTH, HEIGHT);
+    std::vector<ScreenVertex> out(count), reference(count);
+    
+    std::printf("\nvertex stage, %zu vertices, one thread, best of 7, normals included\n\n", count);
+    std::printf("%-8s %10s %12s %10s %12s %9s %s\n", "simd", "full ms", "full GB/s", "compact ms", "compact GB/s",
+                "speedup", "");
+    const SimdLevel levels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+    for (SimdLevel level : levels) {
+        if (level > detect_simd_level()) continue;
+        set_raster_simd_level(level);
+        double full_ms = best_time_ms([&] {
+            transform_vertex_batch(full_transform, mesh.vertices.data(), count, out.data(), true);
+        });
+        double compact_ms = best_time_ms([&] {
+            transform_vertex_batch(compact_transform, compact.vertices.data(), count, out.data(), true);
+        });
+        
+        // the quantized kernels must agree bit for bit across instruction sets too
+        if (level == SimdLevel::SCALAR) reference = out;
+        bool identical = std::memcmp(reference.data(), out.data(), count * sizeof(ScreenVertex)) == 0;
+        std::printf("%-8s %10.3f %12.2f %10.3f %12.2f %8.2fx %s\n", simd_level_name(level), full_ms,
+                    count * sizeof(Vertex) / (full_ms * 1e6), compact_ms,
+                    count * sizeof(QuantizedVertex) / (compact_ms * 1e6), full_ms / compact_ms,
+                    identical ? "" : "MISMATCH");
+    }
+    set_raster_simd_level(detect_simd_level());
+    
+    // whole frames with each encoding, flat shading with face normals rebuilt from the quantized
+    // vertices and smooth shading from the octahedral normals
+    std::printf("\nframes, median of %d, alternating; compact flat shading rebuilds each face normal\n\n", FRAMES);
+    std::printf("%-9s %-8s %10s %10s %10s %10s %10s\n", "mesh", "shading", "full ms", "compact ms", "differ",
+                "off by >4", "max diff");
+    for (size_t m = 0; m < scans.size(); m++) {
+        for (bool flat_shading : {true, false}) {
+            setup_view(scene);
+            scene.add_mesh(scans[m]);
+            setup_view(compact_scene);
+            compact_scene.add_compact_mesh(compacts[m]);
+            double full_ms, compact_ms;
+            std::vector<uint32_t> full_image = median_frame_ms(scene, compact_scene, renderer, flat_shading, full_ms,
+                                                               compact_ms);
+            
+            ImageDifference difference = image_difference(full_image, snapshot(renderer));
+            char name[32];
+            std::snprintf(name, sizeof(name), "scan %d", segment_counts[m]);
+            std::printf("%-9s %-8s %10.2f %10.2f %10zu %10zu %10d\n", name, flat_shading ? "flat" : "smooth", full_ms,
+                        compact_ms, difference.pixels, difference.visible, difference.worst);
+        }
+    }
+    
+    // the frame differences above include pixels that quantized positions move between triangles;
+    // drawing the quantized positions with each set of face normals isolates the face normal loss
+    std::printf("\nflat shading, original against compact face normals on the quantized positions\n\n");
+    std::printf("%-9s %10s %10s %10s\n", "mesh", "differ", "off by >4", "max diff");
+    bool failed = false;
+    for (size_t m = 0; m < scans.size(); m++) {
+        setup_view(scene);
+        scene.add_mesh(decoded_with_original_normals(scans[m], compacts[m]));
+        scene.render(renderer, false, true);
+        std::vector<uint32_t> reference_image = snapshot(renderer);
+        
+        setup_view(scene);
+        scene.add_mesh(compacts[m].decode());
+        scene.render(renderer, false, true);
+        
+        ImageDifference difference = image_difference(reference_image, snapshot(renderer));
+        bool too_far = difference.worst > MAX_FLAT_NORMAL_DIFFERENCE;
+        char name[32];
+        std::snprintf(name, sizeof(name), "scan %d", segment_counts[m]);
+        std::printf("%-9s %10zu %10zu %10d%s\n", name, difference.pixels, difference.visible, difference.worst,
+                    too_far ? "  FAILED" : "");
+        failed = failed || too_far;
+    }
+    if (failed) {
+        std::printf("\nflat shading from compact face normals is off by more than %d levels\n", MAX_FLAT_NORMAL_DIFFERENCE);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// deferred_bench.cpp
+// forward versus deferred shading on a scene with heavy overdraw
+// a grid of sphere columns receding from the camera, submitted back to front, lit by several point lights
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int COLUMNS = 5, ROWS = 3, DEPTH = 8;  // DEPTH spheres stacked behind each other per column
+    
+    void build_scene(Scene& scene) {
+        scene.clear_scene();
+        Material material(Vec3(0.6f, 0.6f, 0.8f), Vec3(1, 1, 1), 48.0f);
+        
+        // farthest layer first, so every nearer sphere overwrites what is behind it
+        for (int d = DEPTH - 1; d >= 0; d--) {
+            for (int r = 0; r < ROWS; r++) {
+                for (int c = 0; c < COLUMNS; c++) {
+                    Mesh sphere = Mesh::create_sphere(0.9f, 32, material);
+                    sphere.transform = Mat4::translation(Vec3((c - COLUMNS / 2) * 1.6f + 0.3f * d,
+                                                              (r - ROWS / 2) * 1.6f + 0.2f * d,
+                                                              -1.5f * d));
+                    scene.add_mesh(sphere);
+                }
+            }
+        }
+        
+        scene.add_light(Light(LightType::POINT, Vec3(4, 4, 4), Vec3(1, 1, 1), 1.0f));
+        scene.add_light(Light(LightType::POINT, Vec3(-4, 2, 3), Vec3(1, 0.6f, 0.4f), 0.8f));
+        scene.add_light(Light(LightType::POINT, Vec3(0, -3, 5), Vec3(0.4f, 0.6f, 1), 0.8f));
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.3f, -1, -0.5f), Vec3(0.3f, 0.3f, 0.3f), 0.5f));
+        
+        scene.camera.position = Vec3(0, 0, 8);
+        scene.camera.target = Vec3(0, 0, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // best wall time of a full scene render over several runs
+    double best_time_ms(Scene& scene, Renderer& renderer, bool flat_shading, int repetitions = 10) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, flat_shading);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    build_scene(scene);
+    
+    std::printf("deferred shading, %zu spheres back to front, %zu lights, %dx%d, %d thread(s), best of 10\n\n",
+                scene.get_mesh_count(), scene.get_light_count(), WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-18s %10s %12s %12s %12s %10s\n", "mode", "ms", "fragments", "shaded px", "lighting", "overdraw");
+    
+    struct Case {
+        const char* name;
+        bool deferred;
+        bool flat_shading;
+    };
+    const Case cases[] = {
+        {"forward flat", false, true},
+        {"forward gouraud", false, false},
+        {"deferred flat", true, true},
+        {"deferred smooth", true, false},
+    };
+    
+    for (const Case& c : cases) {
+        renderer.set_deferred(c.deferred);
+        double ms = best_time_ms(scene, renderer, c.flat_shading);
+        const RasterStats& raster = renderer.get_raster_stats();
+        const ShadingStats& shading = renderer.get_shading_stats();
+        
+        // forward paths write a shaded color for every fragment that passes the depth test, and
+        // deferred flat shading keeps to them since its triangles are lit once each anyway
+        bool visibility = c.deferred && !c.flat_shading;
+        uint64_t shaded = visibility ? shading.pixels_shaded : raster.fragments_written;
+        std::printf("%-18s %10.3f %12llu %12llu %12llu", c.name, ms,
+                    (unsigned long long)raster.fragments_written, (unsigned long long)shaded,
+                    (unsigned long long)shading.lighting_evaluations);
+        
+        // the visible pixel count is only known once the deferred pass has resolved them
+        if (visibility && shaded) {
+            std::printf(" %9.2fx\n", (double)raster.fragments_written / shaded);
+        } else {
+            std::printf(" %10s\n", "-");
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,90 @@
+// encode_bench.cpp
+// image encoder throughput benchmark on a rendered 4k frame
+// compares the original ascii p3 writer against binary ppm, qoi and png (stored and fast deflate)
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include "../io/image_encoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+    const int WIDTH = 3840, HEIGHT = 2160;
+    
+    // the ascii p3 writer save_ppm used before the encoders: one formatted insert per channel
+    void legacy_write_p3(const ImageView& image, std::ostream& file) {
+        file << "P3\n" << image.width << " " << image.height << "\n255\n";
+        for (int y = 0; y < image.height; y++) {
+            for (int x = 0; x < image.width; x++) {
+                uint32_t c = image.pixels[(size_t)y * image.stride + x];
+                file << (int)(c & 0xFF) << " " << (int)((c >> 8) & 0xFF) << " " << (int)((c >> 16) & 0xFF) << "\n";
+            }
+        }
+    }
+    
+    // best wall time of fn over several runs
+    template <typename Fn>
+    double best_time_ms(Fn&& fn, int repetitions = 5) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+    
+    void report(const char* name, double ms, size_t bytes, double baseline_ms) {
+        double raw = (double)WIDTH * HEIGHT * 3;
+        std::printf("%-18s %10.2f %12.1f %12zu %8.1f%% %8.2fx\n", name, ms, raw / (ms * 1000.0), bytes,
+                    100.0 * bytes / raw, baseline_ms / ms);
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    scene.render(renderer);
+    ImageView image = renderer.get_framebuffer().get_image();
+    
+    std::printf("image encoders, %dx%d demo frame, %d thread(s), best of 5\n\n",
+                WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-18s %10s %12s %12s %9s %9s\n", "encoder", "ms", "MB/s in", "bytes", "size", "speedup");
+    
+    std::string legacy;
+    double legacy_ms = best_time_ms([&] {
+        std::ostringstream file;
+        legacy_write_p3(image, file);
+        legacy = file.str();
+    }, 2);
+    report("p3 ascii (legacy)", legacy_ms, legacy.size(), legacy_ms);
+    
+    // the pool is only used by png; qoi and ppm are sequential
+    ThreadPool pool;
+    struct Case {
+        const char* name;
+        ImageFormat format;
+        ThreadPool* pool;
+    };
+    const Case cases[] = {
+        {"ppm", ImageFormat::PPM, nullptr},
+        {"qoi", ImageFormat::QOI, nullptr},
+        {"png stored", ImageFormat::PNG_STORED, nullptr},
+        {"png stored, pool", ImageFormat::PNG_STORED, &pool},
+        {"png fast", ImageFormat::PNG, nullptr},
+        {"png fast, pool", ImageFormat::PNG, &pool},
+    };
+    
+    std::vector<uint8_t> bytes;
+    for (const Case& c : cases) {
+        std::unique_ptr<ImageEncoder> encoder = make_image_encoder(c.format, c.pool);
+        double ms = best_time_ms([&] { encoder->encode(image, bytes); });
+        report(c.name, ms, bytes.size(), legacy_ms);
+    }
+    
+    return 0;
+}
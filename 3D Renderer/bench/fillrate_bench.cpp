@@ -0,0 +1,153 @@
+// fillrate_bench.cpp
+// triangle fill-rate microbenchmark for the rasterizer kernels
+// compares the original per-pixel barycentric loop against the scalar, sse2 and avx2 edge-function paths
+
+#include "../rendering/rasterizer.h"
+#include "../math/color.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1024, HEIGHT = 1024;
+    const int TRIANGLES = 4096;
+    
+    // the per-pixel barycentric loop the renderer used before the edge-function rasterizer
+    // kept verbatim (sort into a heap vector, five dot products and a division per pixel)
+    void legacy_draw_triangle(Framebuffer& framebuffer, const Vec3& a, const Vec3& b, const Vec3& c,
+                              const Vec3& color) {
+        std::vector<Vec3> points = {a, b, c};
+        std::sort(points.begin(), points.end(), [](const Vec3& p, const Vec3& q) {
+            return p.y < q.y;
+        });
+        
+        for (int y = (int)points[0].y; y <= (int)points[2].y; y++) {
+            for (int x = (int)std::min({points[0].x, points[1].x, points[2].x});
+                 x <= (int)std::max({points[0].x, points[1].x, points[2].x}); x++) {
+                Vec3 p(x, y, 0);
+                Vec3 v0 = points[2] - points[0];
+                Vec3 v1 = points[1] - points[0];
+                Vec3 v2 = p - points[0];
+                
+                float dot00 = v0.dot(v0);
+                float dot01 = v0.dot(v1);
+                float dot02 = v0.dot(v2);
+                float dot11 = v1.dot(v1);
+                float dot12 = v1.dot(v2);
+                
+                float inv_denom = 1 / (dot00 * dot11 - dot01 * dot01);
+                float u = (dot11 * dot02 - dot01 * dot12) * inv_denom;
+                float v = (dot00 * dot12 - dot01 * dot02) * inv_denom;
+                
+                if (u >= 0 && v >= 0 && u + v <= 1) {
+                    float z = points[0].z + u * (points[2].z - points[0].z) + v * (points[1].z - points[0].z);
+                    framebuffer.set_pixel(x, y, color, z);
+                }
+            }
+        }
+    }
+    
+    struct TestTriangle {
+        Vec3 p[3];
+        Vec3 color;
+    };
+    
+    // random triangles of roughly the given edge length, fully on screen, front to back in depth
+    std::vector<TestTriangle> make_triangles(float size, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<TestTriangle> triangles(TRIANGLES);
+        for (int i = 0; i < TRIANGLES; i++) {
+            float cx = size + unit(rng) * (WIDTH - 2 * size);
+            float cy = size + unit(rng) * (HEIGHT - 2 * size);
+            float z = 1.0f - (float)i / TRIANGLES;
+            for (int k = 0; k < 3; k++) {
+                triangles[i].p[k] = Vec3(cx + (unit(rng) - 0.5f) * size, cy + (unit(rng) - 0.5f) * size, z);
+            }
+            triangles[i].color = Vec3(unit(rng), unit(rng), unit(rng));
+        }
+        return triangles;
+    }
+    
+    // best wall time of fn over several runs, with the framebuffer cleared before each (untimed)
+    template <typename Fn>
+    double best_time_ms(Framebuffer& framebuffer, Fn&& fn, int repetitions = 5) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            framebuffer.clear();
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+    
+    // number of pixels a triangle set covers, used to turn times into fill rate
+    long count_covered(const std::vector<TestTriangle>& triangles) {
+        TileRect screen = {0, 0, WIDTH, HEIGHT};
+        long covered = 0;
+        for (const auto& t : triangles) {
+            RasterTriangle tri;
+            if (!setup_triangle(t.p[0], t.p[1], t.p[2], t.color, screen, tri)) continue;
+            for (int y = tri.min_y; y < tri.max_y; y++) {
+                for (int x = tri.min_x; x < tri.max_x; x++) {
+                    int64_t e0 = tri.edge_a[0] * x + tri.edge_b[0] * y + tri.edge_c[0];
+                    int64_t e1 = tri.edge_a[1] * x + tri.edge_b[1] * y + tri.edge_c[1];
+                    int64_t e2 = tri.edge_a[2] * x + tri.edge_b[2] * y + tri.edge_c[2];
+                    if ((e0 | e1 | e2) >= 0) covered++;
+                }
+            }
+        }
+        return covered;
+    }
+}
+
+int main() {
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    TileRect screen = {0, 0, WIDTH, HEIGHT};
+    const SimdLevel levels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+    const float sizes[] = {4.0f, 16.0f, 64.0f, 256.0f};
+    
+    // measure the kernels alone; hierarchical z has its own benchmark
+    set_raster_hiz(false);
+    
+    std::printf("fill rate, %d triangles per pass, %dx%d target, best of 5\n", TRIANGLES, WIDTH, HEIGHT);
+    std::printf("cpu supports: %s\n\n", simd_level_name(detect_simd_level()));
+    std::printf("%-8s %-10s %10s %12s %9s\n", "size", "path", "ms", "Mpixels/s", "speedup");
+    
+    for (float size : sizes) {
+        std::vector<TestTriangle> triangles = make_triangles(size, 1234);
+        double pixels = (double)count_covered(triangles);
+        
+        double legacy_ms = best_time_ms(framebuffer, [&] {
+            for (const auto& t : triangles) legacy_draw_triangle(framebuffer, t.p[0], t.p[1], t.p[2], t.color);
+        });
+        std::printf("%-8.0f %-10s %10.3f %12.1f %8.2fx\n", size, "legacy", legacy_ms,
+                    pixels / (legacy_ms * 1000.0), 1.0);
+        
+        // triangle setup happens once outside the timed loop, as in the binned renderer
+        std::vector<RasterTriangle> setups;
+        for (const auto& t : triangles) {
+            RasterTriangle tri;
+            if (setup_triangle(t.p[0], t.p[1], t.p[2], t.color, screen, tri)) setups.push_back(tri);
+        }
+        
+        for (SimdLevel level : levels) {
+            if (level > detect_simd_level()) continue;
+            set_raster_simd_level(level);
+            double ms = best_time_ms(framebuffer, [&] {
+                for (const auto& tri : setups) rasterize_triangle(tri, screen, framebuffer);
+            });
+            std::printf("%-8.0f %-10s %10.3f %12.1f %8.2fx\n", size, simd_level_name(level), ms,
+                        pixels / (ms * 1000.0), legacy_ms / ms);
+        }
+        std::printf("\n");
+    }
+    
+    set_raster_simd_level(detect_simd_level());
+    set_raster_hiz(true);
+    return 0;
+}
@@ -0,0 +1,111 @@
+// frame_alloc_bench.cpp
+// heap allocations per frame along a camera path, in every renderer configuration; the path is
+// flown twice and the second flight, which repeats frames the renderer has already seen, must not
+// allocate at all. exits with an error when it does, so make bench fails
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include "../core/alloc_counter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int PATH_FRAMES = 24;
+    
+    // the demo objects with every kind of geometry and light the scene draws: level-of-detail
+    // meshes, a compact mesh, instances and point lights for the light grid
+    void build_scene(Scene& scene) {
+        Material metal(Vec3(0.6f, 0.6f, 0.65f), Vec3(0.8f, 0.8f, 0.8f), 64.0f);
+        Mesh dense = Mesh::create_sphere(0.6f, 60, metal);
+        dense.transform = Mat4::translation(Vec3(-3, 0.5f, -3));
+        scene.add_mesh(dense);
+        CompactMesh compact = CompactMesh::encode(Mesh::create_sphere(0.5f, 40, metal));
+        compact.transform = Mat4::translation(Vec3(3, 0.5f, -3));
+        scene.add_compact_mesh(compact);
+        auto pebble = std::make_shared<const Mesh>(Mesh::create_sphere(0.15f, 8, metal));
+        for (int i = 0; i < 400; i++) {
+            scene.add_instance(MeshInstance(pebble, Mat4::translation(Vec3(i % 20 * 0.5f - 5, -0.85f, i / 20 * 0.5f - 5))));
+        }
+        for (int i = 0; i < 16; i++) {
+            scene.add_light(Light(LightType::POINT, Vec3(i % 4 * 2.5f - 4, 0.2f, i / 4 * 2.5f - 4),
+                                  Vec3(1, 0.6f + 0.1f * (i % 4), 0.4f), 0.6f));
+        }
+        scene.generate_lods();
+        scene.set_lod_error(1.0f);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // an orbit that dips close to the ground, so near-plane clipping and level switches happen
+    void place_camera(Scene& scene, int frame) {
+        float t = (float)frame / PATH_FRAMES * 6.2831853f;
+        float radius = 4.0f + 3.0f * std::sin(2.0f * t);
+        scene.camera.position = Vec3(radius * std::cos(t), 0.6f + 2.5f * (1.0f + std::cos(3.0f * t)), radius * std::sin(t));
+        scene.camera.target = Vec3(0, 0, 0);
+    }
+    
+    struct Flight {
+        uint64_t allocations = 0;
+        double frame_ms = 0.0;
+    };
+    
+    Flight fly(Scene& scene, Renderer& renderer, bool wireframe, bool flat_shading) {
+        Flight flight;
+        uint64_t before = heap_allocation_count();
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < PATH_FRAMES; f++) {
+            place_camera(scene, f);
+            scene.render(renderer, wireframe, flat_shading);
+        }
+        flight.frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+                          PATH_FRAMES;
+        flight.allocations = heap_allocation_count() - before;
+        return flight;
+    }
+}
+
+int main() {
+    struct Config {
+        const char* name;
+        bool tiled, deferred, wireframe, flat_shading, shadows, msaa;
+    };
+    const Config configs[] = {
+        {"tiled flat", true, false, false, true, false, false},
+        {"tiled gouraud", true, false, false, false, false, false},
+        {"deferred flat", true, true, false, true, false, false},
+        {"deferred gouraud", true, true, false, false, false, false},
+        {"serial flat", false, false, false, true, false, false},
+        {"serial gouraud", false, false, false, false, false, false},
+        {"wireframe", true, false, true, true, false, false},
+        {"deferred shadowed", true, true, false, false, true, false},
+        {"tiled gouraud msaa", true, false, false, false, false, true},
+    };
+    
+    std::printf("heap allocations per frame, %dx%d, %d-frame camera path flown twice per configuration\n\n",
+                WIDTH, HEIGHT, PATH_FRAMES);
+    std::printf("%-18s %14s %14s %10s\n", "configuration", "first flight", "second flight", "frame ms");
+    bool failed = false;
+    for (const Config& config : configs) {
+        // a fresh renderer and scene per configuration, so every first flight starts cold
+        Renderer renderer(WIDTH, HEIGHT);
+        renderer.set_tiled(config.tiled);
+        renderer.set_deferred(config.deferred);
+        renderer.set_shadow_mapping(config.shadows);
+        renderer.set_multisampling(config.msaa);
+        Scene scene;
+        build_scene(scene);
+        Flight first = fly(scene, renderer, config.wireframe, config.flat_shading);
+        Flight second = fly(scene, renderer, config.wireframe, config.flat_shading);
+        std::printf("%-18s %14.2f %14.2f %10.2f%s\n", config.name, (double)first.allocations / PATH_FRAMES,
+                    (double)second.allocations / PATH_FRAMES, second.frame_ms, second.allocations ? "  FAILED" : "");
+        failed = failed || second.allocations > 0;
+    }
+    if (failed) {
+        std::fprintf(stderr, "Error: steady-state frames allocated heap memory\n");
+        return 1;
+    }
+    std::printf("\nsteady-state frames made no heap allocations\n");
+    return 0;
+}
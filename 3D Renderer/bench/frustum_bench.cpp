@@ -0,0 +1,133 @@
+// frustum_bench.cpp
+// mesh frustum culling on large fields of small objects seen from inside
+// times the culling step alone for linear and hierarchy culling, then whole frames with each mode
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int VIEWS = 32;           // camera headings around a full turn
+    const float SPACING = 3.0f;     // distance between neighbouring objects
+    
+    // side x side cubes on a jittered grid, the camera standing in the middle at eye height
+    void build_scene(Scene& scene, int side) {
+        scene.clear_scene();
+        Material gray(Vec3(0.6f, 0.6f, 0.6f), Vec3(1, 1, 1), 32.0f);
+        Mesh cube = Mesh::create_cube(1.0f, gray);
+        
+        uint32_t seed = 12345;
+        auto jitter = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return ((seed >> 8) / 16777216.0f - 0.5f) * SPACING * 0.5f;
+        };
+        for (int z = 0; z < side; z++) {
+            for (int x = 0; x < side; x++) {
+                Vec3 position((x - side / 2) * SPACING + jitter(), jitter() * 0.5f,
+                              (z - side / 2) * SPACING + jitter());
+                cube.transform = Mat4::translation(position) * Mat4::rotation_y(jitter());
+                scene.add_mesh(cube);
+            }
+        }
+        
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.3f, -1, -0.5f), Vec3(1, 1, 1), 0.8f));
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+        scene.camera.far_plane = 100.0f;
+    }
+    
+    void place_camera(Camera& camera, int view) {
+        float angle = 2.0f * (float)M_PI * view / VIEWS;
+        camera.position = Vec3(0.5f, 2.0f, 0.5f);
+        camera.target = camera.position + Vec3(std::sin(angle), -0.1f, -std::cos(angle));
+    }
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    // average time of find_visible_objects over every view, best of several sweeps
+    double cull_time_ms(Scene& scene, MeshCulling mode, int sweeps = 10) {
+        scene.set_mesh_culling(mode);
+        scene.find_visible_objects();  // bounds and tree are built on first use
+        double best = 1e30;
+        for (int s = 0; s < sweeps; s++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int view = 0; view < VIEWS; view++) {
+                place_camera(scene.camera, view);
+                scene.find_visible_objects();
+            }
+            best = std::min(best, elapsed_ms(start) / VIEWS);
+        }
+        return best;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    
+    std::printf("mesh frustum culling, %d views around a full turn, far plane 100\n\n", VIEWS);
+    std::printf("%-8s %10s %10s %12s %12s %12s %10s\n", "meshes", "visible", "nodes", "build ms",
+                "linear ms", "bvh ms", "speedup");
+    
+    const int sides[] = {32, 100, 256};
+    for (int side : sides) {
+        build_scene(scene, side);
+        
+        // first use pays for the world bounds and the tree
+        scene.set_mesh_culling(MeshCulling::BVH);
+        auto start = std::chrono::steady_clock::now();
+        scene.find_visible_objects();
+        double build_ms = elapsed_ms(start);
+        
+        double linear_ms = cull_time_ms(scene, MeshCulling::LINEAR);
+        double bvh_ms = cull_time_ms(scene, MeshCulling::BVH);
+        
+        size_t visible = 0, nodes = 0;
+        for (int view = 0; view < VIEWS; view++) {
+            place_camera(scene.camera, view);
+            visible += scene.find_visible_objects().size();
+            nodes += scene.get_cull_stats().nodes_visited;
+        }
+        std::printf("%-8zu %10zu %10zu %12.3f %12.4f %12.4f %9.2fx\n", scene.get_mesh_count(),
+                    visible / VIEWS, nodes / VIEWS, build_ms, linear_ms, bvh_ms, linear_ms / bvh_ms);
+    }
+    
+    // whole frames on the largest field, where unculled meshes still pay for their vertex stage
+    std::printf("\nframes, %zu meshes, %dx%d, %d thread(s), average over the views\n\n",
+                scene.get_mesh_count(), WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-8s %10s %12s\n", "culling", "ms", "meshes drawn");
+    
+    struct Case {
+        const char* name;
+        MeshCulling mode;
+    };
+    const Case cases[] = {
+        {"none", MeshCulling::NONE},
+        {"linear", MeshCulling::LINEAR},
+        {"bvh", MeshCulling::BVH},
+    };
+    for (const Case& c : cases) {
+        scene.set_mesh_culling(c.mode);
+        double total_ms = 0.0;
+        size_t drawn = 0;
+        for (int view = 0; view < VIEWS; view++) {
+            place_camera(scene.camera, view);
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer);
+            total_ms += elapsed_ms(start);
+            drawn += scene.get_cull_stats().objects - scene.get_cull_stats().objects_culled;
+        }
+        std::printf("%-8s %10.3f %12zu\n", c.name, total_ms / VIEWS, drawn / VIEWS);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,85 @@
+// hiz_bench.cpp
+// overdraw benchmark for hierarchical z rejection
+// stacks of large overlapping quads drawn front to back and back to front, with hi-z on and off
+
+#include "../rendering/rasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1024, HEIGHT = 1024;
+    const int LAYERS = 256;
+    
+    // one quad (two triangles) per layer, each covering a random 40-100% of the screen
+    // at a constant depth; layer 0 is the nearest
+    std::vector<RasterTriangle> make_layers(unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        TileRect screen = {0, 0, WIDTH, HEIGHT};
+        std::vector<RasterTriangle> setups;
+        for (int i = 0; i < LAYERS; i++) {
+            float w = WIDTH * (0.4f + 0.6f * unit(rng)), h = HEIGHT * (0.4f + 0.6f * unit(rng));
+            float x = unit(rng) * (WIDTH - w), y = unit(rng) * (HEIGHT - h);
+            float z = 0.1f + 0.8f * (float)i / LAYERS;
+            Vec3 color(unit(rng), unit(rng), unit(rng));
+            Vec3 a(x, y, z), b(x + w, y, z), c(x + w, y + h, z), d(x, y + h, z);
+            
+            RasterTriangle tri;
+            if (setup_triangle(a, b, c, color, screen, tri)) setups.push_back(tri);
+            if (setup_triangle(a, c, d, color, screen, tri)) setups.push_back(tri);
+        }
+        return setups;
+    }
+    
+    // best wall time over several runs, with the framebuffer cleared before each (untimed)
+    double best_time_ms(Framebuffer& framebuffer, const std::vector<RasterTriangle>& setups,
+                        RasterStats& stats, int repetitions = 10) {
+        TileRect screen = {0, 0, WIDTH, HEIGHT};
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            framebuffer.clear();
+            stats = RasterStats();
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& tri : setups) rasterize_triangle(tri, screen, framebuffer, &stats);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+}
+
+int main() {
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    std::vector<RasterTriangle> front_to_back = make_layers(99);
+    std::vector<RasterTriangle> back_to_front(front_to_back.rbegin(), front_to_back.rend());
+    
+    std::printf("hierarchical z, %d overlapping quads, %dx%d target, %s, best of 10\n\n",
+                LAYERS, WIDTH, HEIGHT, simd_level_name(get_raster_simd_level()));
+    std::printf("%-14s %-5s %10s %9s %22s %22s\n", "order", "hi-z", "ms", "speedup",
+                "triangles rejected", "blocks rejected");
+    
+    struct Case {
+        const char* name;
+        const std::vector<RasterTriangle>* setups;
+    };
+    const Case cases[] = {{"front-to-back", &front_to_back}, {"back-to-front", &back_to_front}};
+    
+    for (const Case& c : cases) {
+        RasterStats stats;
+        set_raster_hiz(false);
+        double off_ms = best_time_ms(framebuffer, *c.setups, stats);
+        std::printf("%-14s %-5s %10.3f %8.2fx %22s %22s\n", c.name, "off", off_ms, 1.0, "-", "-");
+        
+        set_raster_hiz(true);
+        double on_ms = best_time_ms(framebuffer, *c.setups, stats);
+        std::printf("%-14s %-5s %10.3f %8.2fx %11llu / %-8llu %11llu / %-8llu\n", c.name, "on", on_ms,
+                    off_ms / on_ms,
+                    (unsigned long long)stats.triangles_rejected, (unsigned long long)stats.triangles_tested,
+                    (unsigned long long)stats.blocks_rejected, (unsigned long long)stats.blocks_tested);
+    }
+    
+    return 0;
+}
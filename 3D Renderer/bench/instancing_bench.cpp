@@ -0,0 +1,143 @@
+// instancing_bench.cpp
+// a forest of 100k trees stored as full mesh copies versus instances of one shared mesh
+// reports geometry memory, scene build time and frame times, and checks both render the same image
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int SIDE = 317;           // SIDE x SIDE trees, just over 100k
+    const float SPACING = 2.0f;
+    const int FRAMES = 9;
+    
+    // tree crown: a low-poly sphere stretched upwards, standing on the ground
+    Mesh make_tree() {
+        Mesh tree = Mesh::create_sphere(0.8f, 8, Material(Vec3(0.2f, 0.6f, 0.2f), Vec3(0.2f, 0.2f, 0.2f), 8.0f));
+        tree.transform = Mat4::translation(Vec3(0, 1.2f, 0)) * Mat4::scale(Vec3(1, 1.5f, 1));
+        return tree;
+    }
+    
+    // placement and shade of tree i; both scene layouts use the same values
+    void tree_at(int i, Mat4& transform, Material& material, const Material& base) {
+        int x = i % SIDE, z = i / SIDE;
+        uint32_t hash = (uint32_t)i * 2654435761u;
+        float jitter_x = ((hash >> 8) & 0xFF) / 255.0f - 0.5f;
+        float jitter_z = ((hash >> 16) & 0xFF) / 255.0f - 0.5f;
+        transform = Mat4::translation(Vec3((x - SIDE / 2 + jitter_x) * SPACING, 0, -(z + jitter_z) * SPACING)) *
+                    Mat4::rotation_y((hash & 0xFF) / 40.0f);
+        material = base;
+        material.diffuse_color = base.diffuse_color * (0.7f + 0.6f * ((hash >> 24) & 0xFF) / 255.0f);
+    }
+    
+    void setup_view(Scene& scene) {
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.4f, -1, -0.3f), Vec3(1, 1, 0.9f), 0.9f));
+        scene.camera.position = Vec3(0, 6, 4);
+        scene.camera.target = Vec3(0, 0, -30);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // every tree a full mesh with its transform baked in
+    void build_copies(Scene& scene) {
+        scene.clear_scene();
+        Mesh tree = make_tree();
+        Mat4 shape = tree.transform;
+        for (int i = 0; i < SIDE * SIDE; i++) {
+            Mat4 placement;
+            tree_at(i, placement, tree.material, make_tree().material);
+            tree.transform = placement * shape;
+            scene.add_mesh(tree);
+        }
+        setup_view(scene);
+    }
+    
+    // one shared mesh, every tree an instance with a material override
+    void build_instances(Scene& scene) {
+        scene.clear_scene();
+        std::shared_ptr<const Mesh> tree = std::make_shared<const Mesh>(make_tree());
+        for (int i = 0; i < SIDE * SIDE; i++) {
+            Mat4 placement;
+            Material material;
+            tree_at(i, placement, material, tree->material);
+            scene.add_instance(MeshInstance(tree, placement, material));
+        }
+        setup_view(scene);
+    }
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    double median_frame_ms(Scene& scene, Renderer& renderer, bool flat_shading) {
+        std::vector<double> times;
+        for (int f = 0; f < FRAMES; f++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, flat_shading);
+            times.push_back(elapsed_ms(start));
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+    
+    std::vector<uint32_t> snapshot(Renderer& renderer) {
+        ImageView image = renderer.get_framebuffer().get_image();
+        std::vector<uint32_t> pixels;
+        for (int y = 0; y < image.height; y++) {
+            pixels.insert(pixels.end(), image.pixels + (size_t)y * image.stride,
+                          image.pixels + (size_t)y * image.stride + image.width);
+        }
+        return pixels;
+    }
+    
+    int max_channel_diff(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+        int worst = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                worst = std::max(worst, std::abs((int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF)));
+            }
+        }
+        return worst;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    
+    std::printf("instancing, %d trees of %zu triangles, %dx%d, %d thread(s), median of %d frames\n\n",
+                SIDE * SIDE, make_tree().triangles.size(), WIDTH, HEIGHT, renderer.get_thread_count(), FRAMES);
+    std::printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n", "layout", "geom MB", "build ms", "flat ms",
+                "smooth ms", "visible", "batches", "triangles");
+    
+    std::vector<uint32_t> images[2];
+    for (int layout = 0; layout < 2; layout++) {
+        // each layout gets a fresh scene so the copies are freed before the instances are built
+        std::unique_ptr<Scene> scene = std::make_unique<Scene>();
+        auto start = std::chrono::steady_clock::now();
+        if (layout == 0) {
+            build_copies(*scene);
+        } else {
+            build_instances(*scene);
+        }
+        double build_ms = elapsed_ms(start);
+        SceneMemory memory = scene->get_memory_usage();
+        
+        double smooth_ms = median_frame_ms(*scene, renderer, false);
+        double flat_ms = median_frame_ms(*scene, renderer, true);
+        images[layout] = snapshot(renderer);
+        const CullStats& culling = scene->get_cull_stats();
+        const GeometryStats& geometry = renderer.get_geometry_stats();
+        std::printf("%-10s %10.1f %10.1f %10.2f %10.2f %10zu %10llu %10llu\n", layout == 0 ? "copies" : "instances",
+                    memory.total() / (1024.0 * 1024.0), build_ms, flat_ms, smooth_ms,
+                    culling.objects - culling.objects_culled, (unsigned long long)geometry.draw_batches,
+                    (unsigned long long)geometry.triangles_submitted);
+    }
+    
+    std::printf("\nmax channel difference between layouts: %d\n", max_channel_diff(images[0], images[1]));
+    return 0;
+}
@@ -0,0 +1,100 @@
+// light_culling_bench.cpp
+// tiled light culling on a field of spheres lit by hundreds of small point lights
+// compares every surface looping over every light against the per-tile light lists
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int COLUMNS = 16, ROWS = 9;
+    const int LIGHTS_X = 32, LIGHTS_Y = 8;  // light grid hovering in front of the spheres
+    
+    // the engine's attenuation falls off slowly, so lights bright enough to see reach tens of
+    // units; the field is laid out at that scale for each light to touch only a few spheres
+    const float SPACING = 20.0f;
+    
+    void build_scene(Scene& scene) {
+        scene.clear_scene();
+        Material material(Vec3(0.7f, 0.7f, 0.7f), Vec3(1, 1, 1), 32.0f);
+        
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < COLUMNS; c++) {
+                Mesh sphere = Mesh::create_sphere(0.45f * SPACING, 24, material);
+                sphere.transform = Mat4::translation(Vec3((c - (COLUMNS - 1) * 0.5f) * SPACING,
+                                                          (r - (ROWS - 1) * 0.5f) * SPACING, 0.0f));
+                scene.add_mesh(sphere);
+            }
+        }
+        
+        for (int y = 0; y < LIGHTS_Y; y++) {
+            for (int x = 0; x < LIGHTS_X; x++) {
+                Vec3 color(0.3f + 0.7f * (x % 3 == 0), 0.3f + 0.7f * (x % 3 == 1), 0.3f + 0.7f * (x % 3 == 2));
+                Vec3 position((x - (LIGHTS_X - 1) * 0.5f) * 0.5f * SPACING,
+                              (y - (LIGHTS_Y - 1) * 0.5f) * 1.1f * SPACING, 0.6f * SPACING);
+                scene.add_light(Light(LightType::POINT, position, color, 0.04f));
+            }
+        }
+        
+        scene.camera.position = Vec3(0, 0, 9 * SPACING);
+        scene.camera.target = Vec3(0, 0, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+        scene.camera.far_plane = 20 * SPACING;
+    }
+    
+    // best wall time of a full scene render over several runs
+    double best_time_ms(Scene& scene, Renderer& renderer, bool flat_shading, int repetitions = 5) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, flat_shading);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    build_scene(scene);
+    
+    std::printf("light culling, %zu spheres, %zu point lights, %dx%d, %d thread(s), best of 5\n\n",
+                scene.get_mesh_count(), scene.get_light_count(), WIDTH, HEIGHT, renderer.get_thread_count());
+    std::printf("%-18s %10s %10s %14s %12s %8s\n", "mode", "culling", "ms", "lighting", "lights/tile", "speedup");
+    
+    struct Case {
+        const char* name;
+        bool deferred;
+        bool flat_shading;
+    };
+    const Case cases[] = {
+        {"forward flat", false, true},
+        {"forward gouraud", false, false},
+        {"deferred smooth", true, false},
+    };
+    
+    for (const Case& c : cases) {
+        renderer.set_deferred(c.deferred);
+        double baseline_ms = 0.0;
+        for (bool culling : {false, true}) {
+            renderer.set_light_culling(culling);
+            double ms = best_time_ms(scene, renderer, c.flat_shading);
+            const LightGrid* grid = renderer.get_light_grid();
+            std::printf("%-18s %10s %10.3f %14llu", c.name, culling ? "tiled" : "off", ms,
+                        (unsigned long long)renderer.get_shading_stats().lighting_evaluations);
+            if (grid) {
+                std::printf(" %12.1f %7.2fx\n", grid->average_tile_lights(), baseline_ms / ms);
+            } else {
+                std::printf(" %12zu %8s\n", scene.get_light_count(), "-");
+                baseline_ms = ms;
+            }
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,239 @@
+// lighting_bench.cpp
+// the batched lighting kernel against the scalar reference calculate_lighting: time per surface
+// point by light count and simd path, accuracy of the colors and of the pow approximation, and
+// whole deferred frames of a many-light scene with each lighting mode
+
+#include "bench_harness.h"
+#include "../rendering/renderer.h"
+#include "../rendering/rasterizer.h"
+#include "../rendering/light_kernel.h"
+#include "../scene/scene.h"
+#include "../math/color.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t POINTS = 4096;  // surface points per call
+    const int WIDTH = 1280, HEIGHT = 720;
+    
+    // 8-bit differences of packed colors, per channel
+    struct ColorError {
+        int max_step = 0;
+        uint64_t channels_differing = 0;
+        uint64_t channels = 0;
+        double step_sum = 0.0;
+        
+        void add(uint32_t a, uint32_t b) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                int step = std::abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+                max_step = std::max(max_step, step);
+                channels_differing += step != 0;
+                step_sum += step;
+                channels++;
+            }
+        }
+        
+        void print(const char* name) const {
+            std::printf("%-22s max %3d steps, %7.3f%% of channels differ, mean %.4f steps\n", name, max_step,
+                        100.0 * channels_differing / std::max<uint64_t>(1, channels), step_sum / std::max<uint64_t>(1, channels));
+        }
+    };
+    
+    // a field of spheres under a grid of small point lights and one dim directional light
+    void build_scene(Scene& scene, int lights_x, int lights_y) {
+        scene.clear_scene();
+        Material material(Vec3(0.7f, 0.7f, 0.7f), Vec3(1, 1, 1), 32.0f);
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 7; c++) {
+                Mesh sphere = Mesh::create_sphere(0.9f, 32, material);
+                sphere.transform = Mat4::translation(Vec3((c - 3) * 2.0f, (r - 1.5f) * 2.0f, 0.0f));
+                scene.add_mesh(sphere);
+            }
+        }
+        for (int y = 0; y < lights_y; y++) {
+            for (int x = 0; x < lights_x; x++) {
+                Vec3 color(0.3f + 0.7f * (x % 3 == 0), 0.3f + 0.7f * (x % 3 == 1), 0.3f + 0.7f * (x % 3 == 2));
+                Vec3 position((x - (lights_x - 1) * 0.5f) * 14.0f / lights_x, (y - (lights_y - 1) * 0.5f) * 8.0f / lights_y,
+                              1.5f);
+                scene.add_light(Light(LightType::POINT, position, color, 0.1f));
+            }
+        }
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.3f, -1, -0.5f), Vec3(0.3f, 0.3f, 0.3f), 0.3f));
+        scene.camera.position = Vec3(0, 0, 9);
+        scene.camera.target = Vec3(0, 0, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // best frame time, the shading stage of that frame, and the image
+    double best_frame_ms(Scene& scene, Renderer& renderer, double& shade_ms, std::vector<uint32_t>& image) {
+        double best = 1e30;
+        for (int r = 0; r < 5; r++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, false);
+            FrameStats stats = renderer.get_frame_stats();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (ms < best) {
+                best = ms;
+                shade_ms = stats.times.stage_ms[(int)ProfileStage::SHADE];
+            }
+        }
+        Framebuffer& framebuffer = renderer.get_framebuffer();
+        framebuffer.resolve();
+        image.clear();
+        for (int y = 0; y < HEIGHT; y++) {
+            const uint32_t* row = framebuffer.get_color_row(y);
+            image.insert(image.end(), row, row + WIDTH);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchHarness harness("lighting_bench", argc, argv);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+    
+    // surface points in a box with the lights, facing every way; one directional light, the rest points
+    std::vector<Vec3> positions(POINTS), normals(POINTS), colors(POINTS);
+    std::vector<uint32_t> reference(POINTS), batched(POINTS);
+    for (size_t i = 0; i < POINTS; i++) {
+        positions[i] = Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+        normals[i] = Vec3(coordinate(rng), coordinate(rng), coordinate(rng)).normalize();
+    }
+    Renderer renderer(64, 64);
+    Material material(Vec3(0.7f, 0.5f, 0.3f), Vec3(1, 1, 1), 32.0f);
+    Vec3 view_dir = Vec3(0, -0.3f, -1).normalize();
+    Vec3 ambient(0.2f, 0.2f, 0.2f);
+    SimdLevel detected = get_raster_simd_level();
+    
+    struct Accuracy {
+        int light_count;
+        ColorError phong, blinn;
+        double max_error = 0.0;  // largest float difference of a phong channel from the reference
+    };
+    std::vector<Accuracy> accuracy;
+    
+    for (int light_count : {1, 4, 16, 64}) {
+        std::vector<Light> lights = {Light(LightType::DIRECTIONAL, Vec3(-0.5f, -1, -0.3f), Vec3(1, 1, 1), 0.5f)};
+        while ((int)lights.size() < light_count) {
+            lights.push_back(Light(LightType::POINT, Vec3(coordinate(rng), coordinate(rng), coordinate(rng))));
+        }
+        PackedLights packed;
+        packed.pack(lights, view_dir);
+        std::string suffix = "_" + std::to_string(light_count) + "_lights";
+        
+        harness.run("reference" + suffix, "point", POINTS, [&] {
+            for (size_t i = 0; i < POINTS; i++) {
+                colors[i] = renderer.calculate_lighting(positions[i], normals[i], material, lights, view_dir);
+            }
+            keep_result(colors);
+        });
+        auto shade_all = [&](SpecularModel model) {
+            ShadingPoints points;
+            for (size_t i = 0; i < POINTS; i += SHADING_WIDTH) {
+                points.count = 0;
+                for (size_t k = i; k < i + SHADING_WIDTH; k++) points.add(positions[k], normals[k], material.shininess);
+                shade_points(packed, nullptr, lights.size(), model, points);
+                for (int k = 0; k < SHADING_WIDTH; k++) colors[i + k] = points.color(k, material, ambient);
+            }
+            keep_result(colors);
+        };
+        for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2}) {
+            if (level > detected) continue;
+            set_raster_simd_level(level);
+            std::string path = level == SimdLevel::AVX2 ? "_avx2" : "_scalar";
+            harness.run("phong" + path + suffix, "point", POINTS, [&] { shade_all(SpecularModel::PHONG); });
+            harness.run("blinn" + path + suffix, "point", POINTS, [&] { shade_all(SpecularModel::BLINN_PHONG); });
+        }
+        set_raster_simd_level(detected);
+        
+        Accuracy result;
+        result.light_count = light_count;
+        for (size_t i = 0; i < POINTS; i++) {
+            Vec3 color = renderer.calculate_lighting(positions[i], normals[i], material, lights, view_dir);
+            reference[i] = Color::to_packed(color);
+            colors[i] = color;
+        }
+        std::vector<Vec3> exact = colors;
+        shade_all(SpecularModel::PHONG);
+        for (size_t i = 0; i < POINTS; i++) {
+            result.phong.add(reference[i], Color::to_packed(colors[i]));
+            Vec3 error = colors[i] - exact[i];
+            result.max_error = std::max({result.max_error, (double)std::fabs(error.x), (double)std::fabs(error.y),
+                                         (double)std::fabs(error.z)});
+        }
+        shade_all(SpecularModel::BLINN_PHONG);
+        for (size_t i = 0; i < POINTS; i++) result.blinn.add(reference[i], Color::to_packed(colors[i]));
+        accuracy.push_back(result);
+    }
+    
+    // the pow approximation over the range specular bases take, by exponent
+    std::printf("\nfast_pow against std::pow on (0, 1], where std::pow is above 1e-6:\n");
+    for (float exponent : {1.0f, 8.0f, 32.0f, 128.0f, 512.0f}) {
+        double max_relative = 0.0;
+        for (int i = 1; i <= 1 << 20; i++) {
+            float x = (float)i / (1 << 20);
+            double exact = std::pow((double)x, (double)exponent);
+            if (exact < 1e-6) continue;
+            max_relative = std::max(max_relative, std::fabs(fast_pow(x, exponent) - exact) / exact);
+        }
+        std::printf("  exponent %5.0f: max relative error %.2e\n", exponent, max_relative);
+    }
+    
+    std::printf("\ncolors against the reference, %zu random points (blinn-phong is a different highlight model, "
+                "not an error):\n", POINTS);
+    for (const Accuracy& result : accuracy) {
+        std::printf("%d light(s): phong max float error %.2e\n", result.light_count, result.max_error);
+        result.phong.print("  batched phong");
+        result.blinn.print("  batched blinn-phong");
+    }
+    
+    // whole frames: deferred smooth shading lights every visible pixel against its tile's lights
+    std::printf("\ndeferred frames, 28 spheres, %dx%d, %d thread(s), best of 5:\n", WIDTH, HEIGHT,
+                renderer.get_thread_count());
+    std::printf("%-8s %-20s %10s %10s %8s   image against the reference\n", "lights", "mode", "frame ms", "shade ms",
+                "speedup");
+    Renderer frame_renderer(WIDTH, HEIGHT);
+    frame_renderer.set_deferred(true);
+    Scene scene;
+    struct Mode {
+        const char* name;
+        LightingMode mode;
+    };
+    const Mode modes[] = {
+        {"reference", LightingMode::REFERENCE},
+        {"batched phong", LightingMode::BATCHED_PHONG},
+        {"batched blinn-phong", LightingMode::BATCHED_BLINN_PHONG},
+    };
+    for (int lights_x : {4, 16}) {
+        build_scene(scene, lights_x, 4);
+        std::vector<uint32_t> reference_image, image;
+        double reference_ms = 0.0, reference_shade_ms = 0.0;
+        for (const Mode& mode : modes) {
+            frame_renderer.set_lighting_mode(mode.mode);
+            double shade_ms = 0.0;
+            double ms = best_frame_ms(scene, frame_renderer, shade_ms, image);
+            std::printf("%-8zu %-20s %10.3f %10.3f", scene.get_light_count(), mode.name, ms, shade_ms);
+            if (mode.mode == LightingMode::REFERENCE) {
+                reference_image = image;
+                reference_ms = ms;
+                reference_shade_ms = shade_ms;
+                std::printf(" %8s\n", "-");
+                continue;
+            }
+            // the shading stage alone when the profiler is compiled in
+            double speedup = shade_ms > 0.0 ? reference_shade_ms / shade_ms : reference_ms / ms;
+            ColorError error;
+            for (size_t i = 0; i < image.size(); i++) error.add(reference_image[i], image[i]);
+            std::printf(" %7.2fx   max %d steps, %.3f%% of channels differ\n", speedup, error.max_step,
+                        100.0 * error.channels_differing / error.channels);
+        }
+    }
+    
+    return harness.finish() ? 0 : 1;
+}
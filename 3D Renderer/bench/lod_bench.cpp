@@ -0,0 +1,159 @@
+// lod_bench.cpp
+// a field of dense rocks flown through by a camera, at full detail and with level-of-detail chains
+// at several pixel error thresholds; reports frame time, triangles drawn, image error and level switches
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include "../geometry/mesh_simplifier.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int SIDE = 8;            // SIDE x SIDE rocks
+    const float SPACING = 6.0f;
+    const int SEGMENTS = 100;      // 20k triangles per rock
+    const int PATH_FRAMES = 16;
+    
+    // a lumpy sphere standing in for a scanned rock
+    Mesh make_rock() {
+        Mesh rock = Mesh::create_sphere(1.0f, SEGMENTS, Material(Vec3(0.6f, 0.55f, 0.5f), Vec3(0.2f, 0.2f, 0.2f), 8.0f));
+        for (auto& vertex : rock.vertices) {
+            const Vec3& p = vertex.position;
+            float lumps = 0.15f * std::sin(4.0f * p.x + 0.5f) * std::sin(3.0f * p.y + 1.0f) * std::sin(5.0f * p.z);
+            float grain = 0.01f * std::sin(41.0f * p.x + 17.0f * p.y) * std::cos(37.0f * p.z);
+            vertex.position = p * (1.0f + lumps + grain);
+        }
+        for (auto& triangle : rock.triangles) triangle.calculate_normal(rock.vertices);
+        rock.calculate_vertex_normals();
+        rock.update_bounds();
+        return rock;
+    }
+    
+    void build_field(Scene& scene) {
+        scene.clear_scene();
+        Mesh rock = make_rock();
+        for (int i = 0; i < SIDE * SIDE; i++) {
+            uint32_t hash = (uint32_t)i * 2654435761u;
+            float size = 0.8f + 0.8f * ((hash >> 8) & 0xFF) / 255.0f;
+            rock.transform = Mat4::translation(Vec3((i % SIDE - SIDE / 2 + 0.5f) * SPACING, size * 0.5f,
+                                                    -(i / SIDE) * SPACING)) *
+                             Mat4::rotation_y((hash & 0xFF) / 40.0f) * Mat4::scale(Vec3(size, size, size));
+            scene.add_mesh(rock);
+        }
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.4f, -1, -0.3f), Vec3(1, 1, 0.9f), 0.9f));
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    // a low flight from behind the field towards its far end, looking slightly down and ahead
+    void place_camera(Scene& scene, int frame) {
+        float t = (float)frame / (PATH_FRAMES - 1);
+        float z = 12.0f - t * (SIDE * SPACING);
+        scene.camera.position = Vec3(2.0f * std::sin(3.0f * t), 2.5f, z);
+        scene.camera.target = scene.camera.position + Vec3(0, -0.6f, -3.0f);
+    }
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    std::vector<uint32_t> snapshot(Renderer& renderer) {
+        ImageView image = renderer.get_framebuffer().get_image();
+        std::vector<uint32_t> pixels;
+        for (int y = 0; y < image.height; y++) {
+            pixels.insert(pixels.end(), image.pixels + (size_t)y * image.stride,
+                          image.pixels + (size_t)y * image.stride + image.width);
+        }
+        return pixels;
+    }
+    
+    // mean squared channel difference, and pixels off by more than a few levels
+    void image_error(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, double& squared, size_t& visible) {
+        const int VISIBLE_LEVELS = 4;
+        for (size_t i = 0; i < a.size(); i++) {
+            int worst = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                int difference = std::abs((int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF));
+                squared += difference * difference / 3.0;
+                worst = std::max(worst, difference);
+            }
+            if (worst > VISIBLE_LEVELS) visible++;
+        }
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene full, lod;
+    build_field(full);
+    build_field(lod);
+    auto start = std::chrono::steady_clock::now();
+    lod.generate_lods();
+    double build_ms = elapsed_ms(start);
+    
+    SceneMemory memory = lod.get_memory_usage();
+    std::printf("level of detail, %d rocks of %zu triangles, %dx%d, %d thread(s), %d-frame camera path\n",
+                SIDE * SIDE, full.meshes[0].triangles.size(), WIDTH, HEIGHT, renderer.get_thread_count(), PATH_FRAMES);
+    std::printf("chains built in %.0f ms, %.1f MB of levels for %.1f MB of meshes\n\n", build_ms,
+                memory.lod_bytes / (1024.0 * 1024.0), memory.mesh_bytes / (1024.0 * 1024.0));
+    
+    // full-detail reference images and times along the path
+    std::vector<std::vector<uint32_t>> reference(PATH_FRAMES);
+    double full_ms = 0.0;
+    for (int f = 0; f < PATH_FRAMES; f++) {
+        place_camera(full, f);
+        full.render(renderer, false, false);
+        start = std::chrono::steady_clock::now();
+        full.render(renderer, false, false);
+        full_ms += elapsed_ms(start);
+        reference[f] = snapshot(renderer);
+    }
+    std::printf("%-10s %9s %10s %10s %9s %10s %9s\n", "threshold", "frame ms", "speedup", "triangles", "psnr dB",
+                "off by >4", "switches");
+    std::printf("%-10s %9.2f %9.2fx %10zu %9s %10s %9s\n", "full", full_ms / PATH_FRAMES, 1.0,
+                full.meshes.size() * full.meshes[0].triangles.size(), "-", "-", "-");
+    
+    const float thresholds[] = {0.5f, 1.0f, 2.0f, 4.0f};
+    for (float threshold : thresholds) {
+        lod.set_lod_error(threshold);
+        double frame_ms = 0.0, squared = 0.0;
+        size_t visible = 0, triangles = 0, switches = 0;
+        for (int f = 0; f < PATH_FRAMES; f++) {
+            place_camera(lod, f);
+            lod.render(renderer, false, false);
+            switches += lod.get_lod_stats().switched;
+            start = std::chrono::steady_clock::now();
+            lod.render(renderer, false, false);
+            frame_ms += elapsed_ms(start);
+            const LodStats& stats = lod.get_lod_stats();
+            triangles += stats.drawn_triangles;
+            image_error(reference[f], snapshot(renderer), squared, visible);
+        }
+        double mse = squared / ((double)WIDTH * HEIGHT * PATH_FRAMES);
+        double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+        char name[16];
+        std::snprintf(name, sizeof(name), "%.1f px", threshold);
+        std::printf("%-10s %9.2f %9.2fx %10zu %9.1f %9.3f%% %9zu\n", name, frame_ms / PATH_FRAMES, full_ms / frame_ms,
+                    triangles / PATH_FRAMES, psnr, 100.0 * visible / ((double)WIDTH * HEIGHT * PATH_FRAMES), switches);
+    }
+    
+    // stability: a camera swaying a little back and forth, where every sway that crosses a level
+    // threshold without hysteresis switches a mesh back and forth
+    std::printf("\nswaying camera, 1 px threshold, 64 frames\n\n%-12s %9s\n", "hysteresis", "switches");
+    for (float hysteresis : {0.0f, 0.25f}) {
+        lod.set_lod_error(1.0f, hysteresis);
+        size_t switches = 0;
+        for (int f = 0; f < 64; f++) {
+            place_camera(lod, PATH_FRAMES / 2);
+            lod.camera.position = lod.camera.position + Vec3(0, 0, 0.3f * std::sin(f * 0.7f));
+            lod.render(renderer, false, false);
+            if (f > 0) switches += lod.get_lod_stats().switched;
+        }
+        std::printf("%-12.2f %9zu\n", hysteresis, switches);
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// mesh_load_bench.cpp
+// a million-triangle mesh written as obj, ascii ply and binary ply, then imported serially and in
+// parallel, cached as .rmesh and mapped back; reports import rates, time to first frame and page faults
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include "../io/mesh_import.h"
+#include "../io/mesh_cache.h"
+#include "../geometry/mesh_optimizer.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int SEGMENTS = 710;  // just over a million triangles
+    const int REPETITIONS = 3;
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    long minor_faults() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_minflt;
+    }
+    
+    size_t file_bytes(const std::string& path) {
+        uint64_t size = 0;
+        int64_t modified_ns;
+        file_stamp(path, size, modified_ns);
+        return (size_t)size;
+    }
+    
+    // positions and normals printed with enough digits to read back exactly
+    bool write_obj(const std::string& path, const Mesh& mesh) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        std::fprintf(file, "# mesh_load_bench\no sphere\n");
+        for (const Vertex& vertex : mesh.vertices) {
+            std::fprintf(file, "v %.9g %.9g %.9g\n", vertex.position.x, vertex.position.y, vertex.position.z);
+        }
+        for (const Vertex& vertex : mesh.vertices) {
+            std::fprintf(file, "vn %.9g %.9g %.9g\n", vertex.normal.x, vertex.normal.y, vertex.normal.z);
+        }
+        for (const Triangle& triangle : mesh.triangles) {
+            std::fprintf(file, "f %d//%d %d//%d %d//%d\n", triangle.v0 + 1, triangle.v0 + 1, triangle.v1 + 1,
+                         triangle.v1 + 1, triangle.v2 + 1, triangle.v2 + 1);
+        }
+        return std::fclose(file) == 0;
+    }
+    
+    bool write_ply(const std::string& path, const Mesh& mesh, bool binary) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        std::fprintf(file, "ply\nformat %s 1.0\nelement vertex %zu\n", binary ? "binary_little_endian" : "ascii",
+                     mesh.vertices.size());
+        std::fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+        std::fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+        std::fprintf(file, "element face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+                     mesh.triangles.size());
+        for (const Vertex& vertex : mesh.vertices) {
+            const float values[6] = {vertex.position.x, vertex.position.y, vertex.position.z,
+                                     vertex.normal.x, vertex.normal.y, vertex.normal.z};
+            if (binary) {
+                std::fwrite(values, sizeof(values), 1, file);
+            } else {
+                std::fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g\n", values[0], values[1], values[2], values[3],
+                             values[4], values[5]);
+            }
+        }
+        for (const Triangle& triangle : mesh.triangles) {
+            if (binary) {
+                const unsigned char count = 3;
+                const int indices[3] = {triangle.v0, triangle.v1, triangle.v2};
+                std::fwrite(&count, 1, 1, file);
+                std::fwrite(indices, sizeof(indices), 1, file);
+            } else {
+                std::fprintf(file, "3 %d %d %d\n", triangle.v0, triangle.v1, triangle.v2);
+            }
+        }
+        return std::fclose(file) == 0;
+    }
+    
+    // the import must reproduce the written mesh exactly
+    bool same_geometry(const Mesh& a, const Vertex* vertices, size_t vertex_count, const Triangle* triangles,
+                       size_t triangle_count) {
+        if (a.vertices.size() != vertex_count || a.triangles.size() != triangle_count) return false;
+        for (size_t i = 0; i < vertex_count; i++) {
+            const Vertex& v = a.vertices[i];
+            if (std::memcmp(&v.position, &vertices[i].position, sizeof(Vec3)) != 0 ||
+                std::memcmp(&v.normal, &vertices[i].normal, sizeof(Vec3)) != 0) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < triangle_count; i++) {
+            const Triangle& t = a.triangles[i];
+            if (t.v0 != triangles[i].v0 || t.v1 != triangles[i].v1 || t.v2 != triangles[i].v2) return false;
+        }
+        return true;
+    }
+    
+    void setup_view(Scene& scene) {
+        scene.clear_scene();
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.5f, -0.8f, -0.6f), Vec3(1, 1, 1), 0.9f));
+        scene.camera.position = Vec3(0, 0.6f, 3.2f);
+        scene.camera.target = Vec3(0, 0, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    ThreadPool& pool = renderer.get_thread_pool();
+    Mesh source = Mesh::create_sphere(1.0f, SEGMENTS, Material(Vec3(0.7f, 0.6f, 0.5f), Vec3(0.3f, 0.3f, 0.3f), 16.0f));
+    
+    struct SourceFile {
+        const char* name;
+        std::string path;
+        bool written;
+    };
+    SourceFile files[] = {
+        {"obj", "mesh_load_bench.obj", write_obj("mesh_load_bench.obj", source)},
+        {"ply ascii", "mesh_load_bench_ascii.ply", write_ply("mesh_load_bench_ascii.ply", source, false)},
+        {"ply binary", "mesh_load_bench_binary.ply", write_ply("mesh_load_bench_binary.ply", source, true)},
+    };
+    
+    std::printf("mesh loading, %zu vertices, %zu triangles, %d thread(s), best of %d\n\n", source.vertices.size(),
+                source.triangles.size(), pool.thread_count(), REPETITIONS);
+    std::printf("%-11s %9s %10s %10s %10s %10s %8s %s\n", "format", "file MB", "serial ms", "serial MB/s", "pool ms",
+                "pool MB/s", "speedup", "");
+    for (const SourceFile& file : files) {
+        if (!file.written) {
+            std::printf("%-11s could not write %s\n", file.name, file.path.c_str());
+            continue;
+        }
+        double megabytes = file_bytes(file.path) / (1024.0 * 1024.0);
+        double times[2] = {1e30, 1e30};
+        bool exact = true;
+        for (int parallel = 0; parallel < 2; parallel++) {
+            for (int r = 0; r < REPETITIONS; r++) {
+                Mesh mesh;
+                auto start = std::chrono::steady_clock::now();
+                if (!import_mesh(file.path, mesh, parallel ? &pool : nullptr)) return 1;
+                times[parallel] = std::min(times[parallel], elapsed_ms(start));
+                exact = exact && same_geometry(mesh, source.vertices.data(), source.vertices.size(),
+                                               source.triangles.data(), source.triangles.size());
+            }
+        }
+        std::printf("%-11s %9.1f %10.1f %10.1f %10.1f %10.1f %7.2fx %s\n", file.name, megabytes, times[0],
+                    megabytes * 1000.0 / times[0], times[1], megabytes * 1000.0 / times[1], times[0] / times[1],
+                    exact ? "" : "MISMATCH");
+    }
+    
+    // time to first frame: import and render, first run (import, optimize, cache write, map) and later runs
+    // (map only); a mapped frame's extra time over an in-memory one is the cost of faulting pages in
+    std::printf("\ntime to first frame from %s (page cache warm)\n\n", files[2].path.c_str());
+    std::printf("%-16s %10s %10s %10s %12s %s\n", "path", "load ms", "frame ms", "total ms", "page faults", "");
+    // the cache holds the import after optimize_mesh
+    Mesh optimized = source;
+    optimize_mesh(optimized);
+    
+    // one frame of the source first, so no run pays for growing the renderer's buffers
+    Scene scene;
+    setup_view(scene);
+    scene.add_mesh(source);
+    scene.render(renderer, false, true);
+    std::string cache = mesh_cache_path(files[2].path);
+    std::remove(cache.c_str());
+    for (int run = 0; run < 3; run++) {
+        setup_view(scene);
+        long faults = minor_faults();
+        auto start = std::chrono::steady_clock::now();
+        if (run == 0) {
+            Mesh mesh;
+            if (!import_mesh(files[2].path, mesh, &pool)) return 1;
+            scene.meshes.push_back(std::move(mesh));
+        } else {
+            MappedMesh mesh;
+            bool cache_hit = false;
+            if (!load_mesh_cached(files[2].path, mesh, &pool, &cache_hit) || cache_hit != (run == 2)) return 1;
+            scene.add_mapped_mesh(std::move(mesh));
+        }
+        double load_ms = elapsed_ms(start);
+        auto frame_start = std::chrono::steady_clock::now();
+        scene.render(renderer, false, true);
+        double frame_ms = elapsed_ms(frame_start);
+        long faults_taken = minor_faults() - faults;
+        
+        bool exact = run == 0 || same_geometry(optimized, scene.mapped_meshes[0].vertices(),
+                                               scene.mapped_meshes[0].vertex_count(),
+                                               scene.mapped_meshes[0].triangles(),
+                                               scene.mapped_meshes[0].triangle_count());
+        const char* names[] = {"import", "import + cache", "mapped cache"};
+        std::printf("%-16s %10.2f %10.2f %10.2f %12ld %s\n", names[run], load_ms, frame_ms, load_ms + frame_ms,
+                    faults_taken, exact ? "" : "MISMATCH");
+    }
+    std::printf("\ncache file: %.1f MB\n", file_bytes(cache) / (1024.0 * 1024.0));
+    
+    scene.clear_scene();
+    for (const SourceFile& file : files) std::remove(file.path.c_str());
+    std::remove(cache.c_str());
+    return 0;
+}
@@ -0,0 +1,154 @@
+// mesh_optimizer_bench.cpp
+// sphere meshes as generated and in shuffled (imported-looking) triangle order, before and after
+// optimize_mesh; reports vertex cache and fetch statistics, optimizer and frame times, and meshlet culling
+
+#include "../rendering/renderer.h"
+#include "../rendering/frustum.h"
+#include "../scene/scene.h"
+#include "../geometry/mesh_optimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int SEGMENTS = 400;
+    const int FRAMES = 7;
+    
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    void setup_view(Scene& scene) {
+        scene.clear_scene();
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.5f, -0.8f, -0.6f), Vec3(1, 1, 1), 0.9f));
+        scene.add_light(Light(LightType::POINT, Vec3(2, 2, 3), Vec3(1, 0.9f, 0.8f), 0.8f));
+        scene.camera.position = Vec3(0.3f, 0.4f, 1.9f);
+        scene.camera.target = Vec3(0.6f, 0.1f, 0);
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    }
+    
+    double median_frame_ms(Scene& scene, Renderer& renderer, bool flat_shading) {
+        std::vector<double> times;
+        for (int f = 0; f < FRAMES; f++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, flat_shading);
+            times.push_back(elapsed_ms(start));
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+    
+    void print_stats(const char* name, const char* state, const Mesh& mesh, double optimize_ms, double flat_ms,
+                     double smooth_ms) {
+        VertexCacheStats cache16 = analyze_vertex_cache(mesh, 16);
+        VertexCacheStats cache32 = analyze_vertex_cache(mesh, 32);
+        VertexFetchStats fetch = analyze_vertex_fetch(mesh);
+        std::printf("%-9s %-6s %9zu %9zu %8.3f %8.3f %8.3f %9.2f %9.1f %9.2f %9.2f\n", name, state,
+                    mesh.vertices.size(), mesh.triangles.size(), cache16.acmr, cache32.acmr, cache16.atvr,
+                    fetch.overfetch, optimize_ms, flat_ms, smooth_ms);
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    Scene scene;
+    Material material(Vec3(0.7f, 0.6f, 0.5f), Vec3(0.3f, 0.3f, 0.3f), 16.0f);
+    Mesh generated = Mesh::create_sphere(1.0f, SEGMENTS, material);
+    Mesh shuffled = generated;
+    std::mt19937 random(1234);
+    std::shuffle(shuffled.triangles.begin(), shuffled.triangles.end(), random);
+    
+    std::printf("mesh optimization, %dx%d, %d thread(s), frames median of %d\n", WIDTH, HEIGHT,
+                renderer.get_thread_count(), FRAMES);
+    std::printf("acmr: vertex transforms per triangle with a FIFO of 16 and 32 entries; atvr: per vertex (16);\n");
+    std::printf("overfetch: Vertex bytes read through a 16 KB cache over the array size\n\n");
+    std::printf("%-9s %-6s %9s %9s %8s %8s %8s %9s %9s %9s %9s\n", "mesh", "state", "vertices", "triangles",
+                "acmr16", "acmr32", "atvr", "overfetch", "opt ms", "flat ms", "smooth ms");
+    
+    Mesh optimized;
+    const char* names[] = {"grid", "shuffled"};
+    const Mesh* sources[] = {&generated, &shuffled};
+    for (int m = 0; m < 2; m++) {
+        const Mesh& source = *sources[m];
+        setup_view(scene);
+        scene.add_mesh(source);
+        double flat_before = median_frame_ms(scene, renderer, true);
+        double smooth_before = median_frame_ms(scene, renderer, false);
+        print_stats(names[m], "before", source, 0.0, flat_before, smooth_before);
+        
+        optimized = source;
+        auto start = std::chrono::steady_clock::now();
+        optimize_mesh(optimized);
+        double optimize_ms = elapsed_ms(start);
+        setup_view(scene);
+        scene.add_mesh(optimized);
+        double flat_after = median_frame_ms(scene, renderer, true);
+        double smooth_after = median_frame_ms(scene, renderer, false);
+        print_stats(names[m], "after", optimized, optimize_ms, flat_after, smooth_after);
+    }
+    
+    // each step alone on the shuffled mesh
+    Mesh step = shuffled;
+    auto start = std::chrono::steady_clock::now();
+    size_t welded = weld_vertices(step);
+    double weld_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+    optimize_vertex_cache(step);
+    double cache_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+    optimize_vertex_fetch(step);
+    double fetch_ms = elapsed_ms(start);
+    std::printf("\nsteps on the shuffled mesh: weld %.1f ms (%zu vertices and %zu triangles removed), cache order "
+                "%.1f ms, fetch order %.1f ms\n", weld_ms, welded, shuffled.triangles.size() - step.triangles.size(),
+                cache_ms, fetch_ms);
+    
+    // meshlets of the optimized mesh, culled as whole clusters from the bench view; the sphere's
+    // transform is the identity, so object and world space agree
+    start = std::chrono::steady_clock::now();
+    MeshletMesh meshlets = build_meshlets(optimized);
+    double meshlet_ms = elapsed_ms(start);
+    setup_view(scene);
+    Frustum frustum(scene.camera.get_projection_matrix() * scene.camera.get_view_matrix());
+    const Vec3& eye = scene.camera.position;
+    auto faces_away = [&](int v0, int v1, int v2) {
+        const Vec3& p0 = optimized.vertices[v0].position;
+        Vec3 normal = (optimized.vertices[v1].position - p0).cross(optimized.vertices[v2].position - p0);
+        return normal.dot(p0 - eye) >= 0.0f;
+    };
+    size_t frustum_culled = 0, cone_culled = 0, triangles_culled = 0, vertices_used = 0, wrongly_culled = 0;
+    for (const Meshlet& meshlet : meshlets.meshlets) {
+        vertices_used += meshlet.vertex_count;
+        if (!frustum.intersects(meshlet.bounds)) {
+            frustum_culled++;
+        } else if (meshlet.is_backfacing(eye)) {
+            // the cone test is conservative: every triangle in the cluster must face away
+            cone_culled++;
+            const uint32_t* vertices = meshlets.vertices.data() + meshlet.vertex_offset;
+            const uint8_t* local = meshlets.triangles.data() + meshlet.triangle_offset;
+            for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+                wrongly_culled += !faces_away(vertices[local[3 * t]], vertices[local[3 * t + 1]],
+                                              vertices[local[3 * t + 2]]);
+            }
+        } else {
+            continue;
+        }
+        triangles_culled += meshlet.triangle_count;
+    }
+    size_t backfacing = 0;
+    for (const Triangle& triangle : optimized.triangles) {
+        backfacing += faces_away(triangle.v0, triangle.v1, triangle.v2);
+    }
+    size_t triangle_count = optimized.triangles.size();
+    size_t count = meshlets.meshlets.size();
+    std::printf("\nmeshlets (max %zu vertices, %zu triangles): %zu built in %.1f ms, avg %.1f vertices and %.1f "
+                "triangles, %.2f vertex copies per mesh vertex\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, count,
+                meshlet_ms, (double)vertices_used / count, (double)optimized.triangles.size() / count,
+                (double)vertices_used / optimized.vertices.size());
+    std::printf("from the bench view: %zu frustum culled, %zu cone culled, %.1f%% of triangles skipped as clusters "
+                "(%.1f%% face away)%s\n", frustum_culled, cone_culled, 100.0 * triangles_culled / triangle_count,
+                100.0 * backfacing / triangle_count, wrongly_culled ? ", MISMATCH: front faces culled" : "");
+    return 0;
+}
@@ -0,0 +1,222 @@
+// micro_bench.cpp
+// microbenchmark suite for the engine's building blocks: vector and matrix math (scalar and sse),
+// the vertex stage, fill rate by triangle size, lighting by light count, framebuffer clears and image output
+// results go to micro_bench.json for comparison between commits (see bench_harness.h for options)
+
+#include "bench_harness.h"
+#include "../rendering/renderer.h"
+#include "../rendering/rasterizer.h"
+#include "../rendering/vertex_transform.h"
+#include "../rendering/framebuffer.h"
+#include "../math/simd_math.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const size_t BATCH = 4096;  // points, vertices or surfaces per call
+    
+    std::vector<Mat4> random_matrices(size_t count, std::mt19937& rng) {
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f), offset(-5.0f, 5.0f), size(0.5f, 2.0f);
+        std::vector<Mat4> matrices;
+        for (size_t i = 0; i < count; i++) {
+            matrices.push_back(Mat4::translation(Vec3(offset(rng), offset(rng), offset(rng))) *
+                               Mat4::rotation_y(angle(rng)) * Mat4::scale(Vec3(size(rng), size(rng), size(rng))));
+        }
+        return matrices;
+    }
+    
+    // random triangles of about size pixels across, each nearer than the one before, so every
+    // covered pixel passes the depth test and is written; they share a square about 16 triangles
+    // wide, so the tiles the lazy clear fills stay few next to the pixels drawn
+    std::vector<RasterTriangle> make_fill_triangles(float size, std::mt19937& rng, uint64_t& pixels) {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        TileRect screen = {0, 0, WIDTH, HEIGHT};
+        float region = std::min(std::max(size * 16.0f, (float)TILE_SIZE), (float)HEIGHT);
+        const int count = 2048;
+        std::vector<RasterTriangle> triangles;
+        for (int i = 0; i < count; i++) {
+            float x = unit(rng) * (region - size - 2) + 1, y = unit(rng) * (region - size - 2) + 1;
+            float z = 0.9f - 0.8f * i / count;
+            Vec3 a(x + unit(rng) * size * 0.3f, y, z);
+            Vec3 b(x + size, y + unit(rng) * size, z);
+            Vec3 c(x + unit(rng) * size, y + size, z);
+            RasterTriangle tri;
+            if (setup_triangle(a, c, b, Vec3(unit(rng), unit(rng), unit(rng)), screen, tri)) triangles.push_back(tri);
+        }
+        Framebuffer framebuffer(WIDTH, HEIGHT);
+        RasterStats stats;
+        for (const auto& tri : triangles) rasterize_triangle(tri, screen, framebuffer, &stats);
+        pixels = stats.fragments_written;
+        return triangles;
+    }
+    
+    // Mat4::operator*'s constant-evaluation loop, which run-time products skip for the sse path
+    Mat4 multiply_scalar(const Mat4& a, const Mat4& b) {
+        Mat4 result;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                float sum = 0;
+                for (int k = 0; k < 4; k++) sum += a.m[i * 4 + k] * b.m[k * 4 + j];
+                result.m[i * 4 + j] = sum;
+            }
+        }
+        return result;
+    }
+    
+    // the simd variants promise bit-identical results; a mismatch is reported next to the timings
+    bool same_bits(const void* a, const void* b, size_t bytes) {
+        return std::memcmp(a, b, bytes) == 0;
+    }
+    
+    // largest error of v in units in the last place of reference, over x, y and z
+    float ulp_error(const Vec3& v, const Vec3& reference) {
+        float error = 0.0f;
+        const float values[3] = {v.x, v.y, v.z}, references[3] = {reference.x, reference.y, reference.z};
+        for (int i = 0; i < 3; i++) {
+            float ulp = std::nextafter(std::fabs(references[i]), INFINITY) - std::fabs(references[i]);
+            error = std::max(error, std::fabs(values[i] - references[i]) / ulp);
+        }
+        return error;
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchHarness harness("micro_bench", argc, argv);
+    std::mt19937 rng(1234);
+    
+    // matrix math; products also fold at compile time
+    constexpr Mat4 folded = Mat4::translation(Vec3(1, 2, 3)) * Mat4::scale(Vec3(2, 2, 2));
+    static_assert(folded.m[0] == 2 && folded.m[3] == 1 && folded.transform_point(Vec3(1, 0, 0)).x == 3,
+                  "constexpr matrix math");
+    std::vector<Mat4> a = random_matrices(BATCH, rng), b = random_matrices(BATCH, rng), product(BATCH);
+    harness.run("mat4_multiply", "matrix", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) product[i] = a[i] * b[i];
+        keep_result(product);
+    });
+    
+    // the sse product against the scalar loop constant evaluation uses, which it must match
+    std::vector<Mat4> product_scalar(BATCH);
+    harness.run("mat4_multiply_scalar", "matrix", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) product_scalar[i] = multiply_scalar(a[i], b[i]);
+        keep_result(product_scalar);
+    });
+    bool products_match = same_bits(product.data(), product_scalar.data(), BATCH * sizeof(Mat4));
+    
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    std::vector<Vec3> points(BATCH), transformed(BATCH);
+    for (Vec3& p : points) p = Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+    const Mat4& model = a[0];
+    harness.run("mat4_transform_point", "point", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) transformed[i] = model.transform_point(points[i]);
+        keep_result(transformed);
+    });
+    std::vector<Vec3> batched(BATCH);
+    harness.run("transform_points", "point", BATCH, [&] {
+        transform_points(model, points.data(), batched.data(), BATCH);
+        keep_result(batched);
+    });
+    bool points_match = same_bits(batched.data(), transformed.data(), BATCH * sizeof(Vec3));
+
+    harness.run("mat4_transform_direction", "vector", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) transformed[i] = model.transform_direction(points[i]);
+        keep_result(transformed);
+    });
+    
+    // vector math: the exact normalize against the batched reciprocal square root estimate
+    std::vector<Vec3> unit(BATCH), unit_fast(BATCH);
+    harness.run("vec3_normalize", "vector", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) unit[i] = points[i].normalize();
+        keep_result(unit);
+    });
+    harness.run("normalize_vectors", "vector", BATCH, [&] {
+        normalize_vectors(points.data(), unit_fast.data(), BATCH);
+        keep_result(unit_fast);
+    });
+    float fast_error = 0.0f;
+    for (size_t i = 0; i < BATCH; i++) fast_error = std::max(fast_error, ulp_error(unit_fast[i], points[i].normalize()));
+    harness.run("vec3_cross", "vector", BATCH, [&] {
+        for (size_t i = 0; i < BATCH; i++) unit[i] = points[i].cross(points[(i + 1) % BATCH]);
+        keep_result(unit);
+    });
+    
+    // the renderer's batched vertex stage, on the widest simd path
+    Mat4 view_proj = Mat4::perspective(1.0f, (float)WIDTH / HEIGHT, 0.1f, 100.0f) *
+                     Mat4::look_at(Vec3(0, 5, 25), Vec3(0, 0, 0), Vec3(0, 1, 0));
+    VertexTransform transform(model, view_proj, WIDTH, HEIGHT);
+    std::vector<Vertex> vertices(BATCH);
+    for (size_t i = 0; i < BATCH; i++) vertices[i] = Vertex(points[i], points[(i + 1) % BATCH].normalize());
+    std::vector<ScreenVertex> screen_vertices(BATCH);
+    harness.run("vertex_stage_positions", "vertex", BATCH, [&] {
+        transform_vertex_batch(transform, vertices.data(), BATCH, screen_vertices.data(), false);
+        keep_result(screen_vertices);
+    });
+    harness.run("vertex_stage_normals", "vertex", BATCH, [&] {
+        transform_vertex_batch(transform, vertices.data(), BATCH, screen_vertices.data(), true);
+        keep_result(screen_vertices);
+    });
+    
+    // fill rate of the raster kernels alone, hierarchical z has its own benchmark; the clear
+    // before each pass only fills the few tiles the triangles touch
+    set_raster_hiz(false);
+    Framebuffer framebuffer(WIDTH, HEIGHT);
+    TileRect screen = {0, 0, WIDTH, HEIGHT};
+    for (float size : {4.0f, 16.0f, 64.0f, 256.0f}) {
+        uint64_t pixels = 0;
+        std::vector<RasterTriangle> triangles = make_fill_triangles(size, rng, pixels);
+        harness.run("fill_" + std::to_string((int)size) + "px", "pixel", pixels, [&] {
+            framebuffer.clear();
+            for (const auto& tri : triangles) rasterize_triangle(tri, screen, framebuffer);
+        });
+    }
+    set_raster_hiz(true);
+    
+    // phong lighting by number of lights: one directional light, the rest point lights
+    Renderer renderer(64, 64);
+    Material material(Vec3(0.7f, 0.5f, 0.3f), Vec3(1, 1, 1), 32.0f);
+    std::vector<Vec3> normals(BATCH), colors(BATCH);
+    for (size_t i = 0; i < BATCH; i++) normals[i] = Vec3(coordinate(rng), coordinate(rng), coordinate(rng)).normalize();
+    Vec3 view_dir = Vec3(0, -0.3f, -1).normalize();
+    for (int light_count : {1, 4, 16, 64}) {
+        std::vector<Light> lights = {Light(LightType::DIRECTIONAL, Vec3(-0.5f, -1, -0.3f), Vec3(1, 1, 1), 0.5f)};
+        while ((int)lights.size() < light_count) {
+            lights.push_back(Light(LightType::POINT, Vec3(coordinate(rng), coordinate(rng), coordinate(rng))));
+        }
+        harness.run("lighting_" + std::to_string(light_count) + "_lights", "surface", BATCH, [&] {
+            for (size_t i = 0; i < BATCH; i++) {
+                colors[i] = renderer.calculate_lighting(points[i], normals[i], material, lights, view_dir);
+            }
+            keep_result(colors);
+        });
+    }
+    
+    // clears: the lazy clear itself, and the clear with every tile filled as a frame would
+    uint64_t frame_pixels = (uint64_t)WIDTH * HEIGHT;
+    harness.run("framebuffer_clear", "frame", 1, [&] {
+        framebuffer.clear(Vec3(0.1f, 0.1f, 0.2f));
+    });
+    harness.run("framebuffer_clear_resolve", "pixel", frame_pixels, [&] {
+        framebuffer.clear(Vec3(0.1f, 0.1f, 0.2f));
+        framebuffer.resolve();
+    });
+    
+    // image output through the file system, without the log line of every save
+    const char* image_path = "micro_bench.ppm";
+    std::cout.setstate(std::ios::failbit);
+    harness.run("save_ppm", "pixel", frame_pixels, [&] {
+        framebuffer.save_ppm(image_path);
+    });
+    std::cout.clear();
+    std::remove(image_path);
+    
+    std::printf("\nsse matrix products %s, batched point transforms %s; normalize_vectors within %.1f ulp\n",
+                products_match ? "match the scalar loop" : "DIFFER from the scalar loop",
+                points_match ? "match transform_point" : "DIFFER from transform_point", fast_error);
+    return harness.finish() ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+// msaa_bench.cpp
+// 4x multisampling against brute-force 2x2 supersampling on the demo scene: frame time, pixel
+// memory, and the error of each image against a 4x4 supersampled reference, over the whole frame
+// and over the edge pixels where aliasing shows. also checks that flushing after every mesh gives
+// the same multisampled image as one flush per frame, and exits with an error when it does not
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+    const int WIDTH = 800, HEIGHT = 600;
+    const int REPEATS = 10;
+    const int REFERENCE_SCALE = 4;  // the reference takes 16 samples per pixel
+    
+    // channels of a pixel farther than this from the reference without anti-aliasing count as edge
+    const int EDGE_STEPS = 8;
+    
+    // box filter of a scale x scale supersampled framebuffer into packed pixels, rounding to nearest
+    void downsample(Framebuffer& source, int scale, std::vector<uint32_t>& image) {
+        source.resolve();
+        int count = scale * scale;
+        image.resize((size_t)WIDTH * HEIGHT);
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                uint32_t sum[4] = {0, 0, 0, 0};
+                for (int sy = 0; sy < scale; sy++) {
+                    const uint32_t* row = source.get_color_row(y * scale + sy) + x * scale;
+                    for (int sx = 0; sx < scale; sx++) {
+                        for (int c = 0; c < 4; c++) sum[c] += (row[sx] >> (8 * c)) & 0xFF;
+                    }
+                }
+                uint32_t packed = 0;
+                for (int c = 0; c < 4; c++) packed |= ((sum[c] + count / 2) / count) << (8 * c);
+                image[(size_t)y * WIDTH + x] = packed;
+            }
+        }
+    }
+    
+    // the same for 2x2, as fast as the supersampled frame can have it: channels 0 and 2, then 1 and
+    // 3, are summed in the 16-bit halves of one word, which four bytes and the rounding cannot overflow
+    void downsample_2x2(Framebuffer& source, std::vector<uint32_t>& image) {
+        source.resolve();
+        image.resize((size_t)WIDTH * HEIGHT);
+        const uint32_t mask = 0x00FF00FF, round = 0x00020002;
+        for (int y = 0; y < HEIGHT; y++) {
+            const uint32_t* top = source.get_color_row(2 * y);
+            const uint32_t* bottom = source.get_color_row(2 * y + 1);
+            uint32_t* out = image.data() + (size_t)y * WIDTH;
+            for (int x = 0; x < WIDTH; x++) {
+                uint32_t a = top[2 * x], b = top[2 * x + 1], c = bottom[2 * x], d = bottom[2 * x + 1];
+                uint32_t even = (a & mask) + (b & mask) + (c & mask) + (d & mask) + round;
+                uint32_t odd = ((a >> 8) & mask) + ((b >> 8) & mask) + ((c >> 8) & mask) + ((d >> 8) & mask) + round;
+                out[x] = ((even >> 2) & mask) | (((odd >> 2) & mask) << 8);
+            }
+        }
+    }
+    
+    void copy_image(Framebuffer& framebuffer, std::vector<uint32_t>& image) {
+        framebuffer.resolve();
+        image.clear();
+        for (int y = 0; y < HEIGHT; y++) {
+            const uint32_t* row = framebuffer.get_color_row(y);
+            image.insert(image.end(), row, row + WIDTH);
+        }
+    }
+    
+    // best of REPEATS frames, with the 2x2 downsample when the renderer is twice the output size
+    double best_frame_ms(Scene& scene, Renderer& renderer, bool flat_shading, std::vector<uint32_t>& image) {
+        Framebuffer& framebuffer = renderer.get_framebuffer();
+        bool supersampled = framebuffer.get_width() == 2 * WIDTH;
+        double best = 1e30;
+        for (int r = 0; r < REPEATS; r++) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, flat_shading);
+            if (supersampled) downsample_2x2(framebuffer, image);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, ms);
+        }
+        if (!supersampled) copy_image(framebuffer, image);
+        return best;
+    }
+    
+    // the demo scene's meshes drawn in order, flushed after each one or only at the end; mid-frame
+    // flushes must not cost the tiles their samples
+    void render_meshes(Scene& scene, Renderer& renderer, bool flat_shading, bool flush_each,
+                       std::vector<uint32_t>& image) {
+        renderer.clear(Vec3(0.1f, 0.1f, 0.2f));
+        for (const Mesh& mesh : scene.meshes) {
+            renderer.render_mesh(mesh, scene.camera, scene.lights, false, flat_shading);
+            if (flush_each) renderer.flush();
+        }
+        renderer.flush();
+        copy_image(renderer.get_framebuffer(), image);
+    }
+    
+    double framebuffer_mib(const Framebuffer& framebuffer) {
+        return (double)framebuffer.get_stride() * framebuffer.get_height() * (sizeof(uint32_t) + sizeof(float)) /
+               (1024.0 * 1024.0);
+    }
+    
+    // mean 8-bit error per channel against the reference, over every pixel and over edge pixels
+    struct ImageError {
+        double mean = 0.0, edge_mean = 0.0;
+        int max_step = 0;
+    };
+    
+    int channel_step(uint32_t a, uint32_t b, int shift) {
+        return std::abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+    }
+    
+    ImageError measure(const std::vector<uint32_t>& image, const std::vector<uint32_t>& reference,
+                       const std::vector<unsigned char>& edge) {
+        ImageError error;
+        double sum = 0.0, edge_sum = 0.0;
+        uint64_t edge_pixels = 0;
+        for (size_t i = 0; i < image.size(); i++) {
+            int pixel = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                int step = channel_step(image[i], reference[i], shift);
+                pixel += step;
+                error.max_step = std::max(error.max_step, step);
+            }
+            sum += pixel;
+            if (edge[i]) {
+                edge_sum += pixel;
+                edge_pixels++;
+            }
+        }
+        error.mean = sum / (3.0 * image.size());
+        error.edge_mean = edge_sum / (3.0 * std::max<uint64_t>(1, edge_pixels));
+        return error;
+    }
+}
+
+int main() {
+    Scene scene;  // the demo scene and camera, as the demo renders them
+    
+    Renderer renderer(WIDTH, HEIGHT);
+    Renderer supersampled(2 * WIDTH, 2 * HEIGHT);
+    Renderer reference_renderer(REFERENCE_SCALE * WIDTH, REFERENCE_SCALE * HEIGHT);
+    int threads = renderer.get_thread_count();
+    std::printf("anti-aliasing on the demo scene, %dx%d, %d thread(s), best of %d, errors in 8-bit steps against "
+                "%dx%d supersampling\n", WIDTH, HEIGHT, threads, REPEATS, REFERENCE_SCALE, REFERENCE_SCALE);
+    
+    bool failed = false;
+    for (int pass = 0; pass < 2; pass++) {
+        bool flat_shading = pass == 0;
+        std::vector<uint32_t> reference, aliased, multisampled, image, one_flush, flushed;
+        scene.render(reference_renderer, false, flat_shading);
+        downsample(reference_renderer.get_framebuffer(), REFERENCE_SCALE, reference);
+        
+        renderer.set_multisampling(false);
+        double aliased_ms = best_frame_ms(scene, renderer, flat_shading, aliased);
+        renderer.set_multisampling(true);
+        double msaa_ms = best_frame_ms(scene, renderer, flat_shading, multisampled);
+        render_meshes(scene, renderer, flat_shading, false, one_flush);
+        render_meshes(scene, renderer, flat_shading, true, flushed);
+        
+        // a sample tile per worker, plus the bases of tiles redrawn after a flush
+        double sample_mib = (double)renderer.get_sample_memory() / (1024.0 * 1024.0);
+        renderer.set_multisampling(false);
+        int flush_step = 0;
+        for (size_t i = 0; i < one_flush.size(); i++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                flush_step = std::max(flush_step, channel_step(one_flush[i], flushed[i], shift));
+            }
+        }
+        double ssaa_ms = best_frame_ms(scene, supersampled, flat_shading, image);
+        
+        // edge pixels: where the aliased image strays from the reference
+        std::vector<unsigned char> edge(aliased.size());
+        size_t edge_pixels = 0;
+        for (size_t i = 0; i < aliased.size(); i++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                edge[i] |= channel_step(aliased[i], reference[i], shift) > EDGE_STEPS;
+            }
+            edge_pixels += edge[i];
+        }
+        
+        std::printf("\n%s shading, %zu edge pixels (%.2f%%)\n", flat_shading ? "flat" : "gouraud", edge_pixels,
+                    100.0 * edge_pixels / aliased.size());
+        std::printf("%-16s %9s %8s %11s %10s %10s %9s\n", "mode", "frame ms", "cost", "pixel MiB", "mean err",
+                    "edge err", "max err");
+        struct Row {
+            const char* name;
+            double ms, mib;
+            const std::vector<uint32_t>* image;
+        };
+        const Row rows[] = {
+            {"no anti-alias", aliased_ms, framebuffer_mib(renderer.get_framebuffer()), &aliased},
+            {"4x msaa", msaa_ms, framebuffer_mib(renderer.get_framebuffer()) + sample_mib, &multisampled},
+            {"2x2 supersample", ssaa_ms, framebuffer_mib(supersampled.get_framebuffer()), &image},
+        };
+        for (const Row& row : rows) {
+            ImageError error = measure(*row.image, reference, edge);
+            std::printf("%-16s %9.2f %7.2fx %11.2f %10.4f %10.3f %9d\n", row.name, row.ms, row.ms / aliased_ms,
+                        row.mib, error.mean, error.edge_mean, error.max_step);
+        }
+        std::printf("4x msaa flushed after every mesh: max difference %d against one flush%s\n", flush_step,
+                    flush_step ? "  FAILED" : "");
+        failed = failed || flush_step > 0;
+    }
+    if (failed) {
+        std::fprintf(stderr, "Error: mid-frame flushes changed the multisampled image\n");
+        return 1;
+    }
+    return 0;
+}
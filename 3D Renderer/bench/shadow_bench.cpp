@@ -0,0 +1,135 @@
+// shadow_bench.cpp
+// shadow mapping over camera orbits of static scenes: frame time without shadows, with the maps
+// redrawn every frame, and with cached maps, plus a case where one object moves each frame
+
+#include "../rendering/renderer.h"
+#include "../scene/scene.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int ORBIT_FRAMES = 48;
+    
+    // a grid of spheres and boxes on a floor, lit by the sun and two point lights
+    void build_field(Scene& scene) {
+        scene.clear_scene();
+        Material floor_material(Vec3(0.6f, 0.6f, 0.6f), Vec3(0.3f, 0.3f, 0.3f), 16.0f);
+        Mesh floor = Mesh::create_plane(24.0f, floor_material);
+        floor.transform = Mat4::translation(Vec3(0, -1, 0));
+        scene.add_mesh(floor);
+        for (int i = 0; i < 36; i++) {
+            Material material(Vec3(0.3f + 0.1f * (i % 7), 0.5f, 0.9f - 0.1f * (i % 5)), Vec3(1, 1, 1), 32.0f);
+            Vec3 position((i % 6 - 2.5f) * 3.0f, 0.0f, (i / 6 - 2.5f) * 3.0f);
+            Mesh mesh = i % 3 == 0 ? Mesh::create_cube(1.4f, material) : Mesh::create_sphere(0.8f, 48, material);
+            mesh.transform = Mat4::translation(position);
+            scene.add_mesh(mesh);
+        }
+        scene.add_light(Light(LightType::DIRECTIONAL, Vec3(-0.4f, -1, -0.3f), Vec3(1, 1, 0.9f), 0.6f));
+        scene.add_light(Light(LightType::POINT, Vec3(-4, 3, 2), Vec3(1, 0.8f, 0.6f), 1.0f));
+        scene.add_light(Light(LightType::POINT, Vec3(5, 2.5f, -3), Vec3(0.6f, 0.8f, 1), 1.0f));
+        scene.camera.position = Vec3(0, 9, 18);
+        scene.camera.target = Vec3(0, 0, 0);
+    }
+    
+    void build_demo(Scene& scene) {
+        scene.clear_scene();
+        scene.create_demo_scene();
+        scene.camera.position = Vec3(5, 3, 5);
+        scene.camera.target = Vec3(0, 0, 0);
+    }
+    
+    enum class Mode { NO_SHADOWS, UNCACHED, CACHED, CACHED_MOVING };
+    
+    struct OrbitResult {
+        double frame_ms = 0.0;   // per frame, shadow pass included
+        double shadow_ms = 0.0;  // per frame
+        double faces_rendered = 0.0, faces_cached = 0.0;
+        double triangles = 0.0;
+    };
+    
+    // one orbit of the camera around the scene; in the moving case the last object bobs up and down
+    OrbitResult run_orbit(Scene& scene, Renderer& renderer, Mode mode) {
+        renderer.set_shadow_mapping(mode != Mode::NO_SHADOWS);
+        ShadowSettings settings;
+        settings.cache = mode != Mode::UNCACHED;
+        renderer.set_shadow_settings(settings);
+        Mesh& mover = scene.meshes.back();
+        Mat4 rest = mover.transform;
+        
+        // a first frame draws every map, so the orbit shows the steady state
+        scene.render(renderer, false, false);
+        OrbitResult result;
+        for (int f = 0; f < ORBIT_FRAMES; f++) {
+            scene.camera.rotate_around_target(2.0f * 3.14159265f / ORBIT_FRAMES, 0.0f);
+            if (mode == Mode::CACHED_MOVING) {
+                mover.transform = Mat4::translation(Vec3(0, 0.5f * std::sin(f * 0.4f), 0)) * rest;
+                scene.update_bounds();
+            }
+            auto start = std::chrono::steady_clock::now();
+            scene.render(renderer, false, false);
+            renderer.flush();
+            result.frame_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const ShadowStats& stats = renderer.get_shadow_stats();
+            if (mode != Mode::NO_SHADOWS) {
+                result.shadow_ms += stats.update_ms;
+                result.faces_rendered += stats.faces_rendered;
+                result.faces_cached += stats.faces_cached;
+                result.triangles += stats.triangles_drawn;
+            }
+        }
+        mover.transform = rest;
+        scene.update_bounds();
+        
+        result.frame_ms /= ORBIT_FRAMES;
+        result.shadow_ms /= ORBIT_FRAMES;
+        result.faces_rendered /= ORBIT_FRAMES;
+        result.faces_cached /= ORBIT_FRAMES;
+        result.triangles /= ORBIT_FRAMES;
+        return result;
+    }
+}
+
+int main() {
+    Renderer renderer(WIDTH, HEIGHT);
+    renderer.set_deferred(true);
+    renderer.set_lighting_mode(LightingMode::BATCHED_PHONG);
+    ShadowSettings defaults;
+    std::printf("shadow maps, %dx%d deferred, %d thread(s), %d-frame camera orbit, %d texel directional maps, "
+                "%d texel cube faces, %dx%d pcf\n", WIDTH, HEIGHT, renderer.get_thread_count(), ORBIT_FRAMES,
+                defaults.directional_size, defaults.cube_size, 2 * defaults.pcf_radius + 1, 2 * defaults.pcf_radius + 1);
+    
+    struct Case {
+        const char* name;
+        Mode mode;
+    };
+    const Case cases[] = {
+        {"no shadows", Mode::NO_SHADOWS},
+        {"shadows, redrawn", Mode::UNCACHED},
+        {"shadows, cached", Mode::CACHED},
+        {"cached, one moving", Mode::CACHED_MOVING},
+    };
+    Scene scene;
+    for (int s = 0; s < 2; s++) {
+        if (s == 0) {
+            build_demo(scene);
+        } else {
+            build_field(scene);
+        }
+        scene.camera.aspect_ratio = (float)WIDTH / HEIGHT;
+        size_t triangles = 0;
+        for (const Mesh& mesh : scene.meshes) triangles += mesh.triangles.size();
+        std::printf("\n%s scene: %zu objects, %zu triangles, %zu lights\n", s == 0 ? "demo" : "field",
+                    scene.get_mesh_count(), triangles, scene.get_light_count());
+        std::printf("%-20s %9s %10s %14s %12s %12s\n", "case", "frame ms", "shadow ms", "faces drawn", "faces kept",
+                    "triangles");
+        for (const Case& c : cases) {
+            OrbitResult result = run_orbit(scene, renderer, c.mode);
+            std::printf("%-20s %9.2f %10.3f %14.2f %12.2f %12.0f\n", c.name, result.frame_ms, result.shadow_ms,
+                        result.faces_rendered, result.faces_cached, result.triangles);
+        }
+    }
+    return 0;
+}
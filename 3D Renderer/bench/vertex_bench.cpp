@@ -0,0 +1,103 @@
+// vertex_bench.cpp
+// vertex stage throughput on a one million vertex mesh
+// compares the original per-vertex matrix calls against the batched scalar, sse2 and avx2 kernels
+
+#include "../rendering/vertex_transform.h"
+#include "../rendering/rasterizer.h"
+#include "../rendering/camera.h"
+#include "../geometry/mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+    const int WIDTH = 1920, HEIGHT = 1080;
+    const int SEGMENTS = 999;  // (SEGMENTS + 1)^2 vertices
+    
+    // the loop render_mesh ran before the vertex stage: three full matrix transforms, a normal
+    // transform and a push_back into a fresh vector per vertex
+    void legacy_transform(const Mesh& mesh, const Camera& camera, std::vector<Vertex>& out) {
+        Mat4 mvp = camera.get_projection_matrix() * camera.get_view_matrix() * mesh.transform;
+        Mat4 model_view = camera.get_view_matrix() * mesh.transform;
+        out = std::vector<Vertex>();
+        for (const Vertex& vertex : mesh.vertices) {
+            Vertex transformed = vertex;
+            Vec3 world_pos = mesh.transform.transform_point(vertex.position);
+            Vec3 view_pos = model_view.transform_point(vertex.position);
+            Vec3 clip_pos = mvp.transform_point(vertex.position);
+            if (clip_pos.z != 0) {
+                transformed.position.x = (clip_pos.x / clip_pos.z + 1.0f) * WIDTH * 0.5f;
+                transformed.position.y = (1.0f - clip_pos.y / clip_pos.z) * HEIGHT * 0.5f;
+                transformed.position.z = clip_pos.z;
+            }
+            transformed.normal = mesh.transform.transform_direction(vertex.normal).normalize();
+            transformed.color = world_pos + view_pos;  // keep both transforms alive
+            out.push_back(transformed);
+        }
+    }
+    
+    // best wall time of fn over several runs
+    template <typename Fn>
+    double best_time_ms(Fn&& fn, int repetitions = 10) {
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+    
+    void report(const char* name, double ms, size_t vertices, size_t bytes, double baseline_ms) {
+        std::printf("%-22s %10.3f %12.1f %10.2f %8.2fx\n", name, ms, vertices / (ms * 1000.0),
+                    bytes / (ms * 1e6), baseline_ms / ms);
+    }
+}
+
+int main() {
+    Mesh mesh = Mesh::create_sphere(1.0f, SEGMENTS, Material());
+    mesh.transform = Mat4::translation(Vec3(0.2f, -0.1f, -0.5f)) * Mat4::rotation_y(0.7f) *
+                     Mat4::scale(Vec3(1.5f, 1.0f, 0.8f));
+    Camera camera;
+    camera.position = Vec3(0, 1, 4);
+    camera.aspect_ratio = (float)WIDTH / HEIGHT;
+    size_t count = mesh.vertices.size();
+    
+    std::printf("vertex stage, %zu vertices, one thread, best of 10\n", count);
+    std::printf("bytes counted: vertex read plus post-transform write\n\n");
+    std::printf("%-22s %10s %12s %10s %9s\n", "path", "ms", "Mvert/s", "GB/s", "speedup");
+    
+    std::vector<Vertex> legacy;
+    double legacy_ms = best_time_ms([&] { legacy_transform(mesh, camera, legacy); }, 3);
+    report("per-vertex (legacy)", legacy_ms, count, count * 2 * sizeof(Vertex), legacy_ms);
+    
+    VertexTransform transform(mesh.transform, camera.get_projection_matrix() * camera.get_view_matrix(),
+                              WIDTH, HEIGHT);
+    std::vector<ScreenVertex> reference(count), out(count);
+    const SimdLevel levels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+    for (SimdLevel level : levels) {
+        if (level > detect_simd_level()) continue;
+        set_raster_simd_level(level);
+        for (bool with_normals : {false, true}) {
+            double ms = best_time_ms([&] {
+                transform_vertex_batch(transform, mesh.vertices.data(), count, out.data(), with_normals);
+            });
+            
+            // every path must reproduce the scalar kernel bit for bit
+            if (level == SimdLevel::SCALAR) reference = out;
+            bool identical = std::memcmp(reference.data(), out.data(), count * sizeof(ScreenVertex)) == 0;
+            
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s%s%s", simd_level_name(level), with_normals ? " +normals" : "",
+                          identical ? "" : " MISMATCH");
+            size_t written = with_normals ? sizeof(ScreenVertex) - sizeof(Vec3) : 2 * sizeof(Vec3) + sizeof(float);
+            report(name, ms, count, count * (sizeof(Vertex) + written), legacy_ms);
+        }
+    }
+    set_raster_simd_level(detect_simd_level());
+    
+    return 0;
+}
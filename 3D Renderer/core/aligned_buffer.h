@@ -0,0 +1,69 @@
+// aligned_buffer.h
+// fixed-size heap array with cache-line alignment
+// used for pixel planes and other arrays that simd loops stream through
+
+#ifndef ALIGNED_BUFFER_H
+#define ALIGNED_BUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// one cache line; simd loads never straddle two lines when rows start on this boundary
+constexpr size_t CACHE_LINE = 64;
+
+// owning array of trivially copyable elements, 64-byte aligned, left uninitialized on allocation
+template <typename T>
+class AlignedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "aligned buffers hold plain data only");
+    
+public:
+    AlignedBuffer() : elements(nullptr), count(0) {}
+    explicit AlignedBuffer(size_t n) : elements(nullptr), count(0) { reset(n); }
+    ~AlignedBuffer() { release(); }
+    
+    AlignedBuffer(const AlignedBuffer& other) : elements(nullptr), count(0) {
+        reset(other.count);
+        if (count) std::memcpy(elements, other.elements, count * sizeof(T));
+    }
+    
+    AlignedBuffer(AlignedBuffer&& other) noexcept : elements(other.elements), count(other.count) {
+        other.elements = nullptr;
+        other.count = 0;
+    }
+    
+    AlignedBuffer& operator=(AlignedBuffer other) noexcept {
+        std::swap(elements, other.elements);
+        std::swap(count, other.count);
+        return *this;
+    }
+    
+    // reallocate to n elements; previous contents are discarded
+    void reset(size_t n) {
+        release();
+        if (n == 0) return;
+        elements = static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(CACHE_LINE)));
+        count = n;
+    }
+    
+    T* data() { return elements; }
+    const T* data() const { return elements; }
+    size_t size() const { return count; }
+    
+    T& operator[](size_t i) { return elements[i]; }
+    const T& operator[](size_t i) const { return elements[i]; }
+    
+private:
+    void release() {
+        if (elements) ::operator delete(elements, std::align_val_t(CACHE_LINE));
+        elements = nullptr;
+        count = 0;
+    }
+    
+    T* elements;
+    size_t count;
+};
+
+#endif
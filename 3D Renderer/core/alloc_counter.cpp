@@ -0,0 +1,48 @@
+// alloc_counter.cpp
+// replacement global operator new and delete that count allocations
+// a relaxed atomic increment per allocation, small next to the allocation itself
+
+#include "alloc_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> allocations{0};
+    
+    void* allocate(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+            if (void* memory = std::malloc(size ? size : 1)) return memory;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+    
+    void* allocate_aligned(size_t size, std::align_val_t alignment) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t align = std::max(sizeof(void*), (size_t)alignment);
+        while (true) {
+            void* memory = nullptr;
+            if (posix_memalign(&memory, align, size ? size : 1) == 0) return memory;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+}
+
+uint64_t heap_allocation_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// the array and nothrow forms of the standard library forward to these two
+void* operator new(size_t size) { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate_aligned(size, alignment); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
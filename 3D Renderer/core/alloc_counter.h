@@ -0,0 +1,15 @@
+// alloc_counter.h
+// process-wide count of heap allocations, for checking that steady-state frames make none
+// linking alloc_counter.cpp replaces the global operator new, so every allocation in that program
+// is counted; only the benchmarks link it, render_engine keeps the standard allocator
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// allocations made through operator new (scalar, array, aligned and nothrow forms) on any thread
+// since the program started; take the difference over the frames of interest
+uint64_t heap_allocation_count();
+
+#endif
@@ -0,0 +1,27 @@
+// cpu_features.cpp
+// implementation of simd capability detection
+
+#include "cpu_features.h"
+
+SimdLevel detect_simd_level() {
+#if RENDER_HAS_X86_SIMD
+    // the result cannot change while the process runs, so query the cpu once
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::SCALAR;
+    }();
+    return level;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
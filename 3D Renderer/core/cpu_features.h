@@ -0,0 +1,28 @@
+// cpu_features.h
+// runtime detection of the simd instruction sets the engine has kernels for
+// lets hot loops pick the widest path the current cpu supports
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// x86 kernels are compiled with per-function target attributes, so they need gcc or clang
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RENDER_HAS_X86_SIMD 1
+#else
+#define RENDER_HAS_X86_SIMD 0
+#endif
+
+// simd paths in increasing order of width
+enum class SimdLevel {
+    SCALAR,  // portable c++ fallback
+    SSE2,    // 4-wide
+    AVX2     // 8-wide
+};
+
+// widest level supported by this cpu (and by this build)
+SimdLevel detect_simd_level();
+
+// human readable name for logs and benchmark output
+const char* simd_level_name(SimdLevel level);
+
+#endif
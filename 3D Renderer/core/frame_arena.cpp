@@ -0,0 +1,44 @@
+// frame_arena.cpp
+// implementation of the linear frame allocator
+
+#include "frame_arena.h"
+#include <algorithm>
+
+namespace {
+    // smallest block the arena allocates, so the first frames do not grow it in tiny steps
+    const size_t MIN_BLOCK_BYTES = 64 * 1024;
+}
+
+FrameArena::FrameArena(size_t initial_bytes)
+    : block(initial_bytes), current(block.data()), current_size(block.size()), offset(0), retired(0) {}
+
+size_t FrameArena::capacity() const {
+    size_t bytes = block.size();
+    for (const auto& extra : overflow) bytes += extra.size();
+    return bytes;
+}
+
+void* FrameArena::allocate_overflow(size_t bytes) {
+    // blocks double, so a frame needs few of them however far it outgrows the last one;
+    // every block starts on a cache line, which satisfies any allowed alignment
+    retired += offset;
+    size_t size = std::max({bytes, 2 * current_size, MIN_BLOCK_BYTES});
+    overflow.emplace_back(size);
+    current = overflow.back().data();
+    current_size = size;
+    offset = bytes;
+    return current;
+}
+
+void FrameArena::reset() {
+    if (!overflow.empty()) {
+        // one block with room for everything the last frame used
+        size_t needed = retired + offset;
+        overflow.clear();
+        block.reset(needed);
+    }
+    current = block.data();
+    current_size = block.size();
+    offset = 0;
+    retired = 0;
+}
@@ -0,0 +1,55 @@
+// frame_arena.h
+// linear allocator for scratch data that lives until the end of a frame
+// allocation bumps an offset into one block, and reset() releases everything at once
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "aligned_buffer.h"
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// allocations are never freed one by one; reset() rewinds the arena in O(1). a frame that
+// outgrows the block carries on in overflow blocks, and the next reset() replaces them all with
+// one block as large as that frame needed, so once frames stop growing the arena never calls
+// into the heap
+class FrameArena {
+public:
+    explicit FrameArena(size_t initial_bytes = 0);
+    
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    
+    // uninitialized storage for count objects; nothing is ever destroyed, so plain data only
+    template <typename T>
+    T* allocate(size_t count = 1) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        static_assert(alignof(T) <= CACHE_LINE, "blocks are aligned to one cache line");
+        return static_cast<T*>(allocate_bytes(count * sizeof(T), alignof(T)));
+    }
+    
+    // forget every allocation since the last reset
+    void reset();
+    
+    size_t used() const { return retired + offset; }  // bytes handed out since the last reset, with padding
+    size_t capacity() const;                          // bytes held in all blocks
+    
+private:
+    void* allocate_bytes(size_t bytes, size_t alignment) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes > current_size) return allocate_overflow(bytes);
+        offset = start + bytes;
+        return current + start;
+    }
+    void* allocate_overflow(size_t bytes);
+    
+    AlignedBuffer<unsigned char> block;
+    std::vector<AlignedBuffer<unsigned char>> overflow;  // blocks added this frame, newest last
+    unsigned char* current;  // block being filled
+    size_t current_size;
+    size_t offset;           // fill position in current
+    size_t retired;          // bytes consumed in blocks filled earlier this frame
+};
+
+#endif
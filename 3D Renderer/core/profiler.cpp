@@ -0,0 +1,108 @@
+// profiler.cpp
+// implementation of stage timing and trace file output
+
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    uint64_t steady_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+const char* profile_stage_name(ProfileStage stage) {
+    switch (stage) {
+        case ProfileStage::SCENE: return "scene";
+        case ProfileStage::SHADOW: return "shadow";
+        case ProfileStage::VERTEX: return "vertex";
+        case ProfileStage::CULL: return "cull";
+        case ProfileStage::LIGHTING: return "lighting";
+        case ProfileStage::SETUP: return "setup";
+        case ProfileStage::RASTER: return "raster";
+        case ProfileStage::SHADE: return "shade";
+        case ProfileStage::ENCODE: return "encode";
+        default: return "unknown";
+    }
+}
+
+Profiler::Profiler() : epoch(steady_ns() - 1), tracing(false), worker_events(1) {}
+
+void Profiler::resize(int threads) {
+    worker_events.resize(std::max(1, threads));
+}
+
+void Profiler::begin_frame() {
+    times = ProfileTimes();
+}
+
+uint64_t Profiler::now() const {
+    // the epoch sits one nanosecond back, so no timestamp is 0, which EventScope reads as untraced
+    return steady_ns() - epoch;
+}
+
+void Profiler::add_stage(ProfileStage stage, uint64_t start, uint64_t end) {
+    times.stage_ms[(int)stage] += (end - start) / 1e6;
+    times.stage_calls[(int)stage]++;
+    if (tracing) worker_events[0].push_back({profile_stage_name(stage), nullptr, 0, start, end});
+}
+
+void Profiler::add_draw(int64_t object, uint64_t start, uint64_t end) {
+    double ms = (end - start) / 1e6;
+    if (ms > times.slowest_draw_ms) {
+        times.slowest_draw_ms = ms;
+        times.slowest_draw = object;
+    }
+    if (tracing) worker_events[0].push_back({"draw", "object", object, start, end});
+}
+
+void Profiler::add_event(const char* name, int worker, uint64_t start, uint64_t end, const char* arg_name,
+                         int64_t arg) {
+    if (tracing && worker >= 0 && worker < (int)worker_events.size()) {
+        worker_events[worker].push_back({name, arg_name, arg, start, end});
+    }
+}
+
+void Profiler::start_trace() {
+    for (auto& events : worker_events) events.clear();
+    tracing = true;
+}
+
+bool Profiler::write_trace(const std::string& path) const {
+#if RENDER_PROFILING
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Error: Could not write trace file " << path << std::endl;
+        return false;
+    }
+    
+    // one thread per worker, named so the timeline reads as the renderer's pool
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    std::fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"renderer\"}}");
+    for (size_t worker = 0; worker < worker_events.size(); worker++) {
+        std::fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, "
+                     "\"args\": {\"name\": \"%s %zu\"}}", worker, worker == 0 ? "main" : "worker", worker);
+    }
+    for (size_t worker = 0; worker < worker_events.size(); worker++) {
+        for (const TraceEvent& event : worker_events[worker]) {
+            std::fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"render\", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, "
+                         "\"ts\": %.3f, \"dur\": %.3f", event.name, worker, event.start / 1e3,
+                         (event.end - event.start) / 1e3);
+            if (event.arg_name) std::fprintf(file, ", \"args\": {\"%s\": %lld}", event.arg_name, (long long)event.arg);
+            std::fprintf(file, "}");
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    bool ok = std::ferror(file) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) std::cerr << "Error: Could not write trace file " << path << std::endl;
+    return ok;
+#else
+    (void)path;
+    std::cerr << "Error: Tracing needs a build with RENDER_PROFILING=1" << std::endl;
+    return false;
+#endif
+}
@@ -0,0 +1,143 @@
+// profiler.h
+// per-stage frame timing and chrome trace_event export for loading frames into perfetto
+// stage scopes cost two clock reads; building with RENDER_PROFILING=0 compiles them out
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef RENDER_PROFILING
+#define RENDER_PROFILING 1
+#endif
+
+// pipeline stages in frame order; times of each stage add up over every batch of a frame
+enum class ProfileStage {
+    SCENE,     // frustum culling, level-of-detail selection and instance grouping
+    SHADOW,    // shadow map fitting, cache checks and depth-only drawing
+    VERTEX,    // vertex stage
+    CULL,      // frustum rejection, back-face culling and clipping
+    LIGHTING,  // gouraud: lighting each vertex of a front-facing triangle
+    SETUP,     // triangle setup, flat lighting and binning, or visibility setup when deferred
+    RASTER,    // binned tiles, or the immediate path's per-triangle drawing
+    SHADE,     // deferred: lighting every visible pixel
+    ENCODE,    // image encoding and file output
+    COUNT
+};
+constexpr int PROFILE_STAGE_COUNT = (int)ProfileStage::COUNT;
+
+const char* profile_stage_name(ProfileStage stage);
+
+// stage times of the current frame, since the last begin_frame()
+struct ProfileTimes {
+    double stage_ms[PROFILE_STAGE_COUNT] = {};
+    uint32_t stage_calls[PROFILE_STAGE_COUNT] = {};
+    double slowest_draw_ms = 0.0;  // longest submission of one scene object, rasterization excluded when binned
+    int64_t slowest_draw = -1;     // scene object index of that draw, -1 when none was timed
+};
+
+// collects stage times for the frame statistics and, while a trace is running, every timed scope
+// as a trace event; worker ids index one event buffer each, so workers record without locking
+class Profiler {
+public:
+    Profiler();
+    
+    void resize(int threads);  // one event buffer per worker of the renderer's pool
+    void begin_frame();        // restart the stage times
+    const ProfileTimes& get_times() const { return times; }
+    
+    // nanoseconds on a steady clock since the profiler was created
+    uint64_t now() const;
+    
+    void add_stage(ProfileStage stage, uint64_t start, uint64_t end);
+    void add_draw(int64_t object, uint64_t start, uint64_t end);
+    
+    // trace only: a named span on a worker's timeline with an optional integer argument
+    void add_event(const char* name, int worker, uint64_t start, uint64_t end, const char* arg_name = nullptr,
+                   int64_t arg = 0);
+    
+    // tracing keeps every event in memory until write_trace; steady-state frames only allocate
+    // while a trace is running
+    void start_trace();
+    void stop_trace() { tracing = false; }
+    bool is_tracing() const { return tracing; }
+    
+    // chrome trace_event json ("X" complete events, microseconds), loadable by perfetto and
+    // chrome://tracing; returns false when the file cannot be written
+    bool write_trace(const std::string& path) const;
+    
+private:
+    struct TraceEvent {
+        const char* name;
+        const char* arg_name;
+        int64_t arg;
+        uint64_t start, end;
+    };
+    
+    uint64_t epoch;
+    bool tracing;
+    ProfileTimes times;
+    std::vector<std::vector<TraceEvent>> worker_events;
+};
+
+// scopes behind the macros below; each reads the clock on entry and exit
+class StageScope {
+public:
+    StageScope(Profiler& profiler, ProfileStage stage) : profiler(profiler), stage(stage), start(profiler.now()) {}
+    ~StageScope() { profiler.add_stage(stage, start, profiler.now()); }
+    
+private:
+    Profiler& profiler;
+    ProfileStage stage;
+    uint64_t start;
+};
+
+class DrawScope {
+public:
+    DrawScope(Profiler& profiler, int64_t object) : profiler(profiler), object(object), start(profiler.now()) {}
+    ~DrawScope() { profiler.add_draw(object, start, profiler.now()); }
+    
+private:
+    Profiler& profiler;
+    int64_t object;
+    uint64_t start;
+};
+
+// trace-only span; skips the clock entirely while no trace is running
+class EventScope {
+public:
+    EventScope(Profiler& profiler, const char* name, int worker, const char* arg_name = nullptr, int64_t arg = 0)
+        : profiler(profiler), name(name), arg_name(arg_name), arg(arg), worker(worker),
+          start(profiler.is_tracing() ? profiler.now() : 0) {}
+    ~EventScope() {
+        if (start) profiler.add_event(name, worker, start, profiler.now(), arg_name, arg);
+    }
+    
+private:
+    Profiler& profiler;
+    const char* name;
+    const char* arg_name;
+    int64_t arg;
+    int worker;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if RENDER_PROFILING
+// time the rest of the enclosing block as a pipeline stage
+#define PROFILE_STAGE(profiler, stage) StageScope PROFILE_CONCAT(profile_stage_, __LINE__)(profiler, stage)
+// time the rest of the enclosing block as the draw of one scene object
+#define PROFILE_DRAW(profiler, object) DrawScope PROFILE_CONCAT(profile_draw_, __LINE__)(profiler, object)
+// trace the rest of the enclosing block as a named span on a worker's timeline
+#define PROFILE_EVENT(profiler, ...) EventScope PROFILE_CONCAT(profile_event_, __LINE__)(profiler, __VA_ARGS__)
+#else
+#define PROFILE_STAGE(profiler, stage) ((void)0)
+#define PROFILE_DRAW(profiler, object) ((void)0)
+#define PROFILE_EVENT(profiler, ...) ((void)0)
+#endif
+
+#endif
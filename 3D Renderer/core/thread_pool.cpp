@@ -0,0 +1,83 @@
+// thread_pool.cpp
+// implementation of the worker pool
+// one job runs at a time, items are claimed through a shared atomic counter
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads)
+    : task(nullptr), item_count(0), next_item(0), active_workers(0),
+      generation(0), stopping(false) {
+    if (threads <= 0) threads = hardware_threads();
+    
+    // the calling thread takes part in every job, so spawn one fewer
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+int ThreadPool::hardware_threads() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? (int)count : 1;
+}
+
+void ThreadPool::parallel_for(int count, const Task& job) {
+    if (count <= 0) return;
+    
+    // nothing to share: skip the wake-up round trip entirely
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) job(i, 0);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &job;
+        item_count = count;
+        next_item.store(0, std::memory_order_relaxed);
+        active_workers = (int)workers.size();
+        generation++;
+    }
+    work_ready.notify_all();
+    
+    run_items(0);
+    
+    // wait for the other workers to finish the items they already claimed
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this] { return active_workers == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::worker_loop(int worker) {
+    unsigned seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+        }
+        
+        run_items(worker);
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active_workers == 0) work_done.notify_one();
+    }
+}
+
+void ThreadPool::run_items(int worker) {
+    // claim items one at a time until the range is exhausted
+    while (true) {
+        int index = next_item.fetch_add(1, std::memory_order_relaxed);
+        if (index >= item_count) break;
+        (*task)(index, worker);
+    }
+}
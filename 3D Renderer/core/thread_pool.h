@@ -0,0 +1,68 @@
+// thread_pool.h
+// fixed-size worker pool for data-parallel rendering work
+// splits index ranges across threads, the calling thread joins in as a worker
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent pool of worker threads used by the rasterizer and other parallel stages
+// workers sleep between jobs so an idle pool costs nothing
+class ThreadPool {
+public:
+    // task callback receives the item index and the id of the worker running it
+    // worker ids are in [0, thread_count()) and can index per-thread scratch data
+    // the pool only borrows the caller's callable for the duration of parallel_for, so unlike a
+    // std::function it never copies the lambda onto the heap, whatever it captures
+    class Task {
+    public:
+        template <typename F>
+        Task(const F& function)
+            : object(&function),
+              call([](const void* f, int index, int worker) { (*static_cast<const F*>(f))(index, worker); }) {}
+        
+        void operator()(int index, int worker) const { call(object, index, worker); }
+        
+    private:
+        const void* object;
+        void (*call)(const void* function, int index, int worker);
+    };
+    
+    explicit ThreadPool(int threads = 0);  // 0 = one thread per hardware core
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // run task(i) for every i in [0, count) and wait until all are done
+    // items are handed out dynamically so uneven work balances itself
+    void parallel_for(int count, const Task& task);
+    
+    int thread_count() const { return (int)workers.size() + 1; }  // includes the caller
+    
+    static int hardware_threads();
+    
+private:
+    void worker_loop(int worker);
+    void run_items(int worker);
+    
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    
+    // current job, guarded by mutex except for the atomic item counter
+    const Task* task;
+    int item_count;
+    std::atomic<int> next_item;
+    int active_workers;
+    unsigned generation;  // bumped for every job so sleeping workers notice new work
+    bool stopping;
+};
+
+#endif
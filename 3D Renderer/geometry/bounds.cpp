@@ -0,0 +1,63 @@
+// bounds.cpp
+// implementation of bounding box and sphere updates and transforms
+
+#include "bounds.h"
+#include <algorithm>
+
+void Aabb::add_point(const Vec3& p) {
+    min = Vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+    max = Vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+}
+
+void Aabb::add_box(const Aabb& box) {
+    if (box.is_empty()) return;
+    add_point(box.min);
+    add_point(box.max);
+}
+
+void BoundingSphere::add_point(const Vec3& p) {
+    if (is_empty()) {
+        center = p;
+        radius = 0.0f;
+        return;
+    }
+    Vec3 offset = p - center;
+    float distance = offset.length();
+    if (distance <= radius) return;
+    
+    // new sphere spans from the far side of the old one to p
+    float new_radius = (radius + distance) * 0.5f;
+    center = center + offset * ((new_radius - radius) / distance);
+    radius = new_radius;
+}
+
+Aabb transform_aabb(const Mat4& transform, const Aabb& box) {
+    if (box.is_empty()) return box;
+    
+    // the transformed extent along each world axis is the sum of the absolute row terms
+    const float* m = transform.m;
+    Vec3 c = transform.transform_point(box.center());
+    Vec3 e = box.extent();
+    Vec3 extent(std::fabs(m[0]) * e.x + std::fabs(m[1]) * e.y + std::fabs(m[2]) * e.z,
+                std::fabs(m[4]) * e.x + std::fabs(m[5]) * e.y + std::fabs(m[6]) * e.z,
+                std::fabs(m[8]) * e.x + std::fabs(m[9]) * e.y + std::fabs(m[10]) * e.z);
+    
+    Aabb result;
+    result.min = c - extent;
+    result.max = c + extent;
+    return result;
+}
+
+BoundingSphere transform_sphere(const Mat4& transform, const BoundingSphere& sphere) {
+    if (sphere.is_empty()) return sphere;
+    
+    const float* m = transform.m;
+    float scale_sq = std::max({m[0] * m[0] + m[4] * m[4] + m[8] * m[8],
+                               m[1] * m[1] + m[5] * m[5] + m[9] * m[9],
+                               m[2] * m[2] + m[6] * m[6] + m[10] * m[10]});
+    
+    BoundingSphere result;
+    result.center = transform.transform_point(sphere.center);
+    result.radius = sphere.radius * std::sqrt(scale_sq);
+    return result;
+}
@@ -0,0 +1,41 @@
+// bounds.h
+// axis-aligned boxes and spheres bounding a set of points
+// meshes keep both in object space; the scene moves them to world space for culling
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "../math/Vec3.h"
+#include "../math/mat4.h"
+#include <cmath>
+
+// axis-aligned bounding box, empty (min above max) until a point is added
+struct Aabb {
+    Vec3 min = Vec3(INFINITY, INFINITY, INFINITY);
+    Vec3 max = Vec3(-INFINITY, -INFINITY, -INFINITY);
+    
+    bool is_empty() const { return min.x > max.x; }
+    Vec3 center() const { return (min + max) * 0.5f; }
+    Vec3 extent() const { return (max - min) * 0.5f; }
+    
+    void add_point(const Vec3& p);
+    void add_box(const Aabb& box);
+};
+
+struct BoundingSphere {
+    Vec3 center;
+    float radius = -1.0f;  // negative when empty
+    
+    bool is_empty() const { return radius < 0.0f; }
+    
+    // grow just enough to take in p, keeping the old sphere inside the new one
+    void add_point(const Vec3& p);
+};
+
+// box around the transformed corners of box, computed from its center and extent
+Aabb transform_aabb(const Mat4& transform, const Aabb& box);
+
+// sphere around the transformed sphere; the radius is scaled by the largest axis scale
+BoundingSphere transform_sphere(const Mat4& transform, const BoundingSphere& sphere);
+
+#endif
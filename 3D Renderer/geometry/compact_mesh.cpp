@@ -0,0 +1,185 @@
+// compact_mesh.cpp
+// quantization of mesh positions and normals, and the decode back to a full mesh
+// positions round to the nearest of 65536 steps across the bounds, normals to the best octahedral code
+
+#include "compact_mesh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float POSITION_STEPS = 65535.0f;
+    const float NORMAL_STEPS = 127.0f;
+    
+    // error bound of a quantized face normal, as a sine, past which vertex normals do better
+    const float ILL_CONDITIONED_NORMAL = 0.5f;
+    
+    float sign_not_zero(float v) {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+    
+    // snorm8 code of v in -1..1, rounded down or up
+    int8_t snorm8(float v, bool round_up) {
+        float scaled = v * NORMAL_STEPS;
+        float rounded = round_up ? std::ceil(scaled) : std::floor(scaled);
+        return (int8_t)std::min(NORMAL_STEPS, std::max(-NORMAL_STEPS, rounded));
+    }
+}
+
+CompactMesh CompactMesh::encode(const Mesh& mesh) {
+    CompactMesh compact;
+    compact.material = mesh.material;
+    compact.transform = mesh.transform;
+    
+    // the quantization grid spans the exact bounds, whatever the mesh's cached ones say
+    for (const auto& vertex : mesh.vertices) {
+        compact.bounds.add_point(vertex.position);
+    }
+    Vec3 size = compact.bounds.is_empty() ? Vec3() : compact.bounds.max - compact.bounds.min;
+    const float extent[3] = {size.x, size.y, size.z};
+    compact.grid_origin = compact.bounds.is_empty() ? Vec3() : compact.bounds.min;
+    compact.grid_step = size / POSITION_STEPS;
+    
+    compact.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vertex& vertex = mesh.vertices[i];
+        Vec3 offset_vector = vertex.position - compact.grid_origin;
+        const float offset[3] = {offset_vector.x, offset_vector.y, offset_vector.z};
+        QuantizedVertex& quantized = compact.vertices[i];
+        for (int axis = 0; axis < 3; axis++) {
+            float steps = extent[axis] > 0.0f ? offset[axis] / extent[axis] * POSITION_STEPS + 0.5f : 0.0f;
+            quantized.position[axis] = (uint16_t)std::min(POSITION_STEPS, std::max(0.0f, steps));
+        }
+        encode_normal(vertex.normal, quantized.normal);
+    }
+    
+    size_t index_count = mesh.triangles.size() * 3;
+    if (mesh.vertices.size() <= 65536) {
+        compact.indices16.reserve(index_count);
+        for (const auto& triangle : mesh.triangles) {
+            compact.indices16.insert(compact.indices16.end(),
+                                     {(uint16_t)triangle.v0, (uint16_t)triangle.v1, (uint16_t)triangle.v2});
+        }
+    } else {
+        compact.indices32.reserve(index_count);
+        for (const auto& triangle : mesh.triangles) {
+            compact.indices32.insert(compact.indices32.end(),
+                                     {(uint32_t)triangle.v0, (uint32_t)triangle.v1, (uint32_t)triangle.v2});
+        }
+    }
+    
+    // culling bounds come from the positions the renderer will actually draw, as Mesh::update_bounds
+    Aabb drawn;
+    for (const auto& quantized : compact.vertices) {
+        drawn.add_point(compact.decode_position(quantized));
+    }
+    if (!drawn.is_empty()) {
+        Vec3 center = drawn.center();
+        float radius_sq = 0.0f;
+        for (const auto& quantized : compact.vertices) {
+            Vec3 offset = compact.decode_position(quantized) - center;
+            radius_sq = std::max(radius_sq, offset.dot(offset));
+        }
+        compact.bounding_sphere.center = center;
+        compact.bounding_sphere.radius = std::sqrt(radius_sq);
+    }
+    compact.bounds = drawn;
+    return compact;
+}
+
+Mesh CompactMesh::decode() const {
+    Mesh mesh(material);
+    mesh.transform = transform;
+    mesh.vertices.reserve(vertices.size());
+    for (const auto& quantized : vertices) {
+        mesh.add_vertex(Vertex(decode_position(quantized), decode_normal(quantized.normal)));
+    }
+    size_t triangles = triangle_count();
+    mesh.triangles.reserve(triangles);
+    for (size_t i = 0; i < triangles; i++) {
+        Triangle face = triangle(i);
+        face.normal = face_normal(i);
+        mesh.triangles.push_back(face);
+    }
+    mesh.update_bounds();
+    return mesh;
+}
+
+Vec3 CompactMesh::face_normal(size_t i) const {
+    Triangle face = triangle(i);
+    const QuantizedVertex* corner[3] = {&vertices[face.v0], &vertices[face.v1], &vertices[face.v2]};
+    
+    // object-space edges from the codes; each coordinate of an edge is off by at most one step
+    Vec3 edge[2];
+    for (int k = 0; k < 2; k++) {
+        const uint16_t* from = corner[0]->position;
+        const uint16_t* to = corner[k + 1]->position;
+        edge[k] = Vec3(((float)to[0] - from[0]) * grid_step.x, ((float)to[1] - from[1]) * grid_step.y,
+                       ((float)to[2] - from[2]) * grid_step.z);
+    }
+    Vec3 geometric = edge[0].cross(edge[1]);
+    
+    // to first order the cross product moves by at most |step| (|e0| + |e1|), so that over its
+    // length bounds the sine of its error; small triangles and slivers only a few steps wide
+    // cannot resolve their normal from the codes, and take the decoded vertex normals instead.
+    // most triangles resolve theirs, so the vertex normals are only decoded for the others
+    float uncertainty = grid_step.length() * (edge[0].length() + edge[1].length());
+    if (uncertainty > ILL_CONDITIONED_NORMAL * geometric.length()) {
+        Vec3 smooth = decode_normal(corner[0]->normal) + decode_normal(corner[1]->normal) +
+                      decode_normal(corner[2]->normal);
+        if (smooth.length() > 0.0f) return smooth.normalize();
+    }
+    return geometric.normalize();
+}
+
+Mat4 CompactMesh::get_dequantize_matrix() const {
+    if (bounds.is_empty()) return Mat4();
+    return Mat4::translation(grid_origin) * Mat4::scale(grid_step);
+}
+
+Vec3 CompactMesh::decode_position(const QuantizedVertex& vertex) const {
+    return Vec3(grid_origin.x + vertex.position[0] * grid_step.x, grid_origin.y + vertex.position[1] * grid_step.y,
+                grid_origin.z + vertex.position[2] * grid_step.z);
+}
+
+size_t CompactMesh::memory_bytes() const {
+    return sizeof(CompactMesh) + vertices.capacity() * sizeof(QuantizedVertex) +
+           indices16.capacity() * sizeof(uint16_t) + indices32.capacity() * sizeof(uint32_t);
+}
+
+void CompactMesh::encode_normal(const Vec3& normal, int8_t out[2]) {
+    // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper
+    float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (sum <= 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = normal.x / sum, y = normal.y / sum;
+    if (normal.z < 0.0f) {
+        float folded_x = (1.0f - std::fabs(y)) * sign_not_zero(x);
+        y = (1.0f - std::fabs(x)) * sign_not_zero(y);
+        x = folded_x;
+    }
+    
+    // of the four codes around the exact point, keep the one decoding closest to the normal
+    Vec3 unit = normal / std::sqrt(normal.dot(normal));
+    float best = -2.0f;
+    for (int corner = 0; corner < 4; corner++) {
+        const int8_t code[2] = {snorm8(x, corner & 1), snorm8(y, (corner & 2) != 0)};
+        float match = decode_normal(code).dot(unit);
+        if (match > best) {
+            best = match;
+            out[0] = code[0];
+            out[1] = code[1];
+        }
+    }
+}
+
+Vec3 CompactMesh::decode_normal(const int8_t normal[2]) {
+    // unfold in whole code steps, so every decode is exact before the final normalize
+    float x = normal[0], y = normal[1];
+    float z = NORMAL_STEPS - std::fabs(x) - std::fabs(y);
+    float fold = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    return Vec3(x, y, z).normalize();
+}
@@ -0,0 +1,62 @@
+// compact_mesh.h
+// quantized mesh encoding for large meshes held in memory
+// 8 bytes per vertex and 6 per triangle, decoded by the vertex stage itself
+
+#ifndef COMPACT_MESH_H
+#define COMPACT_MESH_H
+
+#include "mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// position as a fraction of the mesh bounds on each axis, and the unit normal folded onto an
+// octahedron and stored as two signed bytes; colors are not kept, the renderer never reads them
+struct QuantizedVertex {
+    uint16_t position[3];  // 0 at the bounds minimum, 65535 at the maximum
+    int8_t normal[2];      // octahedral coordinates, -127..127 for -1..1
+};
+
+// read-only encoding of a Mesh: indices are 16-bit while every vertex fits, and face normals are
+// left out, since face_normal rebuilds them from the quantized vertices when flat shading needs them
+class CompactMesh {
+public:
+    std::vector<QuantizedVertex> vertices;
+    std::vector<uint16_t> indices16;  // three per triangle when there are at most 65536 vertices
+    std::vector<uint32_t> indices32;  // three per triangle otherwise
+    Material material;
+    Mat4 transform;                   // object-to-world, as Mesh::transform
+    
+    static CompactMesh encode(const Mesh& mesh);
+    Mesh decode() const;  // back to a full mesh, with face normals from face_normal
+    
+    size_t triangle_count() const { return (indices16.size() + indices32.size()) / 3; }
+    Triangle triangle(size_t i) const {
+        if (!indices16.empty()) return Triangle(indices16[3 * i], indices16[3 * i + 1], indices16[3 * i + 2]);
+        return Triangle((int)indices32[3 * i], (int)indices32[3 * i + 1], (int)indices32[3 * i + 2]);
+    }
+    
+    // object-space face normal of triangle i for flat shading: the cross product of its quantized
+    // edges, or the sum of its decoded vertex normals when the edges are too short to resolve it
+    Vec3 face_normal(size_t i) const;
+    
+    // maps quantized positions to object space; folded into the model matrix at draw time
+    Mat4 get_dequantize_matrix() const;
+    Vec3 decode_position(const QuantizedVertex& vertex) const;
+    
+    const Aabb& get_bounds() const { return bounds; }
+    const BoundingSphere& get_bounding_sphere() const { return bounding_sphere; }
+    size_t memory_bytes() const;
+    
+    // octahedral normal coding, rounded to the code that decodes closest to normal; a zero
+    // normal has no direction to keep and comes back as +z
+    static void encode_normal(const Vec3& normal, int8_t out[2]);
+    static Vec3 decode_normal(const int8_t normal[2]);
+    
+private:
+    Vec3 grid_origin, grid_step;  // object-space position of code 0 and size of one code step
+    Aabb bounds;
+    BoundingSphere bounding_sphere;
+};
+
+#endif
@@ -3,6 +3,7 @@
 // provides factory methods for common geometric shapes
 
 #include "mesh.h"
+#include <algorithm>
 #include <cmath>
 
 #ifndef M_PI
@@ -13,6 +14,8 @@ Mesh::Mesh(const Material& mat) : material(mat) {}
 
 void Mesh::add_vertex(const Vertex& vertex) {
     vertices.push_back(vertex);
+    bounds.add_point(vertex.position);
+    bounding_sphere.add_point(vertex.position);
 }
 
 void Mesh::add_triangle(int v0, int v1, int v2) {
@@ -44,6 +47,30 @@ void Mesh::calculate_vertex_normals() {
     }
 }
 
+void Mesh::update_bounds() {
+    // the box is exact; the sphere is centered on the box, which is tighter than growing it
+    // point by point for the symmetric shapes meshes usually are
+    bounds = Aabb();
+    for (const auto& vertex : vertices) {
+        bounds.add_point(vertex.position);
+    }
+    
+    bounding_sphere = BoundingSphere();
+    if (bounds.is_empty()) return;
+    Vec3 center = bounds.center();
+    float radius_sq = 0.0f;
+    for (const auto& vertex : vertices) {
+        Vec3 offset = vertex.position - center;
+        radius_sq = std::max(radius_sq, offset.dot(offset));
+    }
+    bounding_sphere.center = center;
+    bounding_sphere.radius = std::sqrt(radius_sq);
+}
+
+size_t Mesh::memory_bytes() const {
+    return sizeof(Mesh) + vertices.capacity() * sizeof(Vertex) + triangles.capacity() * sizeof(Triangle);
+}
+
 Mesh Mesh::create_cube(float size, const Material& mat) {
     // generate cube mesh with 8 vertices and 12 triangles
     Mesh cube(mat);
@@ -76,6 +103,7 @@ Mesh Mesh::create_cube(float size, const Material& mat) {
     }
     
     cube.calculate_vertex_normals();
+    cube.update_bounds();
     return cube;
 }
 
@@ -116,12 +144,14 @@ Mesh Mesh::create_sphere(float radius, int segments, const Material& mat) {
             int v2 = v0 + 1;
             int v3 = v1 + 1;
             
-            // create two triangles per grid square
-            sphere.add_triangle(v0, v1, v2);
-            sphere.add_triangle(v2, v1, v3);
+            // create two triangles per grid square, counter-clockwise seen from outside
+            // so face normals agree with the vertex normals
+            sphere.add_triangle(v0, v2, v1);
+            sphere.add_triangle(v2, v3, v1);
         }
     }
     
+    sphere.update_bounds();
     return sphere;
 }
 
@@ -137,8 +167,9 @@ Mesh Mesh::create_plane(float size, const Material& mat) {
     plane.add_vertex(Vertex(Vec3(-half, 0, half), Vec3(0, 1, 0)));   // top-left
     
     // connect vertices into two triangles
-    plane.add_triangle(0, 1, 2);  // first triangle
-    plane.add_triangle(0, 2, 3);  // second triangle
+    plane.add_triangle(0, 2, 1);  // first triangle, counter-clockwise seen from above
+    plane.add_triangle(0, 3, 2);  // second triangle
     
+    plane.update_bounds();
     return plane;
 }
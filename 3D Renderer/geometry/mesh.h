@@ -8,6 +8,7 @@
 #include "vertex.h"
 #include "triangle.h"
 #include "material.h"
+#include "bounds.h"
 #include "../math/mat4.h"
 #include <vector>
 
@@ -27,10 +28,23 @@ public:
     void add_triangle(int v0, int v1, int v2);       // connect three vertices
     void calculate_vertex_normals();                 // compute smooth normals
     
+    // object-space bounds of the vertices; add_vertex grows them, code that edits vertices
+    // in place calls update_bounds() afterwards, which also tightens the sphere
+    const Aabb& get_bounds() const { return bounds; }
+    const BoundingSphere& get_bounding_sphere() const { return bounding_sphere; }
+    void update_bounds();
+    
+    // bytes held by this mesh, including the capacity of its vertex and triangle arrays
+    size_t memory_bytes() const;
+    
     // factory methods for creating common geometric primitives
     static Mesh create_cube(float size = 1.0f, const Material& mat = Material());
     static Mesh create_sphere(float radius = 1.0f, int segments = 16, const Material& mat = Material());
     static Mesh create_plane(float size = 2.0f, const Material& mat = Material());
+    
+private:
+    Aabb bounds;
+    BoundingSphere bounding_sphere;
 };
 
 #endif
@@ -0,0 +1,13 @@
+// mesh_instance.cpp
+// implementation of mesh instance construction
+
+#include "mesh_instance.h"
+#include <utility>
+
+MeshInstance::MeshInstance(std::shared_ptr<const Mesh> geometry, const Mat4& placement)
+    : mesh(std::move(geometry)), transform(placement), material(mesh ? mesh->material : Material()) {
+}
+
+MeshInstance::MeshInstance(std::shared_ptr<const Mesh> geometry, const Mat4& placement, const Material& mat)
+    : mesh(std::move(geometry)), transform(placement), material(mat) {
+}
@@ -0,0 +1,21 @@
+// mesh_instance.h
+// lightweight placement of shared mesh geometry
+// many instances can point at one immutable mesh, so memory scales with unique geometry
+
+#ifndef MESH_INSTANCE_H
+#define MESH_INSTANCE_H
+
+#include "mesh.h"
+#include <memory>
+
+// one copy of a shared mesh in the scene, with its own transform and material
+struct MeshInstance {
+    std::shared_ptr<const Mesh> mesh;  // geometry shared with every other instance of it
+    Mat4 transform;                    // applied after the mesh's own transform
+    Material material;                 // replaces the mesh's material for this instance
+    
+    MeshInstance(std::shared_ptr<const Mesh> geometry, const Mat4& placement);  // keeps the mesh's material
+    MeshInstance(std::shared_ptr<const Mesh> geometry, const Mat4& placement, const Material& mat);
+};
+
+#endif
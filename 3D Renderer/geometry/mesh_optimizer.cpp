@@ -0,0 +1,377 @@
+// mesh_optimizer.cpp
+// welding over a hash grid, forsyth triangle ordering, fetch remapping, cache and fetch
+// simulation, and greedy meshlet building with normal cones
+
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+    const float COLOR_TOLERANCE_SQ = 1.0f / (1024.0f * 1024.0f);  // colors within 1/1024 per channel
+    
+    bool same_normal(const Vec3& a, const Vec3& b, float min_dot) {
+        float length_a = a.length(), length_b = b.length();
+        if (length_a == 0.0f || length_b == 0.0f) return length_a == length_b;
+        return a.dot(b) >= min_dot * length_a * length_b;
+    }
+    
+    bool is_degenerate(const Triangle& triangle) {
+        return triangle.v0 == triangle.v1 || triangle.v1 == triangle.v2 || triangle.v0 == triangle.v2;
+    }
+    
+    // ---- forsyth ----
+    
+    // cache modelled while scoring; larger than the FIFO analyze_vertex_cache assumes, which
+    // favours orders that are good for any cache up to this size
+    const int FORSYTH_CACHE_SIZE = 32;
+    const int FORSYTH_MAX_VALENCE = 32;  // valence scores are tabulated up to here
+    
+    // vertices in the cache score by recency, except the last triangle's three, which get a fixed
+    // score so strips do not just walk along one edge; vertices with few triangles left score
+    // high, so lone triangles are finished instead of being left behind
+    float forsyth_score(int cache_position, int valence) {
+        if (valence == 0) return 0.0f;
+        float score = 0.0f;
+        if (cache_position >= 0) {
+            if (cache_position < 3) {
+                score = 0.75f;
+            } else {
+                float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cache_position - 3) * scale, 1.5f);
+            }
+        }
+        return score + 2.0f / std::sqrt((float)valence);
+    }
+    
+    struct ForsythScores {
+        float table[FORSYTH_CACHE_SIZE + 1][FORSYTH_MAX_VALENCE + 1];
+        
+        ForsythScores() {
+            for (int position = -1; position < FORSYTH_CACHE_SIZE; position++) {
+                for (int valence = 0; valence <= FORSYTH_MAX_VALENCE; valence++) {
+                    table[position + 1][valence] = forsyth_score(position, valence);
+                }
+            }
+        }
+        
+        float operator()(int cache_position, int valence) const {
+            return table[cache_position + 1][std::min(valence, FORSYTH_MAX_VALENCE)];
+        }
+    };
+    
+    // ---- meshlets ----
+    
+    // below this spread of normals (cosine of the widest angle to the axis) a cone is useless,
+    // and its apex would run off to infinity
+    const float MIN_CONE_SPREAD = 0.1f;
+    const float CONE_DISABLED = 2.0f;
+    
+    void finish_meshlet(const Mesh& mesh, const MeshletMesh& result, Meshlet& meshlet) {
+        const uint32_t* vertices = result.vertices.data() + meshlet.vertex_offset;
+        const uint8_t* triangles = result.triangles.data() + meshlet.triangle_offset;
+        
+        // sphere centered on the box, as Mesh::update_bounds
+        Aabb box;
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) box.add_point(mesh.vertices[vertices[i]].position);
+        Vec3 center = box.center();
+        float radius_sq = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+            Vec3 offset = mesh.vertices[vertices[i]].position - center;
+            radius_sq = std::max(radius_sq, offset.dot(offset));
+        }
+        meshlet.bounds.center = center;
+        meshlet.bounds.radius = std::sqrt(radius_sq);
+        
+        // cone around the face normals, taken from the positions; degenerate triangles have none
+        std::vector<Vec3> normals(meshlet.triangle_count);
+        Vec3 sum;
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+            const Vec3& p0 = mesh.vertices[vertices[triangles[3 * t]]].position;
+            const Vec3& p1 = mesh.vertices[vertices[triangles[3 * t + 1]]].position;
+            const Vec3& p2 = mesh.vertices[vertices[triangles[3 * t + 2]]].position;
+            normals[t] = (p1 - p0).cross(p2 - p0).normalize();
+            sum = sum + normals[t];
+        }
+        meshlet.cone_axis = sum.normalize();
+        meshlet.cone_apex = center;
+        meshlet.cone_cutoff = CONE_DISABLED;
+        float min_dot = 1.0f;
+        for (const Vec3& normal : normals) {
+            if (normal.dot(normal) > 0.0f) min_dot = std::min(min_dot, normal.dot(meshlet.cone_axis));
+        }
+        if (meshlet.cone_axis.dot(meshlet.cone_axis) == 0.0f || min_dot < MIN_CONE_SPREAD) return;
+        
+        // apex behind every triangle's plane: a camera that sees the whole cone from behind the
+        // apex is then behind every triangle too
+        float apex_distance = 0.0f;
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+            if (normals[t].dot(normals[t]) == 0.0f) continue;
+            const Vec3& p0 = mesh.vertices[vertices[triangles[3 * t]]].position;
+            float distance = (center - p0).dot(normals[t]) / normals[t].dot(meshlet.cone_axis);
+            apex_distance = std::max(apex_distance, distance);
+        }
+        meshlet.cone_apex = center - meshlet.cone_axis * apex_distance;
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+}
+
+size_t weld_vertices(Mesh& mesh, const WeldSettings& settings) {
+    size_t count = mesh.vertices.size();
+    if (count == 0) return 0;
+    
+    // a grid of cells twice the tolerance: a vertex's duplicates are in its cell or, on each axis,
+    // the neighbour on the side of the cell's center it is nearer to, 8 cells in all. cells are
+    // at least 2^-20 of the largest extent, so coordinates fit 21 bits
+    Aabb box;
+    for (const auto& vertex : mesh.vertices) box.add_point(vertex.position);
+    Vec3 size = box.max - box.min;
+    float tolerance = settings.position_tolerance * size.length();
+    float cell = std::max(2.0f * tolerance, std::max(size.x, std::max(size.y, size.z)) / (1 << 20));
+    if (!(cell > 0.0f)) cell = 1.0f;
+    float tolerance_sq = tolerance * tolerance;
+    float min_normal_dot = std::cos(settings.normal_tolerance_degrees * (float)M_PI / 180.0f);
+    
+    // each cell chains the kept vertices in it: heads maps a cell to its latest, next links on
+    std::unordered_map<uint64_t, int32_t> heads;
+    heads.reserve(count);
+    std::vector<int32_t> next;
+    std::vector<Vertex> welded;
+    std::vector<int32_t> remap(count);
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = mesh.vertices[i];
+        float fx = (vertex.position.x - box.min.x) / cell;
+        float fy = (vertex.position.y - box.min.y) / cell;
+        float fz = (vertex.position.z - box.min.z) / cell;
+        int64_t cx = (int64_t)fx, cy = (int64_t)fy, cz = (int64_t)fz;
+        int64_t sx = fx - cx < 0.5f ? -1 : 1, sy = fy - cy < 0.5f ? -1 : 1, sz = fz - cz < 0.5f ? -1 : 1;
+        int32_t found = -1;
+        for (int64_t z : {cz, cz + sz}) {
+            for (int64_t y : {cy, cy + sy}) {
+                for (int64_t x : {cx, cx + sx}) {
+                    if (x < 0 || y < 0 || z < 0 || found >= 0) continue;
+                    auto head = heads.find((uint64_t)x | (uint64_t)y << 21 | (uint64_t)z << 42);
+                    if (head == heads.end()) continue;
+                    for (int32_t kept = head->second; kept >= 0; kept = next[kept]) {
+                        const Vertex& other = welded[kept];
+                        Vec3 offset = other.position - vertex.position;
+                        Vec3 color = other.color - vertex.color;
+                        if (offset.dot(offset) <= tolerance_sq && color.dot(color) <= COLOR_TOLERANCE_SQ &&
+                            same_normal(other.normal, vertex.normal, min_normal_dot)) {
+                            found = kept;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (found < 0) {
+            found = (int32_t)welded.size();
+            welded.push_back(vertex);
+            int32_t& head = heads.emplace((uint64_t)cx | (uint64_t)cy << 21 | (uint64_t)cz << 42, -1).first->second;
+            next.push_back(head);
+            head = found;
+        }
+        remap[i] = found;
+    }
+    
+    size_t kept_triangles = 0;
+    for (const Triangle& source : mesh.triangles) {
+        Triangle triangle = source;
+        triangle.v0 = remap[triangle.v0];
+        triangle.v1 = remap[triangle.v1];
+        triangle.v2 = remap[triangle.v2];
+        if (!is_degenerate(triangle)) mesh.triangles[kept_triangles++] = triangle;
+    }
+    mesh.triangles.resize(kept_triangles, Triangle(0, 0, 0));
+    mesh.vertices = std::move(welded);
+    return count - mesh.vertices.size();
+}
+
+void optimize_vertex_cache(Mesh& mesh) {
+    size_t triangle_count = mesh.triangles.size();
+    size_t vertex_count = mesh.vertices.size();
+    if (triangle_count == 0) return;
+    static const ForsythScores score;
+    
+    // triangles of each vertex; the first live[v] entries are the ones not emitted yet
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (const Triangle& triangle : mesh.triangles) {
+        offsets[triangle.v0 + 1]++;
+        offsets[triangle.v1 + 1]++;
+        offsets[triangle.v2 + 1]++;
+    }
+    for (size_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(offsets[vertex_count]);
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t t = 0; t < triangle_count; t++) {
+        const Triangle& triangle = mesh.triangles[t];
+        for (int v : {triangle.v0, triangle.v1, triangle.v2}) adjacency[offsets[v] + live[v]++] = (uint32_t)t;
+    }
+    
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) vertex_score[v] = score(-1, (int)live[v]);
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<unsigned char> emitted(triangle_count, 0);
+    size_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        const Triangle& triangle = mesh.triangles[t];
+        triangle_score[t] = vertex_score[triangle.v0] + vertex_score[triangle.v1] + vertex_score[triangle.v2];
+        if (triangle_score[t] > triangle_score[best]) best = t;
+    }
+    
+    std::vector<Triangle> ordered;
+    ordered.reserve(triangle_count);
+    std::vector<int> cache, next_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    next_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t cursor = 0;
+    while (ordered.size() < triangle_count) {
+        // nothing in the cache has triangles left: continue with the next unemitted one
+        if (best == triangle_count) {
+            while (emitted[cursor]) cursor++;
+            best = cursor;
+        }
+        const Triangle& triangle = mesh.triangles[best];
+        emitted[best] = 1;
+        ordered.push_back(triangle);
+        
+        // the triangle leaves its vertices' live lists, and its vertices move to the cache front
+        next_cache.assign({triangle.v0, triangle.v1, triangle.v2});
+        for (int v : {triangle.v0, triangle.v1, triangle.v2}) {
+            uint32_t* list = adjacency.data() + offsets[v];
+            uint32_t* entry = std::find(list, list + live[v], (uint32_t)best);
+            *entry = list[--live[v]];
+        }
+        for (int v : cache) {
+            if (v != triangle.v0 && v != triangle.v1 && v != triangle.v2) next_cache.push_back(v);
+        }
+        
+        // rescore everything that moved, including what fell out, and pick the best triangle
+        // among the cached vertices' remaining ones
+        best = triangle_count;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            int v = next_cache[i];
+            cache_position[v] = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertex_score[v] = score(cache_position[v], (int)live[v]);
+        }
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            int v = next_cache[i];
+            for (uint32_t k = 0; k < live[v]; k++) {
+                uint32_t t = adjacency[offsets[v] + k];
+                const Triangle& candidate = mesh.triangles[t];
+                triangle_score[t] = vertex_score[candidate.v0] + vertex_score[candidate.v1] + vertex_score[candidate.v2];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+        if (next_cache.size() > (size_t)FORSYTH_CACHE_SIZE) next_cache.resize(FORSYTH_CACHE_SIZE);
+        std::swap(cache, next_cache);
+    }
+    mesh.triangles = std::move(ordered);
+}
+
+void optimize_vertex_fetch(Mesh& mesh) {
+    std::vector<int32_t> remap(mesh.vertices.size(), -1);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (Triangle& triangle : mesh.triangles) {
+        for (int* index : {&triangle.v0, &triangle.v1, &triangle.v2}) {
+            if (remap[*index] < 0) {
+                remap[*index] = (int32_t)ordered.size();
+                ordered.push_back(mesh.vertices[*index]);
+            }
+            *index = remap[*index];
+        }
+    }
+    mesh.vertices = std::move(ordered);
+}
+
+void optimize_mesh(Mesh& mesh, const WeldSettings& settings) {
+    weld_vertices(mesh, settings);
+    optimize_vertex_cache(mesh);
+    optimize_vertex_fetch(mesh);
+    mesh.update_bounds();
+}
+
+VertexCacheStats analyze_vertex_cache(const Mesh& mesh, size_t cache_size) {
+    // a vertex is still in the FIFO when fewer than cache_size misses happened since its own
+    std::vector<size_t> inserted(mesh.vertices.size(), 0);
+    size_t time = cache_size + 1;
+    VertexCacheStats stats;
+    for (const Triangle& triangle : mesh.triangles) {
+        for (int v : {triangle.v0, triangle.v1, triangle.v2}) {
+            if (time - inserted[v] > cache_size) {
+                inserted[v] = time++;
+                stats.transforms++;
+            }
+        }
+    }
+    if (!mesh.triangles.empty()) stats.acmr = (float)stats.transforms / mesh.triangles.size();
+    if (!mesh.vertices.empty()) stats.atvr = (float)stats.transforms / mesh.vertices.size();
+    return stats;
+}
+
+VertexFetchStats analyze_vertex_fetch(const Mesh& mesh, size_t cache_bytes) {
+    const size_t LINE = 64;
+    std::vector<size_t> tags(std::max<size_t>(1, cache_bytes / LINE), SIZE_MAX);
+    VertexFetchStats stats;
+    for (const Triangle& triangle : mesh.triangles) {
+        for (int v : {triangle.v0, triangle.v1, triangle.v2}) {
+            size_t first = (size_t)v * sizeof(Vertex) / LINE, last = ((size_t)v + 1) * sizeof(Vertex) / LINE;
+            if (((size_t)v + 1) * sizeof(Vertex) % LINE == 0) last--;
+            for (size_t line = first; line <= last; line++) {
+                size_t& tag = tags[line % tags.size()];
+                if (tag != line) {
+                    tag = line;
+                    stats.bytes_fetched += LINE;
+                }
+            }
+        }
+    }
+    if (!mesh.vertices.empty()) {
+        stats.overfetch = (float)stats.bytes_fetched / (mesh.vertices.size() * sizeof(Vertex));
+    }
+    return stats;
+}
+
+MeshletMesh build_meshlets(const Mesh& mesh, size_t max_vertices, size_t max_triangles) {
+    max_vertices = std::max<size_t>(3, std::min<size_t>(max_vertices, 256));
+    max_triangles = std::max<size_t>(1, max_triangles);
+    MeshletMesh result;
+    std::vector<int> local(mesh.vertices.size(), -1);  // index in the open meshlet, -1 when not in it
+    Meshlet meshlet;
+    
+    auto close = [&]() {
+        if (meshlet.triangle_count == 0) return;
+        finish_meshlet(mesh, result, meshlet);
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) local[result.vertices[meshlet.vertex_offset + i]] = -1;
+        result.meshlets.push_back(meshlet);
+        meshlet = Meshlet();
+        meshlet.vertex_offset = (uint32_t)result.vertices.size();
+        meshlet.triangle_offset = (uint32_t)result.triangles.size();
+    };
+    
+    for (const Triangle& triangle : mesh.triangles) {
+        int added = (local[triangle.v0] < 0) + (local[triangle.v1] < 0) + (local[triangle.v2] < 0);
+        if (meshlet.vertex_count + added > max_vertices || meshlet.triangle_count + 1 > max_triangles) close();
+        for (int v : {triangle.v0, triangle.v1, triangle.v2}) {
+            if (local[v] < 0) {
+                local[v] = (int)meshlet.vertex_count++;
+                result.vertices.push_back((uint32_t)v);
+            }
+            result.triangles.push_back((uint8_t)local[v]);
+        }
+        meshlet.triangle_count++;
+    }
+    close();
+    return result;
+}
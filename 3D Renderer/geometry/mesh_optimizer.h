@@ -0,0 +1,87 @@
+// mesh_optimizer.h
+// offline and at-load mesh optimization: vertex welding, triangle order for post-transform cache
+// reuse, vertex order for fetch locality, and meshlets with bounds and normal cones for culling
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// vertices within position_tolerance (a fraction of the bounds diagonal) whose normals differ by
+// at most normal_tolerance_degrees and whose colors match are merged
+struct WeldSettings {
+    float position_tolerance = 1e-6f;
+    float normal_tolerance_degrees = 1.0f;
+};
+
+// merge duplicate vertices (such as the seam and pole copies create_sphere makes), drop the
+// triangles that collapse to a line or point, and compact the vertex array; vertices keep the
+// order of their first copy, triangles keep their order. returns the number of vertices removed
+size_t weld_vertices(Mesh& mesh, const WeldSettings& settings = WeldSettings());
+
+// reorder triangles so consecutive triangles share vertices (Forsyth's linear-speed algorithm);
+// vertices are not moved
+void optimize_vertex_cache(Mesh& mesh);
+
+// renumber vertices in the order the triangles first use them and drop unreferenced ones, so the
+// vertex stage and triangle setup walk memory forwards
+void optimize_vertex_fetch(Mesh& mesh);
+
+// weld, optimize_vertex_cache, then optimize_vertex_fetch; bounds are refreshed
+void optimize_mesh(Mesh& mesh, const WeldSettings& settings = WeldSettings());
+
+// post-transform cache simulation: a FIFO of cache_size vertices, as in fixed-function hardware.
+// acmr (transforms per triangle) is 3 at worst and about 0.5 at best on a regular grid; atvr
+// (transforms per vertex) is 1 when every vertex is transformed once
+struct VertexCacheStats {
+    size_t transforms = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+VertexCacheStats analyze_vertex_cache(const Mesh& mesh, size_t cache_size = 16);
+
+// vertex fetch simulation: a direct-mapped cache of 64-byte lines over the Vertex array, read in
+// triangle order; overfetch is the bytes read over the bytes of the vertex array (1 is ideal)
+struct VertexFetchStats {
+    size_t bytes_fetched = 0;
+    float overfetch = 0.0f;
+};
+VertexFetchStats analyze_vertex_fetch(const Mesh& mesh, size_t cache_bytes = 16 * 1024);
+
+// limits sized for the renderer's setup batches; 64 vertices fit a local index in one byte
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// a cluster of neighbouring triangles with object-space bounds and a cone around its face normals;
+// a meshlet can be culled as a whole against the frustum (bounds) and for facing away (cone)
+struct Meshlet {
+    uint32_t vertex_offset = 0;    // first entry in MeshletMesh::vertices
+    uint32_t triangle_offset = 0;  // first local index in MeshletMesh::triangles, three per triangle
+    uint32_t vertex_count = 0;
+    uint32_t triangle_count = 0;
+    BoundingSphere bounds;
+    Vec3 cone_apex;
+    Vec3 cone_axis;
+    float cone_cutoff = 2.0f;      // sine of the cone's half angle; above 1 when it cannot be culled
+    
+    // true when every triangle faces away from camera_position (object space)
+    bool is_backfacing(const Vec3& camera_position) const {
+        return (cone_apex - camera_position).normalize().dot(cone_axis) > cone_cutoff;
+    }
+};
+
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;  // mesh vertex index of each meshlet-local vertex
+    std::vector<uint8_t> triangles;  // meshlet-local vertex indices, three per triangle
+};
+
+// cut the triangle list into meshlets in its current order, so run optimize_vertex_cache first
+// for compact clusters
+MeshletMesh build_meshlets(const Mesh& mesh, size_t max_vertices = MESHLET_MAX_VERTICES,
+                           size_t max_triangles = MESHLET_MAX_TRIANGLES);
+
+#endif
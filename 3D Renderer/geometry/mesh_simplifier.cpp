@@ -0,0 +1,294 @@
+// mesh_simplifier.cpp
+// edge collapse over a priority queue with lazily invalidated entries; collapses that flip or
+// fold a neighbouring triangle or pinch the surface are refused
+
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+
+namespace {
+    // boundary planes are weighted well above the surface, so open edges stay where they are
+    const double BOUNDARY_WEIGHT = 10.0;
+    
+    // a collapse may turn a neighbouring triangle's normal by at most about 75 degrees
+    const double MIN_NORMAL_DOT = 0.25;
+    
+    // symmetric 4x4 plane quadric, upper triangle, plus the total area it was built from
+    struct Quadric {
+        double q[10] = {};  // xx xy xz xw yy yz yw zz zw ww
+        double weight = 0.0;
+        
+        void add_plane(double a, double b, double c, double d, double w) {
+            q[0] += w * a * a; q[1] += w * a * b; q[2] += w * a * c; q[3] += w * a * d;
+            q[4] += w * b * b; q[5] += w * b * c; q[6] += w * b * d;
+            q[7] += w * c * c; q[8] += w * c * d;
+            q[9] += w * d * d;
+            weight += w;
+        }
+        
+        void add(const Quadric& other) {
+            for (int i = 0; i < 10; i++) q[i] += other.q[i];
+            weight += other.weight;
+        }
+        
+        // sum of weighted squared plane distances of p
+        double evaluate(const Vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+                   q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+                   q[7] * z * z + 2 * q[8] * z + q[9];
+        }
+    };
+    
+    struct Collapse {
+        float cost;
+        uint32_t from, to;              // from is removed and its triangles move to to
+        uint32_t from_stamp, to_stamp;  // vertex versions the cost was computed with
+        
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+    
+    class Simplifier {
+    public:
+        explicit Simplifier(const Mesh& source) : mesh(source) {
+            weld_vertices(mesh);
+            size_t vertex_count = mesh.vertices.size();
+            quadrics.resize(vertex_count);
+            stamps.assign(vertex_count, 0);
+            removed.assign(vertex_count, 0);
+            adjacency.resize(vertex_count);
+            alive.assign(mesh.triangles.size(), 1);
+            alive_count = mesh.triangles.size();
+            
+            for (size_t t = 0; t < mesh.triangles.size(); t++) {
+                const Triangle& triangle = mesh.triangles[t];
+                const Vec3& p0 = position(triangle.v0);
+                Vec3 cross = (position(triangle.v1) - p0).cross(position(triangle.v2) - p0);
+                double area = 0.5 * cross.length();
+                Vec3 normal = cross.normalize();
+                for (int v : {triangle.v0, triangle.v1, triangle.v2}) {
+                    quadrics[v].add_plane(normal.x, normal.y, normal.z, -normal.dot(p0), area);
+                    adjacency[v].push_back((uint32_t)t);
+                }
+            }
+            add_boundaries();
+        }
+        
+        void run(size_t target_triangles, float max_error) {
+            double max_cost = (double)max_error * max_error;
+            while (alive_count > target_triangles && !queue.empty()) {
+                Collapse collapse = queue.top();
+                queue.pop();
+                if (removed[collapse.from] || removed[collapse.to] || stamps[collapse.from] != collapse.from_stamp ||
+                    stamps[collapse.to] != collapse.to_stamp) {
+                    continue;
+                }
+                if (collapse.cost > max_cost) break;
+                if (!can_collapse(collapse.from, collapse.to)) continue;
+                apply(collapse.from, collapse.to);
+                worst_cost = std::max(worst_cost, (double)collapse.cost);
+            }
+        }
+        
+        Mesh result() const {
+            Mesh simplified(mesh.material);
+            simplified.transform = mesh.transform;
+            std::vector<int> remap(mesh.vertices.size(), -1);
+            for (size_t t = 0; t < mesh.triangles.size(); t++) {
+                if (!alive[t]) continue;
+                Triangle triangle = mesh.triangles[t];
+                for (int* index : {&triangle.v0, &triangle.v1, &triangle.v2}) {
+                    if (remap[*index] < 0) {
+                        remap[*index] = (int)simplified.vertices.size();
+                        simplified.vertices.push_back(mesh.vertices[*index]);
+                    }
+                    *index = remap[*index];
+                }
+                triangle.calculate_normal(simplified.vertices);
+                simplified.triangles.push_back(triangle);
+            }
+            optimize_vertex_cache(simplified);
+            optimize_vertex_fetch(simplified);
+            simplified.update_bounds();
+            return simplified;
+        }
+        
+        float error() const { return (float)std::sqrt(worst_cost); }
+        
+    private:
+        Mesh mesh;
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> stamps;
+        std::vector<unsigned char> removed;
+        std::vector<std::vector<uint32_t>> adjacency;  // triangles of each vertex, dead ones dropped lazily
+        std::vector<unsigned char> alive;
+        size_t alive_count = 0;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        std::vector<uint32_t> neighbours, other_neighbours;
+        double worst_cost = 0.0;
+        
+        const Vec3& position(int v) const { return mesh.vertices[v].position; }
+        
+        static bool uses(const Triangle& triangle, uint32_t v) {
+            return (uint32_t)triangle.v0 == v || (uint32_t)triangle.v1 == v || (uint32_t)triangle.v2 == v;
+        }
+        
+        // edges used by one triangle only get a plane through the edge, perpendicular to the
+        // triangle, on both ends; every edge also enters the queue once
+        void add_boundaries() {
+            std::vector<std::pair<uint64_t, uint32_t>> edges;
+            edges.reserve(mesh.triangles.size() * 3);
+            for (size_t t = 0; t < mesh.triangles.size(); t++) {
+                const Triangle& triangle = mesh.triangles[t];
+                int corners[3] = {triangle.v0, triangle.v1, triangle.v2};
+                for (int k = 0; k < 3; k++) {
+                    uint64_t a = (uint32_t)corners[k], b = (uint32_t)corners[(k + 1) % 3];
+                    edges.emplace_back(std::min(a, b) << 32 | std::max(a, b), (uint32_t)t);
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();) {
+                size_t run = i + 1;
+                while (run < edges.size() && edges[run].first == edges[i].first) run++;
+                uint32_t a = (uint32_t)(edges[i].first >> 32), b = (uint32_t)edges[i].first;
+                if (run - i == 1) {
+                    const Triangle& triangle = mesh.triangles[edges[i].second];
+                    const Vec3& p0 = position(triangle.v0);
+                    Vec3 normal = (position(triangle.v1) - p0).cross(position(triangle.v2) - p0).normalize();
+                    Vec3 edge = position(b) - position(a);
+                    Vec3 side = edge.cross(normal).normalize();
+                    double weight = BOUNDARY_WEIGHT * edge.dot(edge);
+                    for (uint32_t v : {a, b}) {
+                        quadrics[v].add_plane(side.x, side.y, side.z, -side.dot(position(a)), weight);
+                    }
+                }
+                i = run;
+            }
+            for (size_t i = 0; i < edges.size(); i++) {
+                if (i > 0 && edges[i].first == edges[i - 1].first) continue;
+                push_edge((uint32_t)(edges[i].first >> 32), (uint32_t)edges[i].first);
+            }
+        }
+        
+        double collapse_cost(uint32_t from, uint32_t to) const {
+            Quadric merged = quadrics[from];
+            merged.add(quadrics[to]);
+            double cost = merged.evaluate(position(to));
+            return merged.weight > 0.0 ? std::max(0.0, cost / merged.weight) : 0.0;
+        }
+        
+        // the cheaper direction of the edge
+        void push_edge(uint32_t a, uint32_t b) {
+            double a_to_b = collapse_cost(a, b), b_to_a = collapse_cost(b, a);
+            if (b_to_a < a_to_b) std::swap(a, b);
+            queue.push({(float)std::min(a_to_b, b_to_a), a, b, stamps[a], stamps[b]});
+        }
+        
+        void collect_neighbours(uint32_t v, std::vector<uint32_t>& out) {
+            out.clear();
+            for (uint32_t t : adjacency[v]) {
+                if (!alive[t]) continue;
+                const Triangle& triangle = mesh.triangles[t];
+                for (int u : {triangle.v0, triangle.v1, triangle.v2}) {
+                    if ((uint32_t)u != v) out.push_back((uint32_t)u);
+                }
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+        
+        bool can_collapse(uint32_t from, uint32_t to) {
+            // link condition: the edge's ends may share only the vertices opposite the edge,
+            // otherwise the collapse pinches the surface into a non-manifold fin
+            collect_neighbours(from, neighbours);
+            collect_neighbours(to, other_neighbours);
+            size_t shared_triangles = 0;
+            for (uint32_t t : adjacency[from]) {
+                if (alive[t] && uses(mesh.triangles[t], to)) shared_triangles++;
+            }
+            size_t shared = 0;
+            for (size_t i = 0, j = 0; i < neighbours.size() && j < other_neighbours.size();) {
+                if (neighbours[i] < other_neighbours[j]) {
+                    i++;
+                } else if (neighbours[i] > other_neighbours[j]) {
+                    j++;
+                } else {
+                    shared++;
+                    i++;
+                    j++;
+                }
+            }
+            if (shared_triangles == 0 || shared != shared_triangles) return false;
+            
+            // triangles that move with from must not flip or fold over
+            const Vec3& target = position(to);
+            for (uint32_t t : adjacency[from]) {
+                if (!alive[t]) continue;
+                const Triangle& triangle = mesh.triangles[t];
+                if (uses(triangle, to)) continue;
+                Vec3 p[3] = {position(triangle.v0), position(triangle.v1), position(triangle.v2)};
+                Vec3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+                for (int k = 0; k < 3; k++) {
+                    if ((uint32_t)(k == 0 ? triangle.v0 : k == 1 ? triangle.v1 : triangle.v2) == from) p[k] = target;
+                }
+                Vec3 after = (p[1] - p[0]).cross(p[2] - p[0]);
+                double lengths = (double)before.length() * after.length();
+                if (lengths == 0.0 || before.dot(after) < MIN_NORMAL_DOT * lengths) return false;
+            }
+            return true;
+        }
+        
+        void apply(uint32_t from, uint32_t to) {
+            for (uint32_t t : adjacency[from]) {
+                if (!alive[t]) continue;
+                Triangle& triangle = mesh.triangles[t];
+                if (uses(triangle, to)) {
+                    alive[t] = 0;
+                    alive_count--;
+                    continue;
+                }
+                for (int* index : {&triangle.v0, &triangle.v1, &triangle.v2}) {
+                    if ((uint32_t)*index == from) *index = (int)to;
+                }
+                adjacency[to].push_back(t);
+            }
+            removed[from] = 1;
+            std::vector<uint32_t>().swap(adjacency[from]);
+            std::vector<uint32_t>& list = adjacency[to];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return !alive[t]; }), list.end());
+            quadrics[to].add(quadrics[from]);
+            stamps[to]++;
+            
+            // every edge around to has a new cost; the entries queued before are now stale
+            collect_neighbours(to, neighbours);
+            for (uint32_t v : neighbours) push_edge(to, v);
+        }
+    };
+}
+
+Mesh simplify_mesh(const Mesh& mesh, size_t target_triangles, float max_error, float* result_error) {
+    Simplifier simplifier(mesh);
+    simplifier.run(target_triangles, max_error);
+    if (result_error) *result_error = simplifier.error();
+    return simplifier.result();
+}
+
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, const LodSettings& settings) {
+    std::vector<MeshLod> chain;
+    const Mesh* previous = &mesh;
+    float error = 0.0f;
+    while (chain.size() < settings.max_levels) {
+        size_t count = previous->triangles.size();
+        size_t target = (size_t)(count * settings.reduction);
+        if (target < settings.min_triangles) break;
+        float level_error;
+        Mesh level = simplify_mesh(*previous, target, INFINITY, &level_error);
+        if (level.triangles.size() > count * 0.8) break;
+        error += level_error;
+        chain.push_back({std::move(level), error});
+        previous = &chain.back().mesh;
+    }
+    return chain;
+}
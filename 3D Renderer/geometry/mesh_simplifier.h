@@ -0,0 +1,38 @@
+// mesh_simplifier.h
+// quadric error metric simplification (garland and heckbert) and level-of-detail chains
+// edges collapse cheapest first onto one of their endpoints, so kept vertices keep their attributes
+
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "mesh.h"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// simplify a copy of mesh towards target_triangles, stopping early when the next collapse would
+// cost more than max_error (object-space units). duplicates are welded first, so seams close;
+// edges left open (borders, hard normal creases) are held in place by extra boundary quadrics.
+// result_error (optional) receives the error of the costliest collapse taken: the area-weighted
+// rms distance of a kept vertex from the surface it replaced, in object-space units
+Mesh simplify_mesh(const Mesh& mesh, size_t target_triangles, float max_error = INFINITY,
+                   float* result_error = nullptr);
+
+// one coarser level of a mesh; error bounds the deviation from the full mesh, in object space
+struct MeshLod {
+    Mesh mesh;
+    float error = 0.0f;
+};
+
+struct LodSettings {
+    float reduction = 0.5f;       // triangle ratio between consecutive levels
+    size_t min_triangles = 128;   // no level is built below this many triangles
+    size_t max_levels = 8;
+};
+
+// levels 1, 2, ... of mesh, each simplified from the one before, with errors summed down the
+// chain; level 0 is mesh itself and is not copied. the chain ends early once a level cannot be
+// reduced to at most 0.8 of the previous one
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, const LodSettings& settings = LodSettings());
+
+#endif
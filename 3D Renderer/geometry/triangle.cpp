@@ -4,8 +4,6 @@
 
 #include "triangle.h"
 
-Triangle::Triangle(int a, int b, int c) : v0(a), v1(b), v2(c) {}
-
 void Triangle::calculate_normal(const std::vector<Vertex>& vertices) {
     // calculate face normal using cross product of two edges
     // assumes counter-clockwise vertex winding for outward-facing normal
@@ -15,7 +15,7 @@ struct Triangle {
     int v0, v1, v2;  // indices into vertex array (counter-clockwise winding)
     Vec3 normal;     // face normal vector for flat shading
     
-    Triangle(int a, int b, int c);
+    Triangle(int a, int b, int c) : v0(a), v1(b), v2(c) {}
     
     // calculate face normal from three vertices using cross product
     void calculate_normal(const std::vector<Vertex>& vertices);
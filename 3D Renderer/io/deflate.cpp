@@ -0,0 +1,283 @@
+// deflate.cpp
+// implementation of the deflate segment writer, crc-32 and adler-32
+// fast mode trades ratio for speed: one hash probe per position and the fixed huffman code
+
+#include "deflate.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // crc-32 (ieee, reflected) processed eight bytes at a time with eight lookup tables
+    struct CrcTables {
+        uint32_t table[8][256];
+        
+        CrcTables() {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[0][n] = c;
+            }
+            for (uint32_t n = 0; n < 256; n++) {
+                for (int t = 1; t < 8; t++) {
+                    table[t][n] = (table[t - 1][n] >> 8) ^ table[0][table[t - 1][n] & 0xFF];
+                }
+            }
+        }
+    };
+    
+    const CrcTables crc_tables;
+    
+    const uint32_t ADLER_BASE = 65521;
+    const size_t ADLER_NMAX = 5552;  // most bytes before the 32-bit sums can overflow
+    
+    // fixed huffman code (rfc 1951, 3.2.6), bit-reversed for the lsb-first bit writer
+    // plus the symbol tables for match lengths 3..258 and distances 1..32768
+    const int MIN_MATCH = 4;  // shorter matches rarely beat two or three fixed-code literals
+    const int MAX_MATCH = 258;
+    const int WINDOW_SIZE = 32768;
+    const int HASH_BITS = 15;
+    
+    const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                        8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    
+    uint32_t reverse_bits(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+        return reversed;
+    }
+    
+    struct FixedCode {
+        uint16_t literal_code[288];
+        uint8_t literal_length[288];
+        uint8_t distance_code[32];
+        uint8_t length_symbol[MAX_MATCH + 1];   // index into LENGTH_BASE
+        uint8_t distance_symbol[WINDOW_SIZE + 1];
+        
+        FixedCode() {
+            for (int s = 0; s < 288; s++) {
+                int length, code;
+                if (s < 144) { length = 8; code = 0x30 + s; }
+                else if (s < 256) { length = 9; code = 0x190 + (s - 144); }
+                else if (s < 280) { length = 7; code = s - 256; }
+                else { length = 8; code = 0xC0 + (s - 280); }
+                literal_code[s] = (uint16_t)reverse_bits(code, length);
+                literal_length[s] = (uint8_t)length;
+            }
+            for (int d = 0; d < 32; d++) distance_code[d] = (uint8_t)reverse_bits(d, 5);
+            for (int s = 0; s < 29; s++) {
+                int end = (s == 28) ? MAX_MATCH + 1 : LENGTH_BASE[s + 1];
+                for (int len = LENGTH_BASE[s]; len < end; len++) length_symbol[len] = (uint8_t)s;
+            }
+            for (int s = 0; s < 30; s++) {
+                int end = (s == 29) ? WINDOW_SIZE + 1 : DISTANCE_BASE[s + 1];
+                for (int d = DISTANCE_BASE[s]; d < end; d++) distance_symbol[d] = (uint8_t)s;
+            }
+        }
+    };
+    
+    const FixedCode fixed_code;
+    
+    // lsb-first bit packer writing into memory reserved up front
+    class BitWriter {
+    public:
+        explicit BitWriter(uint8_t* out) : cursor(out), bits(0), count(0) {}
+        
+        void put(uint32_t value, int length) {
+            bits |= (uint64_t)value << count;
+            count += length;
+            if (count >= 32) {
+                uint32_t word = (uint32_t)bits;
+                std::memcpy(cursor, &word, 4);  // deflate is little-endian like the hosts we target
+                cursor += 4;
+                bits >>= 32;
+                count -= 32;
+            }
+        }
+        
+        // pad with zero bits to the next byte boundary and emit everything pending
+        uint8_t* align() {
+            while (count > 0) {
+                *cursor++ = (uint8_t)bits;
+                bits >>= 8;
+                count -= 8;
+            }
+            bits = 0;
+            count = 0;
+            return cursor;
+        }
+        
+        void put_byte_aligned(uint8_t value) { *cursor++ = value; }
+        
+    private:
+        uint8_t* cursor;
+        uint64_t bits;
+        int count;
+    };
+    
+    uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+    
+    uint32_t hash4(const uint8_t* p) {
+        return (read32(p) * 2654435761u) >> (32 - HASH_BITS);
+    }
+    
+    // length of the common prefix of a and b, up to limit bytes, compared eight at a time
+    int match_length(const uint8_t* a, const uint8_t* b, int limit) {
+        int length = 0;
+        while (length + 8 <= limit) {
+            uint64_t x, y;
+            std::memcpy(&x, a + length, 8);
+            std::memcpy(&y, b + length, 8);
+            uint64_t diff = x ^ y;
+            if (diff) return length + (__builtin_ctzll(diff) >> 3);
+            length += 8;
+        }
+        while (length < limit && a[length] == b[length]) length++;
+        return length;
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    const uint32_t (*t)[256] = crc_tables.table;
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+        uint32_t hi = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t size) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+        size_t n = std::min(size, ADLER_NMAX);
+        size -= n;
+        for (; n >= 8; n -= 8, data += 8) {
+            a += data[0]; b += a;
+            a += data[1]; b += a;
+            a += data[2]; b += a;
+            a += data[3]; b += a;
+            a += data[4]; b += a;
+            a += data[5]; b += a;
+            a += data[6]; b += a;
+            a += data[7]; b += a;
+        }
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return a | (b << 16);
+}
+
+uint32_t adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t size_b) {
+    // same derivation as zlib: shift a's sums past size_b bytes, then add b's
+    uint32_t rem = (uint32_t)(size_b % ADLER_BASE);
+    uint32_t sum1 = adler_a & 0xFFFF;
+    uint32_t sum2 = (rem * sum1) % ADLER_BASE;
+    sum1 += (adler_b & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (adler_a >> 16) + (adler_b >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+    if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+    return sum1 | (sum2 << 16);
+}
+
+void DeflateSegmentWriter::write(const uint8_t* data, size_t size, bool final, DeflateMode mode,
+                                 std::vector<uint8_t>& out) {
+    if (mode == DeflateMode::STORED) {
+        write_stored(data, size, final, out);
+    } else {
+        write_fast(data, size, final, out);
+    }
+}
+
+void DeflateSegmentWriter::write_stored(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) {
+    // stored blocks are byte aligned already; an empty final segment still needs its closing block
+    const size_t MAX_STORED = 65535;
+    size_t offset = 0;
+    do {
+        size_t n = std::min(size - offset, MAX_STORED);
+        bool last = final && offset + n == size;
+        uint8_t header[5] = {(uint8_t)(last ? 1 : 0), (uint8_t)n, (uint8_t)(n >> 8),
+                             (uint8_t)~n, (uint8_t)(~n >> 8)};
+        if (n == 0 && !last) break;
+        out.insert(out.end(), header, header + 5);
+        out.insert(out.end(), data + offset, data + offset + n);
+        offset += n;
+    } while (offset < size);
+}
+
+void DeflateSegmentWriter::write_fast(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) {
+    // worst case is every byte a 9-bit literal, plus block framing
+    size_t start = out.size();
+    out.resize(start + size + size / 8 + 16);
+    BitWriter writer(out.data() + start);
+    
+    head.assign((size_t)1 << HASH_BITS, -1);
+    
+    writer.put(final ? 1 : 0, 1);
+    writer.put(1, 2);  // fixed huffman block
+    
+    auto put_literal = [&](int symbol) {
+        writer.put(fixed_code.literal_code[symbol], fixed_code.literal_length[symbol]);
+    };
+    
+    size_t i = 0;
+    while (i + MIN_MATCH <= size) {
+        uint32_t h = hash4(data + i);
+        int32_t candidate = head[h];
+        head[h] = (int32_t)i;
+        
+        if (candidate >= 0 && i - candidate <= (size_t)WINDOW_SIZE && read32(data + candidate) == read32(data + i)) {
+            int limit = (int)std::min<size_t>(MAX_MATCH, size - i);
+            int length = MIN_MATCH + match_length(data + candidate + MIN_MATCH, data + i + MIN_MATCH, limit - MIN_MATCH);
+            int distance = (int)(i - candidate);
+            
+            int ls = fixed_code.length_symbol[length];
+            put_literal(257 + ls);
+            if (LENGTH_EXTRA[ls]) writer.put(length - LENGTH_BASE[ls], LENGTH_EXTRA[ls]);
+            int ds = fixed_code.distance_symbol[distance];
+            writer.put(fixed_code.distance_code[ds], 5);
+            if (DISTANCE_EXTRA[ds]) writer.put(distance - DISTANCE_BASE[ds], DISTANCE_EXTRA[ds]);
+            
+            i += length;
+        } else {
+            put_literal(data[i]);
+            i++;
+        }
+    }
+    while (i < size) put_literal(data[i++]);
+    put_literal(256);  // end of block
+    
+    // an empty stored block brings a non-final segment back to a byte boundary
+    if (!final) {
+        writer.put(0, 3);
+        writer.align();
+        const uint8_t empty[4] = {0x00, 0x00, 0xFF, 0xFF};
+        for (uint8_t b : empty) writer.put_byte_aligned(b);
+    }
+    uint8_t* end = writer.align();
+    out.resize(end - out.data());
+}
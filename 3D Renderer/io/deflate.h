@@ -0,0 +1,39 @@
+// deflate.h
+// minimal zlib-compatible deflate writer and checksums for the png encoder
+// streams are built from independent segments so strips can be compressed in parallel
+
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// checksums, continued across calls by passing the previous result
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size);     // start with 0
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t size); // start with 1
+
+// adler-32 of a + b from adler32(a), adler32(b) and the length of b
+uint32_t adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t size_b);
+
+enum class DeflateMode {
+    STORED,  // no compression, just framing
+    FAST     // greedy single-probe lz77 with the fixed huffman code
+};
+
+// compresses one segment of a deflate stream into out (appended)
+// every segment starts and ends on a byte boundary: a non-final segment ends with an empty
+// stored block, so segments compressed separately can simply be concatenated
+// matches never reach into earlier segments
+class DeflateSegmentWriter {
+public:
+    void write(const uint8_t* data, size_t size, bool final, DeflateMode mode, std::vector<uint8_t>& out);
+    
+private:
+    void write_stored(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out);
+    void write_fast(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out);
+    
+    std::vector<int32_t> head;  // match finder hash table, kept between segments
+};
+
+#endif
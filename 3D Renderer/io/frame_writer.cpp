@@ -0,0 +1,96 @@
+// frame_writer.cpp
+// implementation of the image sequence and video stream writers
+
+#include "frame_writer.h"
+#include <iostream>
+
+namespace {
+    // rgb to bt.601 studio-range ycbcr, 8-bit fixed point as used by most y4m producers
+    inline uint8_t luma(int r, int g, int b) { return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+    inline uint8_t chroma_blue(int r, int g, int b) { return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+    inline uint8_t chroma_red(int r, int g, int b) { return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+}
+
+ImageSequenceWriter::ImageSequenceWriter(const std::string& p)
+    : pattern(p), encoder(make_image_encoder(image_format_for_path(p))) {}
+
+bool ImageSequenceWriter::write_frame(const ImageView& image, int index) {
+    char filename[1024];
+    std::snprintf(filename, sizeof(filename), pattern.c_str(), index);
+    encoder->encode(image, bytes);
+    return write_file(filename, bytes);
+}
+
+VideoStreamWriter::VideoStreamWriter(const std::string& p, StreamFormat f, int rate)
+    : path(p), format(f), fps(rate), file(nullptr), owns_file(false), header_written(false) {
+    if (path == "-") {
+        file = stdout;
+    } else {
+        file = std::fopen(path.c_str(), "wb");
+        owns_file = file != nullptr;
+        if (!file) std::cerr << "Error: Could not open " << path << " for writing" << std::endl;
+    }
+}
+
+VideoStreamWriter::~VideoStreamWriter() {
+    if (owns_file) {
+        std::fclose(file);
+    } else if (file) {
+        std::fflush(file);
+    }
+}
+
+bool VideoStreamWriter::write_frame(const ImageView& image, int) {
+    if (!file) return false;
+    
+    // the stream header needs the frame size, so it goes out with the first frame
+    bytes.clear();
+    if (format == StreamFormat::Y4M && !header_written) {
+        std::string header = "YUV4MPEG2 W" + std::to_string(image.width) + " H" + std::to_string(image.height) +
+                             " F" + std::to_string(fps) + ":1 Ip A1:1 C444\n";
+        bytes.insert(bytes.end(), header.begin(), header.end());
+    }
+    header_written = true;
+    
+    size_t plane = (size_t)image.width * image.height;
+    if (format == StreamFormat::Y4M) {
+        // frame marker then full-resolution y, cb and cr planes
+        const char marker[] = "FRAME\n";
+        bytes.insert(bytes.end(), marker, marker + 6);
+        size_t start = bytes.size();
+        bytes.resize(start + 3 * plane);
+        uint8_t* y_plane = bytes.data() + start;
+        uint8_t* cb_plane = y_plane + plane;
+        uint8_t* cr_plane = cb_plane + plane;
+        for (int y = 0; y < image.height; y++) {
+            const uint32_t* row = image.pixels + (size_t)y * image.stride;
+            size_t offset = (size_t)y * image.width;
+            for (int x = 0; x < image.width; x++) {
+                int r = row[x] & 0xFF, g = (row[x] >> 8) & 0xFF, b = (row[x] >> 16) & 0xFF;
+                y_plane[offset + x] = luma(r, g, b);
+                cb_plane[offset + x] = chroma_blue(r, g, b);
+                cr_plane[offset + x] = chroma_red(r, g, b);
+            }
+        }
+    } else {
+        size_t start = bytes.size();
+        bytes.resize(start + 3 * plane);
+        uint8_t* dst = bytes.data() + start;
+        for (int y = 0; y < image.height; y++) {
+            const uint32_t* row = image.pixels + (size_t)y * image.stride;
+            for (int x = 0; x < image.width; x++) {
+                dst[0] = (uint8_t)row[x];
+                dst[1] = (uint8_t)(row[x] >> 8);
+                dst[2] = (uint8_t)(row[x] >> 16);
+                dst += 3;
+            }
+        }
+    }
+    
+    // one write per frame keeps a reading ffmpeg fed in large chunks
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        std::cerr << "Error: Could not write frame to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
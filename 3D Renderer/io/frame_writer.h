@@ -0,0 +1,60 @@
+// frame_writer.h
+// destinations for rendered frame sequences
+// numbered image files, or a y4m / raw rgb video stream for a pipe into ffmpeg
+
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include "image_encoder.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// receives frames in order; all calls come from one thread, scratch is reused between frames
+class FrameWriter {
+public:
+    virtual ~FrameWriter() = default;
+    
+    // returns false when the frame could not be written
+    virtual bool write_frame(const ImageView& image, int index) = 0;
+};
+
+// one image file per frame; the pattern holds a printf integer field such as frame_%04d.png
+// and the encoder is picked from its extension
+class ImageSequenceWriter : public FrameWriter {
+public:
+    explicit ImageSequenceWriter(const std::string& pattern);
+    
+    bool write_frame(const ImageView& image, int index) override;
+    
+private:
+    std::string pattern;
+    std::unique_ptr<ImageEncoder> encoder;
+    std::vector<uint8_t> bytes;
+};
+
+enum class StreamFormat {
+    Y4M,     // yuv4mpeg2, 4:4:4 bt.601 studio range; self-describing, ffmpeg -i - just works
+    RAW_RGB  // bare rgb24 frames; ffmpeg needs -f rawvideo -pix_fmt rgb24 -s WxH -r FPS
+};
+
+// every frame appended to one stream, "-" meaning stdout; a fifo path works as well
+class VideoStreamWriter : public FrameWriter {
+public:
+    VideoStreamWriter(const std::string& path, StreamFormat format, int fps);
+    ~VideoStreamWriter() override;
+    
+    bool write_frame(const ImageView& image, int index) override;
+    
+private:
+    std::string path;
+    StreamFormat format;
+    int fps;
+    std::FILE* file;
+    bool owns_file;
+    bool header_written;
+    std::vector<uint8_t> bytes;
+};
+
+#endif
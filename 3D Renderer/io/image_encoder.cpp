@@ -0,0 +1,67 @@
+// image_encoder.cpp
+// implementation of the ppm encoder, encoder selection and file output
+
+#include "image_encoder.h"
+#include "qoi_encoder.h"
+#include "png_encoder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+void PpmEncoder::encode(const ImageView& image, std::vector<uint8_t>& out) {
+    // header then tightly packed rgb rows
+    char header[64];
+    int header_size = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", image.width, image.height);
+    out.resize((size_t)header_size + (size_t)image.width * image.height * 3);
+    std::copy(header, header + header_size, out.begin());
+    
+    uint8_t* dst = out.data() + header_size;
+    for (int y = 0; y < image.height; y++) {
+        const uint32_t* row = image.pixels + (size_t)y * image.stride;
+        for (int x = 0; x < image.width; x++) {
+            uint32_t c = row[x];
+            dst[0] = (uint8_t)c;
+            dst[1] = (uint8_t)(c >> 8);
+            dst[2] = (uint8_t)(c >> 16);
+            dst += 3;
+        }
+    }
+}
+
+std::unique_ptr<ImageEncoder> make_image_encoder(ImageFormat format, ThreadPool* pool) {
+    switch (format) {
+        case ImageFormat::QOI: return std::make_unique<QoiEncoder>();
+        case ImageFormat::PNG: return std::make_unique<PngEncoder>(DeflateMode::FAST, pool);
+        case ImageFormat::PNG_STORED: return std::make_unique<PngEncoder>(DeflateMode::STORED, pool);
+        default: return std::make_unique<PpmEncoder>();
+    }
+}
+
+ImageFormat image_format_for_path(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos) return ImageFormat::PPM;
+    
+    std::string extension = filename.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+    if (extension == ".qoi") return ImageFormat::QOI;
+    if (extension == ".png") return ImageFormat::PNG;
+    return ImageFormat::PPM;
+}
+
+bool write_file(const std::string& filename, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+        return false;
+    }
+    
+    file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    if (!file) {
+        std::cerr << "Error: Could not write file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+// image_encoder.h
+// pluggable image file encoders for rendered frames
+// encoders turn a view of packed rgba8 pixels into file bytes; files are written in one call
+
+#ifndef IMAGE_ENCODER_H
+#define IMAGE_ENCODER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// read-only view of packed rgba8 pixels (Color::to_packed layout), alpha is ignored
+struct ImageView {
+    const uint32_t* pixels;
+    int width, height;
+    int stride;  // pixels per row, may exceed width
+};
+
+// base class for file formats; encoders keep their scratch buffers between frames
+class ImageEncoder {
+public:
+    virtual ~ImageEncoder() = default;
+    
+    virtual const char* name() const = 0;
+    virtual const char* extension() const = 0;  // including the dot
+    
+    // replace out with the encoded file contents
+    virtual void encode(const ImageView& image, std::vector<uint8_t>& out) = 0;
+};
+
+// binary p6 portable pixmap
+class PpmEncoder : public ImageEncoder {
+public:
+    const char* name() const override { return "ppm"; }
+    const char* extension() const override { return ".ppm"; }
+    void encode(const ImageView& image, std::vector<uint8_t>& out) override;
+};
+
+enum class ImageFormat { PPM, QOI, PNG, PNG_STORED };
+
+// encoder for a format; pool (optional) lets png compress strips in parallel
+std::unique_ptr<ImageEncoder> make_image_encoder(ImageFormat format, ThreadPool* pool = nullptr);
+
+// format picked from the file extension (.ppm, .qoi, .png), ppm when unknown
+ImageFormat image_format_for_path(const std::string& filename);
+
+// write bytes to a file with a single call; reports failures on stderr like the rest of the engine
+bool write_file(const std::string& filename, const std::vector<uint8_t>& bytes);
+
+#endif
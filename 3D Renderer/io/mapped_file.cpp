@@ -0,0 +1,85 @@
+// mapped_file.cpp
+// posix mmap wrapper for mesh import and the mesh cache
+
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)),
+      opened(std::exchange(other.opened, false)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        std::cerr << "Error: Could not read the size of " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    
+    // empty files cannot be mapped but are valid; the mapping outlives the descriptor
+    length = (size_t)info.st_size;
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Error: Could not map file " << path << std::endl;
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        bytes = static_cast<const uint8_t*>(mapping);
+    }
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::advise_sequential() const {
+    if (!bytes) return;
+    madvise(const_cast<uint8_t*>(bytes), length, MADV_SEQUENTIAL);
+    madvise(const_cast<uint8_t*>(bytes), length, MADV_WILLNEED);
+}
+
+bool file_stamp(const std::string& path, uint64_t& size, int64_t& modified_ns) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+    modified_ns = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    modified_ns = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
@@ -0,0 +1,44 @@
+// mapped_file.h
+// read-only memory mapping of a whole file
+// mesh files are parsed or used in place straight from the page cache, without read() copies
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// owns one mapping; pages are faulted in on first touch and shared with the page cache
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // map path for reading, replacing any previous mapping; reports failures on stderr
+    bool open(const std::string& path);
+    void close();
+    
+    // tell the kernel the whole file will be read front to back, so it reads ahead
+    void advise_sequential() const;
+    
+    bool is_open() const { return opened; }
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool opened = false;
+};
+
+// size and modification time of a file, for checking whether a cache is still current;
+// false when the file does not exist
+bool file_stamp(const std::string& path, uint64_t& size, int64_t& modified_ns);
+
+#endif
@@ -0,0 +1,166 @@
+// mesh_cache.cpp
+// .rmesh writer, validation of mapped caches and the import-or-map entry point
+
+#include "mesh_cache.h"
+#include "mesh_import.h"
+#include "../geometry/mesh_optimizer.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<Vertex>::value && std::is_trivially_copyable<Triangle>::value,
+              "cached arrays are used in place, so their structs must be plain bytes");
+
+namespace {
+    const char RMESH_MAGIC[8] = {'R', 'M', 'E', 'S', 'H', '\r', '\n', '\x1a'};
+    const uint32_t RMESH_BYTE_ORDER = 0x01020304;
+    const uint64_t RMESH_ALIGNMENT = 64;
+    
+    uint64_t align_up(uint64_t offset) {
+        return (offset + RMESH_ALIGNMENT - 1) / RMESH_ALIGNMENT * RMESH_ALIGNMENT;
+    }
+    
+    bool write_padded(std::ofstream& file, const void* data, size_t bytes, uint64_t& offset, uint64_t target) {
+        static const char zeros[RMESH_ALIGNMENT] = {};
+        file.write(zeros, (std::streamsize)(target - offset));
+        file.write(static_cast<const char*>(data), (std::streamsize)bytes);
+        offset = target + bytes;
+        return (bool)file;
+    }
+}
+
+bool write_mesh_cache(const std::string& path, const Mesh& mesh, uint64_t source_size, int64_t source_modified_ns) {
+    RmeshHeader header = {};
+    std::memcpy(header.magic, RMESH_MAGIC, sizeof(header.magic));
+    header.version = RMESH_VERSION;
+    header.byte_order = RMESH_BYTE_ORDER;
+    header.vertex_size = sizeof(Vertex);
+    header.triangle_size = sizeof(Triangle);
+    header.vertex_count = mesh.vertices.size();
+    header.triangle_count = mesh.triangles.size();
+    header.vertex_offset = align_up(sizeof(RmeshHeader));
+    header.triangle_offset = align_up(header.vertex_offset + header.vertex_count * sizeof(Vertex));
+    const Aabb& box = mesh.get_bounds();
+    const BoundingSphere& sphere = mesh.get_bounding_sphere();
+    const float bounds[10] = {box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z,
+                              sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius};
+    std::memcpy(header.bounds_min, bounds, sizeof(bounds));
+    header.source_size = source_size;
+    header.source_modified_ns = source_modified_ns;
+    
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file " << temporary << " for writing" << std::endl;
+            return false;
+        }
+        uint64_t offset = 0;
+        bool written = write_padded(file, &header, sizeof(header), offset, 0) &&
+                       write_padded(file, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), offset,
+                                    header.vertex_offset) &&
+                       write_padded(file, mesh.triangles.data(), mesh.triangles.size() * sizeof(Triangle), offset,
+                                    header.triangle_offset);
+        file.close();
+        if (!written || !file) {
+            std::cerr << "Error: Could not write file " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Could not replace " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MappedMesh::open(const std::string& path) {
+    vertex_data = nullptr;
+    triangle_data = nullptr;
+    header = RmeshHeader();
+    if (!file.open(path)) return false;
+    
+    // everything the arrays are used through is checked once here, never per access
+    const char* problem = nullptr;
+    if (file.size() < sizeof(RmeshHeader)) {
+        problem = "too small for a header";
+    } else {
+        std::memcpy(&header, file.data(), sizeof(header));
+        uint64_t vertex_end = header.vertex_offset + header.vertex_count * sizeof(Vertex);
+        uint64_t triangle_end = header.triangle_offset + header.triangle_count * sizeof(Triangle);
+        if (std::memcmp(header.magic, RMESH_MAGIC, sizeof(header.magic)) != 0) {
+            problem = "not an rmesh file";
+        } else if (header.version != RMESH_VERSION || header.byte_order != RMESH_BYTE_ORDER ||
+                   header.vertex_size != sizeof(Vertex) || header.triangle_size != sizeof(Triangle)) {
+            problem = "written by an incompatible version";
+        } else if (header.vertex_offset % RMESH_ALIGNMENT != 0 || header.triangle_offset % RMESH_ALIGNMENT != 0 ||
+                   header.vertex_offset < sizeof(RmeshHeader) || vertex_end > file.size() ||
+                   triangle_end > file.size() || header.vertex_count > (uint64_t)INT32_MAX) {
+            problem = "truncated or corrupt";
+        }
+    }
+    if (problem) {
+        std::cerr << "Error: Mesh cache " << path << " is " << problem << std::endl;
+        file.close();
+        header = RmeshHeader();
+        return false;
+    }
+    
+    vertex_data = reinterpret_cast<const Vertex*>(file.data() + header.vertex_offset);
+    triangle_data = reinterpret_cast<const Triangle*>(file.data() + header.triangle_offset);
+    bounds.min = Vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+    bounds.max = Vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+    bounding_sphere.center = Vec3(header.sphere_center[0], header.sphere_center[1], header.sphere_center[2]);
+    bounding_sphere.radius = header.sphere_radius;
+    return true;
+}
+
+Mesh MappedMesh::to_mesh() const {
+    Mesh mesh(material);
+    mesh.transform = transform;
+    mesh.vertices.assign(vertex_data, vertex_data + vertex_count());
+    mesh.triangles.assign(triangle_data, triangle_data + triangle_count());
+    mesh.update_bounds();
+    return mesh;
+}
+
+std::string mesh_cache_path(const std::string& source) {
+    return source + ".rmesh";
+}
+
+bool load_mesh_cached(const std::string& source, MappedMesh& mesh, ThreadPool* pool, bool* cache_hit) {
+    if (cache_hit) *cache_hit = false;
+    if (mesh_format_for_path(source) == MeshFileFormat::RMESH) {
+        if (cache_hit) *cache_hit = true;
+        return mesh.open(source);
+    }
+    
+    uint64_t size;
+    int64_t modified_ns;
+    if (!file_stamp(source, size, modified_ns)) {
+        std::cerr << "Error: Could not open file " << source << std::endl;
+        return false;
+    }
+    
+    // a cache is current when it was built from a file of this size and modification time
+    std::string cache = mesh_cache_path(source);
+    uint64_t cache_size;
+    int64_t cache_modified_ns;
+    if (file_stamp(cache, cache_size, cache_modified_ns) && mesh.open(cache)) {
+        const RmeshHeader& header = mesh.get_header();
+        if (header.source_size == size && header.source_modified_ns == modified_ns) {
+            if (cache_hit) *cache_hit = true;
+            return true;
+        }
+    }
+    
+    Mesh imported;
+    if (!import_mesh(source, imported, pool)) return false;
+    optimize_mesh(imported);
+    if (!write_mesh_cache(cache, imported, size, modified_ns)) return false;
+    return mesh.open(cache);
+}
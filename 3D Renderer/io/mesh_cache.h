@@ -0,0 +1,82 @@
+// mesh_cache.h
+// versioned binary .rmesh files holding a mesh's vertex and triangle arrays exactly as in memory
+// a cache is mapped and drawn in place, with no parsing and no copies of the arrays
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mapped_file.h"
+#include "../geometry/mesh.h"
+#include <cstdint>
+#include <string>
+
+class ThreadPool;
+
+// bumped whenever the header, Vertex or Triangle layout or the import processing changes; older
+// files are rebuilt. 2: imports are welded and reordered by optimize_mesh before caching
+constexpr uint32_t RMESH_VERSION = 2;
+
+// file layout: this header, then the Vertex array and the Triangle array, each starting at a
+// 64-byte aligned offset; the writer's byte order and struct sizes are recorded and must match
+struct RmeshHeader {
+    char magic[8];             // "RMESH\r\n\x1a", mangled by any text-mode copy
+    uint32_t version;
+    uint32_t byte_order;       // RMESH_BYTE_ORDER as the writer stored it
+    uint32_t vertex_size;      // sizeof(Vertex) of the writer
+    uint32_t triangle_size;    // sizeof(Triangle) of the writer
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    uint64_t vertex_offset;
+    uint64_t triangle_offset;
+    float bounds_min[3], bounds_max[3];
+    float sphere_center[3], sphere_radius;
+    uint64_t source_size;       // size and modification time of the imported file, 0 when none
+    int64_t source_modified_ns;
+};
+
+// write mesh to path through a temporary file, so a cache is either complete or absent
+bool write_mesh_cache(const std::string& path, const Mesh& mesh, uint64_t source_size = 0,
+                      int64_t source_modified_ns = 0);
+
+// read-only mesh backed by a mapped .rmesh file; material and transform are set by the caller,
+// like a Mesh's, and the renderer and scene draw it without copying the arrays
+class MappedMesh {
+public:
+    Material material;
+    Mat4 transform;
+    
+    // map and validate path; reports failures on stderr
+    bool open(const std::string& path);
+    
+    const Vertex* vertices() const { return vertex_data; }
+    const Triangle* triangles() const { return triangle_data; }
+    size_t vertex_count() const { return (size_t)header.vertex_count; }
+    size_t triangle_count() const { return (size_t)header.triangle_count; }
+    
+    const Aabb& get_bounds() const { return bounds; }
+    const BoundingSphere& get_bounding_sphere() const { return bounding_sphere; }
+    const RmeshHeader& get_header() const { return header; }
+    size_t mapped_bytes() const { return file.size(); }
+    
+    // copy into an ordinary Mesh, for code that edits geometry
+    Mesh to_mesh() const;
+    
+private:
+    MappedFile file;
+    RmeshHeader header = {};
+    const Vertex* vertex_data = nullptr;
+    const Triangle* triangle_data = nullptr;
+    Aabb bounds;
+    BoundingSphere bounding_sphere;
+};
+
+// cache file next to a source mesh: source + ".rmesh"
+std::string mesh_cache_path(const std::string& source);
+
+// the mesh at source mapped from its cache when the cache matches the source's size and
+// modification time, otherwise imported (parsed on pool when given), optimized, cached and mapped;
+// cache_hit (optional) tells which. a .rmesh source is mapped directly
+bool load_mesh_cached(const std::string& source, MappedMesh& mesh, ThreadPool* pool = nullptr,
+                      bool* cache_hit = nullptr);
+
+#endif
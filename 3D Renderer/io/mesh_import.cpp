@@ -0,0 +1,715 @@
+// mesh_import.cpp
+// obj and ply parsers working directly on the mapped file
+// each chunk parses into its own arrays; prefix sums then place every chunk in the final mesh
+
+#include "mesh_import.h"
+#include "mapped_file.h"
+#include "../core/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    // chunks are at least this large, so small files parse on the calling thread
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+    const int CHUNKS_PER_THREAD = 4;  // spare chunks even out lines of different lengths
+    const size_t RANGE_SIZE = 1 << 16;
+    
+    // fn(begin, end) over [0, count) in ranges, on the pool when there is one
+    template <typename Fn>
+    void parallel_ranges(ThreadPool* pool, size_t count, Fn&& fn) {
+        int ranges = (int)((count + RANGE_SIZE - 1) / RANGE_SIZE);
+        if (!pool || ranges <= 1) {
+            fn((size_t)0, count);
+            return;
+        }
+        pool->parallel_for(ranges, [&](int range, int) {
+            size_t begin = (size_t)range * RANGE_SIZE;
+            fn(begin, std::min(count, begin + RANGE_SIZE));
+        });
+    }
+    
+    template <typename Fn>
+    void for_each_chunk(ThreadPool* pool, size_t chunks, Fn&& fn) {
+        if (!pool || chunks <= 1) {
+            for (size_t i = 0; i < chunks; i++) fn(i);
+            return;
+        }
+        pool->parallel_for((int)chunks, [&](int chunk, int) { fn((size_t)chunk); });
+    }
+    
+    size_t chunk_count(size_t bytes, ThreadPool* pool) {
+        size_t threads = pool ? (size_t)pool->thread_count() : 1;
+        return std::max<size_t>(1, std::min(bytes / MIN_CHUNK_BYTES, threads * CHUNKS_PER_THREAD));
+    }
+    
+    const char* next_line(const char* p, const char* end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', (size_t)(end - p)));
+        return newline ? newline + 1 : end;
+    }
+    
+    // boundaries of line-aligned chunks covering [begin, end): chunk i is [bounds[i], bounds[i + 1])
+    std::vector<const char*> split_lines(const char* begin, const char* end, ThreadPool* pool) {
+        size_t size = (size_t)(end - begin);
+        size_t chunks = chunk_count(size, pool);
+        std::vector<const char*> bounds(1, begin);
+        for (size_t i = 1; i < chunks; i++) {
+            const char* p = std::max(begin + size * i / chunks, bounds.back());
+            bounds.push_back(p == begin ? p : next_line(p - 1, end));
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+    
+    inline const char* skip_blanks(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        return p;
+    }
+    
+    inline bool at_line_end(const char* p, const char* end) {
+        p = skip_blanks(p, end);
+        return p == end || *p == '\n' || *p == '#';
+    }
+    
+    // whitespace-separated number at p; from_chars takes no leading '+', so it is skipped here
+    bool parse_float(const char*& p, const char* end, float& value) {
+        p = skip_blanks(p, end);
+        if (p < end && *p == '+') p++;
+#if defined(__cpp_lib_to_chars)
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec == std::errc::invalid_argument) return false;
+        p = result.ptr;
+        return true;
+#else
+        // standard libraries without floating-point from_chars: strtof on a bounded copy
+        char token[64];
+        size_t length = 0;
+        while (p + length < end && length + 1 < sizeof(token) && !std::strchr(" \t\r\n/", p[length])) {
+            token[length] = p[length];
+            length++;
+        }
+        token[length] = '\0';
+        char* stop;
+        value = std::strtof(token, &stop);
+        if (stop == token) return false;
+        p += stop - token;
+        return true;
+#endif
+    }
+    
+    bool parse_int(const char*& p, const char* end, long long& value) {
+        p = skip_blanks(p, end);
+        if (p < end && *p == '+') p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+    
+    bool report_error(const std::string& path, const char* what) {
+        std::cerr << "Error: " << what << " in " << path << std::endl;
+        return false;
+    }
+    
+    // face normals in parallel, then vertex normals when the file had none, then bounds
+    void finish_mesh(Mesh& mesh, bool has_vertex_normals, ThreadPool* pool) {
+        parallel_ranges(pool, mesh.triangles.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) mesh.triangles[i].calculate_normal(mesh.vertices);
+        });
+        if (!has_vertex_normals) mesh.calculate_vertex_normals();
+        mesh.update_bounds();
+    }
+    
+    // ---- obj ----
+    
+    // corner index as parsed: absolute, or counting back from the chunk's latest record, in which
+    // case value is relative to the chunk's first record and may be negative
+    struct ObjIndex {
+        long long value;
+        bool relative;
+    };
+    
+    const int32_t NO_NORMAL = -1;
+    
+    struct ObjChunk {
+        std::vector<Vec3> positions;
+        std::vector<Vec3> normals;
+        std::vector<int32_t> corners;  // position and normal index per corner, three corners per triangle
+        std::vector<std::pair<size_t, long long>> relative;  // corners slot, index from the chunk start
+        bool missing_normals = false;
+        bool failed = false;
+    };
+    
+    bool parse_obj_index(const char*& p, const char* end, size_t local_count, ObjIndex& index) {
+        long long value;
+        if (!parse_int(p, end, value) || value == 0) return false;
+        if (value > 0) {
+            index = {value - 1, false};
+        } else {
+            index = {(long long)local_count + value, true};
+        }
+        return true;
+    }
+    
+    void emit_obj_index(ObjChunk& chunk, const ObjIndex& index) {
+        if (index.relative) {
+            chunk.relative.emplace_back(chunk.corners.size(), index.value);
+            chunk.corners.push_back(0);
+        } else {
+            chunk.corners.push_back((int32_t)index.value);
+        }
+    }
+    
+    // one f record: corners are v, v/vt, v//vn or v/vt/vn, fanned around the first one
+    bool parse_obj_face(const char* p, const char* end, ObjChunk& chunk, std::vector<ObjIndex>& face) {
+        face.clear();
+        while (!at_line_end(p, end)) {
+            ObjIndex position, normal = {NO_NORMAL, false};
+            if (!parse_obj_index(p, end, chunk.positions.size(), position)) return false;
+            if (p < end && *p == '/') {
+                p++;
+                while (p < end && *p != '/' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;  // vt
+                if (p < end && *p == '/') {
+                    p++;
+                    if (!parse_obj_index(p, end, chunk.normals.size(), normal)) return false;
+                }
+            }
+            if (!normal.relative && normal.value == NO_NORMAL) chunk.missing_normals = true;
+            face.push_back(position);
+            face.push_back(normal);
+        }
+        if (face.size() < 6) return false;
+        for (size_t k = 2; k + 2 < face.size(); k += 2) {
+            const size_t fan[3] = {0, k, k + 2};
+            for (size_t corner : fan) {
+                emit_obj_index(chunk, face[corner]);
+                emit_obj_index(chunk, face[corner + 1]);
+            }
+        }
+        return true;
+    }
+    
+    void parse_obj_chunk(const char* p, const char* end, ObjChunk& chunk) {
+        std::vector<ObjIndex> face;
+        while (p < end) {
+            const char* line_end = next_line(p, end);
+            p = skip_blanks(p, line_end);
+            if (line_end - p > 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+                Vec3 v;
+                p += 2;
+                if (!parse_float(p, line_end, v.x) || !parse_float(p, line_end, v.y) || !parse_float(p, line_end, v.z)) {
+                    chunk.failed = true;
+                    return;
+                }
+                chunk.positions.push_back(v);
+            } else if (line_end - p > 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+                Vec3 n;
+                p += 3;
+                if (!parse_float(p, line_end, n.x) || !parse_float(p, line_end, n.y) || !parse_float(p, line_end, n.z)) {
+                    chunk.failed = true;
+                    return;
+                }
+                chunk.normals.push_back(n);
+            } else if (line_end - p > 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                if (!parse_obj_face(p + 2, line_end, chunk, face)) {
+                    chunk.failed = true;
+                    return;
+                }
+            }
+            p = line_end;
+        }
+    }
+    
+    // ---- ply ----
+    
+    enum class PlyType { NONE, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+    
+    struct PlyProperty {
+        std::string name;
+        PlyType type = PlyType::NONE;
+        PlyType count_type = PlyType::NONE;  // set for list properties
+    };
+    
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+    };
+    
+    PlyType ply_type(const std::string& name) {
+        if (name == "char" || name == "int8") return PlyType::INT8;
+        if (name == "uchar" || name == "uint8") return PlyType::UINT8;
+        if (name == "short" || name == "int16") return PlyType::INT16;
+        if (name == "ushort" || name == "uint16") return PlyType::UINT16;
+        if (name == "int" || name == "int32") return PlyType::INT32;
+        if (name == "uint" || name == "uint32") return PlyType::UINT32;
+        if (name == "float" || name == "float32") return PlyType::FLOAT32;
+        if (name == "double" || name == "float64") return PlyType::FLOAT64;
+        return PlyType::NONE;
+    }
+    
+    size_t ply_size(PlyType type) {
+        switch (type) {
+        case PlyType::INT8: case PlyType::UINT8: return 1;
+        case PlyType::INT16: case PlyType::UINT16: return 2;
+        case PlyType::INT32: case PlyType::UINT32: case PlyType::FLOAT32: return 4;
+        case PlyType::FLOAT64: return 8;
+        default: return 0;
+        }
+    }
+    
+    // one binary value of type at p, byte-swapped for big-endian files
+    double read_ply_value(const uint8_t* p, PlyType type, bool swap) {
+        uint8_t bytes[8];
+        size_t size = ply_size(type);
+        for (size_t i = 0; i < size; i++) bytes[i] = p[swap ? size - 1 - i : i];
+        switch (type) {
+        case PlyType::INT8: return (int8_t)bytes[0];
+        case PlyType::UINT8: return bytes[0];
+        case PlyType::INT16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::UINT16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::INT32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::UINT32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::FLOAT32: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::FLOAT64: { double v; std::memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+        }
+    }
+    
+    // slot of a vertex property in Vertex: 0..2 position, 3..5 normal, -1 unused
+    int vertex_slot(const std::string& name) {
+        static const char* const names[6] = {"x", "y", "z", "nx", "ny", "nz"};
+        for (int i = 0; i < 6; i++) {
+            if (name == names[i]) return i;
+        }
+        return -1;
+    }
+    
+    void set_vertex_slot(Vertex& vertex, int slot, float value) {
+        Vec3& target = slot < 3 ? vertex.position : vertex.normal;
+        (slot % 3 == 0 ? target.x : slot % 3 == 1 ? target.y : target.z) = value;
+    }
+    
+    bool is_face_indices(const PlyProperty& property) {
+        return property.count_type != PlyType::NONE &&
+               (property.name == "vertex_indices" || property.name == "vertex_index");
+    }
+    
+    // fan a polygon's indices into triangles, rejecting indices past the vertex count
+    bool emit_ply_face(const std::vector<long long>& polygon, size_t vertex_count, std::vector<Triangle>& triangles) {
+        for (long long index : polygon) {
+            if (index < 0 || (size_t)index >= vertex_count) return false;
+        }
+        for (size_t k = 1; k + 1 < polygon.size(); k++) {
+            triangles.emplace_back((int)polygon[0], (int)polygon[k], (int)polygon[k + 1]);
+        }
+        return true;
+    }
+    
+    // ascii element records, one per line: line starts of every chunk-th record, so chunks can
+    // parse in parallel knowing their first record; returns the end of the element's last line,
+    // or nullptr when the file ends first
+    const char* ply_ascii_chunks(const char* p, const char* end, size_t count, ThreadPool* pool,
+                                 std::vector<const char*>& starts, std::vector<size_t>& first) {
+        size_t chunks = chunk_count((size_t)(end - p), pool);
+        size_t per_chunk = std::max<size_t>(1, (count + chunks - 1) / chunks);
+        starts.clear();
+        first.clear();
+        for (size_t record = 0; record < count; record++) {
+            if (p == end) return nullptr;
+            if (record % per_chunk == 0) {
+                starts.push_back(p);
+                first.push_back(record);
+            }
+            p = next_line(p, end);
+        }
+        starts.push_back(p);
+        first.push_back(count);
+        return p;
+    }
+    
+    // values of one ascii record: scalar properties call scalar(property, value), lists call
+    // list(property, values)
+    template <typename Scalar, typename List>
+    bool parse_ply_ascii_record(const char* p, const char* end, const PlyElement& element,
+                                std::vector<long long>& values, Scalar&& scalar, List&& list) {
+        for (size_t k = 0; k < element.properties.size(); k++) {
+            const PlyProperty& property = element.properties[k];
+            if (property.count_type == PlyType::NONE) {
+                float value;
+                if (!parse_float(p, end, value)) return false;
+                scalar(k, value);
+                continue;
+            }
+            long long length;
+            if (!parse_int(p, end, length) || length < 0) return false;
+            // list items are vertex indices, integers past float precision in large meshes
+            values.clear();
+            for (long long i = 0; i < length; i++) {
+                long long value;
+                if (!parse_int(p, end, value)) return false;
+                values.push_back(value);
+            }
+            if (!list(property, values)) return false;
+        }
+        return true;
+    }
+    
+    // bytes of one binary record with its lists; collects the face indices when indices is given
+    bool read_ply_binary_record(const uint8_t*& p, const uint8_t* end, const PlyElement& element, bool swap,
+                                std::vector<long long>* indices) {
+        for (const PlyProperty& property : element.properties) {
+            if (property.count_type == PlyType::NONE) {
+                p += ply_size(property.type);
+                continue;
+            }
+            size_t count_size = ply_size(property.count_type), item_size = ply_size(property.type);
+            if (p + count_size > end) return false;
+            long long length = (long long)read_ply_value(p, property.count_type, swap);
+            p += count_size;
+            if (length < 0 || p + length * item_size > end) return false;
+            if (indices && is_face_indices(property)) {
+                indices->clear();
+                for (long long i = 0; i < length; i++) {
+                    indices->push_back((long long)read_ply_value(p + i * item_size, property.type, swap));
+                }
+            }
+            p += length * item_size;
+        }
+        return p <= end;
+    }
+    
+    bool parse_ply_header(const char*& p, const char* end, std::vector<PlyElement>& elements, int& format) {
+        // format: 0 ascii, 1 binary little endian, 2 binary big endian
+        if (end - p < 4 || std::strncmp(p, "ply", 3) != 0) return false;
+        format = -1;
+        p = next_line(p, end);
+        while (p < end) {
+            const char* line_end = next_line(p, end);
+            std::string line(p, line_end);
+            p = line_end;
+            while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+            
+            std::vector<std::string> words;
+            for (size_t at = 0; at < line.size();) {
+                size_t start = line.find_first_not_of(" \t", at);
+                if (start == std::string::npos) break;
+                size_t stop = line.find_first_of(" \t", start);
+                if (stop == std::string::npos) stop = line.size();
+                words.push_back(line.substr(start, stop - start));
+                at = stop;
+            }
+            if (words.empty() || words[0] == "comment" || words[0] == "obj_info") continue;
+            if (words[0] == "end_header") return format >= 0;
+            if (words[0] == "format" && words.size() >= 2) {
+                format = words[1] == "ascii" ? 0 : words[1] == "binary_little_endian" ? 1 :
+                         words[1] == "binary_big_endian" ? 2 : -1;
+            } else if (words[0] == "element" && words.size() >= 3) {
+                PlyElement element;
+                element.name = words[1];
+                element.count = (size_t)std::strtoull(words[2].c_str(), nullptr, 10);
+                elements.push_back(element);
+            } else if (words[0] == "property" && !elements.empty()) {
+                PlyProperty property;
+                if (words.size() >= 5 && words[1] == "list") {
+                    property.count_type = ply_type(words[2]);
+                    property.type = ply_type(words[3]);
+                    property.name = words[4];
+                    if (property.count_type == PlyType::NONE) return false;
+                } else if (words.size() >= 3) {
+                    property.type = ply_type(words[1]);
+                    property.name = words[2];
+                } else {
+                    return false;
+                }
+                if (property.type == PlyType::NONE) return false;
+                elements.back().properties.push_back(property);
+            }
+        }
+        return false;
+    }
+}
+
+MeshFileFormat mesh_format_for_path(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return MeshFileFormat::UNKNOWN;
+    std::string extension = path.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return (char)std::tolower(c);
+    });
+    if (extension == ".obj") return MeshFileFormat::OBJ;
+    if (extension == ".ply") return MeshFileFormat::PLY;
+    if (extension == ".rmesh") return MeshFileFormat::RMESH;
+    return MeshFileFormat::UNKNOWN;
+}
+
+bool import_obj(const std::string& path, Mesh& mesh, ThreadPool* pool) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    file.advise_sequential();
+    const char* text = reinterpret_cast<const char*>(file.data());
+    
+    std::vector<const char*> bounds = split_lines(text, text + file.size(), pool);
+    size_t chunks = bounds.size() - 1;
+    std::vector<ObjChunk> parsed(chunks);
+    for_each_chunk(pool, chunks, [&](size_t c) { parse_obj_chunk(bounds[c], bounds[c + 1], parsed[c]); });
+    
+    // where each chunk's records land in the whole file
+    std::vector<size_t> position_base(chunks + 1, 0), normal_base(chunks + 1, 0), corner_base(chunks + 1, 0);
+    bool missing_normals = false;
+    for (size_t c = 0; c < chunks; c++) {
+        if (parsed[c].failed) return report_error(path, "Malformed obj record");
+        position_base[c + 1] = position_base[c] + parsed[c].positions.size();
+        normal_base[c + 1] = normal_base[c] + parsed[c].normals.size();
+        corner_base[c + 1] = corner_base[c] + parsed[c].corners.size();
+        missing_normals |= parsed[c].missing_normals;
+    }
+    size_t position_count = position_base[chunks], normal_count = normal_base[chunks];
+    size_t corner_count = corner_base[chunks];
+    if (position_count > (size_t)INT32_MAX || corner_count / 6 > (size_t)INT32_MAX) {
+        return report_error(path, "Too many vertices");
+    }
+    
+    // gather positions, normals and corners, resolving relative indices and checking every one
+    std::vector<Vec3> positions(position_count), normals(normal_count);
+    std::vector<int32_t> corners(corner_count);
+    std::vector<unsigned char> chunk_valid(chunks, 1);
+    for_each_chunk(pool, chunks, [&](size_t c) {
+        ObjChunk& chunk = parsed[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + position_base[c]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normal_base[c]);
+        int32_t* out = corners.data() + corner_base[c];
+        std::copy(chunk.corners.begin(), chunk.corners.end(), out);
+        for (const auto& fix : chunk.relative) {
+            size_t base = fix.first % 2 == 0 ? position_base[c] : normal_base[c];
+            out[fix.first] = (int32_t)((long long)base + fix.second);
+        }
+        for (size_t k = 0; k < chunk.corners.size(); k += 2) {
+            bool position_ok = out[k] >= 0 && (size_t)out[k] < position_count;
+            bool normal_ok = out[k + 1] == NO_NORMAL || (out[k + 1] >= 0 && (size_t)out[k + 1] < normal_count);
+            if (!position_ok || !normal_ok) chunk_valid[c] = 0;
+        }
+        chunk = ObjChunk();  // release chunk memory as soon as it has been placed
+    });
+    if (std::count(chunk_valid.begin(), chunk_valid.end(), 0) > 0) return report_error(path, "Face index out of range");
+    
+    // vertices: positions alone without normals, position i with normal i when every corner pairs
+    // them that way, otherwise one vertex per distinct position and normal pair
+    bool use_normals = normal_count > 0 && !missing_normals;
+    bool paired = use_normals && normal_count == position_count;
+    for (size_t k = 0; paired && k < corner_count; k += 2) paired = corners[k] == corners[k + 1];
+    
+    size_t triangle_count = corner_count / 6;
+    std::vector<int32_t> vertex_of(corner_count / 2);
+    if (use_normals && !paired) {
+        std::unordered_map<uint64_t, int32_t> pairs;
+        pairs.reserve(position_count);
+        mesh.vertices.clear();
+        for (size_t k = 0; k < corner_count; k += 2) {
+            uint64_t key = (uint64_t)(uint32_t)corners[k] << 32 | (uint32_t)corners[k + 1];
+            auto inserted = pairs.emplace(key, (int32_t)mesh.vertices.size());
+            if (inserted.second) mesh.vertices.emplace_back(positions[corners[k]], normals[corners[k + 1]]);
+            vertex_of[k / 2] = inserted.first->second;
+        }
+        if (mesh.vertices.size() > (size_t)INT32_MAX) return report_error(path, "Too many vertices");
+    } else {
+        mesh.vertices.assign(position_count, Vertex());
+        parallel_ranges(pool, position_count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                mesh.vertices[i].position = positions[i];
+                if (paired) mesh.vertices[i].normal = normals[i];
+            }
+        });
+        parallel_ranges(pool, corner_count / 2, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) vertex_of[i] = corners[2 * i];
+        });
+    }
+    
+    mesh.triangles.assign(triangle_count, Triangle(0, 0, 0));
+    parallel_ranges(pool, triangle_count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            mesh.triangles[i] = Triangle(vertex_of[3 * i], vertex_of[3 * i + 1], vertex_of[3 * i + 2]);
+        }
+    });
+    finish_mesh(mesh, use_normals, pool);
+    return true;
+}
+
+bool import_ply(const std::string& path, Mesh& mesh, ThreadPool* pool) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    file.advise_sequential();
+    const char* text = reinterpret_cast<const char*>(file.data());
+    const char* end = text + file.size();
+    
+    std::vector<PlyElement> elements;
+    int format;
+    const char* p = text;
+    if (!parse_ply_header(p, end, elements, format)) return report_error(path, "Unsupported ply header");
+    bool swap = format == 2;
+    
+    const PlyElement* vertex_element = nullptr;
+    for (const PlyElement& element : elements) {
+        if (element.name == "vertex") vertex_element = &element;
+    }
+    if (!vertex_element || vertex_element->count > (size_t)INT32_MAX) {
+        return report_error(path, "Missing or oversized vertex element");
+    }
+    bool has_normals = false;
+    for (const PlyProperty& property : vertex_element->properties) has_normals |= property.name == "nx";
+    
+    mesh.vertices.assign(vertex_element->count, Vertex());
+    mesh.triangles.clear();
+    std::vector<const char*> starts;
+    std::vector<size_t> first;
+    
+    for (const PlyElement& element : elements) {
+        bool is_vertex = &element == vertex_element;
+        bool is_face = element.name == "face";
+        std::vector<int> slots;  // vertex_slot of each property, looked up once per element
+        for (const PlyProperty& property : element.properties) {
+            slots.push_back(is_vertex ? vertex_slot(property.name) : -1);
+        }
+        
+        if (format == 0) {
+            // ascii: records are lines, found serially with memchr and parsed in parallel chunks
+            const char* section_end = ply_ascii_chunks(p, end, element.count, pool, starts, first);
+            if (!section_end) return report_error(path, "Truncated ply element");
+            size_t chunks = starts.size() - 1;
+            if (is_vertex || is_face) {
+                std::vector<std::vector<Triangle>> faces(chunks);
+                std::vector<unsigned char> valid(chunks, 1);
+                for_each_chunk(pool, chunks, [&](size_t c) {
+                    std::vector<long long> values;
+                    const char* line = starts[c];
+                    for (size_t record = first[c]; record < first[c + 1]; record++) {
+                        const char* line_end = next_line(line, starts[c + 1]);
+                        Vertex* vertex = is_vertex ? &mesh.vertices[record] : nullptr;
+                        bool ok = parse_ply_ascii_record(line, line_end, element, values,
+                            [&](size_t k, float value) {
+                                if (slots[k] >= 0) set_vertex_slot(*vertex, slots[k], value);
+                            },
+                            [&](const PlyProperty& property, const std::vector<long long>& polygon) {
+                                if (!is_face || !is_face_indices(property)) return true;
+                                return emit_ply_face(polygon, mesh.vertices.size(), faces[c]);
+                            });
+                        if (!ok) {
+                            valid[c] = 0;
+                            return;
+                        }
+                        line = line_end;
+                    }
+                });
+                if (std::count(valid.begin(), valid.end(), 0) > 0) return report_error(path, "Malformed ply record");
+                for (const auto& chunk : faces) mesh.triangles.insert(mesh.triangles.end(), chunk.begin(), chunk.end());
+            }
+            p = section_end;
+            continue;
+        }
+        
+        // binary: fixed-size records are converted in parallel straight from the mapping
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(p);
+        const uint8_t* data_end = reinterpret_cast<const uint8_t*>(end);
+        size_t stride = 0;
+        bool fixed = true;
+        for (const PlyProperty& property : element.properties) {
+            fixed &= property.count_type == PlyType::NONE;
+            stride += ply_size(property.type);
+        }
+        if (fixed) {
+            if ((size_t)(data_end - data) < stride * element.count) return report_error(path, "Truncated ply element");
+            if (is_vertex) {
+                std::vector<size_t> offsets;
+                size_t offset = 0;
+                for (const PlyProperty& property : element.properties) {
+                    offsets.push_back(offset);
+                    offset += ply_size(property.type);
+                }
+                parallel_ranges(pool, element.count, [&](size_t begin, size_t range_end) {
+                    for (size_t i = begin; i < range_end; i++) {
+                        const uint8_t* record = data + i * stride;
+                        for (size_t k = 0; k < element.properties.size(); k++) {
+                            if (slots[k] < 0) continue;
+                            float value = (float)read_ply_value(record + offsets[k], element.properties[k].type, swap);
+                            set_vertex_slot(mesh.vertices[i], slots[k], value);
+                        }
+                    }
+                });
+            }
+            p += stride * element.count;
+            continue;
+        }
+        
+        // a face element of triangles only is fixed-size as well: that is tried in parallel first,
+        // and only files with other polygons fall back to the serial walk below
+        if (is_face && element.properties.size() == 1 && is_face_indices(element.properties[0])) {
+            const PlyProperty& list = element.properties[0];
+            size_t count_size = ply_size(list.count_type), item_size = ply_size(list.type);
+            size_t record_size = count_size + 3 * item_size;
+            if ((size_t)(data_end - data) >= record_size * element.count) {
+                size_t base = mesh.triangles.size();
+                mesh.triangles.resize(base + element.count, Triangle(0, 0, 0));
+                std::atomic<bool> all_triangles(true), in_range(true);
+                parallel_ranges(pool, element.count, [&](size_t begin, size_t range_end) {
+                    for (size_t i = begin; i < range_end; i++) {
+                        const uint8_t* record = data + i * record_size;
+                        if (read_ply_value(record, list.count_type, swap) != 3.0) {
+                            all_triangles = false;
+                            return;
+                        }
+                        long long index[3];
+                        for (int k = 0; k < 3; k++) {
+                            index[k] = (long long)read_ply_value(record + count_size + k * item_size, list.type, swap);
+                            if (index[k] < 0 || (size_t)index[k] >= mesh.vertices.size()) {
+                                in_range = false;
+                                return;
+                            }
+                        }
+                        mesh.triangles[base + i] = Triangle((int)index[0], (int)index[1], (int)index[2]);
+                    }
+                });
+                if (all_triangles) {
+                    if (!in_range) return report_error(path, "Face index out of range");
+                    p += record_size * element.count;
+                    continue;
+                }
+                mesh.triangles.resize(base, Triangle(0, 0, 0));
+            }
+        }
+        
+        // records with lists vary in size, so they are walked serially; binary needs no parsing
+        std::vector<long long> polygon;
+        for (size_t i = 0; i < element.count; i++) {
+            polygon.clear();
+            if (!read_ply_binary_record(data, data_end, element, swap, is_face ? &polygon : nullptr)) {
+                return report_error(path, "Truncated ply element");
+            }
+            if (is_face && !emit_ply_face(polygon, mesh.vertices.size(), mesh.triangles)) {
+                return report_error(path, "Face index out of range");
+            }
+        }
+        p = reinterpret_cast<const char*>(data);
+    }
+    
+    finish_mesh(mesh, has_normals, pool);
+    return true;
+}
+
+bool import_mesh(const std::string& path, Mesh& mesh, ThreadPool* pool) {
+    switch (mesh_format_for_path(path)) {
+    case MeshFileFormat::OBJ:
+        return import_obj(path, mesh, pool);
+    case MeshFileFormat::PLY:
+        return import_ply(path, mesh, pool);
+    default:
+        std::cerr << "Error: Unsupported mesh file " << path << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,31 @@
+// mesh_import.h
+// wavefront obj and stanford ply import into Mesh
+// files are mapped, split into line-aligned chunks and parsed in parallel with std::from_chars
+
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include "../geometry/mesh.h"
+#include <string>
+
+class ThreadPool;
+
+enum class MeshFileFormat { OBJ, PLY, RMESH, UNKNOWN };
+
+// format picked from the file extension (.obj, .ply, .rmesh)
+MeshFileFormat mesh_format_for_path(const std::string& path);
+
+// obj: v, vn and f records (polygons are fanned into triangles, negative indices count back
+// from the latest vertex); everything else, texture coordinates and materials included, is skipped.
+// a position used with different normals becomes one vertex per pair
+bool import_obj(const std::string& path, Mesh& mesh, ThreadPool* pool = nullptr);
+
+// ply: ascii, binary little and big endian; x y z and optional nx ny nz of the vertex element,
+// and the vertex_indices list of the face element
+bool import_ply(const std::string& path, Mesh& mesh, ThreadPool* pool = nullptr);
+
+// either of the above by extension; face normals are always computed, vertex normals when the
+// file has none, and the mesh bounds are refreshed. pool (optional) parses chunks in parallel
+bool import_mesh(const std::string& path, Mesh& mesh, ThreadPool* pool = nullptr);
+
+#endif
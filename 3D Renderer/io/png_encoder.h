@@ -0,0 +1,39 @@
+// png_encoder.h
+// png encoder with stored or fast deflate
+// rows are split into strips that are filtered and compressed in parallel
+
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include "image_encoder.h"
+#include "deflate.h"
+
+// 8-bit rgb png; each strip becomes its own IDAT chunk, so checksums are computed per strip
+// and the strips' deflate segments join into a single zlib stream
+class PngEncoder : public ImageEncoder {
+public:
+    explicit PngEncoder(DeflateMode mode = DeflateMode::FAST, ThreadPool* pool = nullptr);
+    
+    const char* name() const override { return mode == DeflateMode::FAST ? "png" : "png-stored"; }
+    const char* extension() const override { return ".png"; }
+    void encode(const ImageView& image, std::vector<uint8_t>& out) override;
+    
+private:
+    // output and scratch of one strip, reused across frames
+    struct Strip {
+        std::vector<uint8_t> filtered;  // filter byte + rgb per row
+        std::vector<uint8_t> chunk;     // IDAT chunk type and data
+        uint32_t crc;                   // of chunk, continued when the zlib trailer is appended
+        uint32_t adler;                 // of the filtered bytes
+    };
+    
+    void encode_strip(const ImageView& image, int strip, int first_row, int last_row, int strip_count,
+                      DeflateSegmentWriter& writer);
+    
+    DeflateMode mode;
+    ThreadPool* pool;
+    std::vector<Strip> strips;
+    std::vector<DeflateSegmentWriter> writers;  // one per worker, holds the match finder tables
+};
+
+#endif
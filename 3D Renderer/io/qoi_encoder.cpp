@@ -0,0 +1,90 @@
+// qoi_encoder.cpp
+// implementation of the qoi encoder (specification 1.0)
+
+#include "qoi_encoder.h"
+#include <cstring>
+
+namespace {
+    const uint8_t QOI_OP_INDEX = 0x00;
+    const uint8_t QOI_OP_DIFF = 0x40;
+    const uint8_t QOI_OP_LUMA = 0x80;
+    const uint8_t QOI_OP_RUN = 0xC0;
+    const uint8_t QOI_OP_RGB = 0xFE;
+    const int MAX_RUN = 62;
+    const uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    
+    uint8_t* put_be32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+        return p + 4;
+    }
+}
+
+void QoiEncoder::encode(const ImageView& image, std::vector<uint8_t>& out) {
+    // worst case: every pixel a 4-byte QOI_OP_RGB
+    out.resize(14 + (size_t)image.width * image.height * 4 + sizeof(END_MARKER));
+    uint8_t* p = out.data();
+    
+    std::memcpy(p, "qoif", 4);
+    p = put_be32(p + 4, (uint32_t)image.width);
+    p = put_be32(p, (uint32_t)image.height);
+    *p++ = 3;  // rgb
+    *p++ = 0;  // srgb with linear alpha
+    
+    // pixels are compared as packed words with alpha forced opaque
+    uint32_t index[64] = {};
+    uint32_t previous = 0xFF000000u;
+    int run = 0;
+    
+    for (int y = 0; y < image.height; y++) {
+        const uint32_t* row = image.pixels + (size_t)y * image.stride;
+        for (int x = 0; x < image.width; x++) {
+            uint32_t pixel = row[x] | 0xFF000000u;
+            if (pixel == previous) {
+                if (++run == MAX_RUN) {
+                    *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            
+            int r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF;
+            int slot = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+            if (index[slot] == pixel) {
+                *p++ = (uint8_t)(QOI_OP_INDEX | slot);
+            } else {
+                index[slot] = pixel;
+                
+                // channel differences wrap around like the decoder's 8-bit arithmetic
+                int dr = (int8_t)(r - (int)(previous & 0xFF));
+                int dg = (int8_t)(g - (int)((previous >> 8) & 0xFF));
+                int db = (int8_t)(b - (int)((previous >> 16) & 0xFF));
+                int dr_dg = dr - dg, db_dg = db - dg;
+                
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    *p++ = (uint8_t)(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    *p++ = (uint8_t)(QOI_OP_LUMA | (dg + 32));
+                    *p++ = (uint8_t)(((dr_dg + 8) << 4) | (db_dg + 8));
+                } else {
+                    *p++ = QOI_OP_RGB;
+                    *p++ = (uint8_t)r;
+                    *p++ = (uint8_t)g;
+                    *p++ = (uint8_t)b;
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+    
+    std::memcpy(p, END_MARKER, sizeof(END_MARKER));
+    p += sizeof(END_MARKER);
+    out.resize(p - out.data());
+}
@@ -0,0 +1,18 @@
+// qoi_encoder.h
+// "quite ok image" format encoder
+// single pass, lossless, typically close to png size at a fraction of the cost
+
+#ifndef QOI_ENCODER_H
+#define QOI_ENCODER_H
+
+#include "image_encoder.h"
+
+// rgb qoi (3 channels, srgb); the format is sequential, so encoding is single threaded
+class QoiEncoder : public ImageEncoder {
+public:
+    const char* name() const override { return "qoi"; }
+    const char* extension() const override { return ".qoi"; }
+    void encode(const ImageView& image, std::vector<uint8_t>& out) override;
+};
+
+#endif
@@ -3,6 +3,9 @@
 // handles different light types and their setup
 
 #include "light.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 Light::Light(LightType t, const Vec3& pos_or_dir, const Vec3& col, float intens)
     : type(t), color(col), intensity(intens) {
@@ -14,4 +17,19 @@ Light::Light(LightType t, const Vec3& pos_or_dir, const Vec3& col, float intens)
         // directional light: store normalized direction, no position needed
         direction = pos_or_dir.normalize();
     }
+    update_radius();
+}
+
+void Light::update_radius() {
+    if (type != LightType::POINT) {
+        radius = std::numeric_limits<float>::infinity();
+        return;
+    }
+    
+    // diffuse and specular each add at most intensity * color before attenuation, so the light
+    // is negligible once 2 * intensity * max(color) * attenuation(d) drops below the cutoff:
+    // solve 1 + 0.1d + 0.01d^2 = peak / cutoff for d
+    float peak = 2.0f * intensity * std::max({color.x, color.y, color.z});
+    float k = peak / LIGHT_CUTOFF;
+    radius = k <= 1.0f ? 0.0f : (-0.1f + std::sqrt(0.04f * k - 0.03f)) / 0.02f;
 }
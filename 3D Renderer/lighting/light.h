@@ -13,6 +13,15 @@ enum class LightType {
     DIRECTIONAL  // directional light like sunlight (parallel rays)
 };
 
+// point lights are treated as reaching no farther than where they add less than this to a color
+// channel, half of one 8-bit step
+constexpr float LIGHT_CUTOFF = 1.0f / 512.0f;
+
+// quadratic distance falloff of point lights
+inline float point_light_attenuation(float distance) {
+    return 1.0f / (1.0f + 0.1f * distance + 0.01f * distance * distance);
+}
+
 // light source structure for illuminating 3d scenes
 // different types have different behaviors and properties
 struct Light {
@@ -21,8 +30,12 @@ struct Light {
     Vec3 direction;     // light direction (directional lights only)
     Vec3 color;         // light color/tint
     float intensity;    // brightness multiplier
+    float radius;       // effective range, infinite for directional lights
     
     Light(LightType t, const Vec3& pos_or_dir, const Vec3& col = Vec3(1, 1, 1), float intens = 1.0f);
+    
+    // recompute radius from color and intensity, call after changing either
+    void update_radius();
 };
 
 #endif
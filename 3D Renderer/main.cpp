@@ -3,39 +3,327 @@
 // demonstrates the engine capabilities with a complete scene
 
 #include "rendering/renderer.h"
+#include "rendering/frame_pipeline.h"
+#include "io/frame_writer.h"
+#include "io/mesh_cache.h"
 #include "scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
 
-int main() {
-    std::cout << "Starting 3D Rendering Engine..." << std::endl;
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// render the scene once and report the wall-clock time in milliseconds
+static double timed_render(Scene& scene, Renderer& renderer, bool wireframe, bool flat_shading) {
+    auto start = std::chrono::steady_clock::now();
+    scene.render(renderer, wireframe, flat_shading);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// sequence mode settings
+struct AnimationSettings {
+    int frames = 0;            // 0 = render the two still images instead
+    int fps = 30;
+    int queue = 2;             // framebuffers waiting for the writer, 0 = write synchronously
+    bool stream = false;       // one y4m / raw rgb stream instead of numbered files
+    StreamFormat stream_format = StreamFormat::Y4M;
+    std::string output;        // file pattern, stream path, or "-" for stdout
+};
+
+// orbit the camera around its target, keeping the starting distance and height
+static void set_turntable_angle(Camera& camera, const Vec3& start, float angle) {
+    Vec3 offset = start - camera.target;
+    float c = std::cos(angle), s = std::sin(angle);
+    camera.position = camera.target + Vec3(offset.x * c - offset.z * s, offset.y, offset.x * s + offset.z * c);
+}
+
+// render a turntable of the scene, handing each frame to the output pipeline
+static int run_animation(Scene& scene, Renderer& renderer, const AnimationSettings& settings, bool flat_shading,
+                         std::ostream& log) {
+    std::unique_ptr<FrameWriter> writer;
+    if (settings.stream) {
+        writer = std::make_unique<VideoStreamWriter>(settings.output, settings.stream_format, settings.fps);
+    } else {
+        writer = std::make_unique<ImageSequenceWriter>(settings.output);
+    }
+    
+    log << "Rendering " << settings.frames << " frames to " << settings.output
+        << (settings.queue > 0 ? " (asynchronous, queue " + std::to_string(settings.queue) + ")" : " (synchronous)")
+        << "..." << std::endl;
+    
+    FramePipeline pipeline(renderer.get_framebuffer().get_width(), renderer.get_framebuffer().get_height(),
+                           *writer, settings.queue);
+    Vec3 start_position = scene.camera.position;
+    auto start = std::chrono::steady_clock::now();
+    double render_ms = 0.0;
+    for (int frame = 0; frame < settings.frames; frame++) {
+        set_turntable_angle(scene.camera, start_position, 2.0f * (float)M_PI * frame / settings.frames);
+        render_ms += timed_render(scene, renderer, false, flat_shading);
+        pipeline.submit(renderer);
+    }
+    pipeline.finish();
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    scene.camera.position = start_position;
+    
+    FramePipelineStats stats = pipeline.get_stats();
+    log << "\nAnimation info:" << std::endl;
+    log << "Frames: " << stats.frames << " in " << total_ms / 1000.0 << " s, "
+        << stats.frames * 1000.0 / total_ms << " fps" << std::endl;
+    log << "Render: " << render_ms / settings.frames << " ms/frame" << std::endl;
+    log << "Encode + write: " << stats.write_ms / settings.frames << " ms/frame" << std::endl;
+    log << "Pipeline stall: " << stats.stall_ms << " ms total, " << stats.stall_ms / settings.frames
+        << " ms/frame (" << 100.0 * stats.stall_ms / total_ms << "% of wall time)" << std::endl;
+    if (stats.failed) {
+        log << "Error: some frames could not be written" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // optional settings: --threads N (0 = all cores), --serial (no tile binning),
+    // --simd scalar|sse2|avx2 (cap the rasterizer's instruction set), --no-hiz (disable
+    // hierarchical z rejection), --format ppm|qoi|png (output image format),
+    // --shading flat|gouraud (per-face or interpolated per-vertex lighting), --deferred (gouraud
+    // shading: visibility buffer pass, then lighting once per visible pixel), --no-light-culling (every surface
+    // loops over every light instead of its tile's list), --lighting reference|phong|blinn (exact
+    // per-point lighting, or the 8-wide batched kernel with phong or blinn-phong highlights),
+    // --shadows (shadow maps for every light, cached while lights and objects stay put),
+    // --msaa (4x multisample anti-aliasing of the forward paths, shaded once per pixel),
+    // --compact (draw the demo meshes from their quantized encoding), --mesh PATH (an obj, ply or
+    // rmesh file in place of the demo objects on the ground plane; imports are cached as PATH.rmesh
+    // and mapped on later runs),
+    // --lod PIXELS (simplified levels of the demo meshes, drawn while their error stays below PIXELS),
+    // --trace PATH (chrome trace_event json of every frame's stages, draws and tiles, for perfetto)
+    // sequence mode: --frames N (turntable), --fps N, --output PATTERN|PATH|-,
+    // --stream y4m|rgb (single stream instead of numbered files), --queue N (0 = synchronous)
+    int threads = 0;
+    bool tiled = true;
+    std::string format = "ppm";
+    bool flat_shading = true;
+    bool deferred = false;
+    bool light_culling = true;
+    LightingMode lighting = LightingMode::REFERENCE;
+    bool shadows = false;
+    bool msaa = false;
+    bool compact = false;
+    std::string mesh_path;
+    float lod_pixels = 0.0f;
+    std::string trace_path;
+    AnimationSettings animation;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--serial") == 0) {
+            tiled = false;
+        } else if (std::strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            const char* level = argv[++i];
+            if (std::strcmp(level, "scalar") == 0) set_raster_simd_level(SimdLevel::SCALAR);
+            else if (std::strcmp(level, "sse2") == 0) set_raster_simd_level(SimdLevel::SSE2);
+            else if (std::strcmp(level, "avx2") == 0) set_raster_simd_level(SimdLevel::AVX2);
+        } else if (std::strcmp(argv[i], "--no-hiz") == 0) {
+            set_raster_hiz(false);
+        } else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (std::strcmp(argv[i], "--shading") == 0 && i + 1 < argc) {
+            flat_shading = std::strcmp(argv[++i], "gouraud") != 0;
+        } else if (std::strcmp(argv[i], "--deferred") == 0) {
+            deferred = true;
+        } else if (std::strcmp(argv[i], "--no-light-culling") == 0) {
+            light_culling = false;
+        } else if (std::strcmp(argv[i], "--lighting") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "reference") == 0) lighting = LightingMode::REFERENCE;
+            else if (std::strcmp(mode, "phong") == 0) lighting = LightingMode::BATCHED_PHONG;
+            else if (std::strcmp(mode, "blinn") == 0) lighting = LightingMode::BATCHED_BLINN_PHONG;
+        } else if (std::strcmp(argv[i], "--shadows") == 0) {
+            shadows = true;
+        } else if (std::strcmp(argv[i], "--msaa") == 0) {
+            msaa = true;
+        } else if (std::strcmp(argv[i], "--compact") == 0) {
+            compact = true;
+        } else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            mesh_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--lod") == 0 && i + 1 < argc) {
+            lod_pixels = std::max(0.0f, (float)std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            animation.frames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            animation.fps = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            animation.queue = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            animation.output = argv[++i];
+        } else if (std::strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            animation.stream = true;
+            animation.stream_format = std::strcmp(argv[++i], "rgb") == 0 ? StreamFormat::RAW_RGB : StreamFormat::Y4M;
+        }
+    }
+    if (animation.output.empty()) {
+        animation.output = animation.stream ? "-" : "frame_%04d." + format;
+    }
+    
+    // a stream on stdout must not be mixed with status messages
+    bool stdout_stream = animation.frames > 0 && animation.stream && animation.output == "-";
+    std::ostream& log = stdout_stream ? std::cerr : std::cout;
+    log << "Starting 3D Rendering Engine..." << std::endl;
     
     // create renderer with specified resolution
     const int width = 800, height = 600;
     Renderer renderer(width, height);
+    renderer.set_thread_count(threads);
+    renderer.set_tiled(tiled);
+    renderer.set_deferred(deferred);
+    renderer.set_light_culling(light_culling);
+    renderer.set_lighting_mode(lighting);
+    renderer.set_shadow_mapping(shadows);
+    renderer.set_multisampling(msaa);
     
     // create and setup demo scene
     Scene scene;
+    if (!mesh_path.empty()) {
+        // load before the first frame, on the renderer's threads while they are idle
+        auto start = std::chrono::steady_clock::now();
+        MappedMesh mesh;
+        bool cache_hit = false;
+        if (!load_mesh_cached(mesh_path, mesh, &renderer.get_thread_pool(), &cache_hit)) return 1;
+        double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        log << "Mesh: " << mesh_path << ", " << mesh.triangle_count() << " triangles, "
+            << (cache_hit ? "mapped from cache" : "imported and cached") << " in " << load_ms << " ms" << std::endl;
+        
+        // centered above the ground plane (the demo scene's third mesh) and scaled to its radius
+        const BoundingSphere& sphere = mesh.get_bounding_sphere();
+        float scale = sphere.radius > 0.0f ? 1.5f / sphere.radius : 1.0f;
+        mesh.material = scene.meshes[1].material;
+        mesh.transform = Mat4::translation(Vec3(0, 0.5f, 0)) * Mat4::scale(Vec3(scale, scale, scale)) *
+                         Mat4::translation(Vec3(0, 0, 0) - sphere.center);
+        Mesh plane = scene.meshes[2];
+        scene.meshes.assign(1, plane);
+        scene.add_mapped_mesh(std::move(mesh));
+    }
+    if (compact) {
+        for (const Mesh& mesh : scene.meshes) scene.add_compact_mesh(CompactMesh::encode(mesh));
+        scene.meshes.clear();
+    }
+    if (lod_pixels > 0.0f) {
+        scene.generate_lods();
+        scene.set_lod_error(lod_pixels);
+    }
+    if (!trace_path.empty()) renderer.get_profiler().start_trace();
+    if (animation.frames > 0) {
+        int result = run_animation(scene, renderer, animation, flat_shading, log);
+        if (!trace_path.empty()) {
+            if (!renderer.get_profiler().write_trace(trace_path)) return 1;
+            log << "Trace: " << trace_path << std::endl;
+        }
+        return result;
+    }
     
     // render scene in solid shading mode
     std::cout << "Rendering solid scene..." << std::endl;
-    scene.render(renderer, false);
-    renderer.save_image("render_solid.ppm");
+    std::string solid_file = "render_solid." + format;
+    std::string wireframe_file = "render_wireframe." + format;
+    double solid_ms = timed_render(scene, renderer, false, flat_shading);
+    RasterStats solid_stats = renderer.get_raster_stats();
+    ShadingStats solid_shading = renderer.get_shading_stats();
+    GeometryStats solid_geometry = renderer.get_geometry_stats();
+    CullStats solid_culling = scene.get_cull_stats();
+    LodStats solid_lod = scene.get_lod_stats();
+    ShadowStats solid_shadows = renderer.get_shadow_stats();
+    const LightGrid* light_grid = renderer.get_light_grid();
+    double tile_lights = light_grid ? light_grid->average_tile_lights() : 0.0;
+    renderer.save_image(solid_file);
+    FrameStats solid_frame = renderer.get_frame_stats();  // after saving, so encoding is included
     
     // render scene in wireframe mode for comparison
     std::cout << "Rendering wireframe scene..." << std::endl;
-    scene.render(renderer, true);
-    renderer.save_image("render_wireframe.ppm");
+    double wireframe_ms = timed_render(scene, renderer, true, flat_shading);
+    renderer.save_image(wireframe_file);
     
     std::cout << "Rendering complete!" << std::endl;
     std::cout << "Output files:" << std::endl;
-    std::cout << "- render_solid.ppm (phong shaded)" << std::endl;
-    std::cout << "- render_wireframe.ppm (wireframe)" << std::endl;
+    std::cout << "- " << solid_file << " ("
+              << (lighting == LightingMode::BATCHED_BLINN_PHONG ? "blinn-phong" : "phong") << " shaded, "
+              << (flat_shading ? "flat" : "gouraud")
+              << (deferred ? ", deferred" : "") << (shadows ? ", shadowed" : "")
+              << (msaa && !deferred ? ", 4x msaa" : "") << ")" << std::endl;
+    std::cout << "- " << wireframe_file << " (wireframe)" << std::endl;
     
     // display render statistics
     std::cout << "\nRender info:" << std::endl;
     std::cout << "Resolution: " << width << "x" << height << std::endl;
-    std::cout << "Objects: " << scene.get_mesh_count() << std::endl;
+    std::cout << "Objects: " << scene.get_mesh_count() + scene.get_compact_mesh_count() + scene.get_mapped_mesh_count()
+              << (compact ? " (compact)" : "") << std::endl;
     std::cout << "Lights: " << scene.get_light_count() << std::endl;
+    std::cout << "Rasterizer: " << (renderer.is_tiled() ? "tiled" : "serial")
+              << ", " << renderer.get_thread_count() << " thread(s), "
+              << simd_level_name(get_raster_simd_level()) << std::endl;
+    std::cout << "Frustum culling: " << solid_culling.objects_culled << "/" << solid_culling.objects
+              << " objects culled" << std::endl;
+    if (lod_pixels > 0.0f) {
+        std::cout << "Level of detail: " << solid_lod.reduced << "/" << solid_lod.meshes << " meshes reduced, "
+                  << solid_lod.drawn_triangles << "/" << solid_lod.full_triangles << " triangles drawn" << std::endl;
+    }
+    std::cout << "Clipping: " << solid_geometry.triangles_rejected << "/" << solid_geometry.triangles_submitted
+              << " triangles rejected, " << solid_geometry.triangles_clipped << " clipped" << std::endl;
+    std::cout << "Hierarchical z: " << (get_raster_hiz() ? "on" : "off") << ", rejected "
+              << solid_stats.triangles_rejected << "/" << solid_stats.triangles_tested << " triangles, "
+              << solid_stats.blocks_rejected << "/" << solid_stats.blocks_tested << " blocks" << std::endl;
+    std::cout << "Lighting evaluations: " << solid_shading.lighting_evaluations << " ("
+              << (flat_shading ? "per visible triangle" : deferred ? "per visible pixel" : "per vertex") << ")" << std::endl;
+    std::cout << "Light culling: ";
+    if (light_grid) {
+        std::cout << "avg " << tile_lights << " of " << scene.get_light_count() << " lights per tile" << std::endl;
+    } else {
+        std::cout << "off" << std::endl;
+    }
+    if (shadows) {
+        std::cout << "Shadows: " << solid_shadows.faces_rendered << " map faces rendered, " << solid_shadows.faces_cached
+                  << " cached, " << solid_shadows.triangles_drawn << " triangles, " << solid_shadows.update_ms << " ms"
+                  << std::endl;
+    }
+    std::cout << "Fragments written: " << solid_stats.fragments_written;
+    if (deferred && solid_shading.pixels_shaded > 0) {
+        std::cout << ", pixels shaded: " << solid_shading.pixels_shaded << " (overdraw "
+                  << (double)solid_stats.fragments_written / solid_shading.pixels_shaded << "x)";
+    }
+    std::cout << std::endl;
+    std::cout << "Triangles: " << solid_frame.triangles_submitted << " submitted, " << solid_frame.triangles_culled
+              << " culled, " << solid_frame.triangles_rasterized << " rasterized" << std::endl;
+    std::cout << "Pixels: ";
+#if RENDER_PROFILING
+    std::cout << solid_frame.pixels_tested << " tested, ";
+#endif
+    std::cout << solid_frame.pixels_depth_passed << " depth passed, " << solid_frame.pixels_overdrawn
+              << " overdrawn" << std::endl;
+    std::cout << "Solid frame: " << solid_ms << " ms" << std::endl;
+#if RENDER_PROFILING
+    std::cout << "Stages:";
+    const char* separator = " ";
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        if (solid_frame.times.stage_calls[stage] == 0) continue;
+        std::cout << separator << profile_stage_name((ProfileStage)stage) << " " << solid_frame.times.stage_ms[stage]
+                  << " ms";
+        separator = ", ";
+    }
+    std::cout << std::endl;
+#endif
+    std::cout << "Wireframe frame: " << wireframe_ms << " ms" << std::endl;
     
+    if (!trace_path.empty()) {
+        if (!renderer.get_profiler().write_trace(trace_path)) return 1;
+        std::cout << "Trace: " << trace_path << std::endl;
+    }
     return 0;
 }
@@ -1,7 +1,7 @@
 // vec3.h
 // basic 3d vector math operations
 // handles positions, directions, normals, and colors in 3d space
-// provides all essential vector operations needed for 3d graphics
+// header-only so every operation inlines into the raster, vertex and lighting loops
 
 #ifndef VEC3_H
 #define VEC3_H
@@ -11,21 +11,37 @@
 struct Vec3 {
     float x, y, z;
     
-    Vec3(float x = 0, float y = 0, float z = 0);
+    constexpr Vec3(float x = 0, float y = 0, float z = 0) : x(x), y(y), z(z) {}
     
     // vector arithmetic operations
-    Vec3 operator+(const Vec3& other) const;
-    Vec3 operator-(const Vec3& other) const;
-    Vec3 operator*(float scalar) const;
-    Vec3 operator*(const Vec3& other) const;  // element-wise multiplication for colors
-    Vec3 operator/(float scalar) const;
+    constexpr Vec3 operator+(const Vec3& other) const { return Vec3(x + other.x, y + other.y, z + other.z); }
+    constexpr Vec3 operator-(const Vec3& other) const { return Vec3(x - other.x, y - other.y, z - other.z); }
+    constexpr Vec3 operator*(float scalar) const { return Vec3(x * scalar, y * scalar, z * scalar); }
+    constexpr Vec3 operator/(float scalar) const { return Vec3(x / scalar, y / scalar, z / scalar); }
+    
+    // element-wise multiplication for colors
+    constexpr Vec3 operator*(const Vec3& other) const { return Vec3(x * other.x, y * other.y, z * other.z); }
     
     // essential vector operations for 3d graphics
-    float dot(const Vec3& other) const;      // measures alignment between vectors
-    Vec3 cross(const Vec3& other) const;     // perpendicular vector for normals
-    float length() const;                    // vector magnitude
-    Vec3 normalize() const;                  // convert to unit vector
-    Vec3 reflect(const Vec3& normal) const;  // reflect across surface normal
+    // dot product - measures how aligned two vectors are, used for lighting and projections
+    constexpr float dot(const Vec3& other) const { return x * other.x + y * other.y + z * other.z; }
+    
+    // cross product - perpendicular vector, essential for calculating surface normals
+    constexpr Vec3 cross(const Vec3& other) const {
+        return Vec3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    }
+    
+    float length() const { return std::sqrt(x * x + y * y + z * z); }  // vector magnitude
+    
+    // convert to unit vector (length = 1); the zero vector stays zero
+    Vec3 normalize() const {
+        float len = length();
+        if (len > 0) return *this / len;
+        return Vec3(0, 0, 0);
+    }
+    
+    // reflect across a surface normal, used for specular lighting
+    constexpr Vec3 reflect(const Vec3& normal) const { return *this - normal * 2.0f * this->dot(normal); }
 };
 
 #endif
@@ -7,6 +7,7 @@
 
 #include "Vec3.h"
 #include <algorithm>
+#include <cstdint>
 
 // utility functions for color operations
 namespace Color {
@@ -27,6 +28,14 @@ namespace Color {
         b = (unsigned char)(clamped.z * 255);
     }
     
+    // pack a color into one 32-bit word holding bytes r, g, b, a in memory order
+    // lets raster loops write a whole pixel color with a single store
+    inline uint32_t to_packed(const Vec3& color) {
+        unsigned char r, g, b;
+        to_bytes(color, r, g, b);
+        return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | (0xFFu << 24);
+    }
+    
     // common color constants
     const Vec3 BLACK(0, 0, 0);
     const Vec3 WHITE(1, 1, 1);
@@ -1,32 +1,160 @@
 // mat4.h
 // 4x4 transformation matrix operations
 // handles rotation, translation, scaling, and projection transformations
-// core of the 3d graphics transformation pipeline
+// core of the 3d graphics transformation pipeline, header-only so it inlines into every caller
 
 #ifndef MAT4_H
 #define MAT4_H
 
 #include "Vec3.h"
+#include "vec4.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RENDER_HAS_SSE_MATH 1
+#else
+#define RENDER_HAS_SSE_MATH 0
+#endif
 
 struct Mat4 {
-    float m[16];  // stored in column-major order for opengl compatibility
+    // row-major: m[row * 4 + column], points are columns on the right (translation in m[3], m[7], m[11])
+    float m[16];
     
-    Mat4();  // initialize as identity matrix
-    Mat4(float values[16]);
+    // initialize as identity matrix (no transformation)
+    constexpr Mat4() : m{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1} {}
+    constexpr Mat4(const float values[16]) : m{} {
+        for (int i = 0; i < 16; i++) m[i] = values[i];
+    }
     
-    // matrix operations
-    Mat4 operator*(const Mat4& other) const;  // combine transformations
+    // combine transformations: this * other applies 'other' first, then 'this'
+    // each row is summed over k in order, so the sse path matches constant evaluation bit for bit
+    constexpr Mat4 operator*(const Mat4& other) const {
+#if RENDER_HAS_SSE_MATH && (defined(__GNUC__) || defined(__clang__))
+        if (!__builtin_is_constant_evaluated()) return multiply_sse(other);
+#endif
+        Mat4 result;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                float sum = 0;
+                for (int k = 0; k < 4; k++) sum += m[i * 4 + k] * other.m[k * 4 + j];
+                result.m[i * 4 + j] = sum;
+            }
+        }
+        return result;
+    }
     
     // transform 3d vectors through the matrix
-    Vec3 transform_point(const Vec3& point) const;      // includes translation
-    Vec3 transform_direction(const Vec3& dir) const;    // no translation for normals
+    // includes translation and the perspective divide for projection matrices
+    constexpr Vec3 transform_point(const Vec3& point) const {
+        return transform(Vec4(point, 1.0f)).project();
+    }
+    
+    // no translation, for normals and directions
+    constexpr Vec3 transform_direction(const Vec3& dir) const {
+        return Vec3(m[0] * dir.x + m[1] * dir.y + m[2] * dir.z,
+                    m[4] * dir.x + m[5] * dir.y + m[6] * dir.z,
+                    m[8] * dir.x + m[9] * dir.y + m[10] * dir.z);
+    }
+    
+    // full homogeneous transform, no divide
+    constexpr Vec4 transform(const Vec4& v) const {
+        return Vec4(m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w,
+                    m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7] * v.w,
+                    m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11] * v.w,
+                    m[12] * v.x + m[13] * v.y + m[14] * v.z + m[15] * v.w);
+    }
     
     // factory methods for common transformations
-    static Mat4 translation(const Vec3& t);                                    // move objects
-    static Mat4 rotation_y(float angle);                                       // rotate around y-axis
-    static Mat4 scale(const Vec3& s);                                         // resize objects
-    static Mat4 perspective(float fov, float aspect, float near, float far);  // perspective projection
-    static Mat4 look_at(const Vec3& eye, const Vec3& target, const Vec3& up); // camera view matrix
+    static constexpr Mat4 translation(const Vec3& t) {
+        Mat4 result;
+        result.m[3] = t.x;
+        result.m[7] = t.y;
+        result.m[11] = t.z;
+        return result;
+    }
+    
+    static constexpr Mat4 scale(const Vec3& s) {
+        Mat4 result;
+        result.m[0] = s.x;
+        result.m[5] = s.y;
+        result.m[10] = s.z;
+        return result;
+    }
+    
+    // rotate around the y-axis (vertical rotation)
+    static Mat4 rotation_y(float angle) {
+        Mat4 result;
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+        result.m[0] = c; result.m[2] = s;
+        result.m[8] = -s; result.m[10] = c;
+        return result;
+    }
+    
+    // perspective projection to opengl-style clip space, w = -z_view
+    static Mat4 perspective(float fov, float aspect, float near, float far) {
+        Mat4 result;
+        float tan_half_fov = std::tan(fov / 2.0f);
+        result.m[0] = 1.0f / (aspect * tan_half_fov);
+        result.m[5] = 1.0f / tan_half_fov;
+        result.m[10] = -(far + near) / (far - near);
+        result.m[11] = -(2.0f * far * near) / (far - near);
+        result.m[14] = -1.0f;
+        result.m[15] = 0.0f;
+        return result;
+    }
+    
+    // orthographic projection of the view-space box to opengl-style clip space, w = 1
+    static constexpr Mat4 orthographic(float left, float right, float bottom, float top, float near, float far) {
+        Mat4 result;
+        result.m[0] = 2.0f / (right - left);
+        result.m[3] = -(right + left) / (right - left);
+        result.m[5] = 2.0f / (top - bottom);
+        result.m[7] = -(top + bottom) / (top - bottom);
+        result.m[10] = -2.0f / (far - near);
+        result.m[11] = -(far + near) / (far - near);
+        return result;
+    }
+    
+    // camera view matrix looking down -z
+    static Mat4 look_at(const Vec3& eye, const Vec3& target, const Vec3& up) {
+        Vec3 forward = (target - eye).normalize();
+        Vec3 right = forward.cross(up).normalize();
+        Vec3 camera_up = right.cross(forward);
+        
+        Mat4 result;
+        result.m[0] = right.x;    result.m[1] = right.y;    result.m[2] = right.z;
+        result.m[4] = camera_up.x; result.m[5] = camera_up.y; result.m[6] = camera_up.z;
+        result.m[8] = -forward.x; result.m[9] = -forward.y; result.m[10] = -forward.z;
+        result.m[3] = -right.dot(eye);
+        result.m[7] = -camera_up.dot(eye);
+        result.m[11] = forward.dot(eye);
+        return result;
+    }
+    
+private:
+#if RENDER_HAS_SSE_MATH
+    // a result row is the rows of other weighted by this row's entries, one broadcast multiply-add
+    // each; written out so the rows stay in registers and the result is stored once
+    Mat4 multiply_sse(const Mat4& other) const {
+        const __m128 r0 = _mm_loadu_ps(other.m), r1 = _mm_loadu_ps(other.m + 4);
+        const __m128 r2 = _mm_loadu_ps(other.m + 8), r3 = _mm_loadu_ps(other.m + 12);
+        auto row = [&](const float* a) {
+            __m128 sum = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(_mm_set1_ps(a[0]), r0));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[1]), r1));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[2]), r2));
+            return _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[3]), r3));
+        };
+        __m128 s0 = row(m), s1 = row(m + 4), s2 = row(m + 8), s3 = row(m + 12);
+        Mat4 result;
+        _mm_storeu_ps(result.m, s0);
+        _mm_storeu_ps(result.m + 4, s1);
+        _mm_storeu_ps(result.m + 8, s2);
+        _mm_storeu_ps(result.m + 12, s3);
+        return result;
+    }
+#endif
 };
 
 #endif
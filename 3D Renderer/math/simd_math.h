@@ -0,0 +1,94 @@
+// simd_math.h
+// batched sse point transforms and normalization over arrays of Vec3; single matrix products
+// already take Mat4's sse path. builds without sse run the same operations on plain floats
+
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include "mat4.h"
+#include <algorithm>
+#include <cstddef>
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "the batched functions read Vec3 arrays as packed floats");
+
+#if RENDER_HAS_SSE_MATH
+// four packed x y z triples in and out of one register per coordinate
+inline void load_xyz4(const Vec3* in, __m128& x, __m128& y, __m128& z) {
+    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    const float* source = &in->x;
+    __m128 a = _mm_loadu_ps(source), b = _mm_loadu_ps(source + 4), c = _mm_loadu_ps(source + 8);
+    x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                       _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                       _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+inline void store_xyz4(Vec3* out, __m128 x, __m128 y, __m128 z) {
+    float* target = &out->x;
+    _mm_storeu_ps(target, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                         _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(target + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                             _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(target + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                             _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+#endif
+
+// out[i] = matrix.transform_point(in[i]) for count points, four at a time; in and out may be the
+// same array. lanes use transform_point's float operations, so results match it bit for bit
+inline void transform_points(const Mat4& matrix, const Vec3* in, Vec3* out, size_t count) {
+    size_t i = 0;
+#if RENDER_HAS_SSE_MATH
+    const float* m = matrix.m;
+    auto row = [&](int r, __m128 x, __m128 y, __m128 z) {
+        __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[r * 4]), x), _mm_mul_ps(_mm_set1_ps(m[r * 4 + 1]), y));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m[r * 4 + 2]), z));
+        return _mm_add_ps(sum, _mm_set1_ps(m[r * 4 + 3]));
+    };
+    for (; i + 4 <= count; i += 4) {
+        __m128 x, y, z;
+        load_xyz4(in + i, x, y, z);
+        __m128 tx = row(0, x, y, z), ty = row(1, x, y, z), tz = row(2, x, y, z), tw = row(3, x, y, z);
+        
+        // perspective divide where w is nonzero, as transform_point does
+        __m128 divide = _mm_cmpneq_ps(tw, _mm_setzero_ps());
+        tx = _mm_or_ps(_mm_and_ps(divide, _mm_div_ps(tx, tw)), _mm_andnot_ps(divide, tx));
+        ty = _mm_or_ps(_mm_and_ps(divide, _mm_div_ps(ty, tw)), _mm_andnot_ps(divide, ty));
+        tz = _mm_or_ps(_mm_and_ps(divide, _mm_div_ps(tz, tw)), _mm_andnot_ps(divide, tz));
+        store_xyz4(out + i, tx, ty, tz);
+    }
+#endif
+    for (; i < count; i++) out[i] = matrix.transform_point(in[i]);
+}
+
+// out[i] = in[i] scaled to unit length for count vectors, four at a time from the hardware
+// reciprocal square root estimate and one newton step, within 4 units in the last place of
+// Vec3::normalize; zero stays zero and in and out may be the same array. the last few go through
+// a padded group, so every vector gets the same result wherever it sits in the array
+inline void normalize_vectors(const Vec3* in, Vec3* out, size_t count) {
+#if RENDER_HAS_SSE_MATH
+    const __m128 half = _mm_set1_ps(0.5f), three_halves = _mm_set1_ps(1.5f), zero = _mm_setzero_ps();
+    auto normalize4 = [&](const Vec3* source, Vec3* target) {
+        __m128 x, y, z;
+        load_xyz4(source, x, y, z);
+        __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 r = _mm_rsqrt_ps(length_squared);
+        r = _mm_mul_ps(r, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, length_squared), _mm_mul_ps(r, r))));
+        r = _mm_and_ps(r, _mm_cmpgt_ps(length_squared, zero));
+        store_xyz4(target, _mm_mul_ps(x, r), _mm_mul_ps(y, r), _mm_mul_ps(z, r));
+    };
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) normalize4(in + i, out + i);
+    if (i < count) {
+        Vec3 group[4];
+        std::copy(in + i, in + count, group);
+        normalize4(group, group);
+        std::copy(group, group + (count - i), out + i);
+    }
+#else
+    for (size_t i = 0; i < count; i++) out[i] = in[i].normalize();
+#endif
+}
+
+#endif
@@ -0,0 +1,34 @@
+// vec4.h
+// homogeneous 4d vector for clip-space positions and points with an explicit w
+// header-only and constexpr like Vec3
+
+#ifndef VEC4_H
+#define VEC4_H
+
+#include "Vec3.h"
+
+struct Vec4 {
+    float x, y, z, w;
+    
+    constexpr Vec4(float x = 0, float y = 0, float z = 0, float w = 0) : x(x), y(y), z(z), w(w) {}
+    constexpr Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+    
+    constexpr Vec4 operator+(const Vec4& other) const {
+        return Vec4(x + other.x, y + other.y, z + other.z, w + other.w);
+    }
+    constexpr Vec4 operator-(const Vec4& other) const {
+        return Vec4(x - other.x, y - other.y, z - other.z, w - other.w);
+    }
+    constexpr Vec4 operator*(float scalar) const { return Vec4(x * scalar, y * scalar, z * scalar, w * scalar); }
+    constexpr Vec4 operator*(const Vec4& other) const {
+        return Vec4(x * other.x, y * other.y, z * other.z, w * other.w);
+    }
+    constexpr float dot(const Vec4& other) const { return x * other.x + y * other.y + z * other.z + w * other.w; }
+    
+    constexpr Vec3 xyz() const { return Vec3(x, y, z); }
+    
+    // perspective divide; a zero w leaves the point as it is, like Mat4::transform_point
+    constexpr Vec3 project() const { return w != 0 ? Vec3(x / w, y / w, z / w) : Vec3(x, y, z); }
+};
+
+#endif
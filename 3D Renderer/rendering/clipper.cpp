@@ -0,0 +1,61 @@
+// clipper.cpp
+// sutherland-hodgman clipping in homogeneous clip space
+// edges are always cut from their inside end, so triangles sharing an edge get the same new vertex
+
+#include "clipper.h"
+#include "screen_projection.h"
+#include <utility>
+
+namespace {
+    // point at parameter t from a towards b; every attribute is linear in clip space
+    ScreenVertex lerp_vertex(const ScreenVertex& a, const ScreenVertex& b, float t, bool with_normals) {
+        ScreenVertex v;
+        for (int k = 0; k < 4; k++) v.clip[k] = a.clip[k] + (b.clip[k] - a.clip[k]) * t;
+        v.world = a.world + (b.world - a.world) * t;
+        v.normal = with_normals ? (a.normal + (b.normal - a.normal) * t).normalize() : a.normal;
+        v.color = a.color + (b.color - a.color) * t;
+        v.clip_code = 0;
+        return v;
+    }
+}
+
+int clip_triangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                  int width, int height, bool with_normals, ScreenVertex out[MAX_CLIP_VERTICES]) {
+    ScreenVertex scratch[MAX_CLIP_VERTICES];
+    ScreenVertex* polygon = out;
+    ScreenVertex* next = scratch;
+    polygon[0] = v0;
+    polygon[1] = v1;
+    polygon[2] = v2;
+    int count = 3;
+    
+    // near plane first: after it every vertex has w > 0, so the guard planes see sane positions
+    uint32_t planes = (v0.clip_code | v1.clip_code | v2.clip_code) & CLIP_CUT;
+    for (uint32_t bit = CLIP_NEAR; planes != 0; bit <<= 1) {
+        if (!(planes & bit)) continue;
+        planes &= ~bit;
+        
+        ClipCode plane = (ClipCode)bit;
+        int next_count = 0;
+        for (int i = 0; i < count; i++) {
+            const ScreenVertex& a = polygon[i];
+            const ScreenVertex& b = polygon[(i + 1) % count];
+            float da = clip_plane_distance(plane, a.clip);
+            float db = clip_plane_distance(plane, b.clip);
+            if (da >= 0.0f) next[next_count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                next[next_count++] = da >= 0.0f ? lerp_vertex(a, b, da / (da - db), with_normals)
+                                                : lerp_vertex(b, a, db / (db - da), with_normals);
+            }
+        }
+        std::swap(polygon, next);
+        count = next_count;
+        if (count < 3) return 0;
+    }
+    
+    if (polygon != out) {
+        for (int i = 0; i < count; i++) out[i] = polygon[i];
+    }
+    for (int i = 0; i < count; i++) clip_to_screen(out[i].clip, width, height, out[i].position, out[i].inv_w);
+    return count;
+}
@@ -0,0 +1,71 @@
+// clipper.h
+// homogeneous clipping of triangles against the near plane and a guard band
+// triangles inside the guard band are left whole; the rasterizer clamps them to the viewport
+
+#ifndef CLIPPER_H
+#define CLIPPER_H
+
+#include "vertex_transform.h"
+#include <cstdint>
+
+// the guard band spans this many half viewports on each side of the center; vertices inside it
+// land well within the rasterizer's fixed-point range, so only triangles leaving it need cutting
+constexpr float GUARD_BAND = 8.0f;
+
+// outcode bits of a clip-space position, set when the plane's distance below is negative
+enum ClipCode : uint32_t {
+    CLIP_LEFT = 1u << 0,           // x + w
+    CLIP_RIGHT = 1u << 1,          // w - x
+    CLIP_BOTTOM = 1u << 2,         // y + w
+    CLIP_TOP = 1u << 3,            // w - y
+    CLIP_NEAR = 1u << 4,           // z + w
+    CLIP_FAR = 1u << 5,            // w - z
+    CLIP_GUARD_LEFT = 1u << 6,     // x + GUARD_BAND * w
+    CLIP_GUARD_RIGHT = 1u << 7,    // GUARD_BAND * w - x
+    CLIP_GUARD_BOTTOM = 1u << 8,   // y + GUARD_BAND * w
+    CLIP_GUARD_TOP = 1u << 9       // GUARD_BAND * w - y
+};
+
+// a triangle with all vertices outside one of these planes is invisible
+constexpr uint32_t CLIP_FRUSTUM = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR;
+
+// planes clip_triangle cuts against, when at least one vertex is outside them
+constexpr uint32_t CLIP_CUT = CLIP_NEAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP;
+
+// a triangle cut by the near plane and all four guard planes gains one vertex per plane
+constexpr int MAX_CLIP_VERTICES = 8;
+
+// signed distance of a clip-space position to one plane, inside when not negative
+// the vertex stage computes its outcodes with these same float operations
+inline float clip_plane_distance(ClipCode plane, const float clip[4]) {
+    switch (plane) {
+    case CLIP_LEFT: return clip[0] + clip[3];
+    case CLIP_RIGHT: return clip[3] - clip[0];
+    case CLIP_BOTTOM: return clip[1] + clip[3];
+    case CLIP_TOP: return clip[3] - clip[1];
+    case CLIP_NEAR: return clip[2] + clip[3];
+    case CLIP_FAR: return clip[3] - clip[2];
+    case CLIP_GUARD_LEFT: return clip[0] + GUARD_BAND * clip[3];
+    case CLIP_GUARD_RIGHT: return GUARD_BAND * clip[3] - clip[0];
+    case CLIP_GUARD_BOTTOM: return clip[1] + GUARD_BAND * clip[3];
+    default: return GUARD_BAND * clip[3] - clip[1];
+    }
+}
+
+// outcode of a clip-space position
+inline uint32_t clip_code(const float clip[4]) {
+    uint32_t code = 0;
+    for (uint32_t bit = CLIP_LEFT; bit <= CLIP_GUARD_TOP; bit <<= 1) {
+        if (clip_plane_distance((ClipCode)bit, clip) < 0.0f) code |= bit;
+    }
+    return code;
+}
+
+// cut a triangle by every CLIP_CUT plane one of its vertices is outside of; out receives the
+// remaining convex polygon in the triangle's winding, with screen positions for the viewport and
+// world positions, normals (renormalized when with_normals is set) and colors interpolated in
+// clip space; returns the vertex count, less than 3 when nothing is left
+int clip_triangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                  int width, int height, bool with_normals, ScreenVertex out[MAX_CLIP_VERTICES]);
+
+#endif
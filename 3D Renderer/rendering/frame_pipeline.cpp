@@ -0,0 +1,93 @@
+// frame_pipeline.cpp
+// implementation of the asynchronous frame output queue
+
+#include "frame_pipeline.h"
+#include <chrono>
+
+namespace {
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+FramePipeline::FramePipeline(int width, int height, FrameWriter& w, int depth)
+    : writer(w), closing(false), next_index(0) {
+    for (int i = 0; i < depth; i++) {
+        buffers.push_back(std::make_unique<Framebuffer>(width, height));
+        free_buffers.push_back(buffers.back().get());
+    }
+    if (depth > 0) worker = std::thread(&FramePipeline::writer_loop, this);
+}
+
+FramePipeline::~FramePipeline() {
+    finish();
+}
+
+void FramePipeline::submit(Renderer& renderer) {
+    auto start = std::chrono::steady_clock::now();
+    
+    // synchronous mode: the render thread encodes and writes the frame itself
+    if (buffers.empty()) {
+        renderer.flush();
+        bool ok = writer.write_frame(renderer.get_framebuffer().get_image(), next_index++);
+        double ms = elapsed_ms(start);
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.frames++;
+        stats.stall_ms += ms;
+        stats.write_ms += ms;
+        stats.failed |= !ok;
+        return;
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    buffer_freed.wait(lock, [this] { return !free_buffers.empty(); });
+    Framebuffer* spare = free_buffers.front();
+    free_buffers.pop_front();
+    stats.stall_ms += elapsed_ms(start);
+    lock.unlock();
+    
+    // the finished frame moves into the spare's slot, the renderer continues on the spare
+    renderer.swap_framebuffer(*spare);
+    
+    lock.lock();
+    queued_frames.push_back(spare);
+    lock.unlock();
+    frame_queued.notify_one();
+}
+
+void FramePipeline::writer_loop() {
+    int index = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        frame_queued.wait(lock, [this] { return closing || !queued_frames.empty(); });
+        if (queued_frames.empty()) break;  // closing and drained
+        Framebuffer* frame = queued_frames.front();
+        queued_frames.pop_front();
+        lock.unlock();
+        
+        auto start = std::chrono::steady_clock::now();
+        bool ok = writer.write_frame(frame->get_image(), index++);
+        double ms = elapsed_ms(start);
+        
+        lock.lock();
+        stats.frames++;
+        stats.write_ms += ms;
+        stats.failed |= !ok;
+        free_buffers.push_back(frame);
+        buffer_freed.notify_one();
+    }
+}
+
+void FramePipeline::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    frame_queued.notify_one();
+    if (worker.joinable()) worker.join();
+}
+
+FramePipelineStats FramePipeline::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,63 @@
+// frame_pipeline.h
+// asynchronous output for frame sequences
+// frame n is encoded and written on a background thread while frame n+1 renders
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include "framebuffer.h"
+#include "renderer.h"
+#include "../io/frame_writer.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// timing of a finished or running pipeline
+struct FramePipelineStats {
+    int frames = 0;           // frames handed to the writer
+    double stall_ms = 0.0;    // render thread blocked on output (waiting for a free framebuffer)
+    double write_ms = 0.0;    // encode and write time on the writer side
+    bool failed = false;      // the writer reported an error
+};
+
+// bounded queue of reusable framebuffers between the renderer and a frame writer
+// submit() swaps the finished frame out of the renderer for a free framebuffer, so nothing
+// is copied; once every spare framebuffer is queued, submit() waits for the writer
+class FramePipeline {
+public:
+    // depth = frames that may wait for the writer; 0 writes synchronously inside submit()
+    FramePipeline(int width, int height, FrameWriter& writer, int depth = 2);
+    ~FramePipeline();  // finish()
+    
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+    
+    // hand over the frame the renderer just finished; the renderer keeps a stale framebuffer
+    // of the same size to clear and draw the next frame into
+    void submit(Renderer& renderer);
+    
+    // wait until every submitted frame is written and stop the writer thread
+    void finish();
+    
+    FramePipelineStats get_stats();
+    
+private:
+    void writer_loop();
+    
+    FrameWriter& writer;
+    std::vector<std::unique_ptr<Framebuffer>> buffers;
+    std::deque<Framebuffer*> free_buffers;    // ready to be swapped into the renderer
+    std::deque<Framebuffer*> queued_frames;   // waiting for the writer, in submission order
+    std::mutex mutex;
+    std::condition_variable buffer_freed;
+    std::condition_variable frame_queued;
+    std::thread worker;
+    bool closing;
+    int next_index;
+    FramePipelineStats stats;  // guarded by mutex
+};
+
+#endif
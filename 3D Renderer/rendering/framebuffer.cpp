@@ -3,66 +3,236 @@
 // handles pixel management and depth testing
 
 #include "framebuffer.h"
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 
-Pixel::Pixel() : r(0), g(0), b(0), depth(1.0f) {}
-
-void Pixel::set_color(const Vec3& color) {
-    // convert floating point color values to byte range with clamping
-    Color::to_bytes(color, r, g, b);
+namespace {
+    // rows are padded to a multiple of 16 pixels, one cache line of colors or depths
+    const int ROW_ALIGNMENT = (int)(CACHE_LINE / sizeof(float));
+    
+    Vec3 unpack_color(uint32_t packed) {
+        return Vec3((packed & 0xFF) / 255.0f, ((packed >> 8) & 0xFF) / 255.0f, ((packed >> 16) & 0xFF) / 255.0f);
+    }
 }
 
 Framebuffer::Framebuffer(int w, int h) : width(w), height(h) {
-    pixels.resize(width * height);
+    stride = (width + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    color_plane.reset((size_t)stride * height);
+    depth_plane.reset((size_t)stride * height);
+    tile_pending.assign(tiles_x * tiles_y, 1);
+    clear_color = Color::to_packed(Vec3(0, 0, 0));
+    blocks_x = (width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    blocks_y = (height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+    block_max_depth.assign((size_t)blocks_x * blocks_y, 1.0f);
 }
 
 void Framebuffer::clear(const Vec3& color) {
-    // clear entire framebuffer to solid color and reset depth buffer
-    for (auto& pixel : pixels) {
-        pixel.set_color(color);
-        pixel.depth = 1.0f;  // far plane in normalized device coordinates
+    // convert the clear color once and defer the per-pixel fill to the first write of each tile
+    clear_color = Color::to_packed(color);
+    std::fill(tile_pending.begin(), tile_pending.end(), 1);
+}
+
+void Framebuffer::fill_tile(int tile) {
+    int tx = tile % tiles_x, ty = tile / tiles_x;
+    int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+    int y1 = std::min(y0 + TILE_SIZE, height);
+    
+    // the last tile column also owns the row padding, keeping simd spans past the edge defined
+    int x1 = (tx == tiles_x - 1) ? stride : x0 + TILE_SIZE;
+    
+    for (int y = y0; y < y1; y++) {
+        std::fill(get_color_row(y) + x0, get_color_row(y) + x1, clear_color);
+        std::fill(get_depth_row(y) + x0, get_depth_row(y) + x1, 1.0f);  // far plane in normalized device coordinates
+    }
+    
+    // the tile's hierarchical z blocks go back to the far plane with it
+    reset_tile_hiz(tile);
+    tile_pending[tile] = 0;
+}
+
+void Framebuffer::reset_tile_hiz(int tile) {
+    int x0 = (tile % tiles_x) * TILE_SIZE, y0 = (tile / tiles_x) * TILE_SIZE;
+    int bx0 = x0 / HIZ_BLOCK_SIZE, bx1 = std::min(blocks_x, (x0 + TILE_SIZE) / HIZ_BLOCK_SIZE);
+    int by0 = y0 / HIZ_BLOCK_SIZE, by1 = std::min(blocks_y, (y0 + TILE_SIZE) / HIZ_BLOCK_SIZE);
+    for (int by = by0; by < by1; by++) {
+        std::fill(get_max_depth_row(by) + bx0, get_max_depth_row(by) + bx1, 1.0f);
+    }
+}
+
+bool Framebuffer::take_tile_clear(int tx, int ty, uint32_t& color) {
+    int tile = ty * tiles_x + tx;
+    if (!tile_pending[tile]) return false;
+    reset_tile_hiz(tile);
+    tile_pending[tile] = 0;
+    color = clear_color;
+    return true;
+}
+
+void Framebuffer::prepare_region(int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width);
+    y1 = std::min(y1, height);
+    if (x0 >= x1 || y0 >= y1) return;
+    
+    for (int ty = y0 / TILE_SIZE; ty <= (y1 - 1) / TILE_SIZE; ty++) {
+        for (int tx = x0 / TILE_SIZE; tx <= (x1 - 1) / TILE_SIZE; tx++) {
+            prepare_tile(tx, ty);
+        }
+    }
+}
+
+void Framebuffer::resolve() {
+    for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+        if (tile_pending[tile]) fill_tile(tile);
     }
 }
 
+uint64_t Framebuffer::count_covered_pixels() const {
+    // pending tiles hold nothing yet, so only prepared tiles are scanned
+    uint64_t covered = 0;
+    for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+        if (tile_pending[tile]) continue;
+        int x0 = (tile % tiles_x) * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, width);
+        int y0 = (tile / tiles_x) * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, height);
+        for (int y = y0; y < y1; y++) {
+            const float* depths = depth_plane.data() + (size_t)y * stride;
+            for (int x = x0; x < x1; x++) covered += depths[x] < 1.0f;
+        }
+    }
+    return covered;
+}
+
 void Framebuffer::set_pixel(int x, int y, const Vec3& color, float depth) {
     // set pixel with depth testing (z-buffer algorithm)
     if (x >= 0 && x < width && y >= 0 && y < height) {
-        int index = y * width + x;
+        prepare_tile(x / TILE_SIZE, y / TILE_SIZE);
+        size_t index = (size_t)y * stride + x;
         
         // only update pixel if this fragment is closer than existing one
-        if (depth < pixels[index].depth) {
-            pixels[index].set_color(color);
-            pixels[index].depth = depth;
+        if (depth < depth_plane[index]) {
+            color_plane[index] = Color::to_packed(color);
+            depth_plane[index] = depth;
         }
     }
 }
 
+uint32_t Framebuffer::read_color(int x, int y) const {
+    if (tile_pending[(y / TILE_SIZE) * tiles_x + x / TILE_SIZE]) return clear_color;
+    return color_plane[(size_t)y * stride + x];
+}
+
 Vec3 Framebuffer::get_pixel_color(int x, int y) const {
     // read pixel color back as floating point values
     if (x >= 0 && x < width && y >= 0 && y < height) {
-        int index = y * width + x;
-        const Pixel& p = pixels[index];
-        return Vec3(p.r / 255.0f, p.g / 255.0f, p.b / 255.0f);
+        return unpack_color(read_color(x, y));
     }
     return Vec3(0, 0, 0);
 }
 
-void Framebuffer::save_ppm(const std::string& filename) const {
-    // save framebuffer as ppm image file (simple uncompressed format)
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+float Framebuffer::get_pixel_depth(int x, int y) const {
+    if (x >= 0 && x < width && y >= 0 && y < height) {
+        if (tile_pending[(y / TILE_SIZE) * tiles_x + x / TILE_SIZE]) return 1.0f;
+        return depth_plane[(size_t)y * stride + x];
+    }
+    return 1.0f;
+}
+
+ImageView Framebuffer::get_image() {
+    resolve();
+    return ImageView{color_plane.data(), width, height, stride};
+}
+
+bool Framebuffer::save(const std::string& filename, ImageEncoder& encoder) {
+    // encode in memory, then hand the whole file to the os in one write
+    std::vector<uint8_t> bytes;
+    encoder.encode(get_image(), bytes);
+    if (!write_file(filename, bytes)) return false;
+    
+    std::cout << "Image saved as " << filename << std::endl;
+    return true;
+}
+
+SampleTile::SampleTile() : x0(0), y0(0), x1(0), y1(0), span(0) {
+    color_planes.reset((size_t)MSAA_SAMPLES * PLANE);
+    depth_planes.reset((size_t)MSAA_SAMPLES * PLANE);
+}
+
+void SampleTile::place(const Framebuffer& framebuffer, int tx, int ty) {
+    x0 = tx * TILE_SIZE;
+    y0 = ty * TILE_SIZE;
+    x1 = std::min(x0 + TILE_SIZE, framebuffer.get_width());
+    y1 = std::min(y0 + TILE_SIZE, framebuffer.get_height());
+    
+    // the padding of the last tile column comes along, so simd spans past the edge stay defined
+    span = std::min(TILE_SIZE, framebuffer.get_stride() - x0);
+}
+
+void SampleTile::fill(uint32_t color) {
+    // one row is filled and copied to the others, which beats filling every row element by element
+    const uint32_t* first_colors = get_color_row(0, y0);
+    const float* first_depths = get_depth_row(0, y0);
+    std::fill(get_color_row(0, y0), get_color_row(0, y0) + span, color);
+    std::fill(get_depth_row(0, y0), get_depth_row(0, y0) + span, 1.0f);
+    for (int s = 0; s < MSAA_SAMPLES; s++) {
+        for (int y = s == 0 ? y0 + 1 : y0; y < y1; y++) {
+            std::copy(first_colors, first_colors + span, get_color_row(s, y));
+            std::copy(first_depths, first_depths + span, get_depth_row(s, y));
+        }
+    }
+    std::fill(block_max_depth, block_max_depth + BLOCKS * BLOCKS, 1.0f);
+}
+
+void SampleTile::copy_pixels(const uint32_t* colors, const float* depths, int stride) {
+    for (int y = y0; y < y1; y++) {
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            std::copy(colors, colors + span, get_color_row(s, y));
+            std::copy(depths, depths + span, get_depth_row(s, y));
+        }
+        colors += stride;
+        depths += stride;
+    }
+}
+
+void SampleTile::load(Framebuffer& framebuffer, int tx, int ty, SampleBase& base) {
+    place(framebuffer, tx, ty);
+    
+    // a tile still waiting for its clear is cleared here instead, the resolve overwrites it all
+    base.cleared = framebuffer.take_tile_clear(tx, ty, base.clear_color);
+    if (base.cleared) {
+        fill(base.clear_color);
         return;
     }
     
-    // ppm header: format, dimensions, max color value
-    file << "P3\n" << width << " " << height << "\n255\n";
+    copy_pixels(framebuffer.get_color_row(y0) + x0, framebuffer.get_depth_row(y0) + x0, framebuffer.get_stride());
     
-    // write pixel data row by row
-    for (const auto& pixel : pixels) {
-        file << (int)pixel.r << " " << (int)pixel.g << " " << (int)pixel.b << "\n";
+    // the framebuffer's entries bound every pixel, and so every sample copied from one
+    for (int by = y0 / HIZ_BLOCK_SIZE; by < (y1 + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE; by++) {
+        const float* entries = framebuffer.get_max_depth_row(by);
+        for (int bx = x0 / HIZ_BLOCK_SIZE; bx < (x1 + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE; bx++) {
+            max_depth(bx, by) = entries[bx];
+        }
     }
     
-    std::cout << "Image saved as " << filename << std::endl;
+    // the first sample plane is now exactly the tile's pixels
+    base.colors.assign(color_planes.data(), color_planes.data() + PLANE);
+    base.depths.assign(depth_planes.data(), depth_planes.data() + PLANE);
+    base.block_max_depth.assign(block_max_depth, block_max_depth + BLOCKS * BLOCKS);
+}
+
+void SampleTile::reload(const Framebuffer& framebuffer, int tx, int ty, const SampleBase& base) {
+    place(framebuffer, tx, ty);
+    if (base.cleared) {
+        fill(base.clear_color);
+        return;
+    }
+    copy_pixels(base.colors.data(), base.depths.data(), TILE_SIZE);
+    std::copy(base.block_max_depth.begin(), base.block_max_depth.end(), block_max_depth);
+}
+
+void Framebuffer::save_ppm(const std::string& filename) {
+    PpmEncoder encoder;
+    save(filename, encoder);
 }
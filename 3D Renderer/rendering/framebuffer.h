@@ -7,39 +7,152 @@
 
 #include "../math/Vec3.h"
 #include "../math/color.h"
+#include "../core/aligned_buffer.h"
+#include "../io/image_encoder.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
-// pixel structure containing color and depth information
-struct Pixel {
-    unsigned char r, g, b;  // rgb color values (0-255)
-    float depth;            // z-buffer depth for hidden surface removal
-    
-    Pixel();
-    void set_color(const Vec3& color);  // convert float color to bytes
-};
+// screen tiles are the unit of lazy clearing here and of parallel work in the binned renderer
+constexpr int TILE_SIZE = 64;
+
+// hierarchical z keeps one conservative max depth per 8x8 pixel block
+constexpr int HIZ_BLOCK_SIZE = 8;
+static_assert(TILE_SIZE % HIZ_BLOCK_SIZE == 0, "hierarchical z blocks must not straddle tiles");
+
+// coverage and depth samples per pixel when multisampling
+constexpr int MSAA_SAMPLES = 4;
 
 // framebuffer class for managing the rendered image
-// provides pixel operations, depth testing, and file output
+// color and depth live in separate 64-byte aligned planes so depth-only work never
+// pulls color bytes through the cache; rows are padded to a whole number of cache lines
 class Framebuffer {
 private:
     int width, height;
-    std::vector<Pixel> pixels;  // 2d pixel array stored as 1d vector
+    int stride;                               // pixels per row including padding
+    int tiles_x, tiles_y;
+    AlignedBuffer<uint32_t> color_plane;      // packed rgba8 (Color::to_packed layout)
+    AlignedBuffer<float> depth_plane;         // z-buffer for hidden surface removal
+    std::vector<unsigned char> tile_pending;  // 1 = tile still waits for the last clear
+    uint32_t clear_color;                     // packed color the pending tiles will receive
+    int blocks_x, blocks_y;
+    std::vector<float> block_max_depth;       // hierarchical z: no pixel in the block is farther
+    
+    void fill_tile(int tile);                 // apply the pending clear to one tile
+    void reset_tile_hiz(int tile);
+    uint32_t read_color(int x, int y) const;  // color as seen by readers, pending tiles included
     
 public:
     Framebuffer(int w, int h);
     
     // framebuffer operations
-    void clear(const Vec3& color = Vec3(0, 0, 0));           // clear to solid color
+    void clear(const Vec3& color = Vec3(0, 0, 0));           // clear to solid color in O(tiles)
     void set_pixel(int x, int y, const Vec3& color, float depth = 0.0f);  // set single pixel with depth test
     Vec3 get_pixel_color(int x, int y) const;               // read pixel color
+    float get_pixel_depth(int x, int y) const;              // read z-buffer value
     
     // accessor methods
     int get_width() const { return width; }
     int get_height() const { return height; }
+    int get_stride() const { return stride; }
+    
+    // lazy clearing: a cleared tile is only filled when something first writes to it
+    // writers must prepare the tiles they touch before using the raw rows below
+    void prepare_tile(int tx, int ty) {
+        int tile = ty * tiles_x + tx;
+        if (tile_pending[tile]) fill_tile(tile);
+    }
+    void prepare_region(int x0, int y0, int x1, int y1);    // every tile overlapping [x0,x1) x [y0,y1)
+    
+    // for a writer that will overwrite every pixel of a tile, its row padding included: a pending
+    // clear is dropped rather than applied and true returned with its color; hierarchical z is reset
+    bool take_tile_clear(int tx, int ty, uint32_t& color);
+    void resolve();                                         // finish the clear of every untouched tile
+    bool is_tile_pending(int tx, int ty) const { return tile_pending[ty * tiles_x + tx] != 0; }
+    uint64_t count_covered_pixels() const;                  // pixels nearer than the far plane
+    
+    // raw row access for rasterizer inner loops (no bounds check, no depth test)
+    // rows start on a cache line and may be read and written up to get_stride() pixels
+    uint32_t* get_color_row(int y) { return color_plane.data() + (size_t)y * stride; }
+    float* get_depth_row(int y) { return depth_plane.data() + (size_t)y * stride; }
+    
+    // hierarchical z, one entry per HIZ_BLOCK_SIZE square block; valid once the tile is prepared
+    // depth only ever decreases between clears, so writers may lower an entry but never raise it
+    float* get_max_depth_row(int block_y) { return block_max_depth.data() + (size_t)block_y * blocks_x; }
+    int get_blocks_x() const { return blocks_x; }
+    int get_blocks_y() const { return blocks_y; }
+    
+    // image output; both resolve pending clears first
+    ImageView get_image();                                  // packed rgba8 view of the color plane
+    bool save(const std::string& filename, ImageEncoder& encoder);
+    void save_ppm(const std::string& filename);             // save as binary ppm image file
+};
+
+// what a screen tile held before it was first multisampled in a frame: the clear it was still
+// waiting for, or else a copy of its pixels and hierarchical z. a later flush redraws the tile's
+// samples from here, so copies are only made for tiles drawn without multisampling first
+struct SampleBase {
+    bool cleared = false;
+    uint32_t clear_color = 0;
+    std::vector<uint32_t> colors;             // TILE_SIZE x TILE_SIZE, rows as in a sample plane
+    std::vector<float> depths;
+    std::vector<float> block_max_depth;
+};
+
+// the samples of one screen tile while it is multisampled: MSAA_SAMPLES planes of color and
+// depth, TILE_SIZE pixels square, plus the tile's own hierarchical z over those samples
+// only tiles being rasterized need samples, so the binned renderer keeps one of these per worker
+// and resolves it into the framebuffer, which stays at one color and depth per pixel
+class SampleTile {
+private:
+    static constexpr int PLANE = TILE_SIZE * TILE_SIZE;
+    static constexpr int BLOCKS = TILE_SIZE / HIZ_BLOCK_SIZE;
+    int x0, y0, x1, y1;                       // the tile's pixels, clamped to the framebuffer
+    int span;                                 // columns loaded and resolved, row padding included
+    AlignedBuffer<uint32_t> color_planes;
+    AlignedBuffer<float> depth_planes;
+    float block_max_depth[BLOCKS * BLOCKS];   // no sample in the block is farther
+    
+    void place(const Framebuffer& framebuffer, int tx, int ty);
+    void fill(uint32_t color);                // every sample cleared to color at the far plane
+    void copy_pixels(const uint32_t* colors, const float* depths, int stride);
+    
+public:
+    SampleTile();
+    
+    // bytes of sample planes one tile holds
+    static constexpr size_t SAMPLE_BYTES = (size_t)MSAA_SAMPLES * PLANE * (sizeof(uint32_t) + sizeof(float));
+    
+    // start on tile (tx, ty): every sample takes its pixel's color and depth, pending clear included;
+    // base records where it started
+    void load(Framebuffer& framebuffer, int tx, int ty, SampleBase& base);
+    
+    // start on tile (tx, ty) again from the base an earlier load recorded
+    void reload(const Framebuffer& framebuffer, int tx, int ty, const SampleBase& base);
+    
+    int get_x0() const { return x0; }
+    int get_y0() const { return y0; }
+    int get_x1() const { return x1; }
+    int get_y1() const { return y1; }
+    int get_span() const { return span; }
+    
+    // rows of one sample plane for screen row y, indexed by x - get_x0(); 64-byte aligned
+    uint32_t* get_color_row(int sample, int y) { return color_planes.data() + sample * PLANE + (y - y0) * TILE_SIZE; }
+    float* get_depth_row(int sample, int y) { return depth_planes.data() + sample * PLANE + (y - y0) * TILE_SIZE; }
+    const uint32_t* get_color_row(int sample, int y) const {
+        return color_planes.data() + sample * PLANE + (y - y0) * TILE_SIZE;
+    }
+    const float* get_depth_row(int sample, int y) const {
+        return depth_planes.data() + sample * PLANE + (y - y0) * TILE_SIZE;
+    }
     
-    // file output
-    void save_ppm(const std::string& filename) const;       // save as ppm image file
+    // hierarchical z entry of the screen block (bx, by), which must lie in this tile
+    float& max_depth(int bx, int by) {
+        return block_max_depth[(by - y0 / HIZ_BLOCK_SIZE) * BLOCKS + bx - x0 / HIZ_BLOCK_SIZE];
+    }
+    float max_depth(int bx, int by) const {
+        return block_max_depth[(by - y0 / HIZ_BLOCK_SIZE) * BLOCKS + bx - x0 / HIZ_BLOCK_SIZE];
+    }
 };
 
 #endif
@@ -0,0 +1,49 @@
+// frustum.cpp
+// implementation of frustum plane extraction and bounding volume tests
+
+#include "frustum.h"
+#include <cmath>
+
+Frustum::Frustum(const Mat4& view_proj) {
+    // clip = M * p, so each plane of -w <= x, y, z <= w is a sum of two matrix rows
+    const float* m = view_proj.m;
+    for (int plane = 0; plane < 6; plane++) {
+        const float* row = m + (plane / 2) * 4;
+        float sign = (plane & 1) ? -1.0f : 1.0f;
+        float length = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            planes[plane][k] = m[12 + k] + sign * row[k];
+            if (k < 3) length += planes[plane][k] * planes[plane][k];
+        }
+        length = std::sqrt(length);
+        if (length > 0.0f) {
+            for (int k = 0; k < 4; k++) planes[plane][k] /= length;
+        }
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    if (sphere.is_empty()) return false;
+    for (const auto& p : planes) {
+        float distance = p[0] * sphere.center.x + p[1] * sphere.center.y + p[2] * sphere.center.z + p[3];
+        if (distance < -sphere.radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const Aabb& box, uint32_t& plane_mask) const {
+    if (box.is_empty()) return false;
+    Vec3 c = box.center(), e = box.extent();
+    for (int plane = 0; plane < 6; plane++) {
+        uint32_t bit = 1u << plane;
+        if (!(plane_mask & bit)) continue;
+        
+        // center distance against the box's projected half-size along the plane normal
+        const float* p = planes[plane];
+        float distance = p[0] * c.x + p[1] * c.y + p[2] * c.z + p[3];
+        float reach = std::fabs(p[0]) * e.x + std::fabs(p[1]) * e.y + std::fabs(p[2]) * e.z;
+        if (distance < -reach) return false;
+        if (distance >= reach) plane_mask &= ~bit;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+// frustum.h
+// the six planes of a camera's view volume in world space, for culling whole objects
+// planes come straight from the rows of the view-projection matrix
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../geometry/bounds.h"
+#include "../math/mat4.h"
+#include <cstdint>
+
+// every plane bit set: nothing has been found fully inside a plane yet
+constexpr uint32_t FRUSTUM_ALL_PLANES = 0x3F;
+
+class Frustum {
+public:
+    // planes in the order left, right, bottom, top, near, far, matching the clip code bits
+    explicit Frustum(const Mat4& view_proj);
+    
+    // false when the sphere is entirely outside one plane
+    bool intersects(const BoundingSphere& sphere) const;
+    
+    // false when the box is entirely outside one of the planes in plane_mask; planes the box is
+    // entirely inside are cleared from plane_mask, so boxes nested in it need not test them again
+    bool intersects(const Aabb& box, uint32_t& plane_mask) const;
+    
+private:
+    float planes[6][4];  // normalized a, b, c, d with a*x + b*y + c*z + d >= 0 inside
+};
+
+#endif
@@ -0,0 +1,102 @@
+// light_grid.cpp
+// implementation of per-tile light culling
+// lists are built with a counting pass and a fill pass into one flat index array
+
+#include "light_grid.h"
+#include "screen_projection.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // tile range covered by the screen-space bounds of a light's bounding box, or every tile when
+    // part of the box has no screen position (the mapping only preserves convexity in front of the camera)
+    TileRect light_tile_range(const Light& light, const Mat4& view_proj, int width, int height,
+                              int tiles_x, int tiles_y) {
+        const TileRect all = {0, 0, tiles_x, tiles_y};
+        const TileRect none = {0, 0, 0, 0};
+        if (light.type != LightType::POINT) return all;
+        if (light.radius <= 0.0f) return none;
+        
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (int corner = 0; corner < 8; corner++) {
+            Vec3 offset((corner & 1) ? light.radius : -light.radius,
+                        (corner & 2) ? light.radius : -light.radius,
+                        (corner & 4) ? light.radius : -light.radius);
+            Vec3 screen;
+            float inv_w;
+            if (!project_to_screen(view_proj, light.position + offset, width, height, screen, inv_w) ||
+                !(inv_w > 0.0f) || !std::isfinite(screen.x) || !std::isfinite(screen.y)) {
+                return all;
+            }
+            min_x = std::min(min_x, screen.x);
+            max_x = std::max(max_x, screen.x);
+            min_y = std::min(min_y, screen.y);
+            max_y = std::max(max_y, screen.y);
+        }
+        
+        TileRect range;
+        range.x0 = (int)std::max(0.0f, std::floor(min_x / TILE_SIZE));
+        range.y0 = (int)std::max(0.0f, std::floor(min_y / TILE_SIZE));
+        range.x1 = (int)std::min((float)tiles_x, std::floor(max_x / TILE_SIZE) + 1.0f);
+        range.y1 = (int)std::min((float)tiles_y, std::floor(max_y / TILE_SIZE) + 1.0f);
+        if (range.x0 >= range.x1 || range.y0 >= range.y1) return none;
+        return range;
+    }
+}
+
+void LightGrid::build(const std::vector<Light>& lights, const Mat4& view_proj_matrix, int w, int h) {
+    width = w;
+    height = h;
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    view_proj = view_proj_matrix;
+    
+    size_t light_count = lights.size();
+    all_lights.resize(light_count);
+    light_tiles.resize(light_count);
+    for (size_t i = 0; i < light_count; i++) all_lights[i] = (uint32_t)i;
+    
+    // count the lights of every tile, then turn the counts into list offsets
+    size_t tile_count = (size_t)tiles_x * tiles_y;
+    tile_offsets.assign(tile_count + 1, 0);
+    for (size_t i = 0; i < light_count; i++) {
+        const TileRect& range = light_tiles[i] = light_tile_range(lights[i], view_proj, width, height, tiles_x, tiles_y);
+        for (int ty = range.y0; ty < range.y1; ty++) {
+            for (int tx = range.x0; tx < range.x1; tx++) tile_offsets[ty * tiles_x + tx + 1]++;
+        }
+    }
+    for (size_t tile = 0; tile < tile_count; tile++) tile_offsets[tile + 1] += tile_offsets[tile];
+    
+    // fill in light order, so every list is sorted like the scene's lights
+    tile_indices.resize(tile_offsets[tile_count]);
+    tile_cursor.assign(tile_offsets.begin(), tile_offsets.end() - 1);
+    for (size_t i = 0; i < light_count; i++) {
+        const TileRect& range = light_tiles[i];
+        for (int ty = range.y0; ty < range.y1; ty++) {
+            for (int tx = range.x0; tx < range.x1; tx++) tile_indices[tile_cursor[ty * tiles_x + tx]++] = (uint32_t)i;
+        }
+    }
+}
+
+const uint32_t* LightGrid::lights_at(const Vec3& screen, float inv_w, size_t& count) const {
+    if (inv_w > 0.0f && screen.x >= 0.0f && screen.x < width && screen.y >= 0.0f && screen.y < height) {
+        return tile_lights((int)screen.x / TILE_SIZE, (int)screen.y / TILE_SIZE, count);
+    }
+    count = all_lights.size();
+    return all_lights.data();
+}
+
+const uint32_t* LightGrid::lights_near(const Vec3& world, size_t& count) const {
+    Vec3 screen;
+    float inv_w;
+    if (project_to_screen(view_proj, world, width, height, screen, inv_w)) {
+        return lights_at(screen, inv_w, count);
+    }
+    count = all_lights.size();
+    return all_lights.data();
+}
+
+double LightGrid::average_tile_lights() const {
+    size_t tile_count = (size_t)tiles_x * tiles_y;
+    return tile_count ? (double)tile_indices.size() / tile_count : 0.0;
+}
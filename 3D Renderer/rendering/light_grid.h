@@ -0,0 +1,51 @@
+// light_grid.h
+// per-tile lists of the lights that can reach each screen tile
+// built once per frame and camera, so shading only loops over the lights of its own tile
+
+#ifndef LIGHT_GRID_H
+#define LIGHT_GRID_H
+
+#include "../lighting/light.h"
+#include "../math/mat4.h"
+#include "framebuffer.h"
+#include "rasterizer.h"
+#include <cstdint>
+#include <vector>
+
+// a point light is listed in every TILE_SIZE tile its bounding box projects onto; any point
+// within the light's radius projects inside that box, so a point's own tile lists every light
+// that can reach it. directional lights, and lights whose box reaches behind the camera, are
+// listed in every tile
+class LightGrid {
+public:
+    // rebuild for the lights as seen through view_proj on a width x height target
+    void build(const std::vector<Light>& lights, const Mat4& view_proj, int width, int height);
+    
+    // light indices for points that project into tile (tx, ty)
+    const uint32_t* tile_lights(int tx, int ty, size_t& count) const {
+        int tile = ty * tiles_x + tx;
+        count = tile_offsets[tile + 1] - tile_offsets[tile];
+        return tile_indices.data() + tile_offsets[tile];
+    }
+    
+    // light indices for a point placed by project_to_screen; points off screen get every light
+    const uint32_t* lights_at(const Vec3& screen, float inv_w, size_t& count) const;
+    
+    // same for a world-space point, projected with the matrices given to build()
+    const uint32_t* lights_near(const Vec3& world, size_t& count) const;
+    
+    size_t light_count() const { return all_lights.size(); }
+    double average_tile_lights() const;
+    
+private:
+    int width = 0, height = 0;
+    int tiles_x = 0, tiles_y = 0;
+    Mat4 view_proj;
+    std::vector<uint32_t> tile_offsets;  // start of each tile's list in tile_indices, then the end
+    std::vector<uint32_t> tile_indices;
+    std::vector<uint32_t> all_lights;    // 0 .. n-1, for points without a tile
+    std::vector<TileRect> light_tiles;   // scratch: tile range of each light, empty when culled
+    std::vector<uint32_t> tile_cursor;   // scratch: fill position of each tile's list
+};
+
+#endif
@@ -0,0 +1,285 @@
+// light_kernel.cpp
+// scalar and avx2 batched lighting kernels
+// the scalar path repeats the avx2 operations lane by lane, max and min included, so both agree exactly
+
+#include "light_kernel.h"
+#include "rasterizer.h"
+#include "shadow_map.h"
+#include <cmath>
+#include <cstring>
+
+#if RENDER_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    const float SQRT2 = 1.41421356f;
+    
+    // log2(m) = 2 / ln2 * atanh(t) with t = (m - 1) / (m + 1); |t| < 0.172 on [sqrt(1/2), sqrt(2)],
+    // so the odd series to t^7 is good to 5e-8
+    const float LOG2_C1 = 2.88539008f, LOG2_C3 = 0.961796694f, LOG2_C5 = 0.577078016f, LOG2_C7 = 0.412198583f;
+    
+    // 2^f = e^(f ln2), taylor series to f^6 on [-0.5, 0.5), good to 2e-7
+    const float EXP2_C1 = 0.693147181f, EXP2_C2 = 0.240226507f, EXP2_C3 = 0.0555041087f,
+                EXP2_C4 = 0.00961812911f, EXP2_C5 = 0.00133335581f, EXP2_C6 = 0.000154035304f;
+    
+    // powers below 2^-64 are far under one color step and come out as zero, so no denormal
+    // products stall the lighting sums; the top keeps the exponent field in range
+    const float MIN_EXPONENT = -64.0f, MAX_EXPONENT = 127.0f;
+    
+    // blinn-phong highlights match phong ones of a quarter the exponent
+    const float BLINN_EXPONENT_SCALE = 4.0f;
+    
+    // _mm_max_ps and _mm_min_ps semantics: the second operand when the compare fails or is unordered
+    inline float lane_max(float a, float b) { return a > b ? a : b; }
+    inline float lane_min(float a, float b) { return a < b ? a : b; }
+    
+    void shade_points_scalar(const PackedLights& lights, const uint32_t* indices, size_t count, SpecularModel model,
+                             const ShadowMaps* shadows, ShadingPoints& points) {
+        const PackedLight* packed = lights.lights.data();
+        const Vec3& v = lights.view_dir;
+        bool blinn = model == SpecularModel::BLINN_PHONG;
+        for (int i = 0; i < points.count; i++) {
+            float px = points.x[i], py = points.y[i], pz = points.z[i];
+            float nx = points.nx[i], ny = points.ny[i], nz = points.nz[i];
+            float exponent = blinn ? points.shininess[i] * BLINN_EXPONENT_SCALE : points.shininess[i];
+            float view_dot_normal = v.x * nx + v.y * ny + v.z * nz;
+            float diffuse[3] = {0.0f, 0.0f, 0.0f}, specular[3] = {0.0f, 0.0f, 0.0f};
+            for (size_t k = 0; k < count; k++) {
+                size_t index = indices ? indices[k] : k;
+                const PackedLight& light = packed[index];
+                float normal_dot_light, base, attenuation = 1.0f;
+                if (light.point) {
+                    float lx = light.position[0] - px, ly = light.position[1] - py, lz = light.position[2] - pz;
+                    float distance_squared = lx * lx + ly * ly + lz * lz;
+                    
+                    // the simd path multiplies the light by zero instead, which adds exactly nothing
+                    if (indices && !(distance_squared <= light.radius_squared)) continue;
+                    float distance = std::sqrt(distance_squared);
+                    float inv_distance = 1.0f / distance;
+                    lx = lx * inv_distance;
+                    ly = ly * inv_distance;
+                    lz = lz * inv_distance;
+                    attenuation = 1.0f / (1.0f + 0.1f * distance + 0.01f * distance * distance);
+                    normal_dot_light = nx * lx + ny * ly + nz * lz;
+                    if (blinn) {
+                        float hx = lx + v.x, hy = ly + v.y, hz = lz + v.z;
+                        base = (nx * hx + ny * hy + nz * hz) / std::sqrt(hx * hx + hy * hy + hz * hz);
+                    } else {
+                        base = normal_dot_light * view_dot_normal * 2.0f - (v.x * lx + v.y * ly + v.z * lz);
+                    }
+                } else {
+                    normal_dot_light = nx * light.direction[0] + ny * light.direction[1] + nz * light.direction[2];
+                    if (blinn) {
+                        base = nx * light.half[0] + ny * light.half[1] + nz * light.half[2];
+                    } else {
+                        base = normal_dot_light * view_dot_normal * 2.0f - light.view_dot;
+                    }
+                }
+                if (shadows && shadows->has_map(index) && (normal_dot_light > 0.0f || base > 0.0f)) {
+                    attenuation = attenuation * shadows->visibility(index, Vec3(px, py, pz), Vec3(nx, ny, nz));
+                }
+                float diffuse_weight = attenuation * lane_max(normal_dot_light, 0.0f);
+                float specular_weight = attenuation * fast_pow(lane_max(base, 0.0f), exponent);
+                for (int c = 0; c < 3; c++) {
+                    diffuse[c] = diffuse[c] + light.color[c] * diffuse_weight;
+                    specular[c] = specular[c] + light.color[c] * specular_weight;
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                points.diffuse[c][i] = diffuse[c];
+                points.specular[c][i] = specular[c];
+            }
+        }
+    }
+    
+#if RENDER_HAS_X86_SIMD
+    __attribute__((target("avx2")))
+    inline __m256 fast_pow_avx2(__m256 x, __m256 exponent) {
+        const __m256 one = _mm256_set1_ps(1.0f), sqrt2 = _mm256_set1_ps(SQRT2);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFF)),
+                                                       _mm256_set1_epi32(0x3F800000)));
+        __m256 big = _mm256_cmp_ps(m, sqrt2, _CMP_GT_OQ);
+        m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+        e = _mm256_blendv_ps(e, _mm256_add_ps(e, one), big);
+        
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 series = _mm256_add_ps(_mm256_set1_ps(LOG2_C5), _mm256_mul_ps(t2, _mm256_set1_ps(LOG2_C7)));
+        series = _mm256_add_ps(_mm256_set1_ps(LOG2_C3), _mm256_mul_ps(t2, series));
+        series = _mm256_add_ps(_mm256_set1_ps(LOG2_C1), _mm256_mul_ps(t2, series));
+        __m256 log2x = _mm256_add_ps(e, _mm256_mul_ps(t, series));
+        
+        __m256 y = _mm256_mul_ps(exponent, log2x);
+        __m256 keep = _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                    _mm256_cmp_ps(y, _mm256_set1_ps(MIN_EXPONENT), _CMP_GT_OQ));
+        y = _mm256_min_ps(y, _mm256_set1_ps(MAX_EXPONENT));
+        __m256 whole = _mm256_floor_ps(y);
+        __m256 f = _mm256_sub_ps(_mm256_sub_ps(y, whole), _mm256_set1_ps(0.5f));
+        __m256 p = _mm256_add_ps(_mm256_set1_ps(EXP2_C5), _mm256_mul_ps(f, _mm256_set1_ps(EXP2_C6)));
+        p = _mm256_add_ps(_mm256_set1_ps(EXP2_C4), _mm256_mul_ps(f, p));
+        p = _mm256_add_ps(_mm256_set1_ps(EXP2_C3), _mm256_mul_ps(f, p));
+        p = _mm256_add_ps(_mm256_set1_ps(EXP2_C2), _mm256_mul_ps(f, p));
+        p = _mm256_add_ps(_mm256_set1_ps(EXP2_C1), _mm256_mul_ps(f, p));
+        p = _mm256_mul_ps(sqrt2, _mm256_add_ps(one, _mm256_mul_ps(f, p)));
+        __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(whole), _mm256_set1_epi32(127)), 23);
+        __m256 result = _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+        return _mm256_and_ps(result, keep);
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256 dot3_avx2(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz) {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+    }
+    
+    // every light is broadcast once and applied to all eight points
+    __attribute__((target("avx2")))
+    void shade_points_avx2(const PackedLights& lights, const uint32_t* indices, size_t count, SpecularModel model,
+                           const ShadowMaps* shadows, ShadingPoints& points) {
+        const PackedLight* packed = lights.lights.data();
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+        bool blinn = model == SpecularModel::BLINN_PHONG;
+        __m256 px = _mm256_load_ps(points.x), py = _mm256_load_ps(points.y), pz = _mm256_load_ps(points.z);
+        __m256 nx = _mm256_load_ps(points.nx), ny = _mm256_load_ps(points.ny), nz = _mm256_load_ps(points.nz);
+        __m256 exponent = _mm256_load_ps(points.shininess);
+        if (blinn) exponent = _mm256_mul_ps(exponent, _mm256_set1_ps(BLINN_EXPONENT_SCALE));
+        __m256 vx = _mm256_set1_ps(lights.view_dir.x), vy = _mm256_set1_ps(lights.view_dir.y);
+        __m256 vz = _mm256_set1_ps(lights.view_dir.z);
+        __m256 view_dot_normal = dot3_avx2(vx, vy, vz, nx, ny, nz);
+        __m256 diffuse[3] = {zero, zero, zero}, specular[3] = {zero, zero, zero};
+        
+        for (size_t k = 0; k < count; k++) {
+            size_t index = indices ? indices[k] : k;
+            const PackedLight& light = packed[index];
+            __m256 normal_dot_light, base, attenuation;
+            if (light.point) {
+                __m256 lx = _mm256_sub_ps(_mm256_set1_ps(light.position[0]), px);
+                __m256 ly = _mm256_sub_ps(_mm256_set1_ps(light.position[1]), py);
+                __m256 lz = _mm256_sub_ps(_mm256_set1_ps(light.position[2]), pz);
+                __m256 distance_squared = dot3_avx2(lx, ly, lz, lx, ly, lz);
+                __m256 distance = _mm256_sqrt_ps(distance_squared);
+                __m256 inv_distance = _mm256_div_ps(one, distance);
+                lx = _mm256_mul_ps(lx, inv_distance);
+                ly = _mm256_mul_ps(ly, inv_distance);
+                lz = _mm256_mul_ps(lz, inv_distance);
+                __m256 falloff = _mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(0.1f), distance));
+                falloff = _mm256_add_ps(falloff, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.01f), distance), distance));
+                attenuation = _mm256_div_ps(one, falloff);
+                if (indices) {
+                    __m256 in_range = _mm256_cmp_ps(distance_squared, _mm256_set1_ps(light.radius_squared), _CMP_LE_OQ);
+                    if (_mm256_movemask_ps(in_range) == 0) continue;
+                    attenuation = _mm256_and_ps(attenuation, in_range);
+                }
+                normal_dot_light = dot3_avx2(nx, ny, nz, lx, ly, lz);
+                if (blinn) {
+                    __m256 hx = _mm256_add_ps(lx, vx), hy = _mm256_add_ps(ly, vy), hz = _mm256_add_ps(lz, vz);
+                    base = _mm256_div_ps(dot3_avx2(nx, ny, nz, hx, hy, hz),
+                                         _mm256_sqrt_ps(dot3_avx2(hx, hy, hz, hx, hy, hz)));
+                } else {
+                    base = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(normal_dot_light, view_dot_normal), two),
+                                         dot3_avx2(vx, vy, vz, lx, ly, lz));
+                }
+            } else {
+                attenuation = one;
+                normal_dot_light = dot3_avx2(nx, ny, nz, _mm256_set1_ps(light.direction[0]),
+                                             _mm256_set1_ps(light.direction[1]), _mm256_set1_ps(light.direction[2]));
+                if (blinn) {
+                    base = dot3_avx2(nx, ny, nz, _mm256_set1_ps(light.half[0]), _mm256_set1_ps(light.half[1]),
+                                     _mm256_set1_ps(light.half[2]));
+                } else {
+                    base = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(normal_dot_light, view_dot_normal), two),
+                                         _mm256_set1_ps(light.view_dot));
+                }
+            }
+            if (shadows && shadows->has_map(index)) {
+                // map lookups are scattered reads, so each lane takes the scalar path's lookup
+                alignas(32) float lit[SHADING_WIDTH], visibility[SHADING_WIDTH];
+                _mm256_store_ps(lit, _mm256_or_ps(_mm256_cmp_ps(normal_dot_light, zero, _CMP_GT_OQ),
+                                                  _mm256_cmp_ps(base, zero, _CMP_GT_OQ)));
+                for (int i = 0; i < SHADING_WIDTH; i++) {
+                    bool lookup = i < points.count && lit[i] != 0.0f;
+                    visibility[i] = lookup ? shadows->visibility(index, Vec3(points.x[i], points.y[i], points.z[i]),
+                                                                 Vec3(points.nx[i], points.ny[i], points.nz[i]))
+                                           : 1.0f;
+                }
+                attenuation = _mm256_mul_ps(attenuation, _mm256_load_ps(visibility));
+            }
+            __m256 diffuse_weight = _mm256_mul_ps(attenuation, _mm256_max_ps(normal_dot_light, zero));
+            __m256 specular_weight = _mm256_mul_ps(attenuation, fast_pow_avx2(_mm256_max_ps(base, zero), exponent));
+            for (int c = 0; c < 3; c++) {
+                __m256 color = _mm256_set1_ps(light.color[c]);
+                diffuse[c] = _mm256_add_ps(diffuse[c], _mm256_mul_ps(color, diffuse_weight));
+                specular[c] = _mm256_add_ps(specular[c], _mm256_mul_ps(color, specular_weight));
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            _mm256_store_ps(points.diffuse[c], diffuse[c]);
+            _mm256_store_ps(points.specular[c], specular[c]);
+        }
+    }
+#endif
+}
+
+float fast_pow(float x, float exponent) {
+    if (!(x > 0.0f)) return 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    float e = (float)((int)(bits >> 23) - 127);
+    uint32_t mantissa_bits = (bits & 0x7FFFFFu) | 0x3F800000u;
+    float m;
+    std::memcpy(&m, &mantissa_bits, sizeof(m));
+    if (m > SQRT2) {
+        m = m * 0.5f;
+        e = e + 1.0f;
+    }
+    
+    float t = (m - 1.0f) / (m + 1.0f);
+    float t2 = t * t;
+    float log2x = e + t * (LOG2_C1 + t2 * (LOG2_C3 + t2 * (LOG2_C5 + t2 * LOG2_C7)));
+    
+    float y = exponent * log2x;
+    if (!(y > MIN_EXPONENT)) return 0.0f;
+    y = lane_min(y, MAX_EXPONENT);
+    float whole = std::floor(y);
+    float f = y - whole - 0.5f;
+    float p = SQRT2 * (1.0f + f * (EXP2_C1 + f * (EXP2_C2 + f * (EXP2_C3 + f * (EXP2_C4 + f * (EXP2_C5 + f * EXP2_C6))))));
+    uint32_t scale_bits = (uint32_t)((int)whole + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scale_bits, sizeof(scale));
+    return p * scale;
+}
+
+void PackedLights::pack(const std::vector<Light>& source, const Vec3& view) {
+    count = source.size();
+    if (lights.size() < count) lights.resize(count);
+    view_dir = view;
+    for (size_t i = 0; i < count; i++) {
+        const Light& light = source[i];
+        PackedLight& packed = lights[i];
+        Vec3 direction = light.direction * -1.0f;
+        Vec3 color = light.color * light.intensity;
+        Vec3 half = (direction + view).normalize();
+        for (int c = 0; c < 3; c++) {
+            packed.position[c] = (&light.position.x)[c];
+            packed.direction[c] = (&direction.x)[c];
+            packed.color[c] = (&color.x)[c];
+            packed.half[c] = (&half.x)[c];
+        }
+        packed.radius_squared = light.radius * light.radius;
+        packed.view_dot = view.dot(direction);
+        packed.point = light.type == LightType::POINT;
+    }
+}
+
+void shade_points(const PackedLights& lights, const uint32_t* indices, size_t count, SpecularModel model,
+                  ShadingPoints& points, const ShadowMaps* shadows) {
+#if RENDER_HAS_X86_SIMD
+    if (get_raster_simd_level() == SimdLevel::AVX2) {
+        shade_points_avx2(lights, indices, count, model, shadows, points);
+        return;
+    }
+#endif
+    shade_points_scalar(lights, indices, count, model, shadows, points);
+}
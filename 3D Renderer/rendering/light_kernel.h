@@ -0,0 +1,85 @@
+// light_kernel.h
+// batched lighting: diffuse and specular light sums for up to 8 surface points per call
+// points are stored as structure-of-arrays, so the avx2 path lights the whole batch per light
+
+#ifndef LIGHT_KERNEL_H
+#define LIGHT_KERNEL_H
+
+#include "../lighting/light.h"
+#include "../geometry/material.h"
+#include "../math/Vec3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ShadowMaps;
+
+// specular term of the batched kernel; the reference Renderer::calculate_lighting is always phong
+enum class SpecularModel {
+    PHONG,       // view direction against the light direction mirrored about the normal
+    BLINN_PHONG  // normal against the half vector of light and view; the exponent is scaled by 4
+                 // so highlights keep roughly their phong size
+};
+
+// one light with the products that do not depend on the surface folded in
+struct PackedLight {
+    float position[3];      // point lights
+    float direction[3];     // towards a directional light
+    float color[3];         // color * intensity
+    float radius_squared;   // range of a point light, for listed lights
+    float view_dot;         // directional: view_dir . direction, for phong
+    float half[3];          // directional: unit half vector of direction and view_dir, for blinn-phong
+    bool point;
+};
+
+// the lights of one view, packed once per batch rather than once per surface point
+struct PackedLights {
+    std::vector<PackedLight> lights;  // only grows, so repacking every frame does not allocate
+    size_t count = 0;
+    Vec3 view_dir;
+    
+    void pack(const std::vector<Light>& source, const Vec3& view);
+};
+
+constexpr int SHADING_WIDTH = 8;
+
+// up to SHADING_WIDTH surface points lit against one light list; lanes past count are ignored
+struct alignas(32) ShadingPoints {
+    float x[SHADING_WIDTH] = {}, y[SHADING_WIDTH] = {}, z[SHADING_WIDTH] = {};     // world position
+    float nx[SHADING_WIDTH] = {}, ny[SHADING_WIDTH] = {}, nz[SHADING_WIDTH] = {};  // world unit normal
+    float shininess[SHADING_WIDTH] = {};
+    float diffuse[3][SHADING_WIDTH];   // out: sum of color * attenuation * n.l, per channel
+    float specular[3][SHADING_WIDTH];  // out: sum of color * attenuation * specular factor
+    int count = 0;
+    
+    void add(const Vec3& position, const Vec3& normal, float shine) {
+        x[count] = position.x;
+        y[count] = position.y;
+        z[count] = position.z;
+        nx[count] = normal.x;
+        ny[count] = normal.y;
+        nz[count] = normal.z;
+        shininess[count] = shine;
+        count++;
+    }
+    
+    // lit color of point i with its material applied; the ambient term is that of calculate_lighting
+    Vec3 color(int i, const Material& material, const Vec3& ambient_light) const {
+        return ambient_light * material.diffuse_color * material.ambient_strength +
+               material.diffuse_color * Vec3(diffuse[0][i], diffuse[1][i], diffuse[2][i]) +
+               material.specular_color * Vec3(specular[0][i], specular[1][i], specular[2][i]);
+    }
+};
+
+// light the points against the listed lights, or every light when indices is null; listed point
+// lights out of range of a point add nothing to it, as in calculate_lighting. pow is evaluated
+// as exp2(shininess * log2(x)) with polynomials, within about 3e-6 of std::pow.
+// runs the simd path of the rasterizer's level, every path produces bit-identical output.
+// with shadows, light i is scaled by its shadow map visibility at each point it can light
+void shade_points(const PackedLights& lights, const uint32_t* indices, size_t count, SpecularModel model,
+                  ShadingPoints& points, const ShadowMaps* shadows = nullptr);
+
+// the pow approximation alone, for accuracy checks; x <= 0 and results below 2^-64 give 0
+float fast_pow(float x, float exponent);
+
+#endif
@@ -0,0 +1,71 @@
+// raster_kernels.h
+// per-instruction-set triangle traversal kernels behind rasterize_triangle
+// all kernels produce bit-identical color and depth output and count the pixels they wrote
+
+#ifndef RASTER_KERNELS_H
+#define RASTER_KERNELS_H
+
+#include "rasterizer.h"
+#include "../core/profiler.h"
+#include <algorithm>
+
+// pixels a kernel call depth tested (covered ones) and wrote; tested stays 0 without RENDER_PROFILING
+struct FragmentCounts {
+    uint64_t tested = 0;
+    uint64_t written = 0;
+};
+
+// packed color of a gouraud triangle at x_rel pixels right of min_x, given the attribute planes
+// already stepped to the row; every kernel performs these same float operations per lane
+inline uint32_t shade_pixel(const RasterTriangle& tri, const float attr_row[4], float x_rel) {
+    float w = 1.0f / (attr_row[3] + tri.attr_dx[3] * x_rel);
+    uint32_t packed = 0xFFu << 24;
+    for (int i = 0; i < 3; i++) {
+        float c = (attr_row[i] + tri.attr_dx[i] * x_rel) * w;
+        packed |= (uint32_t)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f) << (8 * i);
+    }
+    return packed;
+}
+
+// the same for a multisampled pixel whose center lies outside the triangle, taken at one of its
+// covered samples instead, so silhouettes do not get colors extrapolated past the triangle's edge
+inline uint32_t shade_sample(const RasterTriangle& tri, const float attr_row[4], float x_rel, int sample) {
+    float ox = (float)MSAA_OFFSETS[sample][0] / SUBPIXEL_SCALE, oy = (float)MSAA_OFFSETS[sample][1] / SUBPIXEL_SCALE;
+    float attr[4];
+    for (int i = 0; i < 4; i++) attr[i] = attr_row[i] + tri.attr_dy[i] * oy;
+    return shade_pixel(tri, attr, x_rel + ox);
+}
+
+// edge and depth offsets of each multisample position from its pixel center; edge steps are
+// whole multiples of SUBPIXEL_SCALE, so the edge offsets are exact
+inline void sample_offsets(const RasterTriangle& tri, int64_t edge[MSAA_SAMPLES][3], float z[MSAA_SAMPLES]) {
+    for (int s = 0; s < MSAA_SAMPLES; s++) {
+        int ox = MSAA_OFFSETS[s][0], oy = MSAA_OFFSETS[s][1];
+        for (int i = 0; i < 3; i++) edge[s][i] = (tri.edge_a[i] * ox + tri.edge_b[i] * oy) / SUBPIXEL_SCALE;
+        z[s] = tri.z_dx * ((float)ox / SUBPIXEL_SCALE) + tri.z_dy * ((float)oy / SUBPIXEL_SCALE);
+    }
+}
+
+// the resolves average by shifting and take the nearest depth of exactly four planes
+static_assert(MSAA_SAMPLES == 4, "sample resolves assume four samples per pixel");
+
+// one pixel at a time, portable
+FragmentCounts rasterize_triangle_scalar(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer);
+FragmentCounts rasterize_msaa_scalar(const RasterTriangle& tri, const TileRect& rect, SampleTile& tile);
+void resolve_samples_scalar(const SampleTile& tile, Framebuffer& framebuffer);
+
+#if RENDER_HAS_X86_SIMD
+// 4x1 pixel spans with sse2 coverage, depth compare and masked color write
+FragmentCounts rasterize_triangle_sse2(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer);
+
+// 8x1 pixel spans with avx2 coverage, depth compare and masked color write
+FragmentCounts rasterize_triangle_avx2(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer);
+
+// 8x1 pixel spans tested against every sample plane, shaded once for the lanes any sample passed
+FragmentCounts rasterize_msaa_avx2(const RasterTriangle& tri, const TileRect& rect, SampleTile& tile);
+
+// four pixels per step: 16-bit channel sums of the sample planes, and the minimum of their depths
+void resolve_samples_sse2(const SampleTile& tile, Framebuffer& framebuffer);
+#endif
+
+#endif
@@ -0,0 +1,599 @@
+// raster_simd.cpp
+// sse2 and avx2 triangle traversal kernels
+// coverage is tested on exact integer edge values, 32 bits per lane when every tested value fits
+// and 64 bits otherwise, so results match the scalar kernel exactly
+// color and depth come straight from the framebuffer's planar rows
+
+#include "raster_kernels.h"
+
+#if RENDER_HAS_X86_SIMD
+
+#include <immintrin.h>
+#include <algorithm>
+
+namespace {
+    // lanes of an n-wide span that fall inside [x0, x1), as a bit mask
+    inline int range_bits(int span_x, int width, int x0, int x1) {
+        int full = (1 << width) - 1;
+        int lo = std::max(0, x0 - span_x);
+        int hi = std::max(0, span_x + width - x1);
+        if (lo >= width || hi >= width) return 0;
+        return ((full << lo) & (full >> hi)) & full;
+    }
+    
+    // set lanes in a 4-lane mask; __builtin_popcount is a libgcc call without popcnt, and the
+    // call would spill every live vector register of the span loops
+    inline int lane_count4(int bits) {
+        return (int)((0x4332322132212110ull >> (bits * 4)) & 0xF);
+    }
+    
+    inline int lane_count8(int bits) {
+        return lane_count4(bits & 0xF) + lane_count4(bits >> 4);
+    }
+    
+    // packed gouraud colors of a span, lane by lane the same operations as shade_pixel;
+    // max(0, c) and min(1, c) keep the operand order of std::max and std::min
+    __attribute__((target("sse2")))
+    inline __m128i shade_span_sse2(const __m128 attr_row[4], const __m128 attr_dx[4], __m128 x_rel) {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+        __m128 w = _mm_div_ps(one, _mm_add_ps(attr_row[3], _mm_mul_ps(attr_dx[3], x_rel)));
+        __m128i channel[3];
+        for (int i = 0; i < 3; i++) {
+            __m128 c = _mm_mul_ps(_mm_add_ps(attr_row[i], _mm_mul_ps(attr_dx[i], x_rel)), w);
+            channel[i] = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(one, _mm_max_ps(zero, c)), scale));
+        }
+        __m128i packed = _mm_or_si128(channel[0], _mm_slli_epi32(channel[1], 8));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(channel[2], 16));
+        return _mm_or_si128(packed, _mm_set1_epi32((int)(0xFFu << 24)));
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256i shade_span_avx2(const __m256 attr_row[4], const __m256 attr_dx[4], __m256 x_rel) {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+        __m256 w = _mm256_div_ps(one, _mm256_add_ps(attr_row[3], _mm256_mul_ps(attr_dx[3], x_rel)));
+        __m256i channel[3];
+        for (int i = 0; i < 3; i++) {
+            __m256 c = _mm256_mul_ps(_mm256_add_ps(attr_row[i], _mm256_mul_ps(attr_dx[i], x_rel)), w);
+            channel[i] = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_min_ps(one, _mm256_max_ps(zero, c)), scale));
+        }
+        __m256i packed = _mm256_or_si256(channel[0], _mm256_slli_epi32(channel[1], 8));
+        packed = _mm256_or_si256(packed, _mm256_slli_epi32(channel[2], 16));
+        return _mm256_or_si256(packed, _mm256_set1_epi32((int)(0xFFu << 24)));
+    }
+    
+    // true when every edge value a simd kernel tests over [xs, x_last] x [y0, y1) fits in 32
+    // bits; edges are linear, so checking the four corners covers the whole rectangle
+    bool edges_fit_int32(const RasterTriangle& tri, int xs, int x_last, int y0, int y1) {
+        for (int i = 0; i < 3; i++) {
+            for (int x : {xs, x_last}) {
+                for (int y : {y0, y1 - 1}) {
+                    int64_t e = tri.edge_a[i] * x + tri.edge_b[i] * y + tri.edge_c[i];
+                    if (e < INT32_MIN || e > INT32_MAX) return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    // shared span body: depth test the covered lanes and blend color and depth into the row
+    __attribute__((target("sse2")))
+    inline void write_span_sse2(const RasterTriangle& tri, uint32_t* colors, float* depths, int span_x,
+                                __m128 covered, __m128 z, __m128 x_rel, const __m128 attr_row[4],
+                                const __m128 attr_dx[4], __m128i color, FragmentCounts& counts) {
+        __m128 depth = _mm_load_ps(depths + span_x);
+        __m128 pass = _mm_and_ps(_mm_cmplt_ps(z, depth), covered);
+        int pass_bits = _mm_movemask_ps(pass);
+        if (!pass_bits) return;
+        counts.written += lane_count4(pass_bits);
+        
+        _mm_store_ps(depths + span_x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, depth)));
+        __m128i new_color = tri.smooth ? shade_span_sse2(attr_row, attr_dx, x_rel) : color;
+        
+        __m128i pass_i = _mm_castps_si128(pass);
+        __m128i* color_span = reinterpret_cast<__m128i*>(colors + span_x);
+        __m128i old_color = _mm_load_si128(color_span);
+        _mm_store_si128(color_span, _mm_or_si128(_mm_and_si128(pass_i, new_color), _mm_andnot_si128(pass_i, old_color)));
+    }
+    
+    // the avx2 span body; masked stores leave failing lanes untouched, so color is never read
+    __attribute__((target("avx2")))
+    inline void write_span_avx2(const RasterTriangle& tri, float* colors, float* depths, int span_x,
+                                __m256 covered, __m256 z, __m256 x_rel, const __m256 attr_row[4],
+                                const __m256 attr_dx[4], __m256 color, FragmentCounts& counts) {
+        __m256 depth = _mm256_load_ps(depths + span_x);
+        __m256 pass = _mm256_and_ps(_mm256_cmp_ps(z, depth, _CMP_LT_OQ), covered);
+        int pass_bits = _mm256_movemask_ps(pass);
+        if (!pass_bits) return;
+        counts.written += lane_count8(pass_bits);
+        
+        __m256i pass_i = _mm256_castps_si256(pass);
+        _mm256_maskstore_ps(depths + span_x, pass_i, z);
+        __m256 new_color = tri.smooth ? _mm256_castsi256_ps(shade_span_avx2(attr_row, attr_dx, x_rel)) : color;
+        _mm256_maskstore_ps(colors + span_x, pass_i, new_color);
+    }
+}
+
+// spans are aligned to their width and framebuffer rows are padded to a cache line, so a span
+// never leaves its row, and since tiles are 64-aligned it never leaves the caller's tile either
+
+// small and medium triangles keep their edge values in 32 bits, four lanes to a register, so a
+// span costs three adds and one compare for coverage; larger ones fall back to 64-bit lanes.
+// a triangle covers one run of each row, so a row ends at the first empty span after it
+__attribute__((target("sse2")))
+FragmentCounts rasterize_triangle_sse2(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return FragmentCounts();
+    FragmentCounts counts;
+    
+    const int xs = x0 & ~3;
+    const int x_last = ((x1 + 3) & ~3) - 1;
+    const bool narrow_edges = edges_fit_int32(tri, xs, x_last, y0, y1);
+    
+    const __m128 z_dx = _mm_set1_ps(tri.z_dx);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 lane_x = _mm_set_ps(3, 2, 1, 0);
+    const __m128i lane_bits = _mm_set_epi32(8, 4, 2, 1);
+    const __m128i color = _mm_set1_epi32((int)tri.color);
+    __m128 attr_dx[4], attr_row[4];
+    for (int i = 0; i < 4; i++) attr_dx[i] = _mm_set1_ps(tri.attr_dx[i]);
+    
+    int64_t row[3];
+    for (int i = 0; i < 3; i++) row[i] = tri.edge_a[i] * xs + tri.edge_b[i] * y0 + tri.edge_c[i];
+    
+    if (narrow_edges) {
+        // lane offsets and span step wrap in 32 bits, harmless since every tested sum fits
+        __m128i offset[3], step[3];
+        for (int i = 0; i < 3; i++) {
+            uint32_t a = (uint32_t)tri.edge_a[i];
+            offset[i] = _mm_set_epi32((int)(3 * a), (int)(2 * a), (int)a, 0);
+            step[i] = _mm_set1_epi32((int)(4 * a));
+        }
+        const __m128i minus_one = _mm_set1_epi32(-1);
+        
+        // the first and last span of every row clip to [x0, x1) with the same lane masks
+        const int last_span = (x1 - 1) & ~3;
+        const __m128i lane_index = _mm_set_epi32(3, 2, 1, 0);
+        const __m128i first_mask = _mm_cmpgt_epi32(lane_index, _mm_set1_epi32(x0 - xs - 1));
+        const __m128i last_mask = _mm_cmplt_epi32(lane_index, _mm_set1_epi32(x1 - last_span));
+        
+        for (int y = y0; y < y1; y++) {
+            uint32_t* colors = framebuffer.get_color_row(y);
+            float* depths = framebuffer.get_depth_row(y);
+            const __m128 z_row = _mm_set1_ps(tri.z_origin + tri.z_dy * (float)(y - tri.min_y));
+            if (tri.smooth) {
+                for (int i = 0; i < 4; i++) {
+                    attr_row[i] = _mm_set1_ps(tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y));
+                }
+            }
+            
+            __m128i e[3];
+            for (int i = 0; i < 3; i++) e[i] = _mm_add_epi32(_mm_set1_epi32((int32_t)row[i]), offset[i]);
+            __m128 x_rel = _mm_add_ps(_mm_set1_ps((float)(xs - tri.min_x)), lane_x);
+            
+            bool entered = false;
+            for (int span_x = xs; span_x < x1; span_x += 4) {
+                // inside where no edge is negative: or the edges and compare against -1
+                __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]), minus_one);
+                for (int i = 0; i < 3; i++) e[i] = _mm_add_epi32(e[i], step[i]);
+                __m128 lanes_x = x_rel;
+                x_rel = _mm_add_ps(x_rel, four);
+                
+                if (span_x == xs) inside = _mm_and_si128(inside, first_mask);
+                if (span_x == last_span) inside = _mm_and_si128(inside, last_mask);
+                int bits = _mm_movemask_ps(_mm_castsi128_ps(inside));
+                if (!bits) {
+                    if (entered) break;
+                    continue;
+                }
+                entered = true;
+#if RENDER_PROFILING
+                counts.tested += lane_count4(bits);
+#endif
+                __m128 z = _mm_add_ps(z_row, _mm_mul_ps(z_dx, lanes_x));
+                write_span_sse2(tri, colors, depths, span_x, _mm_castsi128_ps(inside), z, lanes_x,
+                                attr_row, attr_dx, color, counts);
+            }
+            
+            for (int i = 0; i < 3; i++) row[i] += tri.edge_b[i];
+        }
+        return counts;
+    }
+    
+    // per-edge lane offsets (2 int64 lanes per register, 2 registers per span) and span step
+    __m128i off_lo[3], off_hi[3], step[3];
+    for (int i = 0; i < 3; i++) {
+        int64_t a = tri.edge_a[i];
+        off_lo[i] = _mm_set_epi64x(a, 0);
+        off_hi[i] = _mm_set_epi64x(3 * a, 2 * a);
+        step[i] = _mm_set1_epi64x(4 * a);
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        uint32_t* colors = framebuffer.get_color_row(y);
+        float* depths = framebuffer.get_depth_row(y);
+        const __m128 z_row = _mm_set1_ps(tri.z_origin + tri.z_dy * (float)(y - tri.min_y));
+        if (tri.smooth) {
+            for (int i = 0; i < 4; i++) {
+                attr_row[i] = _mm_set1_ps(tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y));
+            }
+        }
+        
+        __m128i e_lo[3], e_hi[3];
+        for (int i = 0; i < 3; i++) {
+            __m128i base = _mm_set1_epi64x(row[i]);
+            e_lo[i] = _mm_add_epi64(base, off_lo[i]);
+            e_hi[i] = _mm_add_epi64(base, off_hi[i]);
+        }
+        __m128 x_rel = _mm_add_ps(_mm_set1_ps((float)(xs - tri.min_x)), lane_x);
+        
+        bool entered = false;
+        for (int span_x = xs; span_x < x1; span_x += 4) {
+            // outside when any edge is negative: or the edges, then collect the sign bits
+            __m128i or_lo = _mm_or_si128(_mm_or_si128(e_lo[0], e_lo[1]), e_lo[2]);
+            __m128i or_hi = _mm_or_si128(_mm_or_si128(e_hi[0], e_hi[1]), e_hi[2]);
+            int outside = _mm_movemask_pd(_mm_castsi128_pd(or_lo)) |
+                          (_mm_movemask_pd(_mm_castsi128_pd(or_hi)) << 2);
+            int bits = ~outside & 0xF;
+            if (span_x < x0 || span_x + 4 > x1) bits &= range_bits(span_x, 4, x0, x1);
+            
+            for (int i = 0; i < 3; i++) {
+                e_lo[i] = _mm_add_epi64(e_lo[i], step[i]);
+                e_hi[i] = _mm_add_epi64(e_hi[i], step[i]);
+            }
+            __m128 lanes_x = x_rel;
+            x_rel = _mm_add_ps(x_rel, four);
+            if (!bits) {
+                if (entered) break;
+                continue;
+            }
+            entered = true;
+#if RENDER_PROFILING
+            counts.tested += lane_count4(bits);
+#endif
+            
+            __m128 z = _mm_add_ps(z_row, _mm_mul_ps(z_dx, lanes_x));
+            __m128 covered = _mm_castsi128_ps(_mm_cmpeq_epi32(
+                _mm_and_si128(_mm_set1_epi32(bits), lane_bits), lane_bits));
+            write_span_sse2(tri, colors, depths, span_x, covered, z, lanes_x, attr_row, attr_dx, color, counts);
+        }
+        
+        for (int i = 0; i < 3; i++) row[i] += tri.edge_b[i];
+    }
+    return counts;
+}
+
+// the avx2 kernel is the sse2 one at twice the width, with the same 32-bit edge lanes,
+// 64-bit fallback and early row exit
+__attribute__((target("avx2")))
+FragmentCounts rasterize_triangle_avx2(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return FragmentCounts();
+    FragmentCounts counts;
+    
+    const int xs = x0 & ~7;
+    const int x_last = ((x1 + 7) & ~7) - 1;
+    const bool narrow_edges = edges_fit_int32(tri, xs, x_last, y0, y1);
+    
+    const __m256 z_dx = _mm256_set1_ps(tri.z_dx);
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    const __m256 lane_x = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i lane_bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256 color = _mm256_castsi256_ps(_mm256_set1_epi32((int)tri.color));
+    __m256 attr_dx[4], attr_row[4];
+    for (int i = 0; i < 4; i++) attr_dx[i] = _mm256_set1_ps(tri.attr_dx[i]);
+    
+    int64_t row[3];
+    for (int i = 0; i < 3; i++) row[i] = tri.edge_a[i] * xs + tri.edge_b[i] * y0 + tri.edge_c[i];
+    
+    if (narrow_edges) {
+        // lane offsets and span step wrap in 32 bits, harmless since every tested sum fits
+        __m256i offset[3], step[3];
+        for (int i = 0; i < 3; i++) {
+            uint32_t a = (uint32_t)tri.edge_a[i];
+            offset[i] = _mm256_set_epi32((int)(7 * a), (int)(6 * a), (int)(5 * a), (int)(4 * a),
+                                         (int)(3 * a), (int)(2 * a), (int)a, 0);
+            step[i] = _mm256_set1_epi32((int)(8 * a));
+        }
+        const __m256i minus_one = _mm256_set1_epi32(-1);
+        
+        // the first and last span of every row clip to [x0, x1) with the same lane masks
+        const int last_span = (x1 - 1) & ~7;
+        const __m256i lane_index = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m256i first_mask = _mm256_cmpgt_epi32(lane_index, _mm256_set1_epi32(x0 - xs - 1));
+        const __m256i last_mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(x1 - last_span), lane_index);
+        
+        for (int y = y0; y < y1; y++) {
+            float* colors = reinterpret_cast<float*>(framebuffer.get_color_row(y));
+            float* depths = framebuffer.get_depth_row(y);
+            const __m256 z_row = _mm256_set1_ps(tri.z_origin + tri.z_dy * (float)(y - tri.min_y));
+            if (tri.smooth) {
+                for (int i = 0; i < 4; i++) {
+                    attr_row[i] = _mm256_set1_ps(tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y));
+                }
+            }
+            
+            __m256i e[3];
+            for (int i = 0; i < 3; i++) e[i] = _mm256_add_epi32(_mm256_set1_epi32((int32_t)row[i]), offset[i]);
+            __m256 x_rel = _mm256_add_ps(_mm256_set1_ps((float)(xs - tri.min_x)), lane_x);
+            
+            bool entered = false;
+            for (int span_x = xs; span_x < x1; span_x += 8) {
+                // inside where no edge is negative: or the edges and compare against -1
+                __m256i inside = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]), minus_one);
+                for (int i = 0; i < 3; i++) e[i] = _mm256_add_epi32(e[i], step[i]);
+                __m256 lanes_x = x_rel;
+                x_rel = _mm256_add_ps(x_rel, eight);
+                
+                if (span_x == xs) inside = _mm256_and_si256(inside, first_mask);
+                if (span_x == last_span) inside = _mm256_and_si256(inside, last_mask);
+                int bits = _mm256_movemask_ps(_mm256_castsi256_ps(inside));
+                if (!bits) {
+                    if (entered) break;
+                    continue;
+                }
+                entered = true;
+#if RENDER_PROFILING
+                counts.tested += lane_count8(bits);
+#endif
+                __m256 z = _mm256_add_ps(z_row, _mm256_mul_ps(z_dx, lanes_x));
+                write_span_avx2(tri, colors, depths, span_x, _mm256_castsi256_ps(inside), z, lanes_x,
+                                attr_row, attr_dx, color, counts);
+            }
+            
+            for (int i = 0; i < 3; i++) row[i] += tri.edge_b[i];
+        }
+        return counts;
+    }
+    
+    // per-edge lane offsets (4 int64 lanes per register, 2 registers per span) and span step
+    __m256i off_lo[3], off_hi[3], step[3];
+    for (int i = 0; i < 3; i++) {
+        int64_t a = tri.edge_a[i];
+        off_lo[i] = _mm256_set_epi64x(3 * a, 2 * a, a, 0);
+        off_hi[i] = _mm256_set_epi64x(7 * a, 6 * a, 5 * a, 4 * a);
+        step[i] = _mm256_set1_epi64x(8 * a);
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        float* colors = reinterpret_cast<float*>(framebuffer.get_color_row(y));
+        float* depths = framebuffer.get_depth_row(y);
+        const __m256 z_row = _mm256_set1_ps(tri.z_origin + tri.z_dy * (float)(y - tri.min_y));
+        if (tri.smooth) {
+            for (int i = 0; i < 4; i++) {
+                attr_row[i] = _mm256_set1_ps(tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y));
+            }
+        }
+        
+        __m256i e_lo[3], e_hi[3];
+        for (int i = 0; i < 3; i++) {
+            __m256i base = _mm256_set1_epi64x(row[i]);
+            e_lo[i] = _mm256_add_epi64(base, off_lo[i]);
+            e_hi[i] = _mm256_add_epi64(base, off_hi[i]);
+        }
+        __m256 x_rel = _mm256_add_ps(_mm256_set1_ps((float)(xs - tri.min_x)), lane_x);
+        
+        bool entered = false;
+        for (int span_x = xs; span_x < x1; span_x += 8) {
+            // outside when any edge is negative: or the edges, then collect the sign bits
+            __m256i or_lo = _mm256_or_si256(_mm256_or_si256(e_lo[0], e_lo[1]), e_lo[2]);
+            __m256i or_hi = _mm256_or_si256(_mm256_or_si256(e_hi[0], e_hi[1]), e_hi[2]);
+            int outside = _mm256_movemask_pd(_mm256_castsi256_pd(or_lo)) |
+                          (_mm256_movemask_pd(_mm256_castsi256_pd(or_hi)) << 4);
+            int bits = ~outside & 0xFF;
+            if (span_x < x0 || span_x + 8 > x1) bits &= range_bits(span_x, 8, x0, x1);
+            
+            for (int i = 0; i < 3; i++) {
+                e_lo[i] = _mm256_add_epi64(e_lo[i], step[i]);
+                e_hi[i] = _mm256_add_epi64(e_hi[i], step[i]);
+            }
+            __m256 lanes_x = x_rel;
+            x_rel = _mm256_add_ps(x_rel, eight);
+            if (!bits) {
+                if (entered) break;
+                continue;
+            }
+            entered = true;
+#if RENDER_PROFILING
+            counts.tested += lane_count8(bits);
+#endif
+            
+            __m256 z = _mm256_add_ps(z_row, _mm256_mul_ps(z_dx, lanes_x));
+            __m256 covered = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                _mm256_and_si256(_mm256_set1_epi32(bits), lane_bits), lane_bits));
+            write_span_avx2(tri, colors, depths, span_x, covered, z, lanes_x, attr_row, attr_dx, color, counts);
+        }
+        
+        for (int i = 0; i < 3; i++) row[i] += tri.edge_b[i];
+    }
+    return counts;
+}
+
+// the multisampled kernel works on a sample tile, whose 64-pixel rows hold whole aligned spans
+
+__attribute__((target("avx2")))
+FragmentCounts rasterize_msaa_avx2(const RasterTriangle& tri, const TileRect& rect, SampleTile& tile) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return FragmentCounts();
+    FragmentCounts counts;
+    
+    const int xs = x0 & ~7;
+    
+    // per-edge lane offsets of the pixel centers (4 int64 lanes per register, 2 registers per
+    // span), span step, and the offset of each sample from its center
+    __m256i off_lo[3], off_hi[3], step[3];
+    for (int i = 0; i < 3; i++) {
+        int64_t a = tri.edge_a[i];
+        off_lo[i] = _mm256_set_epi64x(3 * a, 2 * a, a, 0);
+        off_hi[i] = _mm256_set_epi64x(7 * a, 6 * a, 5 * a, 4 * a);
+        step[i] = _mm256_set1_epi64x(8 * a);
+    }
+    int64_t edge_offsets[MSAA_SAMPLES][3];
+    float z_offsets[MSAA_SAMPLES];
+    sample_offsets(tri, edge_offsets, z_offsets);
+    __m256i sample_edge[MSAA_SAMPLES][3];
+    __m256 sample_z[MSAA_SAMPLES], sample_x[MSAA_SAMPLES], sample_y[MSAA_SAMPLES];
+    for (int s = 0; s < MSAA_SAMPLES; s++) {
+        for (int i = 0; i < 3; i++) sample_edge[s][i] = _mm256_set1_epi64x(edge_offsets[s][i]);
+        sample_z[s] = _mm256_set1_ps(z_offsets[s]);
+        sample_x[s] = _mm256_set1_ps((float)MSAA_OFFSETS[s][0] / SUBPIXEL_SCALE);
+        sample_y[s] = _mm256_set1_ps((float)MSAA_OFFSETS[s][1] / SUBPIXEL_SCALE);
+    }
+    
+    const __m256 z_dx = _mm256_set1_ps(tri.z_dx);
+    const __m256 lane_x = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i lane_bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256 color = _mm256_castsi256_ps(_mm256_set1_epi32((int)tri.color));
+    __m256 attr_dx[4], attr_dy[4], attr_row[4];
+    for (int i = 0; i < 4; i++) {
+        attr_dx[i] = _mm256_set1_ps(tri.attr_dx[i]);
+        attr_dy[i] = _mm256_set1_ps(tri.attr_dy[i]);
+    }
+    
+    int64_t row[3];
+    for (int i = 0; i < 3; i++) row[i] = tri.edge_a[i] * xs + tri.edge_b[i] * y0 + tri.edge_c[i];
+    
+    for (int y = y0; y < y1; y++) {
+        float* colors[MSAA_SAMPLES];
+        float* depths[MSAA_SAMPLES];
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            colors[s] = reinterpret_cast<float*>(tile.get_color_row(s, y));
+            depths[s] = tile.get_depth_row(s, y);
+        }
+        const __m256 z_row = _mm256_set1_ps(tri.z_origin + tri.z_dy * (float)(y - tri.min_y));
+        if (tri.smooth) {
+            for (int i = 0; i < 4; i++) {
+                attr_row[i] = _mm256_set1_ps(tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y));
+            }
+        }
+        
+        __m256i e_lo[3], e_hi[3];
+        for (int i = 0; i < 3; i++) {
+            __m256i base = _mm256_set1_epi64x(row[i]);
+            e_lo[i] = _mm256_add_epi64(base, off_lo[i]);
+            e_hi[i] = _mm256_add_epi64(base, off_hi[i]);
+        }
+        
+        for (int span_x = xs; span_x < x1; span_x += 8) {
+            int range = (span_x < x0 || span_x + 8 > x1) ? range_bits(span_x, 8, x0, x1) : 0xFF;
+            int lx = span_x - tile.get_x0();
+            __m256 x_rel = _mm256_add_ps(_mm256_set1_ps((float)(span_x - tri.min_x)), lane_x);
+            __m256 z = _mm256_add_ps(z_row, _mm256_mul_ps(z_dx, x_rel));
+            
+            // coverage and depth per sample plane; depths are stored as they pass, colors wait
+            // until the span's one shading is known
+            __m256i pass[MSAA_SAMPLES];
+            int cover_bits[MSAA_SAMPLES], pass_bits[MSAA_SAMPLES];
+            int covered = 0, passed = 0;
+            for (int s = 0; s < MSAA_SAMPLES; s++) {
+                cover_bits[s] = pass_bits[s] = 0;
+                __m256i or_lo = _mm256_or_si256(_mm256_add_epi64(e_lo[0], sample_edge[s][0]),
+                                                _mm256_add_epi64(e_lo[1], sample_edge[s][1]));
+                __m256i or_hi = _mm256_or_si256(_mm256_add_epi64(e_hi[0], sample_edge[s][0]),
+                                                _mm256_add_epi64(e_hi[1], sample_edge[s][1]));
+                or_lo = _mm256_or_si256(or_lo, _mm256_add_epi64(e_lo[2], sample_edge[s][2]));
+                or_hi = _mm256_or_si256(or_hi, _mm256_add_epi64(e_hi[2], sample_edge[s][2]));
+                int outside = _mm256_movemask_pd(_mm256_castsi256_pd(or_lo)) |
+                              (_mm256_movemask_pd(_mm256_castsi256_pd(or_hi)) << 4);
+                int bits = ~outside & range;
+                if (!bits) continue;
+                cover_bits[s] = bits;
+                covered |= bits;
+                
+                __m256 sample_depth = _mm256_add_ps(z, sample_z[s]);
+                __m256 depth = _mm256_load_ps(depths[s] + lx);
+                __m256 coverage = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                    _mm256_and_si256(_mm256_set1_epi32(bits), lane_bits), lane_bits));
+                __m256 sample_pass = _mm256_and_ps(_mm256_cmp_ps(sample_depth, depth, _CMP_LT_OQ), coverage);
+                pass_bits[s] = _mm256_movemask_ps(sample_pass);
+                if (!pass_bits[s]) continue;
+                pass[s] = _mm256_castps_si256(sample_pass);
+                _mm256_maskstore_ps(depths[s] + lx, pass[s], sample_depth);
+                passed |= pass_bits[s];
+            }
+            
+            // lanes whose centers lie outside the triangle shade at their first covered sample
+            int off_center = 0;
+            if (tri.smooth && passed) {
+                __m256i or_lo = _mm256_or_si256(_mm256_or_si256(e_lo[0], e_lo[1]), e_lo[2]);
+                __m256i or_hi = _mm256_or_si256(_mm256_or_si256(e_hi[0], e_hi[1]), e_hi[2]);
+                off_center = (_mm256_movemask_pd(_mm256_castsi256_pd(or_lo)) |
+                              (_mm256_movemask_pd(_mm256_castsi256_pd(or_hi)) << 4)) & passed;
+            }
+            
+            for (int i = 0; i < 3; i++) {
+                e_lo[i] = _mm256_add_epi64(e_lo[i], step[i]);
+                e_hi[i] = _mm256_add_epi64(e_hi[i], step[i]);
+            }
+#if RENDER_PROFILING
+            counts.tested += lane_count8(covered);
+#endif
+            if (!passed) continue;
+            counts.written += lane_count8(passed);
+            
+            __m256 new_color = color;
+            if (tri.smooth && !off_center) {
+                new_color = _mm256_castsi256_ps(shade_span_avx2(attr_row, attr_dx, x_rel));
+            } else if (tri.smooth) {
+                // later samples first, so the first covered one is the offset left in each lane
+                __m256 shift_x = _mm256_setzero_ps(), shift_y = _mm256_setzero_ps();
+                for (int s = MSAA_SAMPLES - 1; s >= 0; s--) {
+                    int lanes = cover_bits[s] & off_center;
+                    if (!lanes) continue;
+                    __m256 select = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                        _mm256_and_si256(_mm256_set1_epi32(lanes), lane_bits), lane_bits));
+                    shift_x = _mm256_blendv_ps(shift_x, sample_x[s], select);
+                    shift_y = _mm256_blendv_ps(shift_y, sample_y[s], select);
+                }
+                __m256 shifted_row[4];
+                for (int i = 0; i < 4; i++) {
+                    shifted_row[i] = _mm256_add_ps(attr_row[i], _mm256_mul_ps(attr_dy[i], shift_y));
+                }
+                new_color = _mm256_castsi256_ps(shade_span_avx2(shifted_row, attr_dx, _mm256_add_ps(x_rel, shift_x)));
+            }
+            for (int s = 0; s < MSAA_SAMPLES; s++) {
+                if (pass_bits[s]) _mm256_maskstore_ps(colors[s] + lx, pass[s], new_color);
+            }
+        }
+        
+        for (int i = 0; i < 3; i++) row[i] += tri.edge_b[i];
+    }
+    return counts;
+}
+
+__attribute__((target("sse2")))
+void resolve_samples_sse2(const SampleTile& tile, Framebuffer& framebuffer) {
+    const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(2);
+    int x0 = tile.get_x0(), span = tile.get_span();
+    for (int y = tile.get_y0(); y < tile.get_y1(); y++) {
+        uint32_t* colors = framebuffer.get_color_row(y) + x0;
+        float* depths = framebuffer.get_depth_row(y) + x0;
+        const uint32_t* c[MSAA_SAMPLES];
+        const float* d[MSAA_SAMPLES];
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            c[s] = tile.get_color_row(s, y);
+            d[s] = tile.get_depth_row(s, y);
+        }
+        
+        // spans are multiples of 16 pixels, so whole 4-pixel steps cover them
+        for (int x = 0; x < span; x += 4) {
+            __m128i lo = round, hi = round;
+            for (int s = 0; s < MSAA_SAMPLES; s++) {
+                __m128i packed = _mm_load_si128(reinterpret_cast<const __m128i*>(c[s] + x));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(packed, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(packed, zero));
+            }
+            lo = _mm_srli_epi16(lo, 2);
+            hi = _mm_srli_epi16(hi, 2);
+            _mm_store_si128(reinterpret_cast<__m128i*>(colors + x), _mm_packus_epi16(lo, hi));
+            
+            __m128 near01 = _mm_min_ps(_mm_load_ps(d[0] + x), _mm_load_ps(d[1] + x));
+            __m128 near23 = _mm_min_ps(_mm_load_ps(d[2] + x), _mm_load_ps(d[3] + x));
+            _mm_store_ps(depths + x, _mm_min_ps(near01, near23));
+        }
+    }
+}
+
+#endif
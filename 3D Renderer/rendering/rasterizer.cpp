@@ -0,0 +1,542 @@
+// rasterizer.cpp
+// implementation of fixed-point edge-function triangle rasterization
+// the same routine serves the full screen and individual 64x64 tiles
+
+#include "rasterizer.h"
+#include "raster_kernels.h"
+#include "../math/color.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+    // vertices are clamped to +-2^20 pixels so every edge product fits in 64 bits
+    const float MAX_COORDINATE = 1048576.0f;
+    
+    int64_t snap(float v) {
+        return (int64_t)std::llround(std::clamp(v, -MAX_COORDINATE, MAX_COORDINATE) * SUBPIXEL_SCALE);
+    }
+    
+    // integer division rounding toward negative / positive infinity
+    int64_t floor_div(int64_t value, int64_t divisor) {
+        int64_t q = value / divisor;
+        return (value % divisor != 0 && value < 0) ? q - 1 : q;
+    }
+    
+    int64_t ceil_div(int64_t value, int64_t divisor) {
+        return -floor_div(-value, divisor);
+    }
+    
+    // triangles spanning fewer pixel columns than this always take the scalar kernel; the
+    // 4-wide sse2 kernel needs rows of several spans before it pays for its row setup
+    const int NARROW_TRIANGLE = 8;
+    const int NARROW_TRIANGLE_SSE2 = 16;
+    
+    using RasterKernel = FragmentCounts (*)(const RasterTriangle&, const TileRect&, Framebuffer&);
+    
+    void add_fragments(RasterStats& stats, const FragmentCounts& counts) {
+        stats.fragments_tested += counts.tested;
+        stats.fragments_written += counts.written;
+    }
+    
+    RasterKernel kernel_for(SimdLevel level) {
+#if RENDER_HAS_X86_SIMD
+        if (level == SimdLevel::AVX2) return rasterize_triangle_avx2;
+        if (level == SimdLevel::SSE2) return rasterize_triangle_sse2;
+#endif
+        (void)level;
+        return rasterize_triangle_scalar;
+    }
+    
+    // multisampled kernels exist in scalar and avx2 form; sse2 cpus take the scalar one
+    using MsaaKernel = FragmentCounts (*)(const RasterTriangle&, const TileRect&, SampleTile&);
+    
+    int narrow_width_for(SimdLevel level) {
+        return level == SimdLevel::SSE2 ? NARROW_TRIANGLE_SSE2 : NARROW_TRIANGLE;
+    }
+    
+    MsaaKernel msaa_kernel_for(SimdLevel level) {
+#if RENDER_HAS_X86_SIMD
+        if (level == SimdLevel::AVX2) return rasterize_msaa_avx2;
+#endif
+        (void)level;
+        return rasterize_msaa_scalar;
+    }
+    
+    SimdLevel active_level = detect_simd_level();
+    RasterKernel active_kernel = kernel_for(active_level);
+    int active_narrow_width = narrow_width_for(active_level);
+    MsaaKernel active_msaa_kernel = msaa_kernel_for(active_level);
+    bool hiz_enabled = true;
+    
+    // slack between the plane bounds below and per-pixel depths, which round in a different order
+    const float HIZ_EPSILON = 1e-5f;
+    
+    float hiz_margin(float z) {
+        return HIZ_EPSILON * (1.0f + std::fabs(z));
+    }
+}
+
+namespace {
+    // shared setup; colors and inv_w are null for flat triangles
+    // reach is how far from its pixel center a sample may lie, in 1/256 pixel
+    bool setup_common(const Vec3* points[3], const Vec3* colors, const float* inv_w,
+                      const TileRect& viewport, int reach, RasterTriangle& tri) {
+        for (int i = 0; i < 3; i++) {
+            const Vec3* p = points[i];
+            if (!std::isfinite(p->x) || !std::isfinite(p->y) || !std::isfinite(p->z)) return false;
+        }
+        
+        // snap to the sub-pixel grid so every edge test below is exact integer math
+        int64_t x[3], y[3];
+        float z[3];
+        int order[3] = {0, 1, 2};
+        for (int i = 0; i < 3; i++) {
+            x[i] = snap(points[i]->x);
+            y[i] = snap(points[i]->y);
+            z[i] = points[i]->z;
+        }
+        
+        // twice the signed area; normalize winding so the interior is where all edges are positive
+        int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0) return false;
+        if (area < 0) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            std::swap(order[1], order[2]);
+            area = -area;
+        }
+        
+        // pixels whose centers (or samples) can lie inside the triangle, clamped to the viewport
+        const int64_t half = SUBPIXEL_SCALE / 2;
+        int64_t min_x = ceil_div(std::min({x[0], x[1], x[2]}) - half - reach, SUBPIXEL_SCALE);
+        int64_t max_x = floor_div(std::max({x[0], x[1], x[2]}) - half + reach, SUBPIXEL_SCALE) + 1;
+        int64_t min_y = ceil_div(std::min({y[0], y[1], y[2]}) - half - reach, SUBPIXEL_SCALE);
+        int64_t max_y = floor_div(std::max({y[0], y[1], y[2]}) - half + reach, SUBPIXEL_SCALE) + 1;
+        tri.min_x = (int)std::max<int64_t>(viewport.x0, min_x);
+        tri.max_x = (int)std::min<int64_t>(viewport.x1, max_x);
+        tri.min_y = (int)std::max<int64_t>(viewport.y0, min_y);
+        tri.max_y = (int)std::min<int64_t>(viewport.y1, max_y);
+        if (tri.min_x >= tri.max_x || tri.min_y >= tri.max_y) return false;
+        
+        for (int i = 0; i < 3; i++) {
+            int j = (i + 1) % 3;
+            int64_t dx = x[j] - x[i];
+            int64_t dy = y[j] - y[i];
+            
+            // e(p) = dx * (p.y - y[i]) - dy * (p.x - x[i]), stepped one whole pixel at a time
+            tri.edge_a[i] = -dy * SUBPIXEL_SCALE;
+            tri.edge_b[i] = dx * SUBPIXEL_SCALE;
+            tri.edge_c[i] = dx * (half - y[i]) - dy * (half - x[i]);
+            
+            // top-left rule: pixels exactly on a right or bottom edge belong to the neighbor
+            bool top_left = (-dy > 0) || (dy == 0 && dx > 0);
+            if (!top_left) tri.edge_c[i] -= 1;
+        }
+        
+        // depth plane from the snapped vertices, anchored at the first covered pixel center
+        double fx[3], fy[3];
+        for (int i = 0; i < 3; i++) {
+            fx[i] = (double)x[i] / SUBPIXEL_SCALE;
+            fy[i] = (double)y[i] / SUBPIXEL_SCALE;
+        }
+        double det = (double)area / ((double)SUBPIXEL_SCALE * SUBPIXEL_SCALE);
+        auto plane = [&](const float v[3], float& origin, float& step_x, float& step_y) {
+            double v_dx = ((v[1] - v[0]) * (fy[2] - fy[0]) - (v[2] - v[0]) * (fy[1] - fy[0])) / det;
+            double v_dy = ((v[2] - v[0]) * (fx[1] - fx[0]) - (v[1] - v[0]) * (fx[2] - fx[0])) / det;
+            step_x = (float)v_dx;
+            step_y = (float)v_dy;
+            origin = (float)(v[0] + v_dx * (tri.min_x + 0.5 - fx[0]) + v_dy * (tri.min_y + 0.5 - fy[0]));
+        };
+        plane(z, tri.z_origin, tri.z_dx, tri.z_dy);
+        tri.z_min = std::min({z[0], z[1], z[2]});
+        tri.z_max = std::max({z[0], z[1], z[2]});
+        
+        // screen-space depth is already affine in x and y, but colors are only affine after
+        // division by w, so they are interpolated as color/w and divided by the 1/w plane per pixel
+        tri.smooth = colors != nullptr;
+        if (tri.smooth) {
+            float v[4][3];
+            for (int i = 0; i < 3; i++) {
+                const Vec3& c = colors[order[i]];
+                float w = inv_w[order[i]];
+                v[0][i] = c.x * w;
+                v[1][i] = c.y * w;
+                v[2][i] = c.z * w;
+                v[3][i] = w;
+            }
+            for (int k = 0; k < 4; k++) plane(v[k], tri.attr_origin[k], tri.attr_dx[k], tri.attr_dy[k]);
+        }
+        return true;
+    }
+}
+
+bool setup_triangle(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& color,
+                    const TileRect& viewport, RasterTriangle& tri, bool multisample) {
+    const Vec3* points[3] = {&p0, &p1, &p2};
+    if (!setup_common(points, nullptr, nullptr, viewport, multisample ? MSAA_REACH : 0, tri)) return false;
+    tri.color = Color::to_packed(color);
+    return true;
+}
+
+bool setup_triangle(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3 colors[3], const float inv_w[3],
+                    const TileRect& viewport, RasterTriangle& tri, bool multisample) {
+    const Vec3* points[3] = {&p0, &p1, &p2};
+    if (!setup_common(points, colors, inv_w, viewport, multisample ? MSAA_REACH : 0, tri)) return false;
+    tri.color = 0;
+    return true;
+}
+
+namespace {
+    // hierarchical z over the blocks of the clamped rectangle [x0, x1) x [y0, y1), for either target:
+    // max_depth(bx, by) is a block's entry, reach how far a sample lies from its pixel center in
+    // 1/256 pixel, and draw(rect) runs the kernel over each run of blocks that survive
+    template <typename MaxDepth, typename Draw>
+    void rasterize_blocks(const RasterTriangle& tri, int x0, int y0, int x1, int y1, int reach,
+                          MaxDepth max_depth, Draw draw, RasterStats& counts) {
+        counts.triangles_tested = 1;
+        if (!hiz_enabled) {
+            draw(TileRect{x0, y0, x1, y1});
+            return;
+        }
+        
+        // a plane's extremes over a block lie on its corners, so the nearest and farthest depth of a
+        // block are its top-left depth plus fixed offsets; the vertex range tightens extrapolated
+        // corners, and samples widen the block by their reach on every side
+        const int last = HIZ_BLOCK_SIZE - 1;
+        const float z_reach = (std::fabs(tri.z_dx) + std::fabs(tri.z_dy)) * ((float)reach / SUBPIXEL_SCALE);
+        const float near_offset = std::min(0.0f, tri.z_dx * last) + std::min(0.0f, tri.z_dy * last) - z_reach;
+        const float far_offset = std::max(0.0f, tri.z_dx * last) + std::max(0.0f, tri.z_dy * last) + z_reach;
+        auto block_depth = [&](int bx, float z_row) {
+            return z_row + tri.z_dx * (float)(bx * HIZ_BLOCK_SIZE - tri.min_x);
+        };
+        auto hidden = [&](float block_z, float entry) {
+            float z_near = std::max(tri.z_min, block_z + near_offset);
+            return z_near - hiz_margin(z_near) >= entry;
+        };
+        
+        // likewise each edge function is smallest on the block corner picked by the signs of its steps
+        int64_t edge_offset[3], edge_step[3];
+        for (int i = 0; i < 3; i++) {
+            int64_t a = tri.edge_a[i], b = tri.edge_b[i];
+            edge_offset[i] = std::min<int64_t>(0, a * last) + std::min<int64_t>(0, b * last) -
+                             (std::abs(a) + std::abs(b)) / SUBPIXEL_SCALE * reach;
+            edge_step[i] = a * HIZ_BLOCK_SIZE;
+        }
+        
+        // test every 8x8 block against the hierarchical z, lowering the entries of blocks the
+        // triangle covers completely; an entry lowered here never rejects its own triangle
+        int bx0 = x0 / HIZ_BLOCK_SIZE, bx1 = (x1 - 1) / HIZ_BLOCK_SIZE;
+        int by0 = y0 / HIZ_BLOCK_SIZE, by1 = (y1 - 1) / HIZ_BLOCK_SIZE;
+        uint64_t rejected = 0;
+        for (int by = by0; by <= by1; by++) {
+            int block_y = by * HIZ_BLOCK_SIZE;
+            bool whole_rows = block_y >= y0 && block_y + HIZ_BLOCK_SIZE <= y1;
+            float z_row = tri.z_origin + tri.z_dy * (float)(block_y - tri.min_y);
+            
+            int64_t e[3];
+            for (int i = 0; i < 3; i++) {
+                e[i] = tri.edge_a[i] * (bx0 * HIZ_BLOCK_SIZE) + tri.edge_b[i] * block_y + tri.edge_c[i] +
+                       edge_offset[i];
+            }
+            
+            for (int bx = bx0; bx <= bx1; bx++) {
+                float block_z = block_depth(bx, z_row);
+                float& entry = max_depth(bx, by);
+                if (hidden(block_z, entry)) {
+                    // every pixel of the block already holds something nearer
+                    rejected++;
+                } else if (whole_rows && (e[0] | e[1] | e[2]) >= 0) {
+                    // after a fully covered block every pixel is at least as near as the triangle there
+                    int block_x = bx * HIZ_BLOCK_SIZE;
+                    if (block_x >= x0 && block_x + HIZ_BLOCK_SIZE <= x1) {
+                        float z_far = std::min(tri.z_max, block_z + far_offset);
+                        entry = std::min(entry, z_far + hiz_margin(z_far));
+                    }
+                }
+                for (int i = 0; i < 3; i++) e[i] += edge_step[i];
+            }
+        }
+        
+        uint64_t tested = (uint64_t)(bx1 - bx0 + 1) * (by1 - by0 + 1);
+        counts.blocks_tested = tested;
+        counts.blocks_rejected = rejected;
+        bool drawn = rejected < tested;
+        
+        if (rejected == 0) {
+            draw(TileRect{x0, y0, x1, y1});
+        } else if (drawn) {
+            // hand each run of surviving blocks in a block row to the kernel
+            for (int by = by0; by <= by1; by++) {
+                int block_y = by * HIZ_BLOCK_SIZE;
+                int sy0 = std::max(y0, block_y), sy1 = std::min(y1, block_y + HIZ_BLOCK_SIZE);
+                float z_row = tri.z_origin + tri.z_dy * (float)(block_y - tri.min_y);
+                
+                int run_x0 = 0, run_x1 = 0;
+                for (int bx = bx0; bx <= bx1; bx++) {
+                    if (hidden(block_depth(bx, z_row), max_depth(bx, by))) {
+                        if (run_x0 < run_x1) draw(TileRect{run_x0, sy0, run_x1, sy1});
+                        run_x0 = run_x1 = 0;
+                        continue;
+                    }
+                    if (run_x0 == run_x1) run_x0 = std::max(x0, bx * HIZ_BLOCK_SIZE);
+                    run_x1 = std::min(x1, (bx + 1) * HIZ_BLOCK_SIZE);
+                }
+                if (run_x0 < run_x1) draw(TileRect{run_x0, sy0, run_x1, sy1});
+            }
+        }
+        
+        if (!drawn) counts.triangles_rejected = 1;
+    }
+}
+
+void rasterize_triangle(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer,
+                        RasterStats* stats) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return;
+    framebuffer.prepare_region(x0, y0, x1, y1);
+    
+    // a triangle narrower than a few simd spans gains nothing from simd setup, so keep it scalar
+    RasterKernel kernel = (tri.max_x - tri.min_x < active_narrow_width) ? rasterize_triangle_scalar : active_kernel;
+    
+    RasterStats counts;
+    rasterize_blocks(tri, x0, y0, x1, y1, 0,
+                     [&](int bx, int by) -> float& { return framebuffer.get_max_depth_row(by)[bx]; },
+                     [&](const TileRect& run) { add_fragments(counts, kernel(tri, run, framebuffer)); }, counts);
+    if (stats) stats->add(counts);
+}
+
+void rasterize_triangle_msaa(const RasterTriangle& tri, SampleTile& tile, RasterStats* stats) {
+    int x0 = std::max(tile.get_x0(), tri.min_x), x1 = std::min(tile.get_x1(), tri.max_x);
+    int y0 = std::max(tile.get_y0(), tri.min_y), y1 = std::min(tile.get_y1(), tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return;
+    
+    MsaaKernel kernel = (tri.max_x - tri.min_x < NARROW_TRIANGLE) ? rasterize_msaa_scalar : active_msaa_kernel;
+    
+    RasterStats counts;
+    rasterize_blocks(tri, x0, y0, x1, y1, MSAA_REACH,
+                     [&](int bx, int by) -> float& { return tile.max_depth(bx, by); },
+                     [&](const TileRect& run) { add_fragments(counts, kernel(tri, run, tile)); }, counts);
+    if (stats) stats->add(counts);
+}
+
+void resolve_samples(const SampleTile& tile, Framebuffer& framebuffer) {
+#if RENDER_HAS_X86_SIMD
+    if (active_level >= SimdLevel::SSE2) {
+        resolve_samples_sse2(tile, framebuffer);
+    } else {
+        resolve_samples_scalar(tile, framebuffer);
+    }
+#else
+    resolve_samples_scalar(tile, framebuffer);
+#endif
+    
+    // the tile's entries bound every sample, so also the nearest of each pixel's samples
+    int x1 = tile.get_x1(), y1 = tile.get_y1();
+    for (int by = tile.get_y0() / HIZ_BLOCK_SIZE; by * HIZ_BLOCK_SIZE < y1; by++) {
+        float* entries = framebuffer.get_max_depth_row(by);
+        for (int bx = tile.get_x0() / HIZ_BLOCK_SIZE; bx * HIZ_BLOCK_SIZE < x1; bx++) {
+            entries[bx] = std::min(entries[bx], tile.max_depth(bx, by));
+        }
+    }
+}
+
+void rasterize_depth(const RasterTriangle& tri, const TileRect& rect, float* depth, int stride) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return;
+    
+    int64_t e[3];
+    for (int i = 0; i < 3; i++) e[i] = tri.edge_a[i] * x0 + tri.edge_b[i] * y0 + tri.edge_c[i];
+    for (int y = y0; y < y1; y++) {
+        // e + a*k >= 0 bounds the step k from x0 below for a > 0 and from above for a < 0
+        int64_t lo = x0, hi = x1;
+        for (int i = 0; i < 3; i++) {
+            int64_t a = tri.edge_a[i];
+            if (a > 0) {
+                if (e[i] < 0) lo = std::max(lo, x0 + ceil_div(-e[i], a));
+            } else if (a < 0) {
+                hi = e[i] < 0 ? lo : std::min(hi, x0 + floor_div(e[i], -a) + 1);
+            } else if (e[i] < 0) {
+                hi = lo;
+            }
+        }
+        
+        float* row = depth + (size_t)y * stride;
+        float z_row = tri.z_origin + tri.z_dy * (float)(y - tri.min_y);
+        for (int64_t x = lo; x < hi; x++) {
+            float z = z_row + tri.z_dx * (float)(x - tri.min_x);
+            row[x] = std::min(row[x], z);
+        }
+        for (int i = 0; i < 3; i++) e[i] += tri.edge_b[i];
+    }
+}
+
+void set_raster_simd_level(SimdLevel level) {
+    active_level = std::min(level, detect_simd_level());
+    active_kernel = kernel_for(active_level);
+    active_narrow_width = narrow_width_for(active_level);
+    active_msaa_kernel = msaa_kernel_for(active_level);
+}
+
+SimdLevel get_raster_simd_level() {
+    return active_level;
+}
+
+void set_raster_hiz(bool enabled) {
+    hiz_enabled = enabled;
+}
+
+bool get_raster_hiz() {
+    return hiz_enabled;
+}
+
+FragmentCounts rasterize_triangle_scalar(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return FragmentCounts();
+    FragmentCounts counts;
+    
+    // edge values at the first pixel of the first row, then stepped incrementally
+    int64_t row[3];
+    for (int i = 0; i < 3; i++) {
+        row[i] = tri.edge_a[i] * x0 + tri.edge_b[i] * y0 + tri.edge_c[i];
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+        float z_row = tri.z_origin + tri.z_dy * (float)(y - tri.min_y);
+        uint32_t* colors = framebuffer.get_color_row(y);
+        float* depths = framebuffer.get_depth_row(y);
+        float attr_row[4];
+        if (tri.smooth) {
+            for (int i = 0; i < 4; i++) attr_row[i] = tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y);
+        }
+        
+        for (int x = x0; x < x1; x++) {
+            // inside when no edge value is negative, tested with a single sign check
+            if ((e0 | e1 | e2) >= 0) {
+#if RENDER_PROFILING
+                counts.tested++;
+#endif
+                float x_rel = (float)(x - tri.min_x);
+                float z = z_row + tri.z_dx * x_rel;
+                if (z < depths[x]) {
+                    colors[x] = tri.smooth ? shade_pixel(tri, attr_row, x_rel) : tri.color;
+                    depths[x] = z;
+                    counts.written++;
+                }
+            }
+            e0 += tri.edge_a[0];
+            e1 += tri.edge_a[1];
+            e2 += tri.edge_a[2];
+        }
+        
+        row[0] += tri.edge_b[0];
+        row[1] += tri.edge_b[1];
+        row[2] += tri.edge_b[2];
+    }
+    return counts;
+}
+
+FragmentCounts rasterize_msaa_scalar(const RasterTriangle& tri, const TileRect& rect, SampleTile& tile) {
+    int x0 = std::max(rect.x0, tri.min_x), x1 = std::min(rect.x1, tri.max_x);
+    int y0 = std::max(rect.y0, tri.min_y), y1 = std::min(rect.y1, tri.max_y);
+    if (x0 >= x1 || y0 >= y1) return FragmentCounts();
+    FragmentCounts counts;
+    
+    int64_t sample_edge[MSAA_SAMPLES][3];
+    float sample_z[MSAA_SAMPLES];
+    sample_offsets(tri, sample_edge, sample_z);
+    
+    // edge values at the center of the first pixel of the first row, then stepped incrementally
+    int64_t row[3];
+    for (int i = 0; i < 3; i++) {
+        row[i] = tri.edge_a[i] * x0 + tri.edge_b[i] * y0 + tri.edge_c[i];
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+        float z_row = tri.z_origin + tri.z_dy * (float)(y - tri.min_y);
+        uint32_t* colors[MSAA_SAMPLES];
+        float* depths[MSAA_SAMPLES];
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            colors[s] = tile.get_color_row(s, y);
+            depths[s] = tile.get_depth_row(s, y);
+        }
+        float attr_row[4];
+        if (tri.smooth) {
+            for (int i = 0; i < 4; i++) attr_row[i] = tri.attr_origin[i] + tri.attr_dy[i] * (float)(y - tri.min_y);
+        }
+        
+        for (int x = x0; x < x1; x++) {
+            int lx = x - tile.get_x0();
+            float x_rel = (float)(x - tri.min_x);
+            float z = z_row + tri.z_dx * x_rel;
+            int covered = 0, passed = 0;
+            for (int s = 0; s < MSAA_SAMPLES; s++) {
+                if (((e0 + sample_edge[s][0]) | (e1 + sample_edge[s][1]) | (e2 + sample_edge[s][2])) < 0) continue;
+                covered |= 1 << s;
+                float sample_depth = z + sample_z[s];
+                if (sample_depth < depths[s][lx]) {
+                    depths[s][lx] = sample_depth;
+                    passed |= 1 << s;
+                }
+            }
+#if RENDER_PROFILING
+            counts.tested += covered != 0;
+#endif
+            
+            // one color per pixel, at its center or else its first covered sample, for every sample
+            // the triangle won
+            if (passed) {
+                uint32_t color = tri.color;
+                if (tri.smooth && (e0 | e1 | e2) >= 0) {
+                    color = shade_pixel(tri, attr_row, x_rel);
+                } else if (tri.smooth) {
+                    int first = 0;
+                    while (!(covered & (1 << first))) first++;
+                    color = shade_sample(tri, attr_row, x_rel, first);
+                }
+                for (int s = 0; s < MSAA_SAMPLES; s++) {
+                    if (passed & (1 << s)) colors[s][lx] = color;
+                }
+                counts.written++;
+            }
+            e0 += tri.edge_a[0];
+            e1 += tri.edge_a[1];
+            e2 += tri.edge_a[2];
+        }
+        
+        row[0] += tri.edge_b[0];
+        row[1] += tri.edge_b[1];
+        row[2] += tri.edge_b[2];
+    }
+    return counts;
+}
+
+void resolve_samples_scalar(const SampleTile& tile, Framebuffer& framebuffer) {
+    int x0 = tile.get_x0(), span = tile.get_span();
+    for (int y = tile.get_y0(); y < tile.get_y1(); y++) {
+        uint32_t* colors = framebuffer.get_color_row(y) + x0;
+        float* depths = framebuffer.get_depth_row(y) + x0;
+        const uint32_t* c[MSAA_SAMPLES];
+        const float* d[MSAA_SAMPLES];
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            c[s] = tile.get_color_row(s, y);
+            d[s] = tile.get_depth_row(s, y);
+        }
+        for (int x = 0; x < span; x++) {
+            uint32_t packed = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = 2;
+                for (int s = 0; s < MSAA_SAMPLES; s++) sum += (c[s][x] >> shift) & 0xFF;
+                packed |= (sum >> 2) << shift;
+            }
+            colors[x] = packed;
+            depths[x] = std::min(std::min(d[0][x], d[1][x]), std::min(d[2][x], d[3][x]));
+        }
+    }
+}
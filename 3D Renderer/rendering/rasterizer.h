@@ -0,0 +1,109 @@
+// rasterizer.h
+// triangle rasterization shared by the immediate and tile-binned render paths
+// every routine writes only inside a caller-supplied screen rectangle
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "../math/Vec3.h"
+#include "../core/cpu_features.h"
+#include "framebuffer.h"
+#include <cstdint>
+
+// vertices are snapped to 1/256 pixel before edge setup
+constexpr int SUBPIXEL_BITS = 8;
+constexpr int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+// multisample positions relative to the pixel center in 1/256 pixel, the rotated 4x grid: every
+// sample has its own row and column, so near-horizontal and near-vertical edges get four levels
+constexpr int MSAA_OFFSETS[MSAA_SAMPLES][2] = {{-32, -96}, {96, -32}, {-96, 32}, {32, 96}};
+constexpr int MSAA_REACH = 96;  // largest offset along either axis
+
+// half-open pixel rectangle [x0, x1) x [y0, y1)
+struct TileRect {
+    int x0, y0, x1, y1;
+};
+
+// screen-space triangle set up for edge-function traversal
+// each edge function is e(x, y) = a*x + b*y + c, evaluated at pixel centers in fixed point
+// and a pixel is covered when all three are non-negative (top-left fill rule folded into c)
+struct RasterTriangle {
+    int min_x, min_y, max_x, max_y;  // covered pixel bounds clamped to the viewport, half-open
+    int64_t edge_a[3];               // step per pixel in x
+    int64_t edge_b[3];               // step per pixel in y
+    int64_t edge_c[3];               // value at the center of pixel (0, 0)
+    float z_origin;                  // depth at the center of pixel (min_x, min_y)
+    float z_dx, z_dy;                // depth step per pixel
+    float z_min, z_max;              // depth range of the vertices, for hierarchical z
+    uint32_t color;                  // flat shaded result, packed by Color::to_packed
+    
+    // gouraud triangles take their color from these planes instead: 0-2 hold color/w and 3 holds
+    // 1/w, anchored like the depth plane, so the per-pixel quotient is perspective-correct
+    bool smooth;
+    float attr_origin[4];
+    float attr_dx[4], attr_dy[4];
+};
+
+// hierarchical z counters; the binned path counts one triangle per tile it was binned to
+struct RasterStats {
+    uint64_t triangles_tested = 0;
+    uint64_t triangles_rejected = 0;  // every block behind the hierarchical z, no pixel visited
+    uint64_t blocks_tested = 0;       // HIZ_BLOCK_SIZE blocks overlapped by a triangle
+    uint64_t blocks_rejected = 0;
+    uint64_t fragments_tested = 0;    // covered pixels depth tested; counted only with RENDER_PROFILING
+    uint64_t fragments_written = 0;   // pixels that passed the depth test, overdraw included
+    
+    void add(const RasterStats& other) {
+        triangles_tested += other.triangles_tested;
+        triangles_rejected += other.triangles_rejected;
+        blocks_tested += other.blocks_tested;
+        blocks_rejected += other.blocks_rejected;
+        fragments_tested += other.fragments_tested;
+        fragments_written += other.fragments_written;
+    }
+};
+
+// snap the screen-space triangle and compute its edge functions and depth plane
+// returns false for degenerate triangles and triangles with no pixel centers in the viewport;
+// multisampled triangles count sample positions instead, so their bounds reach a little further
+bool setup_triangle(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& color,
+                    const TileRect& viewport, RasterTriangle& tri, bool multisample = false);
+
+// gouraud variant: colors are the lit vertex colors and inv_w the reciprocal of each vertex's
+// perspective divisor; depth is set up exactly as for flat triangles
+bool setup_triangle(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3 colors[3], const float inv_w[3],
+                    const TileRect& viewport, RasterTriangle& tri, bool multisample = false);
+
+// fill the part of the triangle that falls inside rect, with depth testing
+// results do not depend on how the screen is split into rectangles or on the simd path used
+// tiles still pending a lazy clear are filled before the first write
+// blocks the hierarchical z proves hidden are skipped, and blocks the triangle covers
+// completely lower their max depth; counters are added to stats when given
+void rasterize_triangle(const RasterTriangle& tri, const TileRect& rect, Framebuffer& framebuffer,
+                        RasterStats* stats = nullptr);
+
+// multisampled fill of the part of a multisample-set-up triangle inside the loaded tile: coverage
+// and depth are tested per sample, color is shaded once per pixel at its center and stored to
+// every sample that passed. the tile's own hierarchical z rejects and lowers like the framebuffer's,
+// and fragment counters count pixels with any sample covered or written
+void rasterize_triangle_msaa(const RasterTriangle& tri, SampleTile& tile, RasterStats* stats = nullptr);
+
+// average each pixel's samples into the framebuffer's color, rounding to nearest, and keep the
+// nearest sample as its depth; pixels of the framebuffer outside the tile are left alone
+void resolve_samples(const SampleTile& tile, Framebuffer& framebuffer);
+
+// depth-only fill for shadow maps: keeps the nearer of the stored and the triangle's depth in a
+// plain float array of the given row stride, no framebuffer, color or hierarchical z involved.
+// each row is walked over the span its edge functions allow, so no uncovered pixel is visited
+void rasterize_depth(const RasterTriangle& tri, const TileRect& rect, float* depth, int stride);
+
+// simd path used by rasterize_triangle, chosen from the cpu at startup
+// requests above what the cpu supports are clamped down
+void set_raster_simd_level(SimdLevel level);
+SimdLevel get_raster_simd_level();
+
+// hierarchical z rejection, on by default; output is identical either way
+void set_raster_hiz(bool enabled);
+bool get_raster_hiz();
+
+#endif
@@ -3,27 +3,47 @@
 // handles geometry transformation, lighting, and rasterization
 
 #include "renderer.h"
+#include "clipper.h"
+#include "../math/color.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
 
-Renderer::Renderer(int width, int height)
-    : framebuffer(width, height), ambient_light(0.2f, 0.2f, 0.2f) {}
-
-void Renderer::clear(const Vec3& color) {
-    framebuffer.clear(color);
-}
-
-Vec3 Renderer::calculate_lighting(const Vec3& position, const Vec3& normal,
-                                 const Material& material,
-                                 const std::vector<Light>& lights,
-                                 const Vec3& view_dir) {
-    // implement phong lighting model with ambient, diffuse, and specular components
+namespace {
+    // screen-space back-face test shared by the immediate and binned paths
+    bool is_back_facing(const ScreenVertex& v1, const ScreenVertex& v2, const ScreenVertex& v3) {
+        Vec3 edge1 = v2.position - v1.position;
+        Vec3 edge2 = v3.position - v1.position;
+        return edge1.cross(edge2).z > 0;
+    }
     
-    // start with ambient lighting contribution
-    Vec3 final_color = ambient_light * material.diffuse_color * material.ambient_strength;
+    // triangles or vertices handed to one worker during parallel setup
+    const int SETUP_BATCH = 256;
+    
+    // triangle_visible value of a triangle cull_triangles left for clip_triangles
+    const unsigned char NEEDS_CLIP = 2;
+    
+    // vertices per vertex stage task; larger than triangle batches since each vertex is cheap
+    const size_t VERTEX_BATCH = 4096;
     
-    // add contribution from each light source
-    for (const auto& light : lights) {
+    // instances of a small mesh are gathered until each worker's share of their transformed
+    // vertices and triangle setups would outgrow a typical per-core L2, so binning still reads the
+    // setups back from cache, as it does for a single mesh
+    const size_t INSTANCE_BATCH_BYTES = 512 * 1024;
+    
+    // visibility ids share the color plane with resolved pixels: packed colors always carry
+    // alpha 0xFF and ids stay below it, so pixels drawn before an earlier flush are left alone
+    const uint32_t MAX_VISIBILITY_ID = 0xFF000000u;
+    
+    bool is_visibility_id(uint32_t pixel) {
+        return pixel < MAX_VISIBILITY_ID;
+    }
+    
+    // diffuse and specular light added by one source, before the ambient term
+    Vec3 light_contribution(const Light& light, const Vec3& position, const Vec3& normal,
+                            const Material& material, const Vec3& view_dir) {
         Vec3 light_dir;
         float attenuation = 1.0f;
         
@@ -34,7 +54,7 @@ Vec3 Renderer::calculate_lighting(const Vec3& position, const Vec3& normal,
             light_dir = light_vec / distance;
             
             // quadratic attenuation formula for realistic falloff
-            attenuation = 1.0f / (1.0f + 0.1f * distance + 0.01f * distance * distance);
+            attenuation = point_light_attenuation(distance);
         } else {
             // directional light: constant direction, no attenuation
             light_dir = light.direction * -1.0f;
@@ -50,13 +70,263 @@ Vec3 Renderer::calculate_lighting(const Vec3& position, const Vec3& normal,
         Vec3 specular = material.specular_color * light.color * specular_intensity;
         
         // combine diffuse and specular with attenuation and light intensity
-        final_color = final_color + (diffuse + specular) * light.intensity * attenuation;
+        return (diffuse + specular) * light.intensity * attenuation;
+    }
+    
+    // a light's contribution scaled by its shadow map; unlit points skip the lookup
+    Vec3 shadow_contribution(const ShadowMaps& shadows, size_t light, const Vec3& position, const Vec3& normal,
+                             const Vec3& contribution) {
+        if (!(contribution.x > 0.0f || contribution.y > 0.0f || contribution.z > 0.0f)) return contribution;
+        return contribution * shadows.visibility(light, position, normal);
+    }
+    
+    // batched lighting: gathers points until SHADING_WIDTH share one light list, then lights them
+    // with one shade_points call and hands each lane to store(points, lane, item); shadows go
+    // with the packed lights, so they never change within a group
+    template <typename Item, typename Store>
+    class PointBatch {
+    public:
+        PointBatch(SpecularModel model, Store store) : model(model), store(store) {}
+        
+        void add(const PackedLights* lights, const uint32_t* indices, size_t count, const ShadowMaps* shadows,
+                 const Vec3& position, const Vec3& normal, float shininess, const Item& item) {
+            if (points.count == SHADING_WIDTH || (points.count > 0 && (lights != group_lights || indices != group_indices))) {
+                flush();
+            }
+            group_lights = lights;
+            group_shadows = shadows;
+            group_indices = indices;
+            group_count = count;
+            items[points.count] = item;
+            points.add(position, normal, shininess);
+        }
+        
+        void flush() {
+            if (points.count == 0) return;
+            shade_points(*group_lights, group_indices, group_count, model, points, group_shadows);
+            for (int i = 0; i < points.count; i++) store(points, i, items[i]);
+            points.count = 0;
+        }
+        
+    private:
+        SpecularModel model;
+        Store store;
+        ShadingPoints points;
+        Item items[SHADING_WIDTH];
+        const PackedLights* group_lights = nullptr;
+        const uint32_t* group_indices = nullptr;
+        size_t group_count = 0;
+        const ShadowMaps* group_shadows = nullptr;
+    };
+    
+    template <typename Item, typename Store>
+    PointBatch<Item, Store> make_point_batch(SpecularModel model, Store store) {
+        return PointBatch<Item, Store>(model, store);
+    }
+}
+
+Renderer::Renderer(int width, int height)
+    : framebuffer(width, height), ambient_light(0.2f, 0.2f, 0.2f),
+      tiled(true), multisampling(false), thread_pool(std::make_unique<ThreadPool>(0)), binner(width, height),
+      transformed_count(0), deferred(false), deferred_batch_count(0), deferred_material_count(0),
+      deferred_triangle_count(0), light_culling(true), grid_valid(false), grid_lights(nullptr), grid_light_count(0),
+      lighting_mode(LightingMode::REFERENCE), packed_valid(false), packed_source(nullptr),
+      shadow_mapping(false), shadows_ready(false), shadow_lights(nullptr) {
+    profiler.resize(thread_pool->thread_count());
+}
+
+void Renderer::clear(const Vec3& color) {
+    // drop any work still queued from an unfinished frame
+    binner.resize(framebuffer.get_width(), framebuffer.get_height());
+    framebuffer.clear(color);
+    raster_stats = RasterStats();
+    shading_stats = ShadingStats();
+    geometry_stats = GeometryStats();
+    profiler.begin_frame();
+    deferred_triangle_count = 0;
+    deferred_batch_count = 0;
+    deferred_material_count = 0;
+    grid_valid = false;  // lights may have moved since the last frame
+    packed_valid = false;
+    shadows_ready = false;
+}
+
+void Renderer::flush() {
+    if (!binner.empty()) {
+        PROFILE_STAGE(profiler, ProfileStage::RASTER);
+        binner.execute(*thread_pool, framebuffer, raster_stats, &profiler, multisampled());
+    }
+    if (deferred_triangle_count > 0) {
+        PROFILE_STAGE(profiler, ProfileStage::SHADE);
+        shade_deferred();
+    }
+}
+
+FrameStats Renderer::get_frame_stats() {
+    flush();
+    FrameStats stats;
+    stats.times = profiler.get_times();
+    stats.triangles_submitted = geometry_stats.triangles_submitted;
+    stats.triangles_culled = geometry_stats.triangles_rejected + geometry_stats.triangles_backfacing;
+    stats.triangles_rasterized = geometry_stats.triangles_rasterized;
+    stats.pixels_tested = raster_stats.fragments_tested;
+    stats.pixels_depth_passed = raster_stats.fragments_written;
+    
+    // every covered pixel's last write is the one that stays; the writes before it were overdraw
+    uint64_t covered = framebuffer.count_covered_pixels();
+    stats.pixels_overdrawn = stats.pixels_depth_passed > covered ? stats.pixels_depth_passed - covered : 0;
+    stats.lighting_evaluations = shading_stats.lighting_evaluations;
+    return stats;
+}
+
+void Renderer::set_thread_count(int threads) {
+    flush();
+    thread_pool = std::make_unique<ThreadPool>(threads);
+    profiler.resize(thread_pool->thread_count());
+}
+
+void Renderer::set_tiled(bool enabled) {
+    flush();
+    tiled = enabled;
+}
+
+void Renderer::set_multisampling(bool enabled) {
+    flush();
+    multisampling = enabled;
+}
+
+void Renderer::set_deferred(bool enabled) {
+    flush();
+    deferred = enabled;
+}
+
+void Renderer::set_light_culling(bool enabled) {
+    flush();
+    light_culling = enabled;
+    grid_valid = false;
+}
+
+void Renderer::set_lighting_mode(LightingMode mode) {
+    flush();
+    lighting_mode = mode;
+}
+
+void Renderer::set_shadow_mapping(bool enabled) {
+    flush();
+    shadow_mapping = enabled;
+    shadows_ready = false;
+}
+
+void Renderer::set_shadow_settings(const ShadowSettings& settings) {
+    flush();
+    shadow_maps.set_settings(settings);
+    shadows_ready = false;
+}
+
+void Renderer::update_shadows(const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters) {
+    if (!shadow_mapping) return;
+    PROFILE_STAGE(profiler, ProfileStage::SHADOW);
+    shadow_maps.update(lights, casters, *thread_pool);
+    shadows_ready = true;
+    shadow_lights = &lights;
+}
+
+bool Renderer::light_grid_matches(const std::vector<Light>& lights, const Mat4& view_proj) const {
+    return grid_valid && grid_lights == &lights && grid_light_count == lights.size() &&
+           std::memcmp(grid_view_proj.m, view_proj.m, sizeof(view_proj.m)) == 0;
+}
+
+const LightGrid* Renderer::prepare_light_grid(const std::vector<Light>& lights, const Mat4& view_proj) {
+    if (!light_culling) return nullptr;
+    
+    // meshes of one scene share lights and camera, so the grid is normally built once per frame
+    if (!light_grid_matches(lights, view_proj)) {
+        light_grid.build(lights, view_proj, framebuffer.get_width(), framebuffer.get_height());
+        grid_valid = true;
+        grid_lights = &lights;
+        grid_light_count = lights.size();
+        grid_view_proj = view_proj;
+    }
+    return &light_grid;
+}
+
+const PackedLights* Renderer::prepare_packed_lights(const std::vector<Light>& lights, const Vec3& view_dir) {
+    if (lighting_mode == LightingMode::REFERENCE) return nullptr;
+    const Vec3& packed_view = packed_lights.view_dir;
+    if (!packed_valid || packed_source != &lights || packed_lights.count != lights.size() ||
+        packed_view.x != view_dir.x || packed_view.y != view_dir.y || packed_view.z != view_dir.z) {
+        packed_lights.pack(lights, view_dir);
+        packed_valid = true;
+        packed_source = &lights;
+    }
+    return &packed_lights;
+}
+
+Vec3 Renderer::calculate_lighting(const Vec3& position, const Vec3& normal,
+                                 const Material& material,
+                                 const std::vector<Light>& lights,
+                                 const Vec3& view_dir, const ShadowMaps* shadows) {
+    // implement phong lighting model with ambient, diffuse, and specular components
+    
+    // start with ambient lighting contribution
+    Vec3 final_color = ambient_light * material.diffuse_color * material.ambient_strength;
+    
+    // add contribution from each light source, less what its shadow map says is blocked
+    for (size_t i = 0; i < lights.size(); i++) {
+        Vec3 contribution = light_contribution(lights[i], position, normal, material, view_dir);
+        if (shadows) contribution = shadow_contribution(*shadows, i, position, normal, contribution);
+        final_color = final_color + contribution;
     }
     
     return final_color;
 }
 
+Vec3 Renderer::calculate_lighting(const Vec3& position, const Vec3& normal,
+                                 const Material& material,
+                                 const std::vector<Light>& lights,
+                                 const uint32_t* light_indices, size_t light_count,
+                                 const Vec3& view_dir, const ShadowMaps* shadows) {
+    Vec3 final_color = ambient_light * material.diffuse_color * material.ambient_strength;
+    for (size_t i = 0; i < light_count; i++) {
+        const Light& light = lights[light_indices[i]];
+        
+        // tile lists are conservative, so the exact range test still removes many lights
+        if (light.type == LightType::POINT) {
+            Vec3 to_light = light.position - position;
+            if (to_light.dot(to_light) > light.radius * light.radius) continue;
+        }
+        Vec3 contribution = light_contribution(light, position, normal, material, view_dir);
+        if (shadows) contribution = shadow_contribution(*shadows, light_indices[i], position, normal, contribution);
+        final_color = final_color + contribution;
+    }
+    return final_color;
+}
+
 void Renderer::draw_line(Vec3 p1, Vec3 p2, const Vec3& color) {
+    // clip the segment to the screen first (liang-barsky), so edges reaching into the guard band
+    // cost no more steps than their visible part
+    float x_max = framebuffer.get_width() - 0.001f, y_max = framebuffer.get_height() - 0.001f;
+    Vec3 delta = p2 - p1;
+    float t0 = 0.0f, t1 = 1.0f;
+    const float p[4] = {-delta.x, delta.x, -delta.y, delta.y};
+    const float q[4] = {p1.x, x_max - p1.x, p1.y, y_max - p1.y};
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) return;  // parallel to this edge and outside it
+            continue;
+        }
+        float t = q[i] / p[i];
+        if (p[i] < 0.0f) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+    }
+    if (!(t0 <= t1)) return;
+    Vec3 start = p1 + delta * t0;
+    p2 = p1 + delta * t1;
+    p1 = start;
+    
     // simple bresenham line algorithm for wireframe rendering
     int x1 = (int)p1.x, y1 = (int)p1.y;
     int x2 = (int)p2.x, y2 = (int)p2.y;
@@ -77,109 +347,623 @@ void Renderer::draw_line(Vec3 p1, Vec3 p2, const Vec3& color) {
     }
 }
 
-void Renderer::draw_triangle_flat(const Vertex& v1, const Vertex& v2, const Vertex& v3,
+void Renderer::draw_triangle_flat(const ScreenVertex& v1, const ScreenVertex& v2, const ScreenVertex& v3,
                                  const Vec3& face_normal, const Material& material,
-                                 const std::vector<Light>& lights, const Vec3& view_dir) {
-    // flat shading: calculate lighting once at triangle center
-    Vec3 center = (v1.position + v2.position + v3.position) / 3.0f;
-    Vec3 color = calculate_lighting(center, face_normal, material, lights, view_dir);
-    
-    // sort vertices by y coordinate for scanline algorithm
-    std::vector<Vec3> points = {v1.position, v2.position, v3.position};
-    std::sort(points.begin(), points.end(), [](const Vec3& a, const Vec3& b) {
-        return a.y < b.y;
+                                 const std::vector<Light>& lights, const Vec3& view_dir,
+                                 const LightGrid* grid) {
+    // rasterize immediately over the whole screen
+    TileRect screen = {0, 0, framebuffer.get_width(), framebuffer.get_height()};
+    RasterTriangle tri;
+    if (!setup_triangle(v1.position, v2.position, v3.position, Vec3(0, 0, 0), screen, tri)) return;
+    
+    // flat shading: calculate lighting once at the world-space triangle center
+    Vec3 center = (v1.world + v2.world + v3.world) / 3.0f;
+    size_t light_count = lights.size();
+    const uint32_t* light_indices = grid ? grid->lights_near(center, light_count) : nullptr;
+    const ShadowMaps* shadows = shadows_for(lights);
+    Vec3 color;
+    if (const PackedLights* packed = prepare_packed_lights(lights, view_dir)) {
+        ShadingPoints points;
+        points.add(center, face_normal, material.shininess);
+        shade_points(*packed, light_indices, light_count, specular_model(), points, shadows);
+        color = points.color(0, material, ambient_light);
+    } else if (grid) {
+        color = calculate_lighting(center, face_normal, material, lights, light_indices, light_count, view_dir,
+                                   shadows);
+    } else {
+        color = calculate_lighting(center, face_normal, material, lights, view_dir, shadows);
+    }
+    tri.color = Color::to_packed(color);
+    shading_stats.lighting_evaluations++;
+    geometry_stats.triangles_rasterized++;
+    rasterize_triangle(tri, screen, framebuffer, &raster_stats);
+}
+
+void Renderer::draw_triangle_gouraud(const ScreenVertex& v1, const ScreenVertex& v2, const ScreenVertex& v3) {
+    // vertex colors were lit in light_vertices, only interpolation is left
+    TileRect screen = {0, 0, framebuffer.get_width(), framebuffer.get_height()};
+    const Vec3 colors[3] = {v1.color, v2.color, v3.color};
+    const float inv_w[3] = {v1.inv_w, v2.inv_w, v3.inv_w};
+    RasterTriangle tri;
+    if (setup_triangle(v1.position, v2.position, v3.position, colors, inv_w, screen, tri)) {
+        geometry_stats.triangles_rasterized++;
+        rasterize_triangle(tri, screen, framebuffer, &raster_stats);
+    }
+}
+
+void Renderer::transform_vertices(bool with_normals) {
+    // vertices are independent, so batches run in parallel like triangle setup; the buffer only
+    // ever grows, so steady-state frames write into memory that is already allocated
+    // a batch of instances is one run of vertices, split where a task crosses into the next instance
+    size_t mesh_vertices = draw.mesh_vertices;
+    size_t vertex_count = draw.vertex_count();
+    if (transformed_vertices.size() < vertex_count) transformed_vertices.resize(vertex_count);
+    transformed_count = vertex_count;
+    int batches = (int)((vertex_count + VERTEX_BATCH - 1) / VERTEX_BATCH);
+    thread_pool->parallel_for(batches, [&](int batch, int) {
+        size_t begin = (size_t)batch * VERTEX_BATCH;
+        size_t end = std::min(vertex_count, begin + VERTEX_BATCH);
+        while (begin < end) {
+            size_t instance = begin / mesh_vertices;
+            size_t first = begin - instance * mesh_vertices;
+            size_t count = std::min(end - begin, mesh_vertices - first);
+            if (draw.compact) {
+                transform_vertex_batch(draw.transforms[instance], draw.compact->vertices.data() + first, count,
+                                       transformed_vertices.data() + begin, with_normals);
+            } else {
+                transform_vertex_batch(draw.transforms[instance], draw.vertices + first, count,
+                                       transformed_vertices.data() + begin, with_normals);
+            }
+            begin += count;
+        }
+    });
+}
+
+void Renderer::cull_triangles(bool with_normals) {
+    // trivial frustum rejection and back-face culling; triangles crossing the near plane or the
+    // guard band have no usable screen positions yet and are left for clip_triangles
+    size_t mesh_triangles = draw.triangle_count();
+    clipped_triangles.clear();
+    clipped_instances.clear();
+    clipped_vertex_instances.clear();
+    if (triangle_setups.size() < mesh_triangles) {
+        triangle_setups.resize(mesh_triangles);
+        triangle_visible.resize(mesh_triangles);
+    }
+    
+    worker_geometry.assign(thread_pool->thread_count(), GeometryStats());
+    int batches = (int)((mesh_triangles + SETUP_BATCH - 1) / SETUP_BATCH);
+    thread_pool->parallel_for(batches, [&](int batch, int worker) {
+        GeometryStats& stats = worker_geometry[worker];
+        size_t end = std::min(mesh_triangles, (size_t)(batch + 1) * SETUP_BATCH);
+        for_each_triangle((size_t)batch * SETUP_BATCH, end, [&](size_t i, const Triangle& triangle, size_t) {
+            const ScreenVertex& v1 = transformed_vertices[triangle.v0];
+            const ScreenVertex& v2 = transformed_vertices[triangle.v1];
+            const ScreenVertex& v3 = transformed_vertices[triangle.v2];
+            if (v1.clip_code & v2.clip_code & v3.clip_code & CLIP_FRUSTUM) {
+                triangle_visible[i] = 0;
+                stats.triangles_rejected++;
+            } else if ((v1.clip_code | v2.clip_code | v3.clip_code) & CLIP_CUT) {
+                triangle_visible[i] = NEEDS_CLIP;
+                stats.triangles_clipped++;
+            } else {
+                triangle_visible[i] = !is_back_facing(v1, v2, v3);
+                stats.triangles_backfacing += !triangle_visible[i];
+            }
+        });
+    });
+    
+    uint64_t clipped = 0;
+    for (const GeometryStats& stats : worker_geometry) {
+        geometry_stats.triangles_rejected += stats.triangles_rejected;
+        geometry_stats.triangles_backfacing += stats.triangles_backfacing;
+        clipped += stats.triangles_clipped;
+    }
+    geometry_stats.triangles_submitted += mesh_triangles;
+    geometry_stats.triangles_clipped += clipped;
+    if (clipped > 0) clip_triangles(with_normals);
+}
+
+void Renderer::clip_triangles(bool with_normals) {
+    // only triangles near the camera or far off screen get here, so this runs serially; each is
+    // replaced by the front-facing fan of its clipped polygon, appended after the batch triangles
+    int width = framebuffer.get_width(), height = framebuffer.get_height();
+    size_t mesh_triangles = draw.triangle_count();
+    ScreenVertex polygon[MAX_CLIP_VERTICES];
+    for (size_t i = 0; i < mesh_triangles; i++) {
+        if (triangle_visible[i] != NEEDS_CLIP) continue;
+        triangle_visible[i] = 0;
+        Triangle triangle = triangle_at(i);
+        uint32_t instance = (uint32_t)triangle_instance(i);
+        int count = clip_triangle(transformed_vertices[triangle.v0], transformed_vertices[triangle.v1],
+                                  transformed_vertices[triangle.v2], width, height, with_normals, polygon);
+        if (count < 3) continue;
+        
+        // polygon vertices join the post-transform buffer like mesh vertices
+        size_t base = transformed_count;
+        transformed_count += count;
+        if (transformed_vertices.size() < transformed_count) transformed_vertices.resize(transformed_count);
+        std::copy(polygon, polygon + count, transformed_vertices.begin() + base);
+        clipped_vertex_instances.insert(clipped_vertex_instances.end(), count, instance);
+        for (int k = 1; k + 1 < count; k++) {
+            if (is_back_facing(polygon[0], polygon[k], polygon[k + 1])) continue;
+            Triangle piece((int)base, (int)(base + k), (int)(base + k + 1));
+            piece.normal = draw.compact ? draw.compact->face_normal(i - instance * draw.mesh_triangles) : triangle.normal;
+            clipped_triangles.push_back(piece);
+            clipped_instances.push_back(instance);
+        }
+    }
+    
+    size_t draw_count = triangle_count();
+    if (triangle_setups.size() < draw_count) {
+        triangle_setups.resize(draw_count);
+        triangle_visible.resize(draw_count);
+    }
+    std::fill(triangle_visible.begin() + mesh_triangles, triangle_visible.begin() + draw_count, 1);
+    geometry_stats.clipped_pieces += clipped_triangles.size();
+}
+
+void Renderer::light_vertices(const std::vector<Light>& lights, const Vec3& view_dir, const LightGrid* grid) {
+    // gouraud shading: light each vertex of a front-facing triangle once with its smooth normal;
+    // every triangle sharing the vertex reuses the cached color
+    size_t vertex_count = transformed_count;
+    vertex_used.assign(vertex_count, 0);
+    size_t draw_count = triangle_count();
+    for_each_triangle(0, draw_count, [&](size_t i, const Triangle& triangle, size_t) {
+        if (triangle_visible[i]) vertex_used[triangle.v0] = vertex_used[triangle.v1] = vertex_used[triangle.v2] = 1;
     });
     
-    // triangle rasterization using barycentric coordinates
-    for (int y = (int)points[0].y; y <= (int)points[2].y; y++) {
-        for (int x = (int)std::min({points[0].x, points[1].x, points[2].x});
-             x <= (int)std::max({points[0].x, points[1].x, points[2].x}); x++) {
+    const PackedLights* packed = prepare_packed_lights(lights, view_dir);
+    const ShadowMaps* shadows = shadows_for(lights);
+    int batches = (int)((vertex_count + SETUP_BATCH - 1) / SETUP_BATCH);
+    thread_pool->parallel_for(batches, [&](int batch, int) {
+        size_t end = std::min(vertex_count, (size_t)(batch + 1) * SETUP_BATCH);
+        if (packed) {
+            // neighbouring vertices mostly fall in one screen tile, so they share its light list
+            auto vertices = make_point_batch<size_t>(specular_model(), [&](const ShadingPoints& points, int lane,
+                                                                           size_t i) {
+                const Material& material = *draw.materials[vertex_instance(i)];
+                transformed_vertices[i].color = Color::clamp(points.color(lane, material, ambient_light));
+            });
+            for (size_t i = (size_t)batch * SETUP_BATCH; i < end; i++) {
+                if (!vertex_used[i]) continue;
+                const ScreenVertex& transformed = transformed_vertices[i];
+                size_t light_count = lights.size();
+                const uint32_t* light_indices =
+                    grid ? grid->lights_at(transformed.position, transformed.inv_w, light_count) : nullptr;
+                vertices.add(packed, light_indices, light_count, shadows, transformed.world, transformed.normal,
+                             draw.materials[vertex_instance(i)]->shininess, i);
+            }
+            vertices.flush();
+            return;
+        }
+        for (size_t i = (size_t)batch * SETUP_BATCH; i < end; i++) {
+            if (!vertex_used[i]) continue;
+            ScreenVertex& transformed = transformed_vertices[i];
+            const Vec3& normal = transformed.normal;
+            const Material& material = *draw.materials[vertex_instance(i)];
+            Vec3 color;
+            if (grid) {
+                // the vertex's own screen tile lists every light that can reach it
+                size_t light_count;
+                const uint32_t* light_indices = grid->lights_at(transformed.position, transformed.inv_w, light_count);
+                color = calculate_lighting(transformed.world, normal, material, lights,
+                                           light_indices, light_count, view_dir, shadows);
+            } else {
+                color = calculate_lighting(transformed.world, normal, material, lights, view_dir, shadows);
+            }
+            transformed.color = Color::clamp(color);
+        }
+    });
+    shading_stats.lighting_evaluations += std::count(vertex_used.begin(), vertex_used.end(), 1);
+}
+
+void Renderer::bin_triangles(const std::vector<Light>& lights, const Vec3& view_dir, bool flat_shading,
+                             const LightGrid* grid) {
+    // lighting and setup are independent per triangle, so batches run in parallel
+    size_t draw_count = triangle_count();
+    TileRect screen = {0, 0, framebuffer.get_width(), framebuffer.get_height()};
+    const PackedLights* packed = flat_shading ? prepare_packed_lights(lights, view_dir) : nullptr;
+    const ShadowMaps* shadows = shadows_for(lights);
+    int batches = (int)((draw_count + SETUP_BATCH - 1) / SETUP_BATCH);
+    thread_pool->parallel_for(batches, [&](int batch, int) {
+        size_t end = std::min(draw_count, (size_t)(batch + 1) * SETUP_BATCH);
+        auto centers = make_point_batch<size_t>(specular_model(), [&](const ShadingPoints& points, int lane,
+                                                                      size_t i) {
+            const Material& material = *draw.materials[triangle_instance(i)];
+            triangle_setups[i].color = Color::to_packed(points.color(lane, material, ambient_light));
+        });
+        size_t first = (size_t)batch * SETUP_BATCH;
+        for_each_triangle(first, end, [&](size_t i, const Triangle& triangle, size_t instance) {
+            if (!triangle_visible[i]) return;
+            const ScreenVertex& v1 = transformed_vertices[triangle.v0];
+            const ScreenVertex& v2 = transformed_vertices[triangle.v1];
+            const ScreenVertex& v3 = transformed_vertices[triangle.v2];
+            RasterTriangle& tri = triangle_setups[i];
             
-            // point-in-triangle test using barycentric coordinates
-            Vec3 p(x, y, 0);
-            Vec3 v0 = points[2] - points[0];
-            Vec3 v1 = points[1] - points[0];
-            Vec3 v2 = p - points[0];
+            if (!flat_shading) {
+                const Vec3 colors[3] = {v1.color, v2.color, v3.color};
+                const float inv_w[3] = {v1.inv_w, v2.inv_w, v3.inv_w};
+                triangle_visible[i] = setup_triangle(v1.position, v2.position, v3.position, colors, inv_w,
+                                                     screen, tri, multisampled());
+                return;
+            }
             
-            float dot00 = v0.dot(v0);
-            float dot01 = v0.dot(v1);
-            float dot02 = v0.dot(v2);
-            float dot11 = v1.dot(v1);
-            float dot12 = v1.dot(v2);
+            // flat shading: calculate lighting once at the world-space triangle center, only for
+            // triangles that reach a pixel
+            triangle_visible[i] = setup_triangle(v1.position, v2.position, v3.position, Vec3(0, 0, 0),
+                                                 screen, tri, multisampled());
+            if (!triangle_visible[i]) return;
+            const Material& material = *draw.materials[instance];
+            Vec3 world_normal = face_normal(i, triangle, instance);
+            Vec3 center = (v1.world + v2.world + v3.world) / 3.0f;
+            if (packed) {
+                size_t light_count = lights.size();
+                const uint32_t* light_indices = grid ? grid->lights_near(center, light_count) : nullptr;
+                centers.add(packed, light_indices, light_count, shadows, center, world_normal, material.shininess, i);
+                return;
+            }
+            Vec3 color;
+            if (grid) {
+                size_t light_count;
+                const uint32_t* light_indices = grid->lights_near(center, light_count);
+                color = calculate_lighting(center, world_normal, material, lights, light_indices, light_count,
+                                           view_dir, shadows);
+            } else {
+                color = calculate_lighting(center, world_normal, material, lights, view_dir, shadows);
+            }
+            tri.color = Color::to_packed(color);
+        });
+        centers.flush();
+    });
+    
+    // binning stays serial so every tile sees triangles in submission order
+    for (size_t i = 0; i < draw_count; i++) {
+        if (!triangle_visible[i]) continue;
+        binner.add(triangle_setups[i]);
+        geometry_stats.triangles_rasterized++;
+        if (flat_shading) shading_stats.lighting_evaluations++;
+    }
+}
+
+void Renderer::submit_deferred(const std::vector<Light>& lights, const Vec3& view_dir) {
+    // ids must stay clear of packed colors; resolve what is queued before they run out
+    size_t draw_count = triangle_count();
+    if (deferred_triangle_count + draw_count > MAX_VISIBILITY_ID) flush();
+    
+    // surface data shared by every triangle of the batch, and the material of each instance
+    if (deferred_batches.size() <= deferred_batch_count) deferred_batches.resize(deferred_batch_count + 1);
+    uint32_t batch = (uint32_t)deferred_batch_count++;
+    deferred_batches[batch].lights.assign(lights.begin(), lights.end());
+    deferred_batches[batch].view_dir = view_dir;
+    deferred_batches[batch].shadowed = shadows_for(lights) != nullptr;
+    if (lighting_mode != LightingMode::REFERENCE) deferred_batches[batch].packed.pack(lights, view_dir);
+    size_t material_base = deferred_material_count;
+    deferred_material_count += draw.instance_count();
+    if (deferred_materials.size() < deferred_material_count) deferred_materials.resize(deferred_material_count);
+    for (size_t k = 0; k < draw.instance_count(); k++) deferred_materials[material_base + k] = *draw.materials[k];
+    
+    // one id per batch triangle keeps the parallel setup free of any counter
+    size_t base = deferred_triangle_count;
+    deferred_triangle_count += draw_count;
+    if (deferred_triangles.size() < deferred_triangle_count) deferred_triangles.resize(deferred_triangle_count);
+    
+    TileRect screen = {0, 0, framebuffer.get_width(), framebuffer.get_height()};
+    int batches = (int)((draw_count + SETUP_BATCH - 1) / SETUP_BATCH);
+    thread_pool->parallel_for(batches, [&](int setup_batch, int) {
+        size_t end = std::min(draw_count, (size_t)(setup_batch + 1) * SETUP_BATCH);
+        size_t first = (size_t)setup_batch * SETUP_BATCH;
+        for_each_triangle(first, end, [&](size_t i, const Triangle& triangle, size_t instance) {
+            if (!triangle_visible[i]) return;
+            const int index[3] = {triangle.v0, triangle.v1, triangle.v2};
+            const ScreenVertex* v[3];
+            for (int k = 0; k < 3; k++) v[k] = &transformed_vertices[index[k]];
             
-            float inv_denom = 1 / (dot00 * dot11 - dot01 * dot01);
-            float u = (dot11 * dot02 - dot01 * dot12) * inv_denom;
-            float v = (dot00 * dot12 - dot01 * dot02) * inv_denom;
+            // the raster pass writes the id where a flat triangle would write its color
+            RasterTriangle& tri = triangle_setups[i];
+            triangle_visible[i] = setup_triangle(v[0]->position, v[1]->position, v[2]->position, Vec3(0, 0, 0),
+                                                 screen, tri);
+            if (!triangle_visible[i]) return;
+            tri.color = (uint32_t)(base + i);
             
-            // if point is inside triangle, render pixel with interpolated depth
-            if (u >= 0 && v >= 0 && u + v <= 1) {
-                float z = points[0].z + u * (points[2].z - points[0].z) + v * (points[1].z - points[0].z);
-                framebuffer.set_pixel(x, y, color, z);
+            DeferredTriangle& surface = deferred_triangles[base + i];
+            surface.batch = batch;
+            surface.material = (uint32_t)(material_base + instance);
+            for (int k = 0; k < 3; k++) {
+                surface.world[k] = v[k]->world;
+                surface.normal[k] = v[k]->normal;
+            }
+            
+            // screen-space barycentrics at pixel centers, each divided by its vertex w so the
+            // shading pass recovers perspective-correct weights by normalizing their sum
+            double x[3], y[3];
+            for (int k = 0; k < 3; k++) {
+                x[k] = v[k]->position.x - 0.5;
+                y[k] = v[k]->position.y - 0.5;
+            }
+            double det = (y[1] - y[2]) * (x[0] - x[2]) + (x[2] - x[1]) * (y[0] - y[2]);
+            double a[3], b[3], c[3];
+            a[0] = (y[1] - y[2]) / det;
+            b[0] = (x[2] - x[1]) / det;
+            a[1] = (y[2] - y[0]) / det;
+            b[1] = (x[0] - x[2]) / det;
+            a[2] = -a[0] - a[1];
+            b[2] = -b[0] - b[1];
+            for (int k = 0; k < 2; k++) c[k] = -(a[k] * x[2] + b[k] * y[2]);
+            c[2] = 1.0 - c[0] - c[1];
+            for (int k = 0; k < 3; k++) {
+                surface.bary[k][0] = (float)(a[k] * v[k]->inv_w);
+                surface.bary[k][1] = (float)(b[k] * v[k]->inv_w);
+                surface.bary[k][2] = (float)(c[k] * v[k]->inv_w);
+            }
+        });
+    });
+    
+    // same submission order as the forward paths, so depth ties resolve identically
+    for (size_t i = 0; i < draw_count; i++) {
+        if (!triangle_visible[i]) continue;
+        geometry_stats.triangles_rasterized++;
+        if (tiled) {
+            binner.add(triangle_setups[i]);
+        } else {
+            rasterize_triangle(triangle_setups[i], screen, framebuffer, &raster_stats);
+        }
+    }
+}
+
+void Renderer::shade_deferred() {
+    // every pixel still holding an id gets exactly one lighting call; tiles are independent
+    int width = framebuffer.get_width(), height = framebuffer.get_height();
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    worker_shaded.assign(thread_pool->thread_count(), 0);
+    
+    // queued batches all share the grid's lights, render_batch flushes before they change
+    const LightGrid* grid = (light_culling && grid_valid) ? &light_grid : nullptr;
+    bool batched = lighting_mode != LightingMode::REFERENCE;
+    
+    thread_pool->parallel_for(tiles_x * tiles_y, [&](int tile, int worker) {
+        int tx = tile % tiles_x, ty = tile / tiles_x;
+        if (framebuffer.is_tile_pending(tx, ty)) return;  // nothing was drawn here since the clear
+        int x0 = tx * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, width);
+        int y0 = ty * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, height);
+        size_t light_count = 0;
+        const uint32_t* light_indices = grid ? grid->tile_lights(tx, ty, light_count) : nullptr;
+        
+        // batched modes: the tile's pixels share its light list, so only a change of batch splits a group
+        struct Pixel {
+            uint32_t* color;
+            const Material* material;
+        };
+        auto pixels = make_point_batch<Pixel>(specular_model(), [&](const ShadingPoints& points, int lane,
+                                                                    const Pixel& pixel) {
+            *pixel.color = Color::to_packed(points.color(lane, *pixel.material, ambient_light));
+        });
+        
+        uint64_t shaded = 0;
+        for (int y = y0; y < y1; y++) {
+            uint32_t* colors = framebuffer.get_color_row(y);
+            for (int x = x0; x < x1; x++) {
+                if (!is_visibility_id(colors[x])) continue;
+                const DeferredTriangle& surface = deferred_triangles[colors[x]];
+                const DeferredBatch& batch = deferred_batches[surface.batch];
+                const Material& material = deferred_materials[surface.material];
+                const ShadowMaps* shadows = batch.shadowed ? &shadow_maps : nullptr;
+                
+                // perspective-correct barycentrics from the w-divided planes
+                float weight[3], sum = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    weight[k] = surface.bary[k][0] * x + surface.bary[k][1] * y + surface.bary[k][2];
+                    sum += weight[k];
+                }
+                for (int k = 0; k < 3; k++) weight[k] /= sum;
+                
+                Vec3 position = surface.world[0] * weight[0] + surface.world[1] * weight[1] + surface.world[2] * weight[2];
+                Vec3 normal = (surface.normal[0] * weight[0] + surface.normal[1] * weight[1] +
+                               surface.normal[2] * weight[2]).normalize();
+                shaded++;
+                if (batched) {
+                    size_t count = grid ? light_count : batch.lights.size();
+                    pixels.add(&batch.packed, light_indices, count, shadows, position, normal, material.shininess,
+                               {colors + x, &material});
+                    continue;
+                }
+                Vec3 color = grid
+                    ? calculate_lighting(position, normal, material, batch.lights, light_indices, light_count,
+                                         batch.view_dir, shadows)
+                    : calculate_lighting(position, normal, material, batch.lights, batch.view_dir, shadows);
+                colors[x] = Color::to_packed(color);
             }
         }
+        pixels.flush();
+        worker_shaded[worker] += shaded;
+    });
+    
+    for (uint64_t shaded : worker_shaded) {
+        shading_stats.pixels_shaded += shaded;
+        shading_stats.lighting_evaluations += shaded;
     }
+    deferred_triangle_count = 0;
+    deferred_batch_count = 0;
+    deferred_material_count = 0;
 }
 
 void Renderer::render_mesh(const Mesh& mesh, const Camera& camera,
                           const std::vector<Light>& lights,
                           bool wireframe, bool flat_shading) {
     // main mesh rendering function implementing the graphics pipeline
+    // a plain mesh is a batch of one instance with its own transform and material
+    Mat4 view_proj = camera.get_projection_matrix() * camera.get_view_matrix();
+    begin_batch(mesh.vertices.data(), mesh.vertices.size(), mesh.triangles.data(), mesh.triangles.size());
+    draw.transforms.emplace_back(mesh.transform, view_proj, framebuffer.get_width(), framebuffer.get_height());
+    draw.materials.push_back(&mesh.material);
+    render_batch(camera, view_proj, lights, wireframe, flat_shading);
+}
+
+void Renderer::render_mesh(const CompactMesh& mesh, const Camera& camera,
+                          const std::vector<Light>& lights,
+                          bool wireframe, bool flat_shading) {
+    // dequantization rides along in the model matrix, so the vertex stage reads the codes directly
+    Mat4 view_proj = camera.get_projection_matrix() * camera.get_view_matrix();
+    begin_batch(mesh);
+    draw.transforms.emplace_back(mesh.transform, mesh.get_dequantize_matrix(), view_proj,
+                                 framebuffer.get_width(), framebuffer.get_height());
+    draw.materials.push_back(&mesh.material);
+    render_batch(camera, view_proj, lights, wireframe, flat_shading);
+}
+
+void Renderer::render_mesh(const MappedMesh& mesh, const Camera& camera,
+                          const std::vector<Light>& lights,
+                          bool wireframe, bool flat_shading) {
+    Mat4 view_proj = camera.get_projection_matrix() * camera.get_view_matrix();
+    begin_batch(mesh.vertices(), mesh.vertex_count(), mesh.triangles(), mesh.triangle_count());
+    draw.transforms.emplace_back(mesh.transform, view_proj, framebuffer.get_width(), framebuffer.get_height());
+    draw.materials.push_back(&mesh.material);
+    render_batch(camera, view_proj, lights, wireframe, flat_shading);
+}
+
+void Renderer::begin_batch(const Vertex* vertices, size_t vertex_count, const Triangle* triangles,
+                           size_t triangle_count) {
+    draw.vertices = vertices;
+    draw.triangles = triangles;
+    draw.compact = nullptr;
+    draw.mesh_vertices = vertex_count;
+    draw.mesh_triangles = triangle_count;
+    draw.transforms.clear();
+    draw.materials.clear();
+}
+
+void Renderer::begin_batch(const CompactMesh& mesh) {
+    draw.vertices = nullptr;
+    draw.triangles = nullptr;
+    draw.compact = &mesh;
+    draw.mesh_vertices = mesh.vertices.size();
+    draw.mesh_triangles = mesh.triangle_count();
+    draw.transforms.clear();
+    draw.materials.clear();
+}
+
+void Renderer::render_instances(const std::vector<const MeshInstance*>& instances, const Camera& camera,
+                                const std::vector<Light>& lights,
+                                bool wireframe, bool flat_shading) {
+    // matrices are combined once for the whole call, then once per instance; consecutive
+    // instances of one mesh share a batch until it holds about INSTANCE_BATCH_BYTES per worker
+    Mat4 view_proj = camera.get_projection_matrix() * camera.get_view_matrix();
+    int width = framebuffer.get_width(), height = framebuffer.get_height();
+    size_t batch_bytes = INSTANCE_BATCH_BYTES * thread_pool->thread_count();
+    size_t i = 0;
+    while (i < instances.size()) {
+        const Mesh* mesh = instances[i]->mesh.get();
+        if (!mesh) {
+            i++;
+            continue;
+        }
+        size_t instance_bytes = mesh->vertices.size() * sizeof(ScreenVertex) +
+                                mesh->triangles.size() * sizeof(RasterTriangle);
+        size_t batch_limit = std::max<size_t>(1, batch_bytes / std::max<size_t>(1, instance_bytes));
+        begin_batch(mesh->vertices.data(), mesh->vertices.size(), mesh->triangles.data(), mesh->triangles.size());
+        for (; i < instances.size() && instances[i]->mesh.get() == mesh && draw.transforms.size() < batch_limit; i++) {
+            const MeshInstance& instance = *instances[i];
+            draw.transforms.emplace_back(instance.transform * mesh->transform, view_proj, width, height);
+            draw.materials.push_back(&instance.material);
+        }
+        render_batch(camera, view_proj, lights, wireframe, flat_shading);
+    }
+}
+
+void Renderer::render_batch(const Camera& camera, const Mat4& view_proj, const std::vector<Light>& lights,
+                            bool wireframe, bool flat_shading) {
+    // transform all vertices from model space to screen space, drop back faces and triangles
+    // outside the frustum, and clip those crossing the near plane or the guard band
+    // only smooth shading needs per-vertex world normals
+    Vec3 view_dir = (camera.target - camera.position).normalize();
+    bool with_normals = !wireframe && !flat_shading;
+    {
+        PROFILE_STAGE(profiler, ProfileStage::VERTEX);
+        transform_vertices(with_normals);
+    }
+    {
+        PROFILE_STAGE(profiler, ProfileStage::CULL);
+        cull_triangles(with_normals);
+    }
+    geometry_stats.draw_batches++;
+    geometry_stats.instances += draw.instance_count();
     
-    // combine model, view, and projection transformations
-    Mat4 mvp = camera.get_projection_matrix() * camera.get_view_matrix() * mesh.transform;
-    Mat4 model_view = camera.get_view_matrix() * mesh.transform;
+    // per-tile light lists; queued deferred pixels must be lit before the lights they index change
+    if (light_culling && deferred && deferred_triangle_count > 0 && !light_grid_matches(lights, view_proj)) flush();
+    const LightGrid* grid = wireframe ? nullptr : prepare_light_grid(lights, view_proj);
     
-    // transform all vertices from model space to screen space
-    std::vector<Vertex> transformed_vertices;
-    for (const auto& vertex : mesh.vertices) {
-        Vertex transformed = vertex;
-        
-        // apply full transformation pipeline
-        Vec3 world_pos = mesh.transform.transform_point(vertex.position);
-        Vec3 view_pos = model_view.transform_point(vertex.position);
-        Vec3 clip_pos = mvp.transform_point(vertex.position);
-        
-        // perspective divide and viewport transformation
-        if (clip_pos.z != 0) {
-            transformed.position.x = (clip_pos.x / clip_pos.z + 1.0f) * framebuffer.get_width() * 0.5f;
-            transformed.position.y = (1.0f - clip_pos.y / clip_pos.z) * framebuffer.get_height() * 0.5f;
-            transformed.position.z = clip_pos.z;
-        }
-        
-        // transform normal vector for lighting calculations
-        transformed.normal = mesh.transform.transform_direction(vertex.normal).normalize();
-        
-        transformed_vertices.push_back(transformed);
+    // sample tiles kept from earlier flushes only stay valid while every draw goes through them;
+    // the other paths write pixels that the tiles' next resolve would paint over
+    if (!multisampled() || wireframe) binner.release_samples();
+    
+    // deferred: only visibility now, lighting once per pixel in flush(). flat triangles are
+    // already lit once each, so they write their color through the forward path instead of an
+    // id, and flush() leaves those pixels alone
+    if (deferred && !wireframe && !flat_shading) {
+        PROFILE_STAGE(profiler, ProfileStage::SETUP);
+        submit_deferred(lights, view_dir);
+        return;
     }
     
-    Vec3 view_dir = (camera.target - camera.position).normalize();
+    if (!wireframe && !flat_shading) {
+        PROFILE_STAGE(profiler, ProfileStage::LIGHTING);
+        light_vertices(lights, view_dir, grid);
+    }
     
-    // render each triangle in the mesh
-    for (const auto& triangle : mesh.triangles) {
-        const Vertex& v1 = transformed_vertices[triangle.v0];
-        const Vertex& v2 = transformed_vertices[triangle.v1];
-        const Vertex& v3 = transformed_vertices[triangle.v2];
-        
-        // back-face culling - skip triangles facing away from camera
-        Vec3 edge1 = v2.position - v1.position;
-        Vec3 edge2 = v3.position - v1.position;
-        Vec3 screen_normal = edge1.cross(edge2);
-        
-        if (screen_normal.z > 0) continue;  // triangle faces away from camera
+    // solid triangles go to the tile bins and are rasterized in parallel by flush(); samples
+    // only exist per tile, so multisampled triangles take this path too
+    if ((tiled || multisampled()) && !wireframe) {
+        PROFILE_STAGE(profiler, ProfileStage::SETUP);
+        bin_triangles(lights, view_dir, flat_shading, grid);
+        return;
+    }
+    
+    // render each front-facing triangle in the batch; setup and flat lighting happen per
+    // triangle here, so the raster stage includes them
+    PROFILE_STAGE(profiler, ProfileStage::RASTER);
+    size_t draw_count = triangle_count();
+    for (size_t i = 0; i < draw_count; i++) {
+        if (!triangle_visible[i]) continue;
+        Triangle triangle = triangle_at(i);
+        const ScreenVertex& v1 = transformed_vertices[triangle.v0];
+        const ScreenVertex& v2 = transformed_vertices[triangle.v1];
+        const ScreenVertex& v3 = transformed_vertices[triangle.v2];
         
         if (wireframe) {
             // wireframe mode: render triangle edges only
             draw_line(v1.position, v2.position, Vec3(1, 1, 1));
             draw_line(v2.position, v3.position, Vec3(1, 1, 1));
             draw_line(v3.position, v1.position, Vec3(1, 1, 1));
-        } else {
+        } else if (flat_shading) {
             // solid mode: fill triangle with computed lighting
-            Vec3 world_normal = mesh.transform.transform_direction(triangle.normal).normalize();
-            draw_triangle_flat(v1, v2, v3, world_normal, mesh.material, lights, view_dir);
+            size_t instance = triangle_instance(i);
+            Vec3 world_normal = face_normal(i, triangle, instance);
+            draw_triangle_flat(v1, v2, v3, world_normal, *draw.materials[instance], lights, view_dir, grid);
+        } else {
+            draw_triangle_gouraud(v1, v2, v3);
         }
     }
 }
 
-void Renderer::save_image(const std::string& filename) const {
-    framebuffer.save_ppm(filename);
+void Renderer::swap_framebuffer(Framebuffer& other) {
+    flush();
+    if (other.get_width() != framebuffer.get_width() || other.get_height() != framebuffer.get_height()) {
+        std::cerr << "Error: Framebuffer swap needs matching sizes" << std::endl;
+        return;
+    }
+    std::swap(framebuffer, other);
+    binner.release_samples();  // they hold the pixels of the framebuffer that just left
+}
+
+void Renderer::save_image(const std::string& filename) {
+    // png strips are compressed on the renderer's workers
+    std::unique_ptr<ImageEncoder> encoder = make_image_encoder(image_format_for_path(filename), thread_pool.get());
+    save_image(filename, *encoder);
+}
+
+void Renderer::save_image(const std::string& filename, ImageEncoder& encoder) {
+    flush();
+    PROFILE_STAGE(profiler, ProfileStage::ENCODE);
+    framebuffer.save(filename, encoder);
 }
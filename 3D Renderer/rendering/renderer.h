@@ -6,18 +6,242 @@
 #define RENDERER_H
 
 #include "../rendering/framebuffer.h"
+#include "../rendering/tile_binner.h"
+#include "../rendering/light_grid.h"
+#include "../rendering/vertex_transform.h"
+#include "../rendering/light_kernel.h"
+#include "../rendering/shadow_map.h"
 #include "../geometry/mesh.h"
+#include "../geometry/mesh_instance.h"
+#include "../geometry/compact_mesh.h"
+#include "../io/mesh_cache.h"
 #include "../rendering/camera.h"
 #include "../lighting/light.h"
+#include "../core/thread_pool.h"
+#include "../core/profiler.h"
+#include <algorithm>
+#include <memory>
 #include <vector>
 
+// how surfaces are lit; the batched modes light 8 points per call with a polynomial pow, so their
+// colors can differ from the reference by about one 8-bit step
+enum class LightingMode {
+    REFERENCE,           // calculate_lighting per point, phong with std::pow
+    BATCHED_PHONG,       // shade_points kernel, phong
+    BATCHED_BLINN_PHONG  // shade_points kernel, blinn-phong half vectors
+};
+
+// shading cost counters since the last clear(), complete after flush()
+struct ShadingStats {
+    uint64_t lighting_evaluations = 0;  // calculate_lighting calls
+    uint64_t pixels_shaded = 0;         // deferred: visible pixels resolved from the visibility buffer
+};
+
+// clip-stage counters since the last clear()
+struct GeometryStats {
+    uint64_t triangles_submitted = 0;  // mesh triangles entering the clip stage
+    uint64_t triangles_rejected = 0;   // entirely outside one frustum plane
+    uint64_t triangles_backfacing = 0; // inside the frustum but facing away
+    uint64_t triangles_clipped = 0;    // cut at the near plane or the guard band
+    uint64_t clipped_pieces = 0;       // front-facing triangles the clipped polygons were split into
+    uint64_t draw_batches = 0;         // render_mesh calls plus instance batches
+    uint64_t instances = 0;            // mesh copies drawn, one per render_mesh call or instance
+    uint64_t triangles_rasterized = 0; // set up with pixels to cover and handed to the rasterizer
+};
+
+// one frame's cost by pipeline stage and by pipeline counter, from Renderer::get_frame_stats
+struct FrameStats {
+    ProfileTimes times;                  // stage times; all zero when built without RENDER_PROFILING
+    uint64_t triangles_submitted = 0;
+    uint64_t triangles_culled = 0;       // outside the frustum or back-facing
+    uint64_t triangles_rasterized = 0;
+    uint64_t pixels_tested = 0;          // covered pixels depth tested; needs RENDER_PROFILING
+    uint64_t pixels_depth_passed = 0;
+    uint64_t pixels_overdrawn = 0;       // depth-passed pixels later covered again by a nearer triangle
+    uint64_t lighting_evaluations = 0;
+};
+
 // software rasterizer implementing the 3d graphics pipeline
 // transforms geometry, calculates lighting, and rasterizes triangles
 class Renderer {
 private:
     Framebuffer framebuffer;
     Vec3 ambient_light;  // global ambient lighting
-
+    
+    // tile-binned backend: triangles are queued per tile and rasterized in flush()
+    bool tiled;
+    bool multisampling;  // forward triangles are binned and drawn with 4x msaa, whatever tiled says
+    bool multisampled() const { return multisampling && !deferred; }
+    std::unique_ptr<ThreadPool> thread_pool;
+    TileBinner binner;
+    std::vector<RasterTriangle> triangle_setups;  // per-triangle scratch reused across meshes
+    std::vector<unsigned char> triangle_visible;
+    std::vector<ScreenVertex> transformed_vertices;  // post-transform vertex buffer reused across meshes
+    size_t transformed_count;                        // mesh vertices, then vertices made by clipping
+    std::vector<unsigned char> vertex_used;          // referenced by a front-facing triangle
+    RasterStats raster_stats;    // hierarchical z and fragment counters since the last clear()
+    ShadingStats shading_stats;
+    GeometryStats geometry_stats;
+    Profiler profiler;           // stage times since the last clear(), and the trace when one runs
+    
+    // one mesh drawn once per instance: the post-transform buffer holds every instance's copy
+    // of the vertices back to back, and batch triangle i is mesh triangle i % T of instance i / T;
+    // render_mesh draws a batch of one, from a Mesh, a MappedMesh or a CompactMesh; full-precision
+    // geometry is read through plain arrays, so it can live in a vector or in a mapped file
+    struct DrawBatch {
+        const Vertex* vertices = nullptr;
+        const Triangle* triangles = nullptr;
+        const CompactMesh* compact = nullptr;     // set instead of the arrays for quantized geometry
+        size_t mesh_vertices = 0;                 // per instance
+        size_t mesh_triangles = 0;
+        std::vector<VertexTransform> transforms;  // per instance
+        std::vector<const Material*> materials;   // per instance
+        
+        size_t instance_count() const { return transforms.size(); }
+        size_t vertex_count() const { return transforms.size() * mesh_vertices; }
+        size_t triangle_count() const { return transforms.size() * mesh_triangles; }
+        Triangle mesh_triangle(size_t i) const { return compact ? compact->triangle(i) : triangles[i]; }
+    };
+    DrawBatch draw;
+    
+    // clip stage: triangles that cross the near plane or leave the guard band are replaced by
+    // the fan of their clipped polygon, drawn after the batch's own triangles
+    std::vector<Triangle> clipped_triangles;
+    std::vector<uint32_t> clipped_instances;         // instance of each clipped triangle
+    std::vector<uint32_t> clipped_vertex_instances;  // instance of each vertex made by clipping
+    std::vector<GeometryStats> worker_geometry;
+    
+    size_t triangle_count() const { return draw.triangle_count() + clipped_triangles.size(); }
+    
+    // batch triangle i with its vertex indices into the post-transform buffer; vertex indices
+    // are ints, so batch positions always fit the 32-bit divides, which are much cheaper here
+    Triangle triangle_at(size_t i) const {
+        size_t mesh_triangles = draw.mesh_triangles;
+        if (i < mesh_triangles) return draw.mesh_triangle(i);
+        size_t batch_triangles = draw.triangle_count();
+        if (i >= batch_triangles) return clipped_triangles[i - batch_triangles];
+        size_t instance = (uint32_t)i / (uint32_t)mesh_triangles;
+        Triangle triangle = draw.mesh_triangle(i - instance * mesh_triangles);
+        int offset = (int)(instance * draw.mesh_vertices);
+        triangle.v0 += offset;
+        triangle.v1 += offset;
+        triangle.v2 += offset;
+        return triangle;
+    }
+    
+    // visit(i, triangle, instance) for draw triangles first to end - 1 in order; like the vertex
+    // stage, a run is split where it crosses into the next instance, so its triangles are offset
+    // without a divide each, and clipped pieces past the batch come last
+    template <typename Visit>
+    void for_each_triangle(size_t first, size_t end, Visit&& visit) const {
+        size_t mesh_triangles = draw.mesh_triangles;
+        size_t batch_triangles = draw.triangle_count();
+        size_t i = first;
+        while (i < std::min(end, batch_triangles)) {
+            size_t instance = (uint32_t)i / (uint32_t)mesh_triangles;
+            size_t t = i - instance * mesh_triangles;
+            size_t run_end = std::min(end, i + mesh_triangles - t);
+            int offset = (int)(instance * draw.mesh_vertices);
+            for (; i < run_end; i++, t++) {
+                Triangle triangle = draw.mesh_triangle(t);
+                triangle.v0 += offset;
+                triangle.v1 += offset;
+                triangle.v2 += offset;
+                visit(i, triangle, instance);
+            }
+        }
+        for (; i < end; i++) visit(i, clipped_triangles[i - batch_triangles], (size_t)clipped_instances[i - batch_triangles]);
+    }
+    
+    size_t triangle_instance(size_t i) const {
+        size_t batch_triangles = draw.triangle_count();
+        if (i >= batch_triangles) return clipped_instances[i - batch_triangles];
+        return (uint32_t)i / (uint32_t)draw.mesh_triangles;
+    }
+    size_t vertex_instance(size_t v) const {
+        size_t batch_vertices = draw.vertex_count();
+        if (v >= batch_vertices) return clipped_vertex_instances[v - batch_vertices];
+        return (uint32_t)v / (uint32_t)draw.mesh_vertices;
+    }
+    
+    // world-space face normal of draw triangle i for flat shading; compact meshes store none, so
+    // theirs is rebuilt from the quantized vertices, and clipped pieces carry their source's
+    Vec3 face_normal(size_t i, const Triangle& triangle, size_t instance) const {
+        const VertexTransform& transform = draw.transforms[instance];
+        if (!draw.compact || i >= draw.triangle_count()) return transform.transform_normal(triangle.normal);
+        return transform.transform_normal(draw.compact->face_normal(i - instance * draw.mesh_triangles));
+    }
+    
+    // deferred backend: the raster pass writes triangle ids instead of colors for smooth shading
+    // and flush() lights every visible pixel once from the surface data recorded here
+    struct DeferredBatch {
+        std::vector<Light> lights;
+        Vec3 view_dir;
+        PackedLights packed;  // batched lighting modes only
+        bool shadowed;        // lights were the ones the shadow maps were updated for
+    };
+    struct DeferredTriangle {
+        float bary[3][3];    // barycentric weight / w of each vertex as a*x + b*y + c at pixel (x, y)
+        Vec3 world[3];       // world-space vertex positions
+        Vec3 normal[3];      // world-space vertex normals
+        uint32_t batch;
+        uint32_t material;   // index into deferred_materials
+    };
+    bool deferred;
+    std::vector<DeferredBatch> deferred_batches;  // capacity and light lists are kept between frames
+    size_t deferred_batch_count;
+    std::vector<Material> deferred_materials;  // one per instance drawn since the last resolve
+    size_t deferred_material_count;
+    std::vector<DeferredTriangle> deferred_triangles;  // indexed by visibility id, capacity kept like the batches
+    size_t deferred_triangle_count;
+    std::vector<uint64_t> worker_shaded;
+    
+    // tiled light culling; the grid stays valid for one lights vector and camera until clear()
+    bool light_culling;
+    LightGrid light_grid;
+    bool grid_valid;
+    const std::vector<Light>* grid_lights;
+    size_t grid_light_count;
+    Mat4 grid_view_proj;
+    
+    bool light_grid_matches(const std::vector<Light>& lights, const Mat4& view_proj) const;
+    const LightGrid* prepare_light_grid(const std::vector<Light>& lights, const Mat4& view_proj);
+    
+    // lights packed for the batched kernel; like the grid, valid for one lights vector and view until clear()
+    LightingMode lighting_mode;
+    PackedLights packed_lights;
+    bool packed_valid;
+    const std::vector<Light>* packed_source;
+    
+    // null in REFERENCE mode
+    const PackedLights* prepare_packed_lights(const std::vector<Light>& lights, const Vec3& view_dir);
+    SpecularModel specular_model() const {
+        return lighting_mode == LightingMode::BATCHED_BLINN_PHONG ? SpecularModel::BLINN_PHONG : SpecularModel::PHONG;
+    }
+    
+    // shadow maps; active from update_shadows until clear(), for the lights they were updated with
+    bool shadow_mapping;
+    ShadowMaps shadow_maps;
+    bool shadows_ready;
+    const std::vector<Light>* shadow_lights;
+    
+    const ShadowMaps* shadows_for(const std::vector<Light>& lights) const {
+        return shadows_ready && shadow_lights == &lights ? &shadow_maps : nullptr;
+    }
+    
+    void begin_batch(const Vertex* vertices, size_t vertex_count, const Triangle* triangles, size_t triangle_count);
+    void begin_batch(const CompactMesh& mesh);
+    void transform_vertices(bool with_normals);
+    void cull_triangles(bool with_normals);
+    void clip_triangles(bool with_normals);
+    void light_vertices(const std::vector<Light>& lights, const Vec3& view_dir, const LightGrid* grid);
+    void bin_triangles(const std::vector<Light>& lights, const Vec3& view_dir, bool flat_shading,
+                       const LightGrid* grid);
+    void submit_deferred(const std::vector<Light>& lights, const Vec3& view_dir);
+    void render_batch(const Camera& camera, const Mat4& view_proj, const std::vector<Light>& lights,
+                      bool wireframe, bool flat_shading);
+    void shade_deferred();
+    
 public:
     Renderer(int width, int height);
     
@@ -27,21 +251,102 @@ public:
                     const std::vector<Light>& lights,
                     bool wireframe = false, bool flat_shading = true);
     
-    // lighting calculations
+    // the same for quantized geometry, decoded by the vertex stage
+    void render_mesh(const CompactMesh& mesh, const Camera& camera,
+                    const std::vector<Light>& lights,
+                    bool wireframe = false, bool flat_shading = true);
+    
+    // the same for a mesh mapped from a cache file, drawn from the mapping without copying
+    void render_mesh(const MappedMesh& mesh, const Camera& camera,
+                    const std::vector<Light>& lights,
+                    bool wireframe = false, bool flat_shading = true);
+    
+    // draw instances of shared meshes; runs of instances sharing a mesh are transformed, culled
+    // and set up together in batches, so small meshes do not pay per-draw overhead per instance
+    void render_instances(const std::vector<const MeshInstance*>& instances, const Camera& camera,
+                          const std::vector<Light>& lights,
+                          bool wireframe = false, bool flat_shading = true);
+    void flush();  // finish all queued tile work, call before reading the framebuffer
+    
+    // parallel rasterization settings
+    void set_thread_count(int threads);  // 0 = one thread per hardware core
+    int get_thread_count() const { return thread_pool->thread_count(); }
+    ThreadPool& get_thread_pool() { return *thread_pool; }  // shared with loaders, idle between frames
+    void set_tiled(bool enabled);        // false = rasterize immediately on the calling thread
+    bool is_tiled() const { return tiled; }
+    // true = smooth shading writes a visibility buffer, then makes one lighting call per visible
+    // pixel; flat shading keeps its one call per triangle either way
+    void set_deferred(bool enabled);
+    bool is_deferred() const { return deferred; }
+    void set_light_culling(bool enabled);  // false = every surface loops over every light
+    bool is_light_culling() const { return light_culling; }
+    void set_lighting_mode(LightingMode mode);  // REFERENCE by default
+    LightingMode get_lighting_mode() const { return lighting_mode; }
+    // 4x msaa for forward shading, off by default; deferred ignores it. a frame's multisampled triangles
+    // are kept until clear(), and a tile that gets more after a flush is redrawn from its first one, so
+    // the flushes of get_frame_stats, light grid changes or save_image in mid-frame lose no coverage.
+    // wireframe, deferred or non-multisampled draws and swap_framebuffer end that: multisampled
+    // triangles after them start from the resolved pixels
+    void set_multisampling(bool enabled);
+    bool is_multisampling() const { return multisampling; }
+    size_t get_sample_memory() const { return binner.sample_bytes(); }  // sample tiles and tile bases
+    void set_shadow_mapping(bool enabled);  // off by default; the scene then supplies casters each frame
+    bool is_shadow_mapping() const { return shadow_mapping; }
+    void set_shadow_settings(const ShadowSettings& settings);
+    const ShadowSettings& get_shadow_settings() const { return shadow_maps.get_settings(); }
+    
+    // bring the shadow maps of lights up to date with the casters, after clear() and before
+    // drawing; until the next clear() every draw with this lights vector is shadowed by them.
+    // maps are cached across frames, call invalidate_shadows after editing caster geometry in place
+    void update_shadows(const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters);
+    void invalidate_shadows() { shadow_maps.invalidate(); }
+    const ShadowStats& get_shadow_stats() const { return shadow_maps.get_stats(); }
+    
+    // per-tile light lists of the last rendered mesh, when light culling is on
+    const LightGrid* get_light_grid() const { return grid_valid ? &light_grid : nullptr; }
+    
+    // hierarchical z and fragment counters for the current frame, complete after flush()
+    const RasterStats& get_raster_stats() const { return raster_stats; }
+    
+    // frustum rejection and clipping counters for the current frame
+    const GeometryStats& get_geometry_stats() const { return geometry_stats; }
+    
+    // lighting cost of the current frame: one evaluation per visible triangle for flat shading,
+    // one per vertex of a front-facing triangle for gouraud shading, one per visible pixel for
+    // deferred smooth shading
+    const ShadingStats& get_shading_stats() const { return shading_stats; }
+    
+    // stage times and counters of the current frame; flushes first, and counts the pixels still
+    // covered at the end, so call it once per frame rather than per mesh
+    FrameStats get_frame_stats();
+    Profiler& get_profiler() { return profiler; }  // also times the scene's stage and draws
+    
+    // lighting calculations; with shadows, light i is scaled by its map's visibility
+    Vec3 calculate_lighting(const Vec3& position, const Vec3& normal,
+                           const Material& material,
+                           const std::vector<Light>& lights,
+                           const Vec3& view_dir, const ShadowMaps* shadows = nullptr);
+    
+    // only the listed lights, skipping point lights out of range of position
     Vec3 calculate_lighting(const Vec3& position, const Vec3& normal,
                            const Material& material,
                            const std::vector<Light>& lights,
-                           const Vec3& view_dir);
+                           const uint32_t* light_indices, size_t light_count,
+                           const Vec3& view_dir, const ShadowMaps* shadows = nullptr);
     
     // primitive rendering functions
     void draw_line(Vec3 p1, Vec3 p2, const Vec3& color);
-    void draw_triangle_flat(const Vertex& v1, const Vertex& v2, const Vertex& v3,
+    void draw_triangle_flat(const ScreenVertex& v1, const ScreenVertex& v2, const ScreenVertex& v3,
                            const Vec3& face_normal, const Material& material,
-                           const std::vector<Light>& lights, const Vec3& view_dir);
+                           const std::vector<Light>& lights, const Vec3& view_dir,
+                           const LightGrid* grid = nullptr);
+    void draw_triangle_gouraud(const ScreenVertex& v1, const ScreenVertex& v2, const ScreenVertex& v3);
     
-    // framebuffer access
-    void save_image(const std::string& filename) const;
+    // image output, flushing queued work first
+    void save_image(const std::string& filename);                          // format from the extension
+    void save_image(const std::string& filename, ImageEncoder& encoder);
     Framebuffer& get_framebuffer() { return framebuffer; }
+    void swap_framebuffer(Framebuffer& other);  // flushes first; other must match in size
 };
 
 #endif
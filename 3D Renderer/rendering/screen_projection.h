@@ -0,0 +1,40 @@
+// screen_projection.h
+// clip-space transform, perspective divide and viewport mapping to framebuffer pixels
+// shared by the vertex stage, the clipper and light culling so all place points identically
+
+#ifndef SCREEN_PROJECTION_H
+#define SCREEN_PROJECTION_H
+
+#include "../math/mat4.h"
+#include "../math/Vec3.h"
+
+// clip-space x, y, z, w of a model-space point, without the divide of Mat4::transform_point
+// the simd vertex kernels repeat these float operations lane by lane
+inline void transform_to_clip(const Mat4& mvp, const Vec3& point, float clip[4]) {
+    const float* m = mvp.m;
+    clip[0] = m[0] * point.x + m[1] * point.y + m[2] * point.z + m[3];
+    clip[1] = m[4] * point.x + m[5] * point.y + m[6] * point.z + m[7];
+    clip[2] = m[8] * point.x + m[9] * point.y + m[10] * point.z + m[11];
+    clip[3] = m[12] * point.x + m[13] * point.y + m[14] * point.z + m[15];
+}
+
+// screen x and y plus normalized depth in z, and 1/w for perspective-correct attributes
+// only meaningful in front of the camera (w > 0); the clipper guarantees that for triangles
+inline void clip_to_screen(const float clip[4], int width, int height, Vec3& screen, float& inv_w) {
+    inv_w = 1.0f / clip[3];
+    screen.x = (clip[0] * inv_w + 1.0f) * width * 0.5f;
+    screen.y = (1.0f - clip[1] * inv_w) * height * 0.5f;
+    screen.z = clip[2] * inv_w;
+}
+
+// both steps for a single point; returns false (leaving screen untouched) behind the camera
+inline bool project_to_screen(const Mat4& mvp, const Vec3& point, int width, int height,
+                              Vec3& screen, float& inv_w) {
+    float clip[4];
+    transform_to_clip(mvp, point, clip);
+    if (!(clip[3] > 0.0f)) return false;
+    clip_to_screen(clip, width, height, screen, inv_w);
+    return true;
+}
+
+#endif
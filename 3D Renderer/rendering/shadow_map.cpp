@@ -0,0 +1,249 @@
+// shadow_map.cpp
+// fitting, caching and depth-only drawing of shadow maps, and filtered lookups into them
+
+#include "shadow_map.h"
+#include "clipper.h"
+#include "frustum.h"
+#include "rasterizer.h"
+#include "screen_projection.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // near plane of point light faces, in world units
+    const float POINT_NEAR = 0.05f;
+    
+    // cube faces in the order +x, -x, +y, -y, +z, -z; the y faces need another up vector
+    const Vec3 CUBE_AXES[6] = {Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0), Vec3(0, 0, 1), Vec3(0, 0, -1)};
+    const Vec3 CUBE_UPS[6] = {Vec3(0, 1, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3(0, 0, -1), Vec3(0, 1, 0), Vec3(0, 1, 0)};
+    
+    // 64-bit fnv-1a, over the bytes of everything a face's contents depend on
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+    
+    uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * FNV_PRIME;
+        return hash;
+    }
+    
+    template <typename T>
+    uint64_t hash_value(uint64_t hash, const T& value) {
+        return hash_bytes(hash, &value, sizeof(value));
+    }
+    
+    // sphere around every caster, through the box of their spheres
+    BoundingSphere caster_bounds(const std::vector<ShadowCaster>& casters) {
+        Vec3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+        for (const ShadowCaster& caster : casters) {
+            const BoundingSphere& s = caster.bounds;
+            if (s.is_empty()) continue;
+            lo = Vec3(std::min(lo.x, s.center.x - s.radius), std::min(lo.y, s.center.y - s.radius),
+                      std::min(lo.z, s.center.z - s.radius));
+            hi = Vec3(std::max(hi.x, s.center.x + s.radius), std::max(hi.y, s.center.y + s.radius),
+                      std::max(hi.z, s.center.z + s.radius));
+        }
+        BoundingSphere bounds;
+        if (lo.x > hi.x) return bounds;
+        bounds.center = (lo + hi) * 0.5f;
+        bounds.radius = std::max(1e-3f, (hi - lo).length() * 0.5f);
+        return bounds;
+    }
+}
+
+void ShadowMaps::set_settings(const ShadowSettings& new_settings) {
+    settings = new_settings;
+    invalidate();
+}
+
+void ShadowMaps::invalidate() {
+    for (Face& face : faces) face.valid = false;
+}
+
+void ShadowMaps::update(const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters, ThreadPool& pool) {
+    auto start = std::chrono::steady_clock::now();
+    stats = ShadowStats();
+    BoundingSphere scene = caster_bounds(casters);
+    
+    // lay the maps out over the face list, fitting each to the casters
+    light_maps.resize(lights.size());
+    size_t face_count = 0;
+    for (size_t i = 0; i < lights.size(); i++) {
+        const Light& light = lights[i];
+        LightMap& map = light_maps[i];
+        map.point = light.type == LightType::POINT;
+        map.first_face = face_count;
+        map.face_count = 0;
+        if (scene.is_empty()) continue;
+        
+        if (map.point) {
+            // the cube reaches the far side of the scene, or only as far as the light does
+            float far = std::min(light.radius, (scene.center - light.position).length() + scene.radius);
+            if (!(far > 2.0f * POINT_NEAR)) continue;
+            map.position = light.position;
+            map.face_count = 6;
+            Mat4 projection = Mat4::perspective(3.14159265f * 0.5f, 1.0f, POINT_NEAR, far);
+            for (int f = 0; f < 6; f++) {
+                if (faces.size() <= face_count + f) faces.resize(face_count + f + 1);
+                Face& face = faces[face_count + f];
+                Mat4 view = Mat4::look_at(light.position, light.position + CUBE_AXES[f], CUBE_UPS[f]);
+                face.view_proj = projection * view;
+                face.size = settings.cube_size;
+            }
+        } else {
+            // an orthographic box around the scene sphere, looking along the light
+            map.to_light = (light.direction * -1.0f).normalize();
+            map.face_count = 1;
+            float r = scene.radius;
+            map.texel = 2.0f * r / settings.directional_size;
+            Vec3 up = std::fabs(map.to_light.y) > 0.99f ? Vec3(0, 0, 1) : Vec3(0, 1, 0);
+            Mat4 view = Mat4::look_at(scene.center + map.to_light * (2.0f * r), scene.center, up);
+            if (faces.size() <= face_count) faces.resize(face_count + 1);
+            Face& face = faces[face_count];
+            face.view_proj = Mat4::orthographic(-r, r, -r, r, 0.5f * r, 3.5f * r) * view;
+            face.size = settings.directional_size;
+        }
+        face_count += map.face_count;
+    }
+    
+    // a face is redrawn when anything it depends on differs from when it was drawn
+    dirty.clear();
+    for (size_t f = 0; f < face_count; f++) {
+        Face& face = faces[f];
+        Frustum frustum(face.view_proj);
+        uint64_t signature = hash_value(hash_value(FNV_OFFSET, face.view_proj.m), face.size);
+        face.casters.clear();
+        for (size_t c = 0; c < casters.size(); c++) {
+            const ShadowCaster& caster = casters[c];
+            if (caster.bounds.is_empty() || !frustum.intersects(caster.bounds)) continue;
+            face.casters.push_back((uint32_t)c);
+            const void* geometry = caster.compact ? (const void*)caster.compact : (const void*)caster.vertices;
+            signature = hash_value(signature, geometry);
+            signature = hash_value(signature, caster.triangle_count);
+            signature = hash_value(signature, caster.transform.m);
+        }
+        if (settings.cache && face.valid && face.signature == signature) {
+            stats.faces_cached++;
+            continue;
+        }
+        face.signature = signature;
+        face.valid = true;
+        dirty.push_back((uint32_t)f);
+    }
+    
+    // faces are independent, so dirty ones are drawn one per worker
+    int threads = pool.thread_count();
+    if (worker_vertices.size() < (size_t)threads) worker_vertices.resize(threads);
+    worker_triangles.assign(threads, 0);
+    pool.parallel_for((int)dirty.size(), [&](int index, int worker) {
+        worker_triangles[worker] += draw_face(faces[dirty[index]], casters, worker_vertices[worker]);
+    });
+    stats.faces_rendered = dirty.size();
+    for (uint64_t triangles : worker_triangles) stats.triangles_drawn += triangles;
+    stats.update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t ShadowMaps::draw_face(Face& face, const std::vector<ShadowCaster>& casters,
+                               std::vector<ScreenVertex>& vertices) {
+    int size = face.size;
+    face.depth.assign((size_t)size * size, INFINITY);
+    TileRect viewport = {0, 0, size, size};
+    uint64_t drawn = 0;
+    auto draw = [&](const Vec3& p0, const Vec3& p1, const Vec3& p2) {
+        RasterTriangle tri;
+        if (!setup_triangle(p0, p1, p2, Vec3(0, 0, 0), viewport, tri)) return;
+        rasterize_depth(tri, viewport, face.depth.data(), size);
+        drawn++;
+    };
+    
+    for (uint32_t index : face.casters) {
+        const ShadowCaster& caster = casters[index];
+        if (vertices.size() < caster.vertex_count) vertices.resize(caster.vertex_count);
+        if (caster.compact) {
+            VertexTransform transform(caster.transform, caster.compact->get_dequantize_matrix(), face.view_proj,
+                                      size, size);
+            transform_vertex_batch(transform, caster.compact->vertices.data(), caster.vertex_count, vertices.data(),
+                                   false);
+        } else {
+            VertexTransform transform(caster.transform, face.view_proj, size, size);
+            transform_vertex_batch(transform, caster.vertices, caster.vertex_count, vertices.data(), false);
+        }
+        
+        // no back-face culling: open meshes such as the floor cast from either side
+        for (size_t t = 0; t < caster.triangle_count; t++) {
+            Triangle triangle = caster.compact ? caster.compact->triangle(t) : caster.triangles[t];
+            const ScreenVertex& v0 = vertices[triangle.v0];
+            const ScreenVertex& v1 = vertices[triangle.v1];
+            const ScreenVertex& v2 = vertices[triangle.v2];
+            if (v0.clip_code & v1.clip_code & v2.clip_code & CLIP_FRUSTUM) continue;
+            if (((v0.clip_code | v1.clip_code | v2.clip_code) & CLIP_CUT) == 0) {
+                draw(v0.position, v1.position, v2.position);
+                continue;
+            }
+            ScreenVertex polygon[MAX_CLIP_VERTICES];
+            int count = clip_triangle(v0, v1, v2, size, size, false, polygon);
+            for (int i = 1; i + 1 < count; i++) draw(polygon[0].position, polygon[i].position, polygon[i + 1].position);
+        }
+    }
+    return drawn;
+}
+
+float ShadowMaps::visibility(size_t light, const Vec3& position, const Vec3& normal) const {
+    if (!has_map(light)) return 1.0f;
+    const LightMap& map = light_maps[light];
+    
+    // receivers are pushed off their surface by a few texels of the map they are looked up in
+    if (!map.point) {
+        Vec3 offset = normal * (settings.normal_offset * map.texel) + map.to_light * (settings.depth_offset * map.texel);
+        return filter(faces[map.first_face], position + offset);
+    }
+    
+    // a texel of a 90 degree face spans 2 * major / size at the point's distance along the axis
+    Vec3 d = position - map.position;
+    float major = std::max({std::fabs(d.x), std::fabs(d.y), std::fabs(d.z)});
+    if (!(major > 0.0f)) return 1.0f;
+    float texel = 2.0f * major / settings.cube_size;
+    Vec3 to_light = d * (-1.0f / d.length());
+    Vec3 offset = normal * (settings.normal_offset * texel) + to_light * (settings.depth_offset * texel);
+    
+    // the face is picked after the offset, which can carry points near an edge into the next face
+    d = d + offset;
+    float ax = std::fabs(d.x), ay = std::fabs(d.y), az = std::fabs(d.z);
+    int f;
+    if (ax >= ay && ax >= az) {
+        f = d.x >= 0.0f ? 0 : 1;
+    } else if (ay >= az) {
+        f = d.y >= 0.0f ? 2 : 3;
+    } else {
+        f = d.z >= 0.0f ? 4 : 5;
+    }
+    return filter(faces[map.first_face + f], position + offset);
+}
+
+float ShadowMaps::filter(const Face& face, const Vec3& position) const {
+    Vec3 screen;
+    float inv_w;
+    if (!project_to_screen(face.view_proj, position, face.size, face.size, screen, inv_w)) return 1.0f;
+    
+    // a grid of texels around the point, clamped at the map's edges; off the map is lit
+    int r = settings.pcf_radius;
+    if (!(screen.x >= -r && screen.x < face.size + r && screen.y >= -r && screen.y < face.size + r)) return 1.0f;
+    
+    // the texel under the point; truncating the shifted coordinate floors it without a libm call
+    int cx = (int)(screen.x + r) - r, cy = (int)(screen.y + r) - r, last = face.size - 1;
+    int lit = 0;
+    if (cx >= r && cx + r <= last && cy >= r && cy + r <= last) {
+        const float* row = face.depth.data() + (size_t)(cy - r) * face.size + (cx - r);
+        for (int dy = -r; dy <= r; dy++, row += face.size) {
+            for (int dx = 0; dx <= 2 * r; dx++) lit += screen.z <= row[dx];
+        }
+        return (float)lit / (float)((2 * r + 1) * (2 * r + 1));
+    }
+    for (int dy = -r; dy <= r; dy++) {
+        const float* row = face.depth.data() + (size_t)std::clamp(cy + dy, 0, last) * face.size;
+        for (int dx = -r; dx <= r; dx++) lit += screen.z <= row[std::clamp(cx + dx, 0, last)];
+    }
+    return (float)lit / (float)((2 * r + 1) * (2 * r + 1));
+}
@@ -0,0 +1,99 @@
+// shadow_map.h
+// depth maps of the scene as seen from each light, cached across frames
+// directional lights get one orthographic map, point lights a cube of six 90 degree faces
+
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include "vertex_transform.h"
+#include "../geometry/bounds.h"
+#include "../geometry/compact_mesh.h"
+#include "../geometry/triangle.h"
+#include "../geometry/vertex.h"
+#include "../lighting/light.h"
+#include "../math/mat4.h"
+#include "../math/Vec3.h"
+#include "../core/thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ShadowSettings {
+    int directional_size = 1024;  // texels per side of a directional map
+    int cube_size = 512;          // texels per side of each point light face
+    int pcf_radius = 1;           // percentage-closer filtering over (2r+1)^2 texels
+    float normal_offset = 1.5f;   // receiver pushed along its normal, in texels of its map
+    float depth_offset = 1.0f;    // and towards the light, in texels, against shadow acne
+    bool cache = true;            // false re-renders every map on every update, for comparison
+};
+
+// one piece of geometry casting shadows, drawn like Renderer::render_mesh draws it
+struct ShadowCaster {
+    const Vertex* vertices = nullptr;
+    const Triangle* triangles = nullptr;
+    const CompactMesh* compact = nullptr;  // set instead of the arrays for quantized geometry
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    Mat4 transform;                        // object to world
+    BoundingSphere bounds;                 // world space, for culling casters per map face
+};
+
+// counters of the last update
+struct ShadowStats {
+    uint64_t faces_rendered = 0;   // map faces drawn, a point light has six
+    uint64_t faces_cached = 0;     // faces kept from an earlier update
+    uint64_t triangles_drawn = 0;  // caster triangles sent to the depth rasterizer
+    double update_ms = 0.0;        // the whole update, cache checks included
+};
+
+// shadow maps for one list of lights; map i belongs to light i of the last update
+class ShadowMaps {
+public:
+    void set_settings(const ShadowSettings& settings);  // drops every cached map
+    const ShadowSettings& get_settings() const { return settings; }
+    
+    // fit the maps to the casters and redraw the faces whose light, fit or casters changed;
+    // a face is keyed by its view-projection and the geometry and transform of each caster it
+    // sees, so geometry edited in place is only noticed after invalidate()
+    void update(const std::vector<Light>& lights, const std::vector<ShadowCaster>& casters, ThreadPool& pool);
+    void invalidate();
+    
+    bool has_map(size_t light) const { return light < light_maps.size() && light_maps[light].face_count > 0; }
+    
+    // fraction of the light reaching a world-space point with unit normal, 0 to 1; points
+    // outside the map are lit
+    float visibility(size_t light, const Vec3& position, const Vec3& normal) const;
+    
+    const ShadowStats& get_stats() const { return stats; }
+    
+private:
+    struct Face {
+        Mat4 view_proj;
+        std::vector<float> depth;        // normalized depth per texel, INFINITY where nothing is
+        std::vector<uint32_t> casters;   // casters drawn into it, gathered during update
+        int size = 0;
+        uint64_t signature = 0;
+        bool valid = false;
+    };
+    struct LightMap {
+        bool point = false;
+        Vec3 position;                   // point lights
+        Vec3 to_light;                   // directional lights, unit
+        float texel = 0.0f;              // directional: world size of one texel
+        size_t first_face = 0;
+        size_t face_count = 0;           // 0 when the light casts no shadow
+    };
+    
+    ShadowSettings settings;
+    std::vector<Face> faces;             // only grows, so maps are reused between updates
+    std::vector<LightMap> light_maps;
+    std::vector<uint32_t> dirty;
+    std::vector<std::vector<ScreenVertex>> worker_vertices;
+    std::vector<uint64_t> worker_triangles;
+    ShadowStats stats;
+    
+    uint64_t draw_face(Face& face, const std::vector<ShadowCaster>& casters, std::vector<ScreenVertex>& vertices);
+    float filter(const Face& face, const Vec3& position) const;
+};
+
+#endif
@@ -0,0 +1,143 @@
+// tile_binner.cpp
+// implementation of triangle binning and parallel tile rasterization
+
+#include "tile_binner.h"
+#include <algorithm>
+
+TileBinner::TileBinner(int w, int h) : width(0), height(0), tiles_x(0), tiles_y(0), queued(0), samples_held(false) {
+    resize(w, h);
+}
+
+void TileBinner::resize(int w, int h) {
+    width = w;
+    height = h;
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    bins.assign(tiles_x * tiles_y, Bin());
+    triangles.clear();
+    queued = 0;
+    arena.reset();
+    tile_bases.resize(tiles_x * tiles_y);
+    samples_held = false;
+}
+
+void TileBinner::reset_bins() {
+    std::fill(bins.begin(), bins.end(), Bin());
+    triangles.clear();
+    queued = 0;
+    arena.reset();
+}
+
+void TileBinner::release_samples() {
+    if (!samples_held) return;
+    samples_held = false;
+    if (queued == 0) {
+        reset_bins();
+        return;
+    }
+    for (Bin& bin : bins) bin.start = bin.drawn;
+}
+
+size_t TileBinner::sample_bytes() const {
+    size_t bytes = worker_samples.size() * (sizeof(SampleTile) + SampleTile::SAMPLE_BYTES);
+    for (const SampleBase& base : tile_bases) {
+        bytes += sizeof(SampleBase) + base.colors.capacity() * sizeof(uint32_t) +
+                 (base.depths.capacity() + base.block_max_depth.capacity()) * sizeof(float);
+    }
+    return bytes;
+}
+
+template <typename Visit>
+void TileBinner::for_each_index(const Bin& bin, uint32_t first, Visit&& visit) {
+    uint32_t position = 0;
+    for (const BinChunk* chunk = bin.first; chunk; chunk = chunk->next) {
+        if (position + chunk->count <= first) {
+            position += chunk->count;
+            continue;
+        }
+        for (uint32_t i = 0; i < chunk->count; i++, position++) {
+            if (position >= first) visit(position, chunk->indices[i]);
+        }
+    }
+}
+
+void TileBinner::add(const RasterTriangle& tri) {
+    uint32_t index = (uint32_t)triangles.size();
+    triangles.push_back(tri);
+    queued++;
+    
+    // setup already clamped the pixel bounds to the viewport, so tile indices stay in range
+    int tx0 = tri.min_x / TILE_SIZE, tx1 = (tri.max_x - 1) / TILE_SIZE;
+    int ty0 = tri.min_y / TILE_SIZE, ty1 = (tri.max_y - 1) / TILE_SIZE;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            Bin& bin = bins[ty * tiles_x + tx];
+            if (!bin.last || bin.last->count == CHUNK_INDICES) {
+                BinChunk* chunk = arena.allocate<BinChunk>();
+                chunk->next = nullptr;
+                chunk->count = 0;
+                (bin.last ? bin.last->next : bin.first) = chunk;
+                bin.last = chunk;
+            }
+            bin.last->indices[bin.last->count++] = index;
+            bin.count++;
+        }
+    }
+}
+
+void TileBinner::execute(ThreadPool& pool, Framebuffer& framebuffer, RasterStats& stats, Profiler* profiler,
+                         bool multisample) {
+    if (queued == 0) return;
+    
+    // counters are kept per tile and merged per worker, so no atomics are needed
+    worker_stats.assign(pool.thread_count(), RasterStats());
+    if (multisample && worker_samples.size() < (size_t)pool.thread_count()) worker_samples.resize(pool.thread_count());
+    
+    pool.parallel_for(tile_count(), [&](int tile, int worker) {
+        Bin& bin = bins[tile];
+        if (bin.drawn == bin.count) return;
+#if RENDER_PROFILING
+        uint64_t start = profiler && profiler->is_tracing() ? profiler->now() : 0;
+#endif
+        
+        int tx = tile % tiles_x, ty = tile / tiles_x;
+        TileRect rect = {
+            tx * TILE_SIZE, ty * TILE_SIZE,
+            std::min((tx + 1) * TILE_SIZE, width), std::min((ty + 1) * TILE_SIZE, height)
+        };
+        
+        // the tile's 64 rows of color and depth stay hot in this worker's cache
+        RasterStats tile_stats;
+        if (multisample) {
+            // the resolve keeps one color and depth per pixel, which cannot give the samples back, so
+            // a tile multisampled earlier in the frame starts over from its base with every triangle
+            // since; only the new ones are counted
+            SampleTile& samples = worker_samples[worker];
+            if (bin.drawn == bin.start) {
+                samples.load(framebuffer, tx, ty, tile_bases[tile]);
+            } else {
+                samples.reload(framebuffer, tx, ty, tile_bases[tile]);
+            }
+            for_each_index(bin, bin.start, [&](uint32_t position, uint32_t index) {
+                rasterize_triangle_msaa(triangles[index], samples, position < bin.drawn ? nullptr : &tile_stats);
+            });
+            resolve_samples(samples, framebuffer);
+        } else {
+            for_each_index(bin, bin.drawn, [&](uint32_t, uint32_t index) {
+                rasterize_triangle(triangles[index], rect, framebuffer, &tile_stats);
+            });
+            bin.start = bin.count;
+        }
+        bin.drawn = bin.count;
+        worker_stats[worker].add(tile_stats);
+#if RENDER_PROFILING
+        if (start) profiler->add_event("tile", worker, start, profiler->now(), "tile", tile);
+#endif
+    });
+    
+    for (const RasterStats& counts : worker_stats) stats.add(counts);
+    samples_held = samples_held || multisample;
+    (void)profiler;
+    queued = 0;
+    if (!samples_held) reset_bins();
+}
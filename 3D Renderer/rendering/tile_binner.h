@@ -0,0 +1,88 @@
+// tile_binner.h
+// screen-space triangle binning for the multithreaded rasterizer
+// triangles are sorted into 64x64 tiles, then whole tiles are rasterized in parallel
+
+#ifndef TILE_BINNER_H
+#define TILE_BINNER_H
+
+#include "rasterizer.h"
+#include "framebuffer.h"
+#include "../core/thread_pool.h"
+#include "../core/frame_arena.h"
+#include "../core/profiler.h"
+#include <cstdint>
+#include <vector>
+
+// collects the triangles of a frame and replays them tile by tile
+// each tile is owned by exactly one worker, so framebuffer writes need no locking
+// and per-tile submission order is preserved, which keeps output identical to serial rendering
+class TileBinner {
+public:
+    TileBinner(int width = 0, int height = 0);
+    
+    void resize(int width, int height);  // match the framebuffer dimensions
+    
+    // queue a set-up triangle in every tile its bounding box touches
+    void add(const RasterTriangle& tri);
+    
+    // rasterize all queued triangles and empty the bins (memory is kept for the next frame)
+    // hierarchical z counters of all workers are added to stats; with a profiler, each tile is
+    // traced on the timeline of the worker that drew it
+    // multisample draws triangles set up for it into the worker's sample tile, resolved into the
+    // framebuffer once the tile's bin is done; the bins are kept, and a tile drawn again later in
+    // the frame is redrawn from where its first multisampled execute started, so its samples come
+    // out as if the frame had been flushed once
+    void execute(ThreadPool& pool, Framebuffer& framebuffer, RasterStats& stats, Profiler* profiler = nullptr,
+                 bool multisample = false);
+    
+    // forget the multisampled triangles drawn by earlier executes, once the framebuffer was written
+    // around them or belongs to someone else; queued triangles stay, and the next multisampled execute
+    // starts every tile from its pixels again. resize does this too, which is how every frame starts
+    void release_samples();
+    
+    // worker sample tiles and the tile bases kept for redraws, reserved capacity included
+    size_t sample_bytes() const;
+    
+    bool empty() const { return queued == 0; }  // nothing queued since the last execute
+    size_t triangle_count() const { return triangles.size(); }
+    int tile_count() const { return tiles_x * tiles_y; }
+    
+private:
+    int width, height;
+    int tiles_x, tiles_y;
+    std::vector<RasterTriangle> triangles;     // every binned triangle in submission order
+    size_t queued;                             // of which added since the last execute
+    
+    // a tile's indices into triangles, in chunks of one arena allocation each; a tile that sees
+    // more triangles than ever before takes another chunk instead of regrowing its own array
+    static constexpr uint32_t CHUNK_INDICES = 61;  // 256-byte chunks
+    struct BinChunk {
+        BinChunk* next;
+        uint32_t count;
+        uint32_t indices[CHUNK_INDICES];
+    };
+    // positions below start are past for good: drawn straight into the framebuffer, or before the
+    // samples were released. from start to drawn they were multisampled by an earlier execute
+    struct Bin {
+        BinChunk* first = nullptr;
+        BinChunk* last = nullptr;
+        uint32_t count = 0;
+        uint32_t start = 0;
+        uint32_t drawn = 0;
+    };
+    std::vector<Bin> bins;
+    FrameArena arena;                          // every bin chunk of the frame, reset with the bins
+    std::vector<RasterStats> worker_stats;     // one slot per worker, merged after each execute
+    
+    std::vector<SampleTile> worker_samples;    // one per worker, made by the first multisampled execute
+    std::vector<SampleBase> tile_bases;        // per tile, recorded by its first multisampled load
+    bool samples_held;                         // bins keep multisampled triangles for redraws
+    
+    void reset_bins();                         // drop every triangle, queued or drawn
+    
+    // visit(position, triangle index) for the indices of bin from position first on
+    template <typename Visit>
+    static void for_each_index(const Bin& bin, uint32_t first, Visit&& visit);
+};
+
+#endif
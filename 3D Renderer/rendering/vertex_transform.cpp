@@ -0,0 +1,497 @@
+// vertex_transform.cpp
+// scalar, sse2 and avx2 vertex stage kernels
+// vertices are loaded four floats at a time and transposed, so no gathers or scratch copies are needed
+
+#include "vertex_transform.h"
+#include "clipper.h"
+#include "screen_projection.h"
+#include "rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if RENDER_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// the kernels read a vec3 plus the following float, and write 16-byte groups of ScreenVertex
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be three packed floats");
+static_assert(sizeof(Vertex) == 9 * sizeof(float), "vertex kernels read past position and normal");
+static_assert(sizeof(QuantizedVertex) == 8, "quantized kernels load four vertices per 32 bytes");
+static_assert(offsetof(ScreenVertex, inv_w) == offsetof(ScreenVertex, position) + 12 &&
+              offsetof(ScreenVertex, clip) == offsetof(ScreenVertex, position) + 16 &&
+              offsetof(ScreenVertex, clip_code) == offsetof(ScreenVertex, world) + 12,
+              "vertex kernels store position, clip and world as whole vectors");
+
+namespace {
+    // octahedral normal codes run from -127 to 127
+    const float OCTAHEDRAL_STEPS = 127.0f;
+    
+    inline Vec3 transform_affine(const float* m, const Vec3& p) {
+        return Vec3(m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3],
+                    m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7],
+                    m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+    }
+    
+    inline const Vec3& vertex_position(const Vertex& vertex) { return vertex.position; }
+    inline const Vec3& vertex_normal(const Vertex& vertex) { return vertex.normal; }
+    
+    // quantized vertices are decoded in code units: the transform's matrices scale positions, and
+    // the normal is normalized after the normal matrix, so neither needs dividing here
+    inline Vec3 vertex_position(const QuantizedVertex& vertex) {
+        return Vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+    }
+    
+    // octahedral unfold, the same float operations as unfold_octahedral_sse2
+    inline Vec3 vertex_normal(const QuantizedVertex& vertex) {
+        float x = vertex.normal[0], y = vertex.normal[1];
+        float z = OCTAHEDRAL_STEPS - std::fabs(x) - std::fabs(y);
+        float fold = std::max(-z, 0.0f);
+        return Vec3(x - std::copysign(fold, x), y - std::copysign(fold, y), z);
+    }
+    
+    template <typename VertexType>
+    void transform_vertices_scalar(const VertexTransform& transform, const VertexType* vertices, size_t count,
+                                   ScreenVertex* out, bool with_normals) {
+        for (size_t i = 0; i < count; i++) {
+            const VertexType& vertex = vertices[i];
+            ScreenVertex& transformed = out[i];
+            Vec3 position = vertex_position(vertex);
+            transform_to_clip(transform.mvp, position, transformed.clip);
+            transformed.clip_code = clip_code(transformed.clip);
+            clip_to_screen(transformed.clip, transform.width, transform.height, transformed.position, transformed.inv_w);
+            transformed.world = transform_affine(transform.model.m, position);
+            if (with_normals) transformed.normal = transform.transform_normal(vertex_normal(vertex));
+        }
+    }
+    
+#if RENDER_HAS_X86_SIMD
+    // row r of a matrix applied to four lanes, summed left to right like the scalar code
+    __attribute__((target("sse2")))
+    inline __m128 dot_row_sse2(const float* row, __m128 x, __m128 y, __m128 z) {
+        __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0]), x), _mm_mul_ps(_mm_set1_ps(row[1]), y));
+        return _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[2]), z));
+    }
+    
+    // bit in the lanes whose plane distance is negative
+    __attribute__((target("sse2")))
+    inline __m128 code_bit_sse2(__m128 distance, uint32_t bit) {
+        return _mm_and_ps(_mm_cmplt_ps(distance, _mm_setzero_ps()), _mm_castsi128_ps(_mm_set1_epi32((int)bit)));
+    }
+    
+    // outcodes with the float operations of clip_plane_distance, as integer bits in float lanes
+    __attribute__((target("sse2")))
+    inline __m128 clip_codes_sse2(__m128 x, __m128 y, __m128 z, __m128 w) {
+        __m128 guard = _mm_mul_ps(_mm_set1_ps(GUARD_BAND), w);
+        __m128 code = _mm_or_ps(code_bit_sse2(_mm_add_ps(x, w), CLIP_LEFT), code_bit_sse2(_mm_sub_ps(w, x), CLIP_RIGHT));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_add_ps(y, w), CLIP_BOTTOM));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_sub_ps(w, y), CLIP_TOP));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_add_ps(z, w), CLIP_NEAR));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_sub_ps(w, z), CLIP_FAR));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_add_ps(x, guard), CLIP_GUARD_LEFT));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_sub_ps(guard, x), CLIP_GUARD_RIGHT));
+        code = _mm_or_ps(code, code_bit_sse2(_mm_add_ps(y, guard), CLIP_GUARD_BOTTOM));
+        return _mm_or_ps(code, code_bit_sse2(_mm_sub_ps(guard, y), CLIP_GUARD_TOP));
+    }
+    
+    __attribute__((target("sse2")))
+    inline void store_vec3_sse2(Vec3& v, __m128 xyz_) {
+        _mm_storel_pi(reinterpret_cast<__m64*>(&v.x), xyz_);
+        _mm_store_ss(&v.z, _mm_movehl_ps(xyz_, xyz_));
+    }
+    
+    // position, clip and world of four vertices from their transposed model-space positions
+    __attribute__((target("sse2")))
+    inline void transform_lanes_sse2(const VertexTransform& transform, __m128 px, __m128 py, __m128 pz,
+                                     ScreenVertex* o) {
+        const float* mvp = transform.mvp.m;
+        const float* model = transform.model.m;
+        const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+        const __m128 width = _mm_set1_ps((float)transform.width), height = _mm_set1_ps((float)transform.height);
+        
+        __m128 x = _mm_add_ps(dot_row_sse2(mvp, px, py, pz), _mm_set1_ps(mvp[3]));
+        __m128 y = _mm_add_ps(dot_row_sse2(mvp + 4, px, py, pz), _mm_set1_ps(mvp[7]));
+        __m128 z = _mm_add_ps(dot_row_sse2(mvp + 8, px, py, pz), _mm_set1_ps(mvp[11]));
+        __m128 w = _mm_add_ps(dot_row_sse2(mvp + 12, px, py, pz), _mm_set1_ps(mvp[15]));
+        __m128 code = clip_codes_sse2(x, y, z, w);
+        
+        // viewport mapping, as clip_to_screen
+        __m128 inv_w = _mm_div_ps(one, w);
+        __m128 sx = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(x, inv_w), one), width), half);
+        __m128 sy = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(y, inv_w)), height), half);
+        __m128 sz = _mm_mul_ps(z, inv_w);
+        _MM_TRANSPOSE4_PS(sx, sy, sz, inv_w);
+        _mm_storeu_ps(&o[0].position.x, sx);
+        _mm_storeu_ps(&o[1].position.x, sy);
+        _mm_storeu_ps(&o[2].position.x, sz);
+        _mm_storeu_ps(&o[3].position.x, inv_w);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(o[0].clip, x);
+        _mm_storeu_ps(o[1].clip, y);
+        _mm_storeu_ps(o[2].clip, z);
+        _mm_storeu_ps(o[3].clip, w);
+        
+        __m128 wx = _mm_add_ps(dot_row_sse2(model, px, py, pz), _mm_set1_ps(model[3]));
+        __m128 wy = _mm_add_ps(dot_row_sse2(model + 4, px, py, pz), _mm_set1_ps(model[7]));
+        __m128 wz = _mm_add_ps(dot_row_sse2(model + 8, px, py, pz), _mm_set1_ps(model[11]));
+        _MM_TRANSPOSE4_PS(wx, wy, wz, code);
+        _mm_storeu_ps(&o[0].world.x, wx);
+        _mm_storeu_ps(&o[1].world.x, wy);
+        _mm_storeu_ps(&o[2].world.x, wz);
+        _mm_storeu_ps(&o[3].world.x, code);
+    }
+    
+    // world-space unit normals of four vertices from their transposed model-space normals
+    __attribute__((target("sse2")))
+    inline void transform_normal_lanes_sse2(const float* nm, __m128 nx, __m128 ny, __m128 nz, ScreenVertex* o) {
+        const __m128 zero = _mm_setzero_ps();
+        __m128 tx = dot_row_sse2(nm, nx, ny, nz);
+        __m128 ty = dot_row_sse2(nm + 3, nx, ny, nz);
+        __m128 tz = dot_row_sse2(nm + 6, nx, ny, nz);
+        
+        // Vec3::normalize: divide by the length, zero vectors stay zero
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)),
+                                               _mm_mul_ps(tz, tz)));
+        __m128 nonzero = _mm_cmpgt_ps(length, zero);
+        tx = _mm_and_ps(nonzero, _mm_div_ps(tx, length));
+        ty = _mm_and_ps(nonzero, _mm_div_ps(ty, length));
+        tz = _mm_and_ps(nonzero, _mm_div_ps(tz, length));
+        __m128 t3 = zero;
+        _MM_TRANSPOSE4_PS(tx, ty, tz, t3);
+        store_vec3_sse2(o[0].normal, tx);
+        store_vec3_sse2(o[1].normal, ty);
+        store_vec3_sse2(o[2].normal, tz);
+        store_vec3_sse2(o[3].normal, t3);
+    }
+    
+    // octahedral codes to unnormalized normals in code units; z is rebuilt from x and y
+    __attribute__((target("sse2")))
+    inline void unfold_octahedral_sse2(__m128& x, __m128& y, __m128& z) {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(OCTAHEDRAL_STEPS), _mm_andnot_ps(sign, x)), _mm_andnot_ps(sign, y));
+        __m128 fold = _mm_max_ps(_mm_xor_ps(z, sign), _mm_setzero_ps());
+        x = _mm_sub_ps(x, _mm_or_ps(fold, _mm_and_ps(x, sign)));
+        y = _mm_sub_ps(y, _mm_or_ps(fold, _mm_and_ps(y, sign)));
+    }
+    
+    // signed byte b (0 or 1) of the packed normal in each lane
+    __attribute__((target("sse2")))
+    inline __m128 normal_code_sse2(__m128i packed, int b) {
+        __m128i code = b == 0 ? _mm_slli_epi32(packed, 24) : _mm_slli_epi32(packed, 16);
+        return _mm_cvtepi32_ps(_mm_srai_epi32(code, 24));
+    }
+    
+    __attribute__((target("sse2")))
+    void transform_vertices_sse2(const VertexTransform& transform, const Vertex* vertices, size_t count,
+                                 ScreenVertex* out, bool with_normals) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const Vertex* v = vertices + i;
+            __m128 px = _mm_loadu_ps(&v[0].position.x), py = _mm_loadu_ps(&v[1].position.x);
+            __m128 pz = _mm_loadu_ps(&v[2].position.x), p3 = _mm_loadu_ps(&v[3].position.x);
+            _MM_TRANSPOSE4_PS(px, py, pz, p3);
+            transform_lanes_sse2(transform, px, py, pz, out + i);
+            
+            if (!with_normals) continue;
+            __m128 nx = _mm_loadu_ps(&v[0].normal.x), ny = _mm_loadu_ps(&v[1].normal.x);
+            __m128 nz = _mm_loadu_ps(&v[2].normal.x), n3 = _mm_loadu_ps(&v[3].normal.x);
+            _MM_TRANSPOSE4_PS(nx, ny, nz, n3);
+            transform_normal_lanes_sse2(transform.normal, nx, ny, nz, out + i);
+        }
+        transform_vertices_scalar(transform, vertices + i, count - i, out + i, with_normals);
+    }
+    
+    // four 8-byte vertices widen to one row of 32-bit lanes each, x y z and the packed normal,
+    // so the same transpose as the float kernel gives positions and normal codes per lane
+    __attribute__((target("sse2")))
+    void transform_quantized_sse2(const VertexTransform& transform, const QuantizedVertex* vertices, size_t count,
+                                  ScreenVertex* out, bool with_normals) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vertices + i + 2));
+            __m128 px = _mm_castsi128_ps(_mm_unpacklo_epi16(first, zero));
+            __m128 py = _mm_castsi128_ps(_mm_unpackhi_epi16(first, zero));
+            __m128 pz = _mm_castsi128_ps(_mm_unpacklo_epi16(second, zero));
+            __m128 p3 = _mm_castsi128_ps(_mm_unpackhi_epi16(second, zero));
+            _MM_TRANSPOSE4_PS(px, py, pz, p3);
+            px = _mm_cvtepi32_ps(_mm_castps_si128(px));
+            py = _mm_cvtepi32_ps(_mm_castps_si128(py));
+            pz = _mm_cvtepi32_ps(_mm_castps_si128(pz));
+            transform_lanes_sse2(transform, px, py, pz, out + i);
+            
+            if (!with_normals) continue;
+            __m128i packed = _mm_castps_si128(p3);
+            __m128 nx = normal_code_sse2(packed, 0), ny = normal_code_sse2(packed, 1), nz;
+            unfold_octahedral_sse2(nx, ny, nz);
+            transform_normal_lanes_sse2(transform.normal, nx, ny, nz, out + i);
+        }
+        transform_vertices_scalar(transform, vertices + i, count - i, out + i, with_normals);
+    }
+    
+    // 4x4 transpose within each 128-bit half: lanes k and k + 4 of the results come from rows
+    // r0..r3 of the low and high halves respectively
+    __attribute__((target("avx2")))
+    inline void transpose4_avx2(__m256& r0, __m256& r1, __m256& r2, __m256& r3) {
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+        r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    }
+    
+    // four floats at a and b into the low and high half
+    __attribute__((target("avx2")))
+    inline __m256 load_pair_avx2(const float* a, const float* b) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+    }
+    
+    // transposed rows r0..r3 back to eight vertices: row k holds vertex k low and vertex k + 4 high
+    __attribute__((target("avx2")))
+    inline void store_rows_avx2(float* const dst[8], __m256 r0, __m256 r1, __m256 r2, __m256 r3) {
+        const __m256 rows[4] = {r0, r1, r2, r3};
+        for (int k = 0; k < 4; k++) {
+            _mm_storeu_ps(dst[k], _mm256_castps256_ps128(rows[k]));
+            _mm_storeu_ps(dst[k + 4], _mm256_extractf128_ps(rows[k], 1));
+        }
+    }
+    
+    __attribute__((target("avx2")))
+    inline void store_vec3_pair_avx2(Vec3& low, Vec3& high, __m256 row) {
+        store_vec3_sse2(low, _mm256_castps256_ps128(row));
+        store_vec3_sse2(high, _mm256_extractf128_ps(row, 1));
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256 dot_row_avx2(const float* row, __m256 x, __m256 y, __m256 z) {
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(row[0]), x), _mm256_mul_ps(_mm256_set1_ps(row[1]), y));
+        return _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(row[2]), z));
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256 code_bit_avx2(__m256 distance, uint32_t bit) {
+        return _mm256_and_ps(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ),
+                             _mm256_castsi256_ps(_mm256_set1_epi32((int)bit)));
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256 clip_codes_avx2(__m256 x, __m256 y, __m256 z, __m256 w) {
+        __m256 guard = _mm256_mul_ps(_mm256_set1_ps(GUARD_BAND), w);
+        __m256 code = _mm256_or_ps(code_bit_avx2(_mm256_add_ps(x, w), CLIP_LEFT),
+                                   code_bit_avx2(_mm256_sub_ps(w, x), CLIP_RIGHT));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_add_ps(y, w), CLIP_BOTTOM));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_sub_ps(w, y), CLIP_TOP));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_add_ps(z, w), CLIP_NEAR));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_sub_ps(w, z), CLIP_FAR));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_add_ps(x, guard), CLIP_GUARD_LEFT));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_sub_ps(guard, x), CLIP_GUARD_RIGHT));
+        code = _mm256_or_ps(code, code_bit_avx2(_mm256_add_ps(y, guard), CLIP_GUARD_BOTTOM));
+        return _mm256_or_ps(code, code_bit_avx2(_mm256_sub_ps(guard, y), CLIP_GUARD_TOP));
+    }
+    
+    __attribute__((target("avx2")))
+    inline void transform_lanes_avx2(const VertexTransform& transform, __m256 px, __m256 py, __m256 pz,
+                                     ScreenVertex* o) {
+        const float* mvp = transform.mvp.m;
+        const float* model = transform.model.m;
+        const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+        const __m256 width = _mm256_set1_ps((float)transform.width);
+        const __m256 height = _mm256_set1_ps((float)transform.height);
+        
+        __m256 x = _mm256_add_ps(dot_row_avx2(mvp, px, py, pz), _mm256_set1_ps(mvp[3]));
+        __m256 y = _mm256_add_ps(dot_row_avx2(mvp + 4, px, py, pz), _mm256_set1_ps(mvp[7]));
+        __m256 z = _mm256_add_ps(dot_row_avx2(mvp + 8, px, py, pz), _mm256_set1_ps(mvp[11]));
+        __m256 w = _mm256_add_ps(dot_row_avx2(mvp + 12, px, py, pz), _mm256_set1_ps(mvp[15]));
+        __m256 code = clip_codes_avx2(x, y, z, w);
+        
+        // viewport mapping, as clip_to_screen
+        __m256 inv_w = _mm256_div_ps(one, w);
+        __m256 sx = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(x, inv_w), one), width), half);
+        __m256 sy = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(y, inv_w)), height), half);
+        __m256 sz = _mm256_mul_ps(z, inv_w);
+        float* position[8];
+        float* clip[8];
+        float* world[8];
+        for (int k = 0; k < 8; k++) {
+            position[k] = &o[k].position.x;
+            clip[k] = o[k].clip;
+            world[k] = &o[k].world.x;
+        }
+        transpose4_avx2(sx, sy, sz, inv_w);
+        store_rows_avx2(position, sx, sy, sz, inv_w);
+        transpose4_avx2(x, y, z, w);
+        store_rows_avx2(clip, x, y, z, w);
+        
+        __m256 wx = _mm256_add_ps(dot_row_avx2(model, px, py, pz), _mm256_set1_ps(model[3]));
+        __m256 wy = _mm256_add_ps(dot_row_avx2(model + 4, px, py, pz), _mm256_set1_ps(model[7]));
+        __m256 wz = _mm256_add_ps(dot_row_avx2(model + 8, px, py, pz), _mm256_set1_ps(model[11]));
+        transpose4_avx2(wx, wy, wz, code);
+        store_rows_avx2(world, wx, wy, wz, code);
+    }
+    
+    __attribute__((target("avx2")))
+    inline void transform_normal_lanes_avx2(const float* nm, __m256 nx, __m256 ny, __m256 nz, ScreenVertex* o) {
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 tx = dot_row_avx2(nm, nx, ny, nz);
+        __m256 ty = dot_row_avx2(nm + 3, nx, ny, nz);
+        __m256 tz = dot_row_avx2(nm + 6, nx, ny, nz);
+        
+        // Vec3::normalize: divide by the length, zero vectors stay zero
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)),
+                                                     _mm256_mul_ps(tz, tz)));
+        __m256 nonzero = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+        tx = _mm256_and_ps(nonzero, _mm256_div_ps(tx, length));
+        ty = _mm256_and_ps(nonzero, _mm256_div_ps(ty, length));
+        tz = _mm256_and_ps(nonzero, _mm256_div_ps(tz, length));
+        __m256 t3 = zero;
+        transpose4_avx2(tx, ty, tz, t3);
+        store_vec3_pair_avx2(o[0].normal, o[4].normal, tx);
+        store_vec3_pair_avx2(o[1].normal, o[5].normal, ty);
+        store_vec3_pair_avx2(o[2].normal, o[6].normal, tz);
+        store_vec3_pair_avx2(o[3].normal, o[7].normal, t3);
+    }
+    
+    __attribute__((target("avx2")))
+    inline void unfold_octahedral_avx2(__m256& x, __m256& y, __m256& z) {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        z = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(OCTAHEDRAL_STEPS), _mm256_andnot_ps(sign, x)),
+                          _mm256_andnot_ps(sign, y));
+        __m256 fold = _mm256_max_ps(_mm256_xor_ps(z, sign), _mm256_setzero_ps());
+        x = _mm256_sub_ps(x, _mm256_or_ps(fold, _mm256_and_ps(x, sign)));
+        y = _mm256_sub_ps(y, _mm256_or_ps(fold, _mm256_and_ps(y, sign)));
+    }
+    
+    __attribute__((target("avx2")))
+    inline __m256 normal_code_avx2(__m256i packed, int b) {
+        __m256i code = b == 0 ? _mm256_slli_epi32(packed, 24) : _mm256_slli_epi32(packed, 16);
+        return _mm256_cvtepi32_ps(_mm256_srai_epi32(code, 24));
+    }
+    
+    __attribute__((target("avx2")))
+    void transform_vertices_avx2(const VertexTransform& transform, const Vertex* vertices, size_t count,
+                                 ScreenVertex* out, bool with_normals) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const Vertex* v = vertices + i;
+            __m256 px = load_pair_avx2(&v[0].position.x, &v[4].position.x);
+            __m256 py = load_pair_avx2(&v[1].position.x, &v[5].position.x);
+            __m256 pz = load_pair_avx2(&v[2].position.x, &v[6].position.x);
+            __m256 p3 = load_pair_avx2(&v[3].position.x, &v[7].position.x);
+            transpose4_avx2(px, py, pz, p3);
+            transform_lanes_avx2(transform, px, py, pz, out + i);
+            
+            if (!with_normals) continue;
+            __m256 nx = load_pair_avx2(&v[0].normal.x, &v[4].normal.x);
+            __m256 ny = load_pair_avx2(&v[1].normal.x, &v[5].normal.x);
+            __m256 nz = load_pair_avx2(&v[2].normal.x, &v[6].normal.x);
+            __m256 n3 = load_pair_avx2(&v[3].normal.x, &v[7].normal.x);
+            transpose4_avx2(nx, ny, nz, n3);
+            transform_normal_lanes_avx2(transform.normal, nx, ny, nz, out + i);
+        }
+        // clear the upper ymm halves before the SSE tail and callers, or every later SSE
+        // instruction pays the AVX-to-SSE transition until another AVX function cleans up
+        _mm256_zeroupper();
+        transform_vertices_scalar(transform, vertices + i, count - i, out + i, with_normals);
+    }
+    
+    // eight vertices in two loads; swapping the middle halves puts vertices k and k + 4 side by
+    // side, the row layout transpose4_avx2 expects
+    __attribute__((target("avx2")))
+    void transform_quantized_avx2(const VertexTransform& transform, const QuantizedVertex* vertices, size_t count,
+                                  ScreenVertex* out, bool with_normals) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vertices + i));
+            __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vertices + i + 4));
+            __m256i low = _mm256_permute2x128_si256(first, second, 0x20);
+            __m256i high = _mm256_permute2x128_si256(first, second, 0x31);
+            __m256 px = _mm256_castsi256_ps(_mm256_unpacklo_epi16(low, zero));
+            __m256 py = _mm256_castsi256_ps(_mm256_unpackhi_epi16(low, zero));
+            __m256 pz = _mm256_castsi256_ps(_mm256_unpacklo_epi16(high, zero));
+            __m256 p3 = _mm256_castsi256_ps(_mm256_unpackhi_epi16(high, zero));
+            transpose4_avx2(px, py, pz, p3);
+            px = _mm256_cvtepi32_ps(_mm256_castps_si256(px));
+            py = _mm256_cvtepi32_ps(_mm256_castps_si256(py));
+            pz = _mm256_cvtepi32_ps(_mm256_castps_si256(pz));
+            transform_lanes_avx2(transform, px, py, pz, out + i);
+            
+            if (!with_normals) continue;
+            __m256i packed = _mm256_castps_si256(p3);
+            __m256 nx = normal_code_avx2(packed, 0), ny = normal_code_avx2(packed, 1), nz;
+            unfold_octahedral_avx2(nx, ny, nz);
+            transform_normal_lanes_avx2(transform.normal, nx, ny, nz, out + i);
+        }
+        _mm256_zeroupper();
+        transform_vertices_scalar(transform, vertices + i, count - i, out + i, with_normals);
+    }
+#endif
+}
+VertexTransform::VertexTransform(const Mat4& model_matrix, const Mat4& view_proj, int w, int h)
+    : mvp(view_proj * model_matrix), model(model_matrix), width(w), height(h) {
+    set_normal_matrix(model_matrix);
+}
+
+VertexTransform::VertexTransform(const Mat4& model_matrix, const Mat4& dequantize, const Mat4& view_proj, int w, int h)
+    : model(model_matrix * dequantize), width(w), height(h) {
+    // normals are stored unscaled, so they take the model's normal matrix alone
+    mvp = view_proj * model;
+    set_normal_matrix(model_matrix);
+}
+
+void VertexTransform::set_normal_matrix(const Mat4& model_matrix) {
+    // cofactors of the upper 3x3 are its inverse transpose times the determinant, so normals stay
+    // perpendicular to surfaces under non-uniform scale; the sign keeps mirrored normals outward
+    const float* m = model_matrix.m;
+    float c[9] = {
+        m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+        m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+        m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4],
+    };
+    float determinant = m[0] * c[0] + m[1] * c[1] + m[2] * c[2];
+    mirrored = determinant < 0.0f;
+    float sign = mirrored ? -1.0f : 1.0f;
+    for (int i = 0; i < 9; i++) normal[i] = c[i] * sign;
+}
+
+Vec3 VertexTransform::transform_normal(const Vec3& n) const {
+    return Vec3(normal[0] * n.x + normal[1] * n.y + normal[2] * n.z,
+                normal[3] * n.x + normal[4] * n.y + normal[5] * n.z,
+                normal[6] * n.x + normal[7] * n.y + normal[8] * n.z).normalize();
+}
+
+void transform_vertex_batch(const VertexTransform& transform, const Vertex* vertices, size_t count,
+                            ScreenVertex* out, bool with_normals) {
+#if RENDER_HAS_X86_SIMD
+    switch (get_raster_simd_level()) {
+    case SimdLevel::AVX2:
+        transform_vertices_avx2(transform, vertices, count, out, with_normals);
+        return;
+    case SimdLevel::SSE2:
+        transform_vertices_sse2(transform, vertices, count, out, with_normals);
+        return;
+    default:
+        break;
+    }
+#endif
+    transform_vertices_scalar(transform, vertices, count, out, with_normals);
+}
+
+void transform_vertex_batch(const VertexTransform& transform, const QuantizedVertex* vertices, size_t count,
+                            ScreenVertex* out, bool with_normals) {
+#if RENDER_HAS_X86_SIMD
+    switch (get_raster_simd_level()) {
+    case SimdLevel::AVX2:
+        transform_quantized_avx2(transform, vertices, count, out, with_normals);
+        return;
+    case SimdLevel::SSE2:
+        transform_quantized_sse2(transform, vertices, count, out, with_normals);
+        return;
+    default:
+        break;
+    }
+#endif
+    transform_vertices_scalar(transform, vertices, count, out, with_normals);
+}
\ No newline at end of file
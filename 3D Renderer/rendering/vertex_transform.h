@@ -0,0 +1,58 @@
+// vertex_transform.h
+// batched vertex stage from model-space vertices to the renderer's post-transform buffer
+// simd paths transpose vertices into structure-of-arrays registers and process 4 or 8 at a time
+
+#ifndef VERTEX_TRANSFORM_H
+#define VERTEX_TRANSFORM_H
+
+#include "../geometry/vertex.h"
+#include "../geometry/compact_mesh.h"
+#include "../math/mat4.h"
+#include "../math/Vec3.h"
+#include <cstddef>
+#include <cstdint>
+
+// mesh vertex after the vertex stage, shared by every triangle that indexes it
+// the simd kernels store position with inv_w, clip, and world with clip_code as 16-byte vectors
+struct ScreenVertex {
+    Vec3 position;       // screen x and y, normalized depth in z (valid when w > 0)
+    float inv_w;         // 1/w, for perspective-correct attributes
+    float clip[4];       // clip-space x, y, z, w
+    Vec3 world;          // world-space position, for lighting
+    uint32_t clip_code;  // ClipCode bits of clip
+    Vec3 normal;         // world-space unit normal (smooth shading only)
+    Vec3 color;          // lit vertex color (gouraud only)
+};
+
+// per-mesh constants, folded once per draw instead of once per vertex
+struct VertexTransform {
+    Mat4 mvp;           // model to clip space
+    Mat4 model;         // model to world space, affine
+    float normal[9];    // row-major normal matrix: model's inverse transpose up to a positive scale
+    int width, height;  // viewport in pixels
+    bool mirrored;      // model turns counter-clockwise windings clockwise in world space
+    
+    VertexTransform(const Mat4& model, const Mat4& view_proj, int width, int height);
+    
+    // quantized vertices: dequantize maps position codes to model space and is folded into mvp
+    // and model, while the normal matrix stays that of model
+    VertexTransform(const Mat4& model, const Mat4& dequantize, const Mat4& view_proj, int width, int height);
+    
+    // world-space unit normal, the same float operations as the vertex stage
+    Vec3 transform_normal(const Vec3& n) const;
+    
+private:
+    void set_normal_matrix(const Mat4& model);
+};
+
+// transform count vertices into out; normals are only written when with_normals is set
+// runs the simd path of the rasterizer's level, every path produces bit-identical output
+void transform_vertex_batch(const VertexTransform& transform, const Vertex* vertices, size_t count,
+                            ScreenVertex* out, bool with_normals);
+
+// the same for quantized vertices, decoded inside the kernels; positions come out in the space
+// of the transform's dequantize matrix, normals as the octahedral code unfolded
+void transform_vertex_batch(const VertexTransform& transform, const QuantizedVertex* vertices, size_t count,
+                            ScreenVertex* out, bool with_normals);
+
+#endif
@@ -0,0 +1,109 @@
+// mesh_bvh.cpp
+// implementation of the mesh hierarchy build and frustum query
+// traversal keeps the planes each node straddles, so deep nodes usually test only one or two
+
+#include "mesh_bvh.h"
+#include <algorithm>
+
+namespace {
+    // meshes per leaf; small, since each one is tested against the frustum on its own anyway
+    const uint32_t LEAF_SIZE = 4;
+    
+    // deeper than any tree built by median splits over 32-bit counts
+    const int MAX_DEPTH = 64;
+    
+    float axis_value(const Vec3& v, int axis) {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+}
+
+void MeshBvh::clear() {
+    nodes.clear();
+    mesh_order.clear();
+}
+
+void MeshBvh::build(const std::vector<Aabb>& mesh_bounds) {
+    clear();
+    mesh_order.reserve(mesh_bounds.size());
+    for (uint32_t i = 0; i < (uint32_t)mesh_bounds.size(); i++) {
+        if (!mesh_bounds[i].is_empty()) mesh_order.push_back(i);
+    }
+    if (mesh_order.empty()) return;
+    nodes.reserve(2 * mesh_order.size() / LEAF_SIZE + 1);
+    build_node(mesh_bounds, 0, (uint32_t)mesh_order.size());
+}
+
+uint32_t MeshBvh::build_node(const std::vector<Aabb>& mesh_bounds, uint32_t first, uint32_t count) {
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+    
+    Aabb bounds, centroids;
+    for (uint32_t i = first; i < first + count; i++) {
+        const Aabb& box = mesh_bounds[mesh_order[i]];
+        bounds.add_box(box);
+        centroids.add_point(box.center());
+    }
+    nodes[index].bounds = bounds;
+    nodes[index].first = first;
+    nodes[index].count = count;
+    nodes[index].right = 0;
+    
+    Vec3 spread = centroids.max - centroids.min;
+    int axis = (spread.y > spread.x) ? 1 : 0;
+    if (spread.z > axis_value(spread, axis)) axis = 2;
+    if (count <= LEAF_SIZE || axis_value(spread, axis) <= 0.0f) return index;
+    
+    // median split: both halves are the same size, so the depth stays logarithmic
+    uint32_t half = count / 2;
+    auto begin = mesh_order.begin() + first;
+    std::nth_element(begin, begin + half, begin + count, [&](uint32_t a, uint32_t b) {
+        return axis_value(mesh_bounds[a].center(), axis) < axis_value(mesh_bounds[b].center(), axis);
+    });
+    
+    build_node(mesh_bounds, first, half);
+    uint32_t right = build_node(mesh_bounds, first + half, count - half);
+    nodes[index].right = right;
+    return index;
+}
+
+size_t MeshBvh::query(const Frustum& frustum, const std::vector<Aabb>& mesh_bounds,
+                      std::vector<uint32_t>& visible) const {
+    if (nodes.empty()) return 0;
+    
+    struct Entry {
+        uint32_t node;
+        uint32_t plane_mask;
+    };
+    Entry stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = {0, FRUSTUM_ALL_PLANES};
+    size_t visited = 0;
+    
+    while (top > 0) {
+        Entry entry = stack[--top];
+        const Node& node = nodes[entry.node];
+        visited++;
+        
+        uint32_t mask = entry.plane_mask;
+        if (!frustum.intersects(node.bounds, mask)) continue;
+        
+        // fully inside: every mesh below is visible without further tests
+        if (mask == 0) {
+            visible.insert(visible.end(), mesh_order.begin() + node.first,
+                           mesh_order.begin() + node.first + node.count);
+            continue;
+        }
+        
+        if (node.right == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t mesh_mask = mask;
+                if (frustum.intersects(mesh_bounds[mesh_order[i]], mesh_mask)) visible.push_back(mesh_order[i]);
+            }
+            continue;
+        }
+        
+        stack[top++] = {node.right, mask};
+        stack[top++] = {entry.node + 1, mask};
+    }
+    return visited;
+}
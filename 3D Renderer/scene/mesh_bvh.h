@@ -0,0 +1,41 @@
+// mesh_bvh.h
+// bounding volume hierarchy over the world-space boxes of a scene's meshes
+// lets frustum culling skip whole groups of meshes with one box test
+
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include "../geometry/bounds.h"
+#include "../rendering/frustum.h"
+#include <cstdint>
+#include <vector>
+
+// binary tree built top-down by splitting at the median centroid along the widest axis
+// nodes are stored depth first, so a node's left child follows it and its meshes form one
+// contiguous run of mesh_order; a node found fully inside the frustum hands over that run whole
+class MeshBvh {
+public:
+    void build(const std::vector<Aabb>& mesh_bounds);
+    void clear();
+    
+    // append the indices of meshes whose boxes intersect the frustum, in tree order;
+    // returns the number of nodes visited
+    size_t query(const Frustum& frustum, const std::vector<Aabb>& mesh_bounds,
+                 std::vector<uint32_t>& visible) const;
+    
+    size_t node_count() const { return nodes.size(); }
+    
+private:
+    struct Node {
+        Aabb bounds;
+        uint32_t first, count;  // run of mesh_order under this node
+        uint32_t right;         // index of the right child, 0 for leaves
+    };
+    
+    uint32_t build_node(const std::vector<Aabb>& mesh_bounds, uint32_t first, uint32_t count);
+    
+    std::vector<Node> nodes;
+    std::vector<uint32_t> mesh_order;
+};
+
+#endif
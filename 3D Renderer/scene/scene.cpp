@@ -3,6 +3,12 @@
 // provides complete scene setup with objects and lighting
 
 #include "scene.h"
+#include "../rendering/frustum.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 Scene::Scene() : camera(Vec3(5, 3, 5), Vec3(0, 0, 0)) {
     create_demo_scene();
@@ -10,6 +16,22 @@ Scene::Scene() : camera(Vec3(5, 3, 5), Vec3(0, 0, 0)) {
 
 void Scene::add_mesh(const Mesh& mesh) {
     meshes.push_back(mesh);
+    bounds_valid = false;
+}
+
+void Scene::add_compact_mesh(const CompactMesh& mesh) {
+    compact_meshes.push_back(mesh);
+    bounds_valid = false;
+}
+
+void Scene::add_mapped_mesh(MappedMesh&& mesh) {
+    mapped_meshes.push_back(std::move(mesh));
+    bounds_valid = false;
+}
+
+void Scene::add_instance(const MeshInstance& instance) {
+    instances.push_back(instance);
+    bounds_valid = false;
 }
 
 void Scene::add_light(const Light& light) {
@@ -54,18 +76,281 @@ void Scene::create_demo_scene() {
     add_light(Light(LightType::DIRECTIONAL, Vec3(-0.5f, -1, -0.3f), Vec3(0.3f, 0.3f, 0.5f), 0.5f));
 }
 
-void Scene::render(Renderer& renderer, bool wireframe) {
+void Scene::render(Renderer& renderer, bool wireframe, bool flat_shading) {
     // render entire scene with dark blue background
     renderer.clear(Vec3(0.1f, 0.1f, 0.2f));
+    PROFILE_EVENT(renderer.get_profiler(), "frame", 0);
+    if (renderer.is_shadow_mapping() && !wireframe) {
+        {
+            PROFILE_STAGE(renderer.get_profiler(), ProfileStage::SCENE);
+            gather_shadow_casters();
+        }
+        renderer.update_shadows(lights, shadow_casters);
+    }
     
-    // render each mesh in the scene
-    for (const auto& mesh : meshes) {
-        renderer.render_mesh(mesh, camera, lights, wireframe);
+    // render each mesh the camera can see, then the visible instances grouped by mesh
+    {
+        PROFILE_STAGE(renderer.get_profiler(), ProfileStage::SCENE);
+        find_visible_objects();
     }
+    const std::vector<uint32_t>& visible = visible_objects;
+    size_t first_instance = std::lower_bound(visible.begin(), visible.end(), (uint32_t)get_first_instance()) -
+                            visible.begin();
+    
+    // pixels covered by one world unit at distance 1, for projecting level-of-detail errors
+    float pixels_per_unit = renderer.get_framebuffer().get_height() / (2.0f * std::tan(camera.fov * 0.5f));
+    lod_stats = LodStats();
+    for (size_t i = 0; i < first_instance; i++) {
+        size_t object = visible[i];
+        PROFILE_DRAW(renderer.get_profiler(), object);
+        if (object < meshes.size()) {
+            renderer.render_mesh(select_lod(object, pixels_per_unit), camera, lights, wireframe, flat_shading);
+        } else if ((object -= meshes.size()) < compact_meshes.size()) {
+            renderer.render_mesh(compact_meshes[object], camera, lights, wireframe, flat_shading);
+        } else {
+            renderer.render_mesh(mapped_meshes[object - compact_meshes.size()], camera, lights, wireframe, flat_shading);
+        }
+    }
+    if (first_instance < visible.size()) {
+        {
+            PROFILE_STAGE(renderer.get_profiler(), ProfileStage::SCENE);
+            group_visible_instances(visible.data() + first_instance, visible.size() - first_instance);
+        }
+        renderer.render_instances(visible_instances, camera, lights, wireframe, flat_shading);
+    }
+    
+    // resolve binned triangles so the framebuffer is complete
+    renderer.flush();
+}
+
+const Mesh& Scene::select_lod(size_t mesh, float pixels_per_unit) {
+    if (mesh >= mesh_lods.size() || mesh_lods[mesh].empty()) return meshes[mesh];
+    const std::vector<MeshLod>& chain = mesh_lods[mesh];
+    
+    // object-space errors scale with the transform, as the bounding sphere does; the distance is
+    // to the sphere's surface, so the nearest part of the mesh decides
+    const Mesh& full = meshes[mesh];
+    const BoundingSphere& sphere = world_spheres[mesh];
+    float object_radius = full.get_bounding_sphere().radius;
+    float scale = object_radius > 0.0f ? sphere.radius / object_radius : 1.0f;
+    float distance = std::max(camera.near_plane, (sphere.center - camera.position).length() - sphere.radius);
+    float pixels_per_error = scale * pixels_per_unit / distance;
+    
+    // the coarsest level within the threshold, which is tighter for levels coarser than the
+    // current one: a mesh only moves coarser with some margin, and finer as soon as it must
+    size_t current = lod_levels[mesh];
+    size_t level = 0;
+    for (size_t k = chain.size(); k > 0; k--) {
+        float threshold = lod_pixel_error * (k > current ? 1.0f - lod_hysteresis : 1.0f);
+        if (chain[k - 1].error * pixels_per_error <= threshold) {
+            level = k;
+            break;
+        }
+    }
+    if (level != current) lod_stats.switched++;
+    lod_levels[mesh] = (uint8_t)level;
+    
+    lod_stats.meshes++;
+    lod_stats.full_triangles += full.triangles.size();
+    if (level == 0) {
+        lod_stats.drawn_triangles += full.triangles.size();
+        return full;
+    }
+    
+    // levels are drawn with the full mesh's current placement and material
+    Mesh& drawn = mesh_lods[mesh][level - 1].mesh;
+    drawn.transform = full.transform;
+    drawn.material = full.material;
+    lod_stats.reduced++;
+    lod_stats.drawn_triangles += drawn.triangles.size();
+    return drawn;
+}
+
+void Scene::generate_lods(const LodSettings& settings) {
+    mesh_lods.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) mesh_lods[i] = build_lod_chain(meshes[i], settings);
+    lod_levels.assign(meshes.size(), 0);
+}
+
+void Scene::set_lod_error(float pixel_error, float hysteresis) {
+    lod_pixel_error = pixel_error;
+    lod_hysteresis = std::min(std::max(hysteresis, 0.0f), 1.0f);
+}
+
+void Scene::clear_lods() {
+    mesh_lods.clear();
+    lod_levels.clear();
 }
 
 void Scene::clear_scene() {
     // remove all objects and lights from scene
+    clear_lods();
     meshes.clear();
+    compact_meshes.clear();
+    mapped_meshes.clear();
+    instances.clear();
     lights.clear();
+    bounds_valid = false;
+}
+
+void Scene::update_bounds() {
+    size_t first_instance = get_first_instance();
+    size_t object_count = first_instance + instances.size();
+    world_bounds.resize(object_count);
+    world_spheres.resize(object_count);
+    for (size_t i = 0; i < meshes.size(); i++) {
+        world_bounds[i] = transform_aabb(meshes[i].transform, meshes[i].get_bounds());
+        world_spheres[i] = transform_sphere(meshes[i].transform, meshes[i].get_bounding_sphere());
+    }
+    for (size_t i = 0; i < compact_meshes.size(); i++) {
+        const CompactMesh& mesh = compact_meshes[i];
+        world_bounds[meshes.size() + i] = transform_aabb(mesh.transform, mesh.get_bounds());
+        world_spheres[meshes.size() + i] = transform_sphere(mesh.transform, mesh.get_bounding_sphere());
+    }
+    size_t first_mapped = meshes.size() + compact_meshes.size();
+    for (size_t i = 0; i < mapped_meshes.size(); i++) {
+        const MappedMesh& mesh = mapped_meshes[i];
+        world_bounds[first_mapped + i] = transform_aabb(mesh.transform, mesh.get_bounds());
+        world_spheres[first_mapped + i] = transform_sphere(mesh.transform, mesh.get_bounding_sphere());
+    }
+    
+    // instances also number their meshes by first appearance, for grouping at draw time
+    std::unordered_map<const Mesh*, uint32_t> groups;
+    instance_groups.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        const MeshInstance& instance = instances[i];
+        size_t object = first_instance + i;
+        instance_groups[i] = groups.emplace(instance.mesh.get(), (uint32_t)groups.size()).first->second;
+        if (!instance.mesh) {
+            world_bounds[object] = Aabb();
+            world_spheres[object] = BoundingSphere();
+            continue;
+        }
+        Mat4 transform = instance.transform * instance.mesh->transform;
+        world_bounds[object] = transform_aabb(transform, instance.mesh->get_bounds());
+        world_spheres[object] = transform_sphere(transform, instance.mesh->get_bounding_sphere());
+    }
+    group_offsets.assign(groups.size() + 1, 0);
+    
+    bounds_mesh_count = meshes.size();
+    bounds_compact_count = compact_meshes.size();
+    bounds_mapped_count = mapped_meshes.size();
+    bounds_instance_count = instances.size();
+    bounds_valid = true;
+    bvh_valid = false;
+}
+
+void Scene::gather_shadow_casters() {
+    shadow_casters.clear();
+    auto add = [&](const Vertex* vertices, size_t vertex_count, const Triangle* triangles, size_t triangle_count,
+                   const Mat4& transform, const BoundingSphere& sphere) {
+        ShadowCaster caster;
+        caster.vertices = vertices;
+        caster.vertex_count = vertex_count;
+        caster.triangles = triangles;
+        caster.triangle_count = triangle_count;
+        caster.transform = transform;
+        caster.bounds = transform_sphere(transform, sphere);
+        shadow_casters.push_back(caster);
+    };
+    for (const Mesh& mesh : meshes) {
+        add(mesh.vertices.data(), mesh.vertices.size(), mesh.triangles.data(), mesh.triangles.size(), mesh.transform,
+            mesh.get_bounding_sphere());
+    }
+    for (const CompactMesh& mesh : compact_meshes) {
+        add(nullptr, mesh.vertices.size(), nullptr, mesh.triangle_count(), mesh.transform, mesh.get_bounding_sphere());
+        shadow_casters.back().compact = &mesh;
+    }
+    for (const MappedMesh& mesh : mapped_meshes) {
+        add(mesh.vertices(), mesh.vertex_count(), mesh.triangles(), mesh.triangle_count(), mesh.transform,
+            mesh.get_bounding_sphere());
+    }
+    for (const MeshInstance& instance : instances) {
+        const Mesh* mesh = instance.mesh.get();
+        if (!mesh) continue;
+        add(mesh->vertices.data(), mesh->vertices.size(), mesh->triangles.data(), mesh->triangles.size(),
+            instance.transform * mesh->transform, mesh->get_bounding_sphere());
+    }
+}
+
+void Scene::group_visible_instances(const uint32_t* visible, size_t count) {
+    // counting sort by group keeps scene order within each mesh's instances
+    size_t first_instance = get_first_instance();
+    std::fill(group_offsets.begin(), group_offsets.end(), 0);
+    for (size_t i = 0; i < count; i++) group_offsets[instance_groups[visible[i] - first_instance] + 1]++;
+    for (size_t g = 1; g < group_offsets.size(); g++) group_offsets[g] += group_offsets[g - 1];
+    visible_instances.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t instance = visible[i] - first_instance;
+        visible_instances[group_offsets[instance_groups[instance]]++] = &instances[instance];
+    }
+}
+
+SceneMemory Scene::get_memory_usage() const {
+    SceneMemory memory;
+    for (const auto& mesh : meshes) memory.mesh_bytes += mesh.memory_bytes();
+    for (const auto& mesh : compact_meshes) memory.compact_bytes += mesh.memory_bytes();
+    for (const auto& mesh : mapped_meshes) memory.mapped_bytes += mesh.mapped_bytes();
+    for (const auto& chain : mesh_lods) {
+        for (const auto& level : chain) memory.lod_bytes += level.mesh.memory_bytes();
+    }
+    memory.instance_bytes = instances.capacity() * sizeof(MeshInstance);
+    
+    std::unordered_set<const Mesh*> shared;
+    for (const auto& instance : instances) {
+        if (instance.mesh && shared.insert(instance.mesh.get()).second) {
+            memory.shared_bytes += instance.mesh->memory_bytes();
+        }
+    }
+    return memory;
+}
+
+const std::vector<uint32_t>& Scene::find_visible_objects() {
+    size_t object_count = get_first_instance() + instances.size();
+    visible_objects.clear();
+    cull_stats = CullStats();
+    cull_stats.objects = object_count;
+    
+    // grouping needs the instance groups even when nothing is culled
+    if (!bounds_valid || bounds_mesh_count != meshes.size() || bounds_compact_count != compact_meshes.size() ||
+        bounds_mapped_count != mapped_meshes.size() || bounds_instance_count != instances.size()) {
+        update_bounds();
+    }
+    
+    if (mesh_culling == MeshCulling::NONE) {
+        for (uint32_t i = 0; i < (uint32_t)object_count; i++) visible_objects.push_back(i);
+        return visible_objects;
+    }
+    
+    Frustum frustum(camera.get_projection_matrix() * camera.get_view_matrix());
+    
+    if (mesh_culling == MeshCulling::BVH && object_count >= BVH_MIN_MESHES) {
+        if (!bvh_valid) {
+            bvh.build(world_bounds);
+            bvh_valid = true;
+        }
+        cull_stats.nodes_visited = bvh.query(frustum, world_bounds, visible_objects);
+        
+        // tree order differs from scene order, which decides who wins equal depths; a bit per
+        // mesh puts them back in order for a 64th of the cost of a linear test
+        visible_bits.assign((object_count + 63) / 64, 0);
+        for (uint32_t index : visible_objects) visible_bits[index / 64] |= 1ull << (index % 64);
+        visible_objects.clear();
+        for (size_t word = 0; word < visible_bits.size(); word++) {
+            for (uint64_t bits = visible_bits[word]; bits; bits &= bits - 1) {
+                visible_objects.push_back((uint32_t)(word * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    } else {
+        // the sphere rejects most far-off meshes with one dot product before the box test
+        for (uint32_t i = 0; i < (uint32_t)object_count; i++) {
+            uint32_t plane_mask = FRUSTUM_ALL_PLANES;
+            if (frustum.intersects(world_spheres[i]) && frustum.intersects(world_bounds[i], plane_mask)) {
+                visible_objects.push_back(i);
+            }
+        }
+    }
+    
+    cull_stats.objects_culled = object_count - visible_objects.size();
+    return visible_objects;
 }
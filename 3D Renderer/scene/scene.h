@@ -6,16 +6,64 @@
 #define SCENE_H
 
 #include "../geometry/mesh.h"
+#include "../geometry/mesh_instance.h"
+#include "../geometry/compact_mesh.h"
+#include "../geometry/mesh_simplifier.h"
+#include "../io/mesh_cache.h"
 #include "../lighting/light.h"
 #include "../rendering/camera.h"
 #include "../rendering/renderer.h"
+#include "mesh_bvh.h"
 #include <vector>
 
+// how Scene::render skips meshes and instances outside the camera's view
+enum class MeshCulling {
+    NONE,    // everything goes to the renderer
+    LINEAR,  // every object's world bounds are tested
+    BVH      // a hierarchy over the world bounds is walked, linear below BVH_MIN_MESHES
+};
+
+// below this many objects a flat loop over the bounds is as fast as walking a tree
+constexpr size_t BVH_MIN_MESHES = 256;
+
+// objects (meshes, compact meshes, mapped meshes and instances) tested and skipped by the last Scene::render
+struct CullStats {
+    size_t objects = 0;         // meshes, compact meshes, mapped meshes and instances in the scene
+    size_t objects_culled = 0;  // outside the frustum, never sent to the renderer
+    size_t nodes_visited = 0;   // hierarchy nodes tested, 0 for linear culling
+};
+
+// level-of-detail choices of the last Scene::render, over the visible meshes that have a chain
+struct LodStats {
+    size_t meshes = 0;           // visible meshes with a level-of-detail chain
+    size_t reduced = 0;          // of those, drawn from a coarser level
+    size_t full_triangles = 0;   // their triangles at full detail
+    size_t drawn_triangles = 0;  // their triangles as drawn
+    size_t switched = 0;         // drawn at a different level than in the frame before
+};
+
+// bytes held by the scene's geometry
+struct SceneMemory {
+    size_t mesh_bytes = 0;      // meshes owned by the scene, one full copy each
+    size_t compact_bytes = 0;   // compact meshes owned by the scene
+    size_t mapped_bytes = 0;    // cache files mapped by mapped meshes, backed by the page cache
+    size_t shared_bytes = 0;    // distinct meshes referenced by instances, counted once
+    size_t instance_bytes = 0;  // instance records
+    size_t lod_bytes = 0;       // coarser levels of meshes
+    
+    size_t total() const {
+        return mesh_bytes + compact_bytes + mapped_bytes + shared_bytes + instance_bytes + lod_bytes;
+    }
+};
+
 // scene class managing all elements of a 3d scene
 // provides high-level interface for scene setup and rendering
 class Scene {
 public:
     std::vector<Mesh> meshes;   // all 3d objects in the scene
+    std::vector<CompactMesh> compact_meshes;  // quantized meshes, drawn after meshes
+    std::vector<MappedMesh> mapped_meshes;    // meshes mapped from cache files, drawn after compact meshes
+    std::vector<MeshInstance> instances;  // placements of shared meshes, drawn after meshes
     std::vector<Light> lights;  // all light sources
     Camera camera;              // viewpoint for rendering
     
@@ -23,16 +71,86 @@ public:
     
     // scene setup methods
     void add_mesh(const Mesh& mesh);        // add 3d object to scene
+    void add_compact_mesh(const CompactMesh& mesh);   // add quantized object, for large meshes; flat shading
+                                                      // rebuilds its face normals, about 10% slower
+    void add_mapped_mesh(MappedMesh&& mesh);          // add object drawn straight from a mesh cache
+    void add_instance(const MeshInstance& instance);  // place shared geometry without copying it
     void add_light(const Light& light);     // add light source
     void create_demo_scene();               // setup example scene with various objects
     
-    // rendering methods
-    void render(Renderer& renderer, bool wireframe = false);  // render entire scene
+    // rendering methods; shadow maps are brought up to date first when the renderer has them on
+    void render(Renderer& renderer, bool wireframe = false,    // render entire scene
+                bool flat_shading = true);
     void clear_scene();                                       // remove all objects and lights
     
+    // frustum culling of whole meshes and instances before they reach the renderer
+    void set_mesh_culling(MeshCulling mode) { mesh_culling = mode; }
+    MeshCulling get_mesh_culling() const { return mesh_culling; }
+    const CullStats& get_cull_stats() const { return cull_stats; }
+    
+    // level of detail for meshes: generate_lods builds a chain for each mesh in meshes, by index,
+    // and render draws the coarsest level whose error projects to at most pixel_error pixels at
+    // the mesh's nearest point. a level only gets coarser once its error is below
+    // (1 - hysteresis) * pixel_error, so a camera hovering at a threshold does not flicker.
+    // meshes added later have no chain until the next call; clear_scene drops the chains
+    void generate_lods(const LodSettings& settings = LodSettings());
+    void set_lod_error(float pixel_error, float hysteresis = 0.25f);
+    void clear_lods();
+    const LodStats& get_lod_stats() const { return lod_stats; }
+    
+    // world bounds are cached; adding or removing meshes and instances refreshes them, code that
+    // moves them or edits vertices in place calls update_bounds() afterwards
+    void update_bounds();
+    
+    // indices of the objects the camera can see, in scene order: index i below get_mesh_count()
+    // is meshes[i], then come compact_meshes, mapped_meshes and instances from get_first_instance() on
+    const std::vector<uint32_t>& find_visible_objects();
+    
     // scene information
     size_t get_mesh_count() const { return meshes.size(); }
+    size_t get_compact_mesh_count() const { return compact_meshes.size(); }
+    size_t get_mapped_mesh_count() const { return mapped_meshes.size(); }
+    size_t get_instance_count() const { return instances.size(); }
+    size_t get_first_instance() const { return meshes.size() + compact_meshes.size() + mapped_meshes.size(); }
     size_t get_light_count() const { return lights.size(); }
+    SceneMemory get_memory_usage() const;
+    
+private:
+    MeshCulling mesh_culling = MeshCulling::BVH;
+    CullStats cull_stats;
+    
+    std::vector<std::vector<MeshLod>> mesh_lods;  // coarser levels of meshes[i], empty when none
+    std::vector<uint8_t> lod_levels;              // level each mesh was last drawn at, 0 = full
+    float lod_pixel_error = 1.0f;
+    float lod_hysteresis = 0.25f;
+    LodStats lod_stats;
+    
+    const Mesh& select_lod(size_t mesh, float pixels_per_unit);
+    
+    // world-space bounds of each object in scene order, valid while the counts match
+    std::vector<Aabb> world_bounds;
+    std::vector<BoundingSphere> world_spheres;
+    size_t bounds_mesh_count = 0;
+    size_t bounds_compact_count = 0;
+    size_t bounds_mapped_count = 0;
+    size_t bounds_instance_count = 0;
+    bool bounds_valid = false;
+    MeshBvh bvh;
+    bool bvh_valid = false;
+    std::vector<uint32_t> visible_objects;
+    std::vector<uint64_t> visible_bits;
+    
+    // visible instances are handed to the renderer grouped by mesh, so each group can be batched
+    std::vector<uint32_t> instance_groups;  // group of each instance, numbered by first appearance
+    std::vector<uint32_t> group_offsets;
+    std::vector<const MeshInstance*> visible_instances;
+    
+    void group_visible_instances(const uint32_t* visible, size_t count);
+    
+    // every object, visible or not, as a shadow caster; meshes cast at full detail so a level
+    // switch does not redraw the shadow maps
+    std::vector<ShadowCaster> shadow_casters;
+    void gather_shadow_casters();
 };
 
 #endif